@@ -0,0 +1,32 @@
+find_package(PkgConfig QUIET)
+if(PKG_CONFIG_FOUND)
+  pkg_check_modules(PC_LZ4 QUIET liblz4)
+  if(PC_LZ4_FOUND)
+    set(LZ4_VERSION_STRING ${PC_LZ4_VERSION})
+  endif()
+endif()
+
+find_path(LZ4_INCLUDE_DIR
+  NAMES lz4.h
+  HINTS ${PC_LZ4_INCLUDE_DIRS})
+
+find_library(LZ4_LIBRARY
+  NAMES lz4 lz4_static
+  HINTS ${PC_LZ4_LIBRARY_DIRS})
+
+if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY AND NOT TARGET lz4::lz4)
+  add_library(lz4::lz4 UNKNOWN IMPORTED)
+  set_target_properties(lz4::lz4 PROPERTIES
+    INTERFACE_INCLUDE_DIRECTORIES "${LZ4_INCLUDE_DIR}"
+    IMPORTED_LINK_INTERFACE_LANGUAGES "C"
+    IMPORTED_LOCATION "${LZ4_LIBRARY}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(lz4
+  REQUIRED_VARS LZ4_LIBRARY LZ4_INCLUDE_DIR
+  VERSION_VAR LZ4_VERSION_STRING)
+
+mark_as_advanced(
+  LZ4_INCLUDE_DIR
+  LZ4_LIBRARY)
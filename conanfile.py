@@ -20,6 +20,8 @@ class ousterSdkRecipe(ConanFile):
         "build_viz": [True, False],
         "build_pcap": [True, False],
         "build_osf": [True, False],
+        "osf_zstd": [True, False],
+        "osf_lz4": [True, False],
         "shared": [True, False],
         "fPIC": [True, False],
         "ensure_cpp17": [True, False],
@@ -29,6 +31,8 @@ class ousterSdkRecipe(ConanFile):
         "build_viz": False,
         "build_pcap": False,
         "build_osf": False,
+        "osf_zstd": True,
+        "osf_lz4": True,
         "shared": False,
         "fPIC": True,
         "ensure_cpp17": False,
@@ -63,6 +67,10 @@ class ousterSdkRecipe(ConanFile):
     def configure(self):
         if self.options.shared:
             self.options.rm_safe("fPIC")
+        # optional OSF field codecs, see OUSTER_OSF_USE_* in ouster_osf
+        if not self.options.build_osf:
+            self.options.rm_safe("osf_zstd")
+            self.options.rm_safe("osf_lz4")
 
     def requirements(self):
         # not required directly here but because boost and openssl pulling
@@ -85,6 +93,10 @@ class ousterSdkRecipe(ConanFile):
         if self.options.build_osf:
             self.requires("flatbuffers/23.5.26")
             self.requires("libpng/1.6.39")
+            if self.options.osf_zstd:
+                self.requires("zstd/1.5.5")
+            if self.options.osf_lz4:
+                self.requires("lz4/1.9.4")
 
         if self.options.build_viz:
             self.requires("glad/0.1.34")
@@ -108,6 +120,9 @@ class ousterSdkRecipe(ConanFile):
         tc.variables["BUILD_VIZ"] = self.options.build_viz
         tc.variables["BUILD_PCAP"] = self.options.build_pcap
         tc.variables["BUILD_OSF"] = self.options.build_osf
+        if self.options.build_osf:
+            tc.variables["OUSTER_OSF_USE_ZSTD"] = self.options.osf_zstd
+            tc.variables["OUSTER_OSF_USE_LZ4"] = self.options.osf_lz4
         tc.variables[
             "OUSTER_USE_EIGEN_MAX_ALIGN_BYTES_32"
         ] = self.options.eigen_max_align_bytes
@@ -216,6 +216,41 @@ bool read_imu_packet(const client& cli, uint8_t* buf, const packet_format& pf);
  */
 bool read_imu_packet(const client& cli, ImuPacket& packet);
 
+/**
+ * Read up to `n` lidar packets from the sensor in a single batch. Will not
+ * block.
+ *
+ * On Linux this drains the socket with one recvmmsg() call and sets each
+ * packet's host_timestamp from the kernel receive timestamp. On other
+ * platforms at most one packet is read per call.
+ *
+ * @param[in] cli client returned by init_client associated with the connection.
+ * @param[out] packets array of at least `n` LidarPackets to store lidar data
+ * read from a sensor. Expects each packet to have *correct* number of bytes
+ * allocated for the packet. Packets of unexpected size are dropped, so the
+ * packets read are always stored contiguously at the front of the array.
+ * @param[in] n maximum number of packets to read.
+ *
+ * @return the number of lidar packets successfully read.
+ */
+size_t read_lidar_packets(const client& cli, LidarPacket* packets, size_t n);
+
+/**
+ * Read up to `n` imu packets from the sensor in a single batch. Will not
+ * block.
+ *
+ * See read_lidar_packets() for platform specifics.
+ *
+ * @param[in] cli client returned by init_client associated with the connection.
+ * @param[out] packets array of at least `n` ImuPackets to store imu data read
+ * from a sensor. Expects each packet to have *correct* number of bytes
+ * allocated for the packet.
+ * @param[in] n maximum number of packets to read.
+ *
+ * @return the number of imu packets successfully read.
+ */
+size_t read_imu_packets(const client& cli, ImuPacket* packets, size_t n);
+
 /**
  * Get metadata text blob from the sensor.
  *
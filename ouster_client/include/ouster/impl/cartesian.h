@@ -14,11 +14,6 @@ namespace ouster {
 #endif
 #endif
 
-template <typename T>
-using PointsT = Eigen::Array<T, -1, 3>;
-using PointsD = PointsT<double>;
-using PointsF = PointsT<float>;
-
 /**
  * Converts a staggered range image to Cartesian points.
  *
@@ -5,12 +5,20 @@
 
 #pragma once
 
+#include <memory>
+
+#include "ouster/client.h"
+#include "ouster/types.h"
+
 namespace ouster {
 namespace sensor {
 namespace impl {
 
 /**
  * Poller used in multiclient scenarios
+ *
+ * On Linux this is an edge-triggered epoll set with persistent registration,
+ * elsewhere it falls back to select().
  */
 struct client_poller;
 
@@ -22,6 +30,9 @@ std::shared_ptr<client_poller> make_poller();
 /**
  * Reset poller. Must be called prior to any other operations
  *
+ * Clients that are not set again with `set_poll` before the next `poll` call
+ * stop being watched.
+ *
  * @param[in] poller client_poller to reset
  */
 void reset_poll(client_poller& poller);
@@ -65,6 +76,40 @@ client_state get_error(const client_poller& poller);
  */
 client_state get_poll(const client_poller& poller, const client& cli);
 
+/**
+ * Signal that data of the given kind was drained from a client's sockets
+ *
+ * Edge-triggered backends only report new arrivals, so a socket is reported
+ * by `get_poll` until it is cleared here. Should be called once the socket
+ * returns fewer datagrams than requested. No-op for level-triggered backends.
+ *
+ * @param[in] poller client_poller
+ * @param[in] cli client that was read from
+ * @param[in] st combination of LIDAR_DATA and IMU_DATA to clear
+ */
+void clear_poll(client_poller& poller, const client& cli, client_state st);
+
+/**
+ * Read a batch of packets from the socket corresponding to `st`
+ *
+ * Same as read_lidar_packets() / read_imu_packets(), but takes pointers to
+ * packets so that the destinations don't have to be contiguous, e.g. when
+ * writing straight into ring buffer slots.
+ *
+ * @param[in] cli client to read from
+ * @param[in] st one of LIDAR_DATA or IMU_DATA
+ * @param[out] packets array of at least `n` pointers to packets to read into
+ * @param[in] n maximum number of packets to read
+ * @param[out] drained set when the socket returned fewer datagrams than
+ *             requested, i.e. it was drained and `clear_poll` should be called.
+ *             Datagrams dropped for having an unexpected size still count as
+ *             received, so a short return value alone does not imply this
+ *
+ * @return number of packets read, stored in packets[0..return value)
+ */
+size_t read_packets(const client& cli, client_state st, Packet* const* packets,
+                    size_t n, bool& drained);
+
 }  // namespace impl
 }  // namespace sensor
 }  // namespace ouster
@@ -6,8 +6,11 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <vector>
 
 #include "ouster/field.h"
 #include "ouster/impl/packet_writer.h"
@@ -365,26 +368,84 @@ void scan_to_packets(const LidarScan& ls,
 
 }  // namespace impl
 
-template <typename T>
-inline img_t<T> destagger(const Eigen::Ref<const img_t<T>>& img,
-                          const std::vector<int>& pixel_shift_by_row,
-                          bool inverse) {
-    const size_t h = img.rows();
-    const size_t w = img.cols();
+namespace impl {
+
+/**
+ * Number of columns a row is rotated right by when destaggering.
+ *
+ * @param[in] shift pixel shift of the row.
+ * @param[in] w image width.
+ * @param[in] inverse rotate the opposite way, i.e. stagger.
+ *
+ * @return rotation in [0, w).
+ */
+inline std::ptrdiff_t destagger_offset(int shift, std::ptrdiff_t w,
+                                       bool inverse) {
+    const std::ptrdiff_t s = (inverse ? -shift : shift) % w;
+    return s < 0 ? s + w : s;
+}
 
-    if (pixel_shift_by_row.size() != h)
+}  // namespace impl
+
+template <typename T>
+inline void destagger_into(Eigen::Ref<img_t<T>> dst,
+                           const Eigen::Ref<const img_t<T>>& src,
+                           const std::vector<int>& pixel_shift_by_row,
+                           bool inverse) {
+    const std::ptrdiff_t h = src.rows();
+    const std::ptrdiff_t w = src.cols();
+
+    if (pixel_shift_by_row.size() != static_cast<size_t>(h))
         throw std::invalid_argument{"image height does not match shifts size"};
+    if (dst.rows() != h || dst.cols() != w)
+        throw std::invalid_argument{"destination image size mismatch"};
+    if (w == 0) return;
+    if (dst.data() == src.data() && dst.outerStride() == src.outerStride()) {
+        destagger_in_place<T>(dst, pixel_shift_by_row, inverse);
+        return;
+    }
 
-    img_t<T> destaggered{h, w};
-    for (size_t u = 0; u < h; u++) {
+#ifdef __OUSTER_UTILIZE_OPENMP__
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::ptrdiff_t u = 0; u < h; u++) {
         const std::ptrdiff_t offset =
-            ((inverse ? -1 : 1) * pixel_shift_by_row[u] + w) % w;
+            impl::destagger_offset(pixel_shift_by_row[u], w, inverse);
+        const T* const s = src.data() + u * src.outerStride();
+        T* const d = dst.data() + u * dst.outerStride();
+        std::copy(s, s + (w - offset), d + offset);
+        std::copy(s + (w - offset), s + w, d);
+    }
+}
+
+template <typename T>
+inline void destagger_in_place(Eigen::Ref<img_t<T>> img,
+                               const std::vector<int>& pixel_shift_by_row,
+                               bool inverse) {
+    const std::ptrdiff_t h = img.rows();
+    const std::ptrdiff_t w = img.cols();
+
+    if (pixel_shift_by_row.size() != static_cast<size_t>(h))
+        throw std::invalid_argument{"image height does not match shifts size"};
+    if (w == 0) return;
 
-        destaggered.row(u).segment(offset, w - offset) =
-            img.row(u).segment(0, w - offset);
-        destaggered.row(u).segment(0, offset) =
-            img.row(u).segment(w - offset, offset);
+#ifdef __OUSTER_UTILIZE_OPENMP__
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::ptrdiff_t u = 0; u < h; u++) {
+        const std::ptrdiff_t offset =
+            impl::destagger_offset(pixel_shift_by_row[u], w, inverse);
+        T* const row = img.data() + u * img.outerStride();
+        std::rotate(row, row + (w - offset), row + w);
     }
+}
+
+template <typename T>
+inline img_t<T> destagger(const Eigen::Ref<const img_t<T>>& img,
+                          const std::vector<int>& pixel_shift_by_row,
+                          bool inverse) {
+    img_t<T> destaggered{img.rows(), img.cols()};
+    destagger_into<T>(destaggered, img, pixel_shift_by_row, inverse);
     return destaggered;
 }
 
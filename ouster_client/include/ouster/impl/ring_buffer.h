@@ -8,6 +8,9 @@
 #include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -18,7 +21,13 @@ namespace impl {
 /**
  * Ring buffer class for internal use.
  *
- * This is NOT thread safe, thread safety is delegated to the user.
+ * Lock-free for a single producer and a single consumer: the write index is
+ * only advanced by the producer and the read index only by the consumer, and
+ * both live on separate cache lines to avoid false sharing. Storage is
+ * rounded up to a power of two so that slots are addressed by masking
+ * free-running indices.
+ *
+ * Any other use is NOT thread safe, thread safety is delegated to the user.
  * Correct read/write procedure is:
  * \code
  * auto rb = RingBuffer<T>{size, T{...}};
@@ -44,32 +53,51 @@ class RingBuffer {
     static_assert(std::is_copy_constructible<T>::value,
                   "must be copy constructible");
 
-    std::atomic<size_t> r_idx_, w_idx_;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    std::atomic<size_t> r_idx_;
+    char r_pad_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> w_idx_;
+    char w_pad_[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+    size_t capacity_;
+    size_t mask_;
     std::vector<T> bufs_;
 
-    size_t _capacity() const { return bufs_.size(); }
+    static size_t _storage_size(size_t size) {
+        size_t n = 1;
+        while (n < size) n <<= 1;
+        return n;
+    }
+
+    size_t _read_idx() const { return r_idx_.load(std::memory_order_acquire); }
+    size_t _write_idx() const { return w_idx_.load(std::memory_order_acquire); }
 
    public:
     RingBuffer(size_t size, T value = {})
-        : r_idx_(0), w_idx_(0), bufs_(size + 1, value) {}
-
-    RingBuffer(RingBuffer&& other) {
+        : r_idx_(0),
+          w_idx_(0),
+          capacity_(size),
+          mask_(_storage_size(size) - 1),
+          bufs_(_storage_size(size), value) {}
+
+    RingBuffer(RingBuffer&& other)
+        : r_idx_(other.r_idx_.load()),
+          w_idx_(other.w_idx_.load()),
+          capacity_(other.capacity_),
+          mask_(other.mask_) {
         std::swap(bufs_, other.bufs_);
-        r_idx_ = other.r_idx_.load();
-        w_idx_ = other.w_idx_.load();
     }
 
     /**
      * Report the total capacity of allocated elements.
      */
-    size_t capacity() const { return _capacity() - 1; }
+    size_t capacity() const { return capacity_; }
 
     /**
      * Report the size of currently used elements.
      */
-    size_t size() const {
-        return (_capacity() + w_idx_ - r_idx_) % _capacity();
-    }
+    size_t size() const { return _write_idx() - _read_idx(); }
 
     /**
      * Check whether ring buffer is empty.
@@ -83,7 +111,7 @@ class RingBuffer {
      *    }
      * \endcode
      */
-    bool empty() const { return w_idx_ == r_idx_; }
+    bool empty() const { return _write_idx() == _read_idx(); }
 
     /**
      * Check whether ring buffer is empty.
@@ -97,50 +125,66 @@ class RingBuffer {
      *    }
      * \endcode
      */
-    bool full() const { return r_idx_ == ((w_idx_ + 1) % _capacity()); }
+    bool full() const { return size() >= capacity_; }
 
     /**
      * Get element at the front of the ring buffer.
      */
-    T& front() { return bufs_[r_idx_]; }
-    const T& front() const { return bufs_[r_idx_]; }
+    T& front() { return bufs_[_read_idx() & mask_]; }
+    const T& front() const { return bufs_[_read_idx() & mask_]; }
 
     /**
      * Get element at the back of the ring buffer.
      */
-    T& back() { return bufs_[w_idx_]; }
-    const T& back() const { return bufs_[w_idx_]; }
+    T& back() { return bufs_[_write_idx() & mask_]; }
+    const T& back() const { return bufs_[_write_idx() & mask_]; }
+
+    /**
+     * Get element `offset` positions past the back of the ring buffer.
+     *
+     * Allows writing into several free slots before committing them with
+     * push(n). Only valid for offset < space().
+     */
+    T& back(size_t offset) { return bufs_[(_write_idx() + offset) & mask_]; }
+
+    /**
+     * Report the number of elements that can be pushed before the ring buffer
+     * is full.
+     */
+    size_t space() const { return capacity() - size(); }
 
     /**
      * Flush the ring buffer, making it empty.
      */
-    void flush() { r_idx_ = w_idx_.load(); };
+    void flush() { r_idx_.store(_write_idx(), std::memory_order_release); };
 
     /**
-     * Atomically increment read index.
+     * Increment read index, releasing the front element to the producer.
      *
      * Throws if ring buffer is empty.
      */
     void pop() {
         if (empty()) throw std::underflow_error("popped an empty ring buffer");
-        size_t read_idx = r_idx_.load();
-        while (!r_idx_.compare_exchange_strong(read_idx,
-                                               (read_idx + 1) % _capacity())) {
-        }
+        r_idx_.store(r_idx_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
     }
 
     /**
-     * Atomically increment write index.
+     * Increment write index, publishing the back element to the consumer.
      *
      * Throws if ring buffer is full.
      */
-    void push() {
-        if (full()) throw std::overflow_error("pushed a full ring buffer");
-        size_t write_idx = r_idx_.load();
-        // atomic increment modulo
-        while (!w_idx_.compare_exchange_strong(write_idx,
-                                               (write_idx + 1) % _capacity())) {
-        }
+    void push() { push(1); }
+
+    /**
+     * Advance write index by n elements.
+     *
+     * Throws if there is not enough space for n elements.
+     */
+    void push(size_t n) {
+        if (n > space()) throw std::overflow_error("pushed a full ring buffer");
+        w_idx_.store(w_idx_.load(std::memory_order_relaxed) + n,
+                     std::memory_order_release);
     }
 };
 
@@ -192,6 +236,14 @@ class RingBufferMap {
     V& back(const K& key) { return rb_map_.at(key).back(); }
     const V& back(const K& key) const { return rb_map_.at(key).back(); }
 
+    /**
+     * Retrieve value `offset` positions past the back of the ring buffer at
+     * specified key.
+     */
+    V& back(const K& key, size_t offset) {
+        return rb_map_.at(key).back(offset);
+    }
+
     /**
      * Advance read index of the ring buffer at specified key.
      */
@@ -202,6 +254,16 @@ class RingBufferMap {
      */
     void push(const K& key) { rb_map_.at(key).push(); }
 
+    /**
+     * Advance write index of the ring buffer at specified key by n elements.
+     */
+    void push(const K& key, size_t n) { rb_map_.at(key).push(n); }
+
+    /**
+     * Report the number of free elements in the ring buffer at specified key.
+     */
+    size_t space(const K& key) const { return rb_map_.at(key).space(); }
+
     /**
      * Check if the ring buffer at specified key is empty.
      */
@@ -515,12 +515,40 @@ inline bool operator!=(const LidarScan& a, const LidarScan& b) {
 }
 /** @}*/
 
-/** Lookup table of beam directions and offsets. */
-struct XYZLut {
-    LidarScan::Points direction;  ///< Lookup table of beam directions
-    LidarScan::Points offset;     ///< Lookup table of beam offsets
+template <typename T>
+using PointsT = Eigen::Array<T, -1, 3>;
+using PointsD = PointsT<double>;
+using PointsF = PointsT<float>;
+
+/**
+ * Lookup table of beam directions and offsets.
+ *
+ * @tparam T the scalar type of the tables, double or float.
+ */
+template <typename T>
+struct XYZLutT {
+    PointsT<T> direction;  ///< Lookup table of beam directions
+    PointsT<T> offset;     ///< Lookup table of beam offsets
+
+    /**
+     * Convert the lookup table to a different precision.
+     *
+     * @tparam U the scalar type of the resulting tables.
+     *
+     * @return a copy of the lookup table with tables of type U.
+     */
+    template <typename U>
+    XYZLutT<U> cast() const {
+        return {direction.template cast<U>(), offset.template cast<U>()};
+    }
 };
 
+/** Double precision lookup table of beam directions and offsets. */
+using XYZLut = XYZLutT<double>;
+
+/** Single precision lookup table of beam directions and offsets. */
+using XYZLutF = XYZLutT<float>;
+
 /**
  * Generate a set of lookup tables useful for computing Cartesian coordinates
  * from ranges.
@@ -598,6 +626,144 @@ LidarScan::Points cartesian(const LidarScan& scan, const XYZLut& lut);
  */
 LidarScan::Points cartesian(const Eigen::Ref<const img_t<uint32_t>>& range,
                             const XYZLut& lut);
+
+/**
+ * Convert a staggered range image to single precision Cartesian points.
+ *
+ * @param[in] range a range image in the same format as the RANGE field of a
+ * LidarScan.
+ * @param[in] lut single precision lookup tables, e.g.
+ * make_xyz_lut(info).cast<float>().
+ *
+ * @return Cartesian points where ith row is a 3D point which corresponds
+ *         to ith pixel in LidarScan where i = row * w + col.
+ */
+PointsF cartesian(const Eigen::Ref<const img_t<uint32_t>>& range,
+                  const XYZLutF& lut);
+
+/**
+ * Convert a staggered range image to Cartesian points, writing into a caller
+ * provided buffer.
+ *
+ * The points buffer is only resized when its row count does not match the
+ * lookup table, so reusing the same buffer across scans does not allocate.
+ * Pixels with a range of zero produce a point at the origin.
+ *
+ * @param[in, out] points the resulting point cloud.
+ * @param[in] range a range image in the same format as the RANGE field of a
+ * LidarScan.
+ * @param[in] lut lookup tables generated by make_xyz_lut, in double or single
+ * precision.
+ */
+template <typename T>
+void cartesian_into(PointsT<T>& points,
+                    const Eigen::Ref<const img_t<uint32_t>>& range,
+                    const XYZLutT<T>& lut);
+
+/**
+ * Convert LidarScan to Cartesian points, writing into a caller provided
+ * buffer.
+ *
+ * @param[in, out] points the resulting point cloud.
+ * @param[in] scan a LidarScan.
+ * @param[in] lut lookup tables generated by make_xyz_lut, in double or single
+ * precision.
+ */
+template <typename T>
+void cartesian_into(PointsT<T>& points, const LidarScan& scan,
+                    const XYZLutT<T>& lut);
+
+/**
+ * Lookup table of beam directions and offsets with the pixel shifts of the
+ * sensor baked in.
+ *
+ * The tables are indexed by destaggered pixel, so projecting a staggered range
+ * image with it produces destaggered points in a single pass, without
+ * destaggering the range image first.
+ *
+ * @tparam T the scalar type of the tables, double or float.
+ */
+template <typename T>
+struct DestaggeredXYZLutT {
+    PointsT<T> direction;                 ///< Directions, destaggered order
+    PointsT<T> offset;                    ///< Offsets, destaggered order
+    std::vector<int> pixel_shift_by_row;  ///< Shifts baked into the tables
+
+    /**
+     * Convert the lookup table to a different precision.
+     *
+     * @tparam U the scalar type of the resulting tables.
+     *
+     * @return a copy of the lookup table with tables of type U.
+     */
+    template <typename U>
+    DestaggeredXYZLutT<U> cast() const {
+        return {direction.template cast<U>(), offset.template cast<U>(),
+                pixel_shift_by_row};
+    }
+};
+
+/** Double precision destaggering lookup table. */
+using DestaggeredXYZLut = DestaggeredXYZLutT<double>;
+
+/** Single precision destaggering lookup table. */
+using DestaggeredXYZLutF = DestaggeredXYZLutT<float>;
+
+/**
+ * Reorder an xyz lut so that it projects staggered ranges to destaggered
+ * points.
+ *
+ * @param[in] lut lookup tables generated by make_xyz_lut.
+ * @param[in] pixel_shift_by_row offsets, usually queried from the sensor.
+ *
+ * @return the destaggering lookup table.
+ */
+template <typename T>
+DestaggeredXYZLutT<T> make_destaggered_xyz_lut(
+    const XYZLutT<T>& lut, const std::vector<int>& pixel_shift_by_row);
+
+/**
+ * Convenient overload that uses parameters from the supplied sensor_info.
+ *
+ * @param[in] sensor metadata returned from the client.
+ *
+ * @return the destaggering lookup table.
+ */
+inline DestaggeredXYZLut make_destaggered_xyz_lut(
+    const sensor::sensor_info& sensor) {
+    return make_destaggered_xyz_lut(make_xyz_lut(sensor),
+                                    sensor.format.pixel_shift_by_row);
+}
+
+/**
+ * Convert a staggered range image to destaggered Cartesian points, writing
+ * into a caller provided buffer.
+ *
+ * Equivalent to projecting and then destaggering each coordinate, but done in
+ * one pass over the range image.
+ *
+ * @param[in, out] points the resulting point cloud, where ith row corresponds
+ * to ith pixel of the destaggered image.
+ * @param[in] range a staggered range image in the same format as the RANGE
+ * field of a LidarScan.
+ * @param[in] lut lookup tables generated by make_destaggered_xyz_lut.
+ */
+template <typename T>
+void cartesian_into(PointsT<T>& points,
+                    const Eigen::Ref<const img_t<uint32_t>>& range,
+                    const DestaggeredXYZLutT<T>& lut);
+
+/**
+ * Convert LidarScan to destaggered Cartesian points, writing into a caller
+ * provided buffer.
+ *
+ * @param[in, out] points the resulting point cloud.
+ * @param[in] scan a LidarScan.
+ * @param[in] lut lookup tables generated by make_destaggered_xyz_lut.
+ */
+template <typename T>
+void cartesian_into(PointsT<T>& points, const LidarScan& scan,
+                    const DestaggeredXYZLutT<T>& lut);
 /** @}*/
 
 /** \defgroup ouster_client_destagger Ouster Client lidar_scan.h
@@ -627,6 +793,40 @@ inline img_t<T> destagger(const Eigen::Ref<const img_t<T>>& img,
                           const std::vector<int>& pixel_shift_by_row,
                           bool inverse = false);
 
+/**
+ * Destagger a channel field into a caller provided image.
+ *
+ * Same as destagger(), without allocating the result. With OpenMP enabled
+ * rows are processed in parallel.
+ *
+ * @tparam T the datatype of the channel field.
+ *
+ * @param[out] dst the destination image, must have the same size as src. May
+ * be the same image as src, in which case it is destaggered in place.
+ * @param[in] src the channel field.
+ * @param[in] pixel_shift_by_row offsets, usually queried from the sensor.
+ * @param[in] inverse perform the inverse operation.
+ */
+template <typename T>
+inline void destagger_into(Eigen::Ref<img_t<T>> dst,
+                           const Eigen::Ref<const img_t<T>>& src,
+                           const std::vector<int>& pixel_shift_by_row,
+                           bool inverse = false);
+
+/**
+ * Destagger a channel field in place by rotating each row.
+ *
+ * @tparam T the datatype of the channel field.
+ *
+ * @param[in, out] img the channel field.
+ * @param[in] pixel_shift_by_row offsets, usually queried from the sensor.
+ * @param[in] inverse perform the inverse operation, i.e. stagger in place.
+ */
+template <typename T>
+inline void destagger_in_place(Eigen::Ref<img_t<T>> img,
+                               const std::vector<int>& pixel_shift_by_row,
+                               bool inverse = false);
+
 /**
  * Generate a staggered version of a channel field.
  *
@@ -658,7 +858,18 @@ class ScanBatcher {
     std::vector<uint8_t> cache;
     uint64_t cache_packet_ts;
     bool cached_packet = false;
-
+    // channel field destinations resolved for the fields of the last scan
+    std::vector<sensor::packet_format::FieldDest> field_dests;
+    // name, data and layout of every field the destinations were resolved for
+    struct DestsField {
+        std::string name;
+        const void* data;
+        FieldDescriptor desc;
+    };
+    std::vector<DestsField> dests_fields;
+
+    const std::vector<sensor::packet_format::FieldDest>& _field_dests(
+        LidarScan& ls);
     void _parse_by_col(const uint8_t* packet_buf, LidarScan& ls);
     void _parse_by_block(const uint8_t* packet_buf, LidarScan& ls);
 
@@ -1077,10 +1077,6 @@ class packet_format {
     template <typename T>
     T px_field(const uint8_t* px_buf, const std::string& i) const;
 
-    template <typename T, typename SRC, int N>
-    void block_field_impl(Eigen::Ref<img_t<T>> field, const std::string& i,
-                          const uint8_t* packet_buf) const;
-
     struct Impl;
     std::shared_ptr<const Impl> impl_;
 
@@ -1298,6 +1294,46 @@ class packet_format {
     void block_field(Eigen::Ref<img_t<T>> field, const std::string& f,
                      const uint8_t* lidar_buf) const;
 
+    /**
+     * Destination of a single channel field for block_fields().
+     */
+    struct FieldDest {
+        size_t field;        ///< position of the channel field in iteration
+                             ///< order of this packet_format
+        ChanFieldType type;  ///< element type of data
+        void* data;  ///< row-major array with pixels_per_column rows
+        int cols;    ///< number of columns of data
+    };
+
+    /**
+     * Copy several channel fields out of a packet in a single pass.
+     *
+     * Produces the same result as calling block_field() for every
+     * destination, but walks the packet only once: every field is decoded
+     * from a small tile of pixel rows while the tile is still in cache.
+     *
+     * @tparam BlockDim block size, as returned by block_parsable().
+     *
+     * @param[in] dests destinations of the fields to copy.
+     * @param[in] lidar_buf the lidar buffer.
+     */
+    template <int BlockDim>
+    void block_fields(const std::vector<FieldDest>& dests,
+                      const uint8_t* lidar_buf) const;
+
+    /**
+     * Copy several channel fields out of a single measurement column.
+     *
+     * Produces the same result as calling col_field() for every destination
+     * without looking fields up by name.
+     *
+     * @param[in] dests destinations of the fields to copy.
+     * @param[in] col_buf the column buffer.
+     * @param[in] col column of the destinations to write.
+     */
+    void col_fields(const std::vector<FieldDest>& dests,
+                    const uint8_t* col_buf, int col) const;
+
     // Per-pixel channel data block accessors
     /**
      * Get pointer to nth pixel of a column buffer.
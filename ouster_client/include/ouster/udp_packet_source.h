@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
@@ -25,6 +26,7 @@
 #include <mutex>
 #include <numeric>
 #include <stdexcept>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -76,43 +78,103 @@ using EventSet = std::unordered_set<Event>;
  * Two main ways of usage are: one queue per multiple consumers, using
  * next(events) to have consumers wait on specific events, or using
  * multiple queues, one per consumer, as implemented in publisher/subscriber.
+ *
+ * To keep the per-event cost low on the hot producer -> subscriber path,
+ * consumers spin for an adaptively sized number of iterations before going
+ * to sleep, and pushes only notify the condition variable when a consumer is
+ * actually sleeping on it. Batches of events should be pushed with a single
+ * call. Spinning never runs past the deadline of a timed wait.
  */
 class EventQueue {
+    using clock = std::chrono::steady_clock;
+
+    static constexpr int MIN_SPIN = 16;
+    static constexpr int MAX_SPIN = 4096;
+
     mutable std::mutex m;
     mutable std::condition_variable cv;
     std::deque<Event> q;
 
+    // mirrors q.size(), written under the lock, read lock-free when spinning
+    std::atomic<size_t> size_{0};
+    // number of threads blocked on cv, guarded by m
+    int waiters_{0};
+    // current spin budget, grown on successful spins and shrunk otherwise.
+    // Shared by all consumers of the queue: it tunes well for the usual one
+    // consumer per queue (see Publisher/Subscriber), while consumers sharing
+    // a queue through next(events) also share how long they spin
+    std::atomic<int> spin_{MIN_SPIN};
+
+    void _notify(std::unique_lock<std::mutex>& lock) {
+        bool notify = waiters_ > 0;
+        lock.unlock();
+        if (notify) cv.notify_all();
+    }
+
     template <typename Predicate>
-    Event _next(Predicate&& p) {
-        Event e;
-        {
-            std::unique_lock<std::mutex> lock{m};
-            cv.wait(lock, p);
-
-            e = q.front();
-            q.pop_front();
-        }
-        cv.notify_all();
-        return e;
+    bool _wait(std::unique_lock<std::mutex>& lock, Predicate& p) {
+        ++waiters_;
+        cv.wait(lock, p);
+        --waiters_;
+        return true;
     }
 
     template <typename Predicate>
-    Event _next_timeout(float sec, Predicate&& p) {
-        Event e;
-        {
-            std::unique_lock<std::mutex> lock{m};
-            using fsec = std::chrono::duration<float>;
-            bool timeout = !cv.wait_for(lock, fsec{sec}, p);
+    bool _wait(std::unique_lock<std::mutex>& lock, Predicate& p,
+               clock::time_point deadline) {
+        ++waiters_;
+        bool ready = cv.wait_until(lock, deadline, p);
+        --waiters_;
+        return ready;
+    }
 
-            if (timeout) return {-1, client_state::TIMEOUT};
+    static clock::time_point _deadline(float sec) {
+        // roughly 30 years, keeps the conversion within the clock's range
+        constexpr float max_sec = 1e9f;
+        using fsec = std::chrono::duration<float>;
+        return clock::now() +
+               std::chrono::duration_cast<clock::duration>(
+                   fsec{std::min(std::max(sec, 0.0f), max_sec)});
+    }
 
-            e = q.front();
-            q.pop_front();
+    /*
+     * Spin until the queue is non-empty, adapting the spin budget to how often
+     * spinning pays off. Gives up without adapting once the deadline passes.
+     */
+    void _spin(clock::time_point deadline = clock::time_point::max()) {
+        const bool timed = deadline != clock::time_point::max();
+        int budget = spin_.load(std::memory_order_relaxed);
+        for (int i = 0; i < budget; ++i) {
+            if (size_.load(std::memory_order_acquire) > 0) {
+                spin_.store(std::min(budget * 2, MAX_SPIN),
+                            std::memory_order_relaxed);
+                return;
+            }
+            if (timed && clock::now() >= deadline) return;
+            std::this_thread::yield();
         }
-        cv.notify_all();
+        spin_.store(std::max(budget / 2, MIN_SPIN), std::memory_order_relaxed);
+    }
+
+    Event _pop_front(std::unique_lock<std::mutex>& lock) {
+        Event e = q.front();
+        q.pop_front();
+        size_.store(q.size(), std::memory_order_release);
+        _notify(lock);
         return e;
     }
 
+    template <typename Predicate, typename... Deadline>
+    Event _next(Predicate&& p, Deadline... deadline) {
+        if (size_.load(std::memory_order_acquire) == 0) _spin(deadline...);
+
+        std::unique_lock<std::mutex> lock{m};
+        if (!p() && !_wait(lock, p, deadline...))
+            return {-1, client_state::TIMEOUT};
+
+        return _pop_front(lock);
+    }
+
    public:
     /**
      * Push an event to the back of the queue.
@@ -122,11 +184,26 @@ class EventQueue {
      * @param[in] e event
      */
     void push(Event e) {
-        {
-            std::lock_guard<std::mutex> lock{m};
-            q.push_back(e);
-        }
-        cv.notify_all();
+        std::unique_lock<std::mutex> lock{m};
+        q.push_back(e);
+        size_.store(q.size(), std::memory_order_release);
+        _notify(lock);
+    }
+
+    /**
+     * Push n copies of an event to the back of the queue.
+     *
+     * Notifies all threads waiting on the queue once for the whole batch.
+     *
+     * @param[in] e event
+     * @param[in] n number of copies to push
+     */
+    void push(Event e, size_t n) {
+        if (n == 0) return;
+        std::unique_lock<std::mutex> lock{m};
+        q.insert(q.end(), n, e);
+        size_.store(q.size(), std::memory_order_release);
+        _notify(lock);
     }
 
     /**
@@ -139,11 +216,10 @@ class EventQueue {
      */
     template <typename EventIterT>
     void push(EventIterT first, EventIterT last) {
-        {
-            std::lock_guard<std::mutex> lock{m};
-            q.insert(q.end(), first, last);
-        }
-        cv.notify_all();
+        std::unique_lock<std::mutex> lock{m};
+        q.insert(q.end(), first, last);
+        size_.store(q.size(), std::memory_order_release);
+        _notify(lock);
     }
 
     /**
@@ -154,11 +230,10 @@ class EventQueue {
      * @param[in] e event
      */
     void push_priority(Event e) {
-        {
-            std::lock_guard<std::mutex> lock{m};
-            q.push_front(e);
-        }
-        cv.notify_all();
+        std::unique_lock<std::mutex> lock{m};
+        q.push_front(e);
+        size_.store(q.size(), std::memory_order_release);
+        _notify(lock);
     }
 
     /**
@@ -184,7 +259,7 @@ class EventQueue {
      * @return event or Event{-1, client_state::TIMEOUT} in case of timeout
      */
     Event pop(float timeout_sec) {
-        return _next_timeout(timeout_sec, [this] { return !q.empty(); });
+        return _next([this] { return !q.empty(); }, _deadline(timeout_sec));
     }
 
     /**
@@ -214,9 +289,11 @@ class EventQueue {
      * @return event or Event{-1, client_state::TIMEOUT} in case of timeout
      */
     Event next(float timeout_sec, const EventSet& events) {
-        return _next_timeout(timeout_sec, [this, &events] {
-            return !q.empty() && events.count(q.front()) == 1;
-        });
+        return _next(
+            [this, &events] {
+                return !q.empty() && events.count(q.front()) == 1;
+            },
+            _deadline(timeout_sec));
     }
 
     /**
@@ -229,6 +306,7 @@ class EventQueue {
         std::lock_guard<std::mutex> lock{m};
         std::deque<Event> out;
         out.swap(q);
+        size_.store(0, std::memory_order_release);
         return out;
     }
 };
@@ -283,6 +361,16 @@ class Publisher {
         }
     }
 
+    /**
+     * Publish n copies of an event to the publisher queue at once.
+     *
+     * @param[in] e event
+     * @param[in] n number of copies
+     */
+    void publish(Event e, size_t n) {
+        if (accepts(e)) q_->push(e, n);
+    }
+
     /**
      * Retrieve internal event queue.
      *
@@ -293,6 +381,88 @@ class Publisher {
     std::shared_ptr<EventQueue> queue() { return q_; }
 };
 
+class Subscriber;
+
+/**
+ * Borrowed reference to a packet stored in the producer ring buffer.
+ *
+ * Allows consumers (e.g. ScanBatcher) to parse packets in place instead of
+ * copying them out first. The ring buffer slot is returned to the producer
+ * when the lease is released or destroyed.
+ *
+ * Leases of the same event type must be released in the order they were
+ * taken, and only one lease per event type may be outstanding at a time.
+ */
+class PacketLease {
+    Subscriber* sub_;
+    Event e_;
+    Packet* p_;
+
+   public:
+    PacketLease() : sub_(nullptr), e_{-1, client_state::TIMEOUT}, p_(nullptr) {}
+
+    PacketLease(Subscriber* sub, Event e, Packet* p)
+        : sub_(sub), e_(e), p_(p) {}
+
+    PacketLease(PacketLease&& other) : PacketLease() { swap(other); }
+
+    PacketLease& operator=(PacketLease&& other) {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    PacketLease(const PacketLease&) = delete;
+    PacketLease& operator=(const PacketLease&) = delete;
+
+    ~PacketLease() { release(); }
+
+    void swap(PacketLease& other) {
+        std::swap(sub_, other.sub_);
+        std::swap(e_, other.e_);
+        std::swap(p_, other.p_);
+    }
+
+    /**
+     * Check whether the lease holds a packet.
+     */
+    explicit operator bool() const { return p_ != nullptr; }
+
+    /**
+     * Retrieve the event this lease was taken for.
+     */
+    Event event() const { return e_; }
+
+    /**
+     * Retrieve the leased packet. Only valid until release().
+     */
+    const Packet& packet() const { return *p_; }
+
+    /**
+     * Retrieve the leased packet as a lidar packet. Only valid until
+     * release() and if the lease was taken for LIDAR_DATA.
+     */
+    const LidarPacket& lidar_packet() const {
+        return static_cast<const LidarPacket&>(*p_);
+    }
+
+    /**
+     * Retrieve the leased packet as an imu packet. Only valid until
+     * release() and if the lease was taken for IMU_DATA.
+     */
+    const ImuPacket& imu_packet() const {
+        return static_cast<const ImuPacket&>(*p_);
+    }
+
+    /**
+     * Return the packet to the ring buffer. Does nothing if the lease is
+     * empty.
+     */
+    inline void release();
+};
+
 class Subscriber {
    protected:
     std::shared_ptr<EventQueue> q_;
@@ -350,6 +520,21 @@ class Subscriber {
         if (_has_packet(e)) rb_->pop(e);
     }
 
+    /**
+     * Borrow the packet corresponding to the event without copying it.
+     *
+     * The ring buffer read index is advanced when the lease is released, so
+     * advance() must not be called for the event.
+     *
+     * @param[in] e event
+     * @return lease holding the packet, or an empty lease if the event does
+     *         not correspond to any packets
+     */
+    PacketLease lease(Event e) {
+        if (!_has_packet(e)) return {};
+        return {this, e, &rb_->front(e)};
+    }
+
     /**
      * Flush the queue, releasing all corresponding packets from the ring buffer
      */
@@ -366,6 +551,13 @@ class Subscriber {
     }
 };
 
+void PacketLease::release() {
+    if (p_) {
+        sub_->advance(e_);
+        p_ = nullptr;
+    }
+}
+
 class Producer {
    protected:
     std::vector<std::shared_ptr<Publisher>> pubs_;
@@ -512,6 +704,7 @@ class UDPPacketSource : protected Producer, protected Subscriber {
 
     using Subscriber::advance;
     using Subscriber::flush;
+    using Subscriber::lease;
     using Subscriber::packet;
     using Subscriber::pop;
 };
@@ -615,6 +808,20 @@ class BufferedUDPSource : protected Producer, protected Subscriber {
      */
     client_state consume(LidarPacket& lidarp, ImuPacket& imup,
                          float timeout_sec);
+
+    /**
+     * Borrow next available packet in the buffer without copying it.
+     *
+     * Same as consume(LidarPacket&, ImuPacket&, float), except that the packet
+     * is left in the internal buffer and handed out through `lease`, which
+     * releases whatever it was holding before. The buffer slot is returned
+     * once the lease is released or destroyed.
+     *
+     * @param[out] lease lease to hold the packet
+     * @param[in] timeout_sec maximum time to wait for data.
+     * @return client status, see sensor::poll_client().
+     */
+    client_state consume(PacketLease& lease, float timeout_sec);
 };
 
 }  // namespace impl
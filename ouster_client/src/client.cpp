@@ -20,9 +20,14 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
 #include "ouster/impl/client_poller.h"
 #include "ouster/impl/logging.h"
 #include "ouster/impl/netcompat.h"
@@ -56,6 +61,22 @@ namespace {
 // default udp receive buffer size on windows is very low -- use 256K
 const int RCVBUF_SIZE = 1024 * 1024;
 
+// maximum number of datagrams read by a single recvmmsg() call
+constexpr size_t MAX_RECV_BATCH = 64;
+
+// ask the kernel to attach receive timestamps, used by the batched read path
+void socket_set_rx_timestamps(SOCKET sock_fd) {
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_TIMESTAMPNS, (char*)&on,
+                   sizeof(on))) {
+        logger().warn("udp setsockopt(): {}", impl::socket_get_error());
+    }
+#else
+    (void)sock_fd;
+#endif
+}
+
 int32_t get_sock_port(SOCKET sock_fd) {
     struct sockaddr_storage ss;
     socklen_t addrlen = sizeof ss;
@@ -144,6 +165,8 @@ SOCKET udp_data_socket(int port) {
                 continue;
             }
 
+            socket_set_rx_timestamps(sock_fd);
+
             freeaddrinfo(info_start);
             return sock_fd;
         }
@@ -234,6 +257,8 @@ SOCKET mtp_data_socket(int port, const std::string& udp_dest_host = "",
                 continue;
             }
 
+            socket_set_rx_timestamps(sock_fd);
+
             freeaddrinfo(info_start);
             return sock_fd;
         }
@@ -546,48 +571,209 @@ std::shared_ptr<client> mtp_init_client(const std::string& hostname,
 
 namespace impl {
 
+static int select_poll(fd_set& rfds, SOCKET max_fd, int timeout_sec,
+                       client_state& err) {
+    timeval tv;
+    tv.tv_sec = timeout_sec;
+    tv.tv_usec = 0;
+
+    SOCKET retval = select((int)max_fd + 1, &rfds, NULL, NULL, &tv);
+
+    if (!impl::socket_valid(retval)) {
+        if (impl::socket_exit()) {
+            err = client_state::EXIT;
+        } else {
+            logger().error("select: {}", impl::socket_get_error());
+            err = client_state::CLIENT_ERROR;
+        }
+
+        return -1;
+    }
+
+    return (int)retval;
+}
+
+#if defined(__linux__)
+
+/*
+ * Edge-triggered epoll backend. Sockets stay registered across polls, so a
+ * poll costs O(ready sockets) and there is no FD_SETSIZE limit.
+ *
+ * Since an edge is only reported when new data arrives, a socket is reported
+ * as ready until the reader signals with clear_poll() that it was drained.
+ */
 struct client_poller {
-    fd_set rfds;
-    SOCKET max_fd;
+    struct watch {
+        bool ready;
+        uint64_t generation;
+    };
+
+    SOCKET epoll_fd;
+    std::unordered_map<SOCKET, watch> fds;
+    uint64_t generation;
+    size_t n_set;
+    size_t n_ready;
     client_state err;
+
+    client_poller()
+        : epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+          generation(0),
+          n_set(0),
+          n_ready(0),
+          err(client_state::TIMEOUT) {
+        if (!impl::socket_valid(epoll_fd))
+            logger().error("epoll_create1: {}", impl::socket_get_error());
+    }
+
+    ~client_poller() {
+        if (impl::socket_valid(epoll_fd)) impl::socket_close(epoll_fd);
+    }
+
+    client_poller(const client_poller&) = delete;
+    client_poller& operator=(const client_poller&) = delete;
 };
 
 std::shared_ptr<client_poller> make_poller() {
-    return std::make_unique<client_poller>();
+    return std::make_shared<client_poller>();
 }
 
 void reset_poll(client_poller& poller) {
-    FD_ZERO(&poller.rfds);
-    poller.max_fd = 0;
+    ++poller.generation;
+    poller.n_set = 0;
     poller.err = client_state::TIMEOUT;
 }
 
+static void watch_fd(client_poller& poller, SOCKET fd) {
+    auto it = poller.fds.find(fd);
+    if (it != poller.fds.end()) {
+        if (it->second.generation != poller.generation) {
+            it->second.generation = poller.generation;
+            ++poller.n_set;
+        }
+        return;
+    }
+
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(poller.epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+        logger().error("epoll_ctl: {}", impl::socket_get_error());
+        poller.err = client_state::CLIENT_ERROR;
+        return;
+    }
+
+    // data may have been queued before registration, which won't produce an
+    // edge; start out as ready and let the first read find out
+    poller.fds.emplace(fd, client_poller::watch{true, poller.generation});
+    ++poller.n_set;
+    ++poller.n_ready;
+}
+
 void set_poll(client_poller& poller, const client& c) {
-    FD_SET(c.lidar_fd, &poller.rfds);
-    FD_SET(c.imu_fd, &poller.rfds);
-    poller.max_fd = std::max({poller.max_fd, c.lidar_fd, c.imu_fd});
+    watch_fd(poller, c.lidar_fd);
+    watch_fd(poller, c.imu_fd);
 }
 
 int poll(client_poller& poller, int timeout_sec) {
-    timeval tv;
-    tv.tv_sec = timeout_sec;
-    tv.tv_usec = 0;
+    if (!impl::socket_valid(poller.epoll_fd))
+        poller.err = client_state::CLIENT_ERROR;
+    if (poller.err != client_state::TIMEOUT) return -1;
+
+    // stop watching sockets that were not set since the last reset
+    if (poller.n_set != poller.fds.size()) {
+        for (auto it = poller.fds.begin(); it != poller.fds.end();) {
+            if (it->second.generation == poller.generation) {
+                ++it;
+                continue;
+            }
+            epoll_ctl(poller.epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+            if (it->second.ready) --poller.n_ready;
+            it = poller.fds.erase(it);
+        }
+    }
 
-    SOCKET retval =
-        select((int)poller.max_fd + 1, &poller.rfds, NULL, NULL, &tv);
+    // don't block if some sockets still have unread data
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+    int timeout_ms = poller.n_ready ? 0 : timeout_sec * 1000;
+    int n = epoll_wait(poller.epoll_fd, events, max_events, timeout_ms);
 
-    if (!impl::socket_valid(retval)) {
+    if (n < 0) {
         if (impl::socket_exit()) {
             poller.err = client_state::EXIT;
         } else {
-            logger().error("select: {}", impl::socket_get_error());
+            logger().error("epoll_wait: {}", impl::socket_get_error());
             poller.err = client_state::CLIENT_ERROR;
         }
-
         return -1;
     }
 
-    return (int)retval;
+    for (int i = 0; i < n; ++i) {
+        auto it = poller.fds.find(events[i].data.fd);
+        if (it != poller.fds.end() && !it->second.ready) {
+            it->second.ready = true;
+            ++poller.n_ready;
+        }
+    }
+
+    return (int)poller.n_ready;
+}
+
+client_state get_error(const client_poller& poller) { return poller.err; }
+
+static bool fd_ready(const client_poller& poller, SOCKET fd) {
+    auto it = poller.fds.find(fd);
+    return it != poller.fds.end() && it->second.ready;
+}
+
+client_state get_poll(const client_poller& poller, const client& c) {
+    client_state s = client_state(0);
+
+    if (fd_ready(poller, c.lidar_fd)) s = client_state(s | LIDAR_DATA);
+    if (fd_ready(poller, c.imu_fd)) s = client_state(s | IMU_DATA);
+
+    return s;
+}
+
+static void clear_fd(client_poller& poller, SOCKET fd) {
+    auto it = poller.fds.find(fd);
+    if (it != poller.fds.end() && it->second.ready) {
+        it->second.ready = false;
+        --poller.n_ready;
+    }
+}
+
+void clear_poll(client_poller& poller, const client& c, client_state st) {
+    if (st & LIDAR_DATA) clear_fd(poller, c.lidar_fd);
+    if (st & IMU_DATA) clear_fd(poller, c.imu_fd);
+}
+
+#else
+
+struct client_poller {
+    fd_set rfds;
+    SOCKET max_fd;
+    client_state err;
+};
+
+std::shared_ptr<client_poller> make_poller() {
+    return std::make_unique<client_poller>();
+}
+
+void reset_poll(client_poller& poller) {
+    FD_ZERO(&poller.rfds);
+    poller.max_fd = 0;
+    poller.err = client_state::TIMEOUT;
+}
+
+void set_poll(client_poller& poller, const client& c) {
+    FD_SET(c.lidar_fd, &poller.rfds);
+    FD_SET(c.imu_fd, &poller.rfds);
+    poller.max_fd = std::max({poller.max_fd, c.lidar_fd, c.imu_fd});
+}
+
+int poll(client_poller& poller, int timeout_sec) {
+    return select_poll(poller.rfds, poller.max_fd, timeout_sec, poller.err);
 }
 
 client_state get_error(const client_poller& poller) { return poller.err; }
@@ -601,19 +787,32 @@ client_state get_poll(const client_poller& poller, const client& c) {
     return s;
 }
 
+// select() is level-triggered, nothing to track
+void clear_poll(client_poller&, const client&, client_state) {}
+
+#endif
+
 }  // namespace impl
 
 client_state poll_client(const client& c, const int timeout_sec) {
-    impl::client_poller poller;
-    impl::reset_poll(poller);
-    impl::set_poll(poller, c);
-    int res = impl::poll(poller, timeout_sec);
+    // one-shot wait on a single client: a plain select() is cheapest and has
+    // the level-triggered semantics documented for poll_client()
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(c.lidar_fd, &rfds);
+    FD_SET(c.imu_fd, &rfds);
+    client_state err = client_state::TIMEOUT;
+    int res = impl::select_poll(rfds, std::max(c.lidar_fd, c.imu_fd),
+                                timeout_sec, err);
     if (res <= 0) {
         // covers TIMEOUT and error states
-        return impl::get_error(poller);
-    } else {
-        return impl::get_poll(poller, c);
+        return err;
     }
+
+    client_state s = client_state(0);
+    if (FD_ISSET(c.lidar_fd, &rfds)) s = client_state(s | LIDAR_DATA);
+    if (FD_ISSET(c.imu_fd, &rfds)) s = client_state(s | IMU_DATA);
+    return s;
 }
 
 static bool recv_fixed(SOCKET fd, void* buf, int64_t len) {
@@ -631,6 +830,125 @@ static bool recv_fixed(SOCKET fd, void* buf, int64_t len) {
     return false;
 }
 
+static uint64_t host_time_ns() {
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               now.time_since_epoch())
+        .count();
+}
+
+/*
+ * Read up to MAX_RECV_BATCH packets. Packets of unexpected size are dropped
+ * and the remaining ones are compacted to the front of the array. The number
+ * of datagrams taken off the socket is reported in `received`; fewer than `n`
+ * means the socket was drained.
+ */
+static size_t recv_batch(SOCKET fd, Packet* const* packets, size_t n,
+                         size_t& received) {
+    n = std::min(n, MAX_RECV_BATCH);
+    received = 0;
+    if (n == 0) return 0;
+
+#if defined(__linux__)
+    mmsghdr msgs[MAX_RECV_BATCH];
+    iovec iovs[MAX_RECV_BATCH];
+    alignas(cmsghdr) char ctrl[MAX_RECV_BATCH][CMSG_SPACE(sizeof(timespec))];
+
+    std::memset(msgs, 0, n * sizeof(mmsghdr));
+    for (size_t i = 0; i < n; ++i) {
+        // read one byte more than expected to detect oversized packets
+        iovs[i].iov_base = packets[i]->buf.data();
+        iovs[i].iov_len = packets[i]->buf.size() + 1;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = ctrl[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+    }
+
+    int res = recvmmsg(fd, msgs, static_cast<unsigned int>(n), MSG_DONTWAIT,
+                       nullptr);
+    if (res < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            logger().error("recvmmsg: {}", impl::socket_get_error());
+        return 0;
+    }
+
+    received = static_cast<size_t>(res);
+    const uint64_t fallback_ts = host_time_ns();
+    size_t read = 0;
+    for (int i = 0; i < res; ++i) {
+        Packet& p = *packets[i];
+        if (msgs[i].msg_len != p.buf.size()) {
+            logger().warn("Unexpected udp packet length: {}", msgs[i].msg_len);
+            continue;
+        }
+
+        p.host_timestamp = fallback_ts;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msgs[i].msg_hdr); c != nullptr;
+             c = CMSG_NXTHDR(&msgs[i].msg_hdr, c)) {
+            if (c->cmsg_level == SOL_SOCKET &&
+                c->cmsg_type == SCM_TIMESTAMPNS) {
+                timespec ts;
+                std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                p.host_timestamp = static_cast<uint64_t>(ts.tv_sec) *
+                                       1000000000ull +
+                                   static_cast<uint64_t>(ts.tv_nsec);
+            }
+        }
+
+        if (static_cast<size_t>(i) != read) {
+            Packet& dst = *packets[read];
+            std::swap(dst.buf, p.buf);
+            std::swap(dst.host_timestamp, p.host_timestamp);
+        }
+        ++read;
+    }
+    return read;
+#else
+    // no batched receive available; the socket was reported readable, so a
+    // single read is all that is guaranteed not to block. Leave `received` at
+    // zero so that callers stop here
+    Packet& p = *packets[0];
+    p.host_timestamp = host_time_ns();
+    return recv_fixed(fd, p.buf.data(), p.buf.size()) ? 1 : 0;
+#endif
+}
+
+/*
+ * Read up to `n` packets in batches. `drained` is set when the last recvmmsg
+ * call returned fewer datagrams than requested, regardless of how many of them
+ * were dropped for having an unexpected size.
+ */
+static size_t recv_packets(SOCKET fd, Packet* const* packets, size_t n,
+                           bool& drained) {
+    size_t total = 0;
+    drained = false;
+    while (total < n) {
+        size_t batch = std::min(n - total, MAX_RECV_BATCH);
+        size_t received;
+        total += recv_batch(fd, packets + total, batch, received);
+        if (received < batch) {
+            drained = true;
+            break;
+        }
+    }
+    return total;
+}
+
+template <typename PacketT>
+static size_t recv_packets(SOCKET fd, PacketT* packets, size_t n) {
+    Packet* ptrs[MAX_RECV_BATCH];
+    size_t total = 0;
+    while (total < n) {
+        size_t batch = std::min(n - total, MAX_RECV_BATCH);
+        for (size_t i = 0; i < batch; ++i) ptrs[i] = &packets[total + i];
+        size_t received;
+        total += recv_batch(fd, ptrs, batch, received);
+        if (received < batch) break;
+    }
+    return total;
+}
+
 bool read_lidar_packet(const client& cli, uint8_t* buf, size_t bytes) {
     return recv_fixed(cli.lidar_fd, buf, bytes);
 }
@@ -666,6 +984,27 @@ bool read_imu_packet(const client& cli, ImuPacket& packet) {
     return read_imu_packet(cli, packet.buf.data(), packet.buf.size());
 }
 
+size_t read_lidar_packets(const client& cli, LidarPacket* packets, size_t n) {
+    return recv_packets(cli.lidar_fd, packets, n);
+}
+
+size_t read_imu_packets(const client& cli, ImuPacket* packets, size_t n) {
+    return recv_packets(cli.imu_fd, packets, n);
+}
+
+size_t impl::read_packets(const client& cli, client_state st,
+                          Packet* const* packets, size_t n, bool& drained) {
+    switch (st) {
+        case client_state::LIDAR_DATA:
+            return recv_packets(cli.lidar_fd, packets, n, drained);
+        case client_state::IMU_DATA:
+            return recv_packets(cli.imu_fd, packets, n, drained);
+        default:
+            drained = false;
+            return 0;
+    }
+}
+
 int get_lidar_port(const client& cli) { return get_sock_port(cli.lidar_fd); }
 
 int get_imu_port(const client& cli) { return get_sock_port(cli.imu_fd); }
@@ -18,6 +18,11 @@
 #include "ouster/strings.h"
 #include "ouster/types.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OUSTER_CARTESIAN_SIMD_X86
+#endif
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -677,20 +682,247 @@ XYZLut make_xyz_lut(size_t w, size_t h, double range_unit,
     return lut;
 }
 
+namespace impl {
+
+/**
+ * Signature of a kernel projecting pixels [begin, end) of an n pixel image.
+ * Points, direction and offset are column-major n x 3 arrays indexed by
+ * output pixel; rng points at the range of pixel begin and is read
+ * contiguously from there.
+ */
+template <typename T>
+using cartesian_kernel_t = void (*)(T* pts, const uint32_t* rng, const T* dir,
+                                    const T* ofs, Eigen::Index begin,
+                                    Eigen::Index end, Eigen::Index n);
+
+template <typename T>
+static void cartesian_scalar(T* pts, const uint32_t* rng, const T* dir,
+                             const T* ofs, Eigen::Index begin,
+                             Eigen::Index end, Eigen::Index n) {
+    // branch-free so the compiler can vectorize it on any target
+    for (Eigen::Index i = begin; i < end; ++i) {
+        const uint32_t r = rng[i - begin];
+        const T rt = static_cast<T>(r);
+        for (Eigen::Index k = i; k < 3 * n; k += n)
+            pts[k] = r == 0 ? T{0} : rt * dir[k] + ofs[k];
+    }
+}
+
+#if defined(OUSTER_CARTESIAN_SIMD_X86)
+
+#define OUSTER_TARGET_AVX2 __attribute__((target("avx2")))
+
+static bool cpu_has_avx2() {
+    static const bool has_avx2 = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return has_avx2;
+}
+
+// Multiply and add are kept separate (no FMA) so results are bit-identical to
+// the scalar kernel.
+OUSTER_TARGET_AVX2 static void cartesian_avx2(float* pts, const uint32_t* rng,
+                                              const float* dir,
+                                              const float* ofs,
+                                              Eigen::Index begin,
+                                              Eigen::Index end,
+                                              Eigen::Index n) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo_mask = _mm256_set1_epi32(0xffff);
+    const __m256 two16 = _mm256_set1_ps(65536.0f);
+    Eigen::Index i = begin;
+    for (; i + 8 <= end; i += 8) {
+        const __m256i ri = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(rng + (i - begin)));
+        // unsigned conversion: both halves are exact, the sum rounds once
+        const __m256 hi = _mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_srli_epi32(ri, 16)), two16);
+        const __m256 r = _mm256_add_ps(
+            hi, _mm256_cvtepi32_ps(_mm256_and_si256(ri, lo_mask)));
+        const __m256 invalid =
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(ri, zero));
+        for (Eigen::Index k = i; k < 3 * n; k += n) {
+            const __m256 p = _mm256_add_ps(
+                _mm256_mul_ps(r, _mm256_loadu_ps(dir + k)),
+                _mm256_loadu_ps(ofs + k));
+            _mm256_storeu_ps(pts + k, _mm256_andnot_ps(invalid, p));
+        }
+    }
+    cartesian_scalar(pts, rng + (i - begin), dir, ofs, i, end, n);
+}
+
+OUSTER_TARGET_AVX2 static void cartesian_avx2(double* pts,
+                                              const uint32_t* rng,
+                                              const double* dir,
+                                              const double* ofs,
+                                              Eigen::Index begin,
+                                              Eigen::Index end,
+                                              Eigen::Index n) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d two32 = _mm256_set1_pd(4294967296.0);
+    Eigen::Index i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const __m128i ri = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(rng + (i - begin)));
+        // signed conversion, then add 2^32 to lanes that came out negative
+        __m256d r = _mm256_cvtepi32_pd(ri);
+        r = _mm256_add_pd(
+            r, _mm256_and_pd(_mm256_cmp_pd(r, zero, _CMP_LT_OQ), two32));
+        const __m256d invalid = _mm256_castsi256_pd(
+            _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(ri, _mm_setzero_si128())));
+        for (Eigen::Index k = i; k < 3 * n; k += n) {
+            const __m256d p = _mm256_add_pd(
+                _mm256_mul_pd(r, _mm256_loadu_pd(dir + k)),
+                _mm256_loadu_pd(ofs + k));
+            _mm256_storeu_pd(pts + k, _mm256_andnot_pd(invalid, p));
+        }
+    }
+    cartesian_scalar(pts, rng + (i - begin), dir, ofs, i, end, n);
+}
+
+#endif
+
+template <typename T>
+static cartesian_kernel_t<T> cartesian_kernel() {
+#if defined(OUSTER_CARTESIAN_SIMD_X86)
+    if (cpu_has_avx2()) return &cartesian_avx2;
+#endif
+    return &cartesian_scalar<T>;
+}
+
+// pixels handed to a kernel at a time; also the unit of work with OpenMP
+constexpr Eigen::Index CARTESIAN_BLOCK = 4096;
+
+}  // namespace impl
+
+template <typename T>
+void cartesian_into(PointsT<T>& points,
+                    const Eigen::Ref<const img_t<uint32_t>>& range,
+                    const XYZLutT<T>& lut) {
+    const Eigen::Index n = lut.direction.rows();
+    if (range.size() != n || lut.offset.rows() != n)
+        throw std::invalid_argument("unexpected image dimensions");
+    if (points.rows() != n) points.resize(n, 3);
+
+    static const impl::cartesian_kernel_t<T> kernel =
+        impl::cartesian_kernel<T>();
+
+    T* const pts = points.data();
+    const uint32_t* const rng = range.data();
+    const T* const dir = lut.direction.data();
+    const T* const ofs = lut.offset.data();
+    const Eigen::Index n_blocks =
+        (n + impl::CARTESIAN_BLOCK - 1) / impl::CARTESIAN_BLOCK;
+
+#ifdef __OUSTER_UTILIZE_OPENMP__
+#pragma omp parallel for schedule(static)
+#endif
+    for (Eigen::Index b = 0; b < n_blocks; ++b) {
+        const Eigen::Index begin = b * impl::CARTESIAN_BLOCK;
+        const Eigen::Index end =
+            std::min(n, begin + impl::CARTESIAN_BLOCK);
+        kernel(pts, rng + begin, dir, ofs, begin, end, n);
+    }
+}
+
+template <typename T>
+void cartesian_into(PointsT<T>& points, const LidarScan& scan,
+                    const XYZLutT<T>& lut) {
+    cartesian_into(points, scan.field(sensor::ChanField::RANGE), lut);
+}
+
+template <typename T>
+DestaggeredXYZLutT<T> make_destaggered_xyz_lut(
+    const XYZLutT<T>& lut, const std::vector<int>& pixel_shift_by_row) {
+    const Eigen::Index n = lut.direction.rows();
+    const Eigen::Index h = pixel_shift_by_row.size();
+    if (h == 0 || n % h != 0 || lut.offset.rows() != n)
+        throw std::invalid_argument("unexpected scan dimensions");
+    const Eigen::Index w = n / h;
+
+    DestaggeredXYZLutT<T> dlut{PointsT<T>(n, 3), PointsT<T>(n, 3),
+                               pixel_shift_by_row};
+    for (Eigen::Index c = 0; c < 3; ++c) {
+        Eigen::Map<img_t<T>>(dlut.direction.data() + c * n, h, w) =
+            destagger<T>(Eigen::Map<const img_t<T>>(
+                             lut.direction.data() + c * n, h, w),
+                         pixel_shift_by_row);
+        Eigen::Map<img_t<T>>(dlut.offset.data() + c * n, h, w) =
+            destagger<T>(
+                Eigen::Map<const img_t<T>>(lut.offset.data() + c * n, h, w),
+                pixel_shift_by_row);
+    }
+    return dlut;
+}
+
+template <typename T>
+void cartesian_into(PointsT<T>& points,
+                    const Eigen::Ref<const img_t<uint32_t>>& range,
+                    const DestaggeredXYZLutT<T>& lut) {
+    const Eigen::Index n = lut.direction.rows();
+    const Eigen::Index h = lut.pixel_shift_by_row.size();
+    if (range.rows() != h || range.size() != n || lut.offset.rows() != n)
+        throw std::invalid_argument("unexpected image dimensions");
+    const Eigen::Index w = range.cols();
+    if (points.rows() != n) points.resize(n, 3);
+
+    static const impl::cartesian_kernel_t<T> kernel =
+        impl::cartesian_kernel<T>();
+
+    T* const pts = points.data();
+    const T* const dir = lut.direction.data();
+    const T* const ofs = lut.offset.data();
+
+#ifdef __OUSTER_UTILIZE_OPENMP__
+#pragma omp parallel for schedule(static)
+#endif
+    for (Eigen::Index u = 0; u < h; ++u) {
+        const uint32_t* const rng = range.data() + u * range.outerStride();
+        const Eigen::Index row = u * w;
+        const Eigen::Index offset = (lut.pixel_shift_by_row[u] % w + w) % w;
+        // staggered columns [0, w - offset) land on [offset, w) ...
+        kernel(pts, rng, dir, ofs, row + offset, row + w, n);
+        // ... and the remaining ones wrap around to [0, offset)
+        kernel(pts, rng + (w - offset), dir, ofs, row, row + offset, n);
+    }
+}
+
+template <typename T>
+void cartesian_into(PointsT<T>& points, const LidarScan& scan,
+                    const DestaggeredXYZLutT<T>& lut) {
+    cartesian_into(points, scan.field(sensor::ChanField::RANGE), lut);
+}
+
+// clang-format off
+template DestaggeredXYZLut make_destaggered_xyz_lut(const XYZLut& lut, const std::vector<int>& pixel_shift_by_row);
+template DestaggeredXYZLutF make_destaggered_xyz_lut(const XYZLutF& lut, const std::vector<int>& pixel_shift_by_row);
+template void cartesian_into(PointsD& points, const Eigen::Ref<const img_t<uint32_t>>& range, const DestaggeredXYZLut& lut);
+template void cartesian_into(PointsF& points, const Eigen::Ref<const img_t<uint32_t>>& range, const DestaggeredXYZLutF& lut);
+template void cartesian_into(PointsD& points, const LidarScan& scan, const DestaggeredXYZLut& lut);
+template void cartesian_into(PointsF& points, const LidarScan& scan, const DestaggeredXYZLutF& lut);
+template void cartesian_into(PointsD& points, const Eigen::Ref<const img_t<uint32_t>>& range, const XYZLut& lut);
+template void cartesian_into(PointsF& points, const Eigen::Ref<const img_t<uint32_t>>& range, const XYZLutF& lut);
+template void cartesian_into(PointsD& points, const LidarScan& scan, const XYZLut& lut);
+template void cartesian_into(PointsF& points, const LidarScan& scan, const XYZLutF& lut);
+// clang-format on
+
 LidarScan::Points cartesian(const LidarScan& scan, const XYZLut& lut) {
     return cartesian(scan.field(sensor::ChanField::RANGE), lut);
 }
 
 LidarScan::Points cartesian(const Eigen::Ref<const img_t<uint32_t>>& range,
                             const XYZLut& lut) {
-    if (range.cols() * range.rows() != lut.direction.rows())
-        throw std::invalid_argument("unexpected image dimensions");
-    auto reshaped = Eigen::Map<const Eigen::Array<uint32_t, -1, 1>>(
-        range.data(), range.cols() * range.rows());
-    auto nooffset = lut.direction.colwise() * reshaped.cast<double>();
-    return (reshaped == 0)
-        .replicate<1, 3>()
-        .select(nooffset, nooffset + lut.offset);
+    LidarScan::Points points;
+    cartesian_into(points, range, lut);
+    return points;
+}
+
+PointsF cartesian(const Eigen::Ref<const img_t<uint32_t>>& range,
+                  const XYZLutF& lut) {
+    PointsF points;
+    cartesian_into(points, range, lut);
+    return points;
 }
 
 ScanBatcher::ScanBatcher(size_t w, const sensor::packet_format& pf)
@@ -731,20 +963,16 @@ void zero_header_cols(LidarScan& ls, std::ptrdiff_t start, std::ptrdiff_t end) {
 }
 
 /*
- * Generic operation to read a channel field from a packet measurement block
- * into a scan
+ * Collects the destination of a channel field for
+ * packet_format::block_fields and packet_format::col_fields
  */
-struct parse_field_col {
+struct collect_field_dest {
     template <typename T>
-    void operator()(Eigen::Ref<img_t<T>> field, const std::string& f,
-                    uint16_t m_id, const sensor::packet_format& pf,
-                    const uint8_t* col_buf) const {
-        // RAW_HEADERS field is populated separately because it has
-        // a different processing scheme and doesn't fit into existing field
-        // model (i.e. data packed per column rather than per pixel)
-        if (f == sensor::ChanField::RAW_HEADERS) return;
-
-        pf.col_field(col_buf, f, field.col(m_id).data(), field.cols());
+    void operator()(
+        Eigen::Ref<img_t<T>> field, size_t position,
+        std::vector<sensor::packet_format::FieldDest>& dests) const {
+        dests.push_back({position, sensor::impl::type_cft<T>(), field.data(),
+                         static_cast<int>(field.cols())});
     }
 };
 
@@ -813,6 +1041,7 @@ struct pack_raw_headers_col {
 
 void ScanBatcher::_parse_by_col(const uint8_t* packet_buf, LidarScan& ls) {
     const bool raw_headers = impl::raw_headers_enabled(pf, ls);
+    const auto& dests = _field_dests(ls);
     for (int icol = 0; icol < pf.columns_per_packet; icol++) {
         const uint8_t* col_buf = pf.nth_col(icol, packet_buf);
         const uint16_t m_id = pf.col_measurement_id(col_buf);
@@ -853,24 +1082,43 @@ void ScanBatcher::_parse_by_col(const uint8_t* packet_buf, LidarScan& ls) {
         ls.measurement_id()[m_id] = m_id;
         ls.status()[m_id] = status;
 
-        impl::foreach_channel_field(ls, pf, parse_field_col{}, m_id, pf,
-                                    col_buf);
+        pf.col_fields(dests, col_buf, m_id);
     }
 }
 
-/*
- * Faster version of parse_field_col that works by blocks instead and skips
- * extra checks
- */
-template <int BlockDim>
-struct parse_field_block {
-    template <typename T>
-    void operator()(Eigen::Ref<img_t<T>> field, const std::string& f,
-                    const sensor::packet_format& pf,
-                    const uint8_t* packet_buf) const {
-        pf.block_field<T, BlockDim>(field, f, packet_buf);
+const std::vector<sensor::packet_format::FieldDest>& ScanBatcher::_field_dests(
+    LidarScan& ls) {
+    // field data doesn't move while the scan keeps the same fields, so a
+    // walk over the field table is enough to tell the dests are current. A
+    // replaced field may get the old address back, its layout tells it apart
+    bool current = (ls.fields().size() == dests_fields.size());
+    size_t i = 0;
+    for (auto it = ls.fields().begin(); current && it != ls.fields().end();
+         ++it, ++i) {
+        const auto& seen = dests_fields[i];
+        current = it->second.get() == seen.data && it->first == seen.name &&
+                  it->second.desc() == seen.desc;
     }
-};
+    if (current) return field_dests;
+
+    dests_fields.clear();
+    for (const auto& kv : ls.fields())
+        dests_fields.push_back({kv.first, kv.second.get(), kv.second.desc()});
+
+    field_dests.clear();
+    size_t position = 0;
+    for (const auto& ft : pf) {
+        // RAW_HEADERS is packed per column rather than per pixel and is
+        // populated separately
+        if (ft.first != sensor::ChanField::RAW_HEADERS &&
+            ls.has_field(ft.first)) {
+            impl::visit_field(ls, ft.first, collect_field_dest{}, position,
+                              field_dests);
+        }
+        ++position;
+    }
+    return field_dests;
+}
 
 void ScanBatcher::_parse_by_block(const uint8_t* packet_buf, LidarScan& ls) {
     // zero out missing columns if we jumped forward
@@ -895,18 +1143,16 @@ void ScanBatcher::_parse_by_block(const uint8_t* packet_buf, LidarScan& ls) {
         ls.status()[m_id] = status;
     }
 
+    const auto& dests = _field_dests(ls);
     switch (pf.block_parsable()) {
         case 16:
-            impl::foreach_channel_field(ls, pf, parse_field_block<16>{}, pf,
-                                        packet_buf);
+            pf.block_fields<16>(dests, packet_buf);
             break;
         case 8:
-            impl::foreach_channel_field(ls, pf, parse_field_block<8>{}, pf,
-                                        packet_buf);
+            pf.block_fields<8>(dests, packet_buf);
             break;
         case 4:
-            impl::foreach_channel_field(ls, pf, parse_field_block<4>{}, pf,
-                                        packet_buf);
+            pf.block_fields<4>(dests, packet_buf);
             break;
         default:
             throw std::invalid_argument("Invalid block dim for packet format");
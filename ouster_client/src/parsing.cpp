@@ -19,6 +19,14 @@
 #include "ouster/impl/packet_writer.h"
 #include "ouster/types.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OUSTER_PARSING_SIMD_X86
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OUSTER_PARSING_SIMD_NEON
+#endif
+
 namespace ouster {
 namespace sensor {
 
@@ -36,6 +44,64 @@ struct FieldInfo {
     int shift;
 };
 
+/**
+ * Operation needed to turn the raw bytes of a field into its value. Resolved
+ * once per field so that the decode kernels can be instantiated for it rather
+ * than testing mask and shift for every pixel.
+ */
+enum DecodeOp {
+    DECODE_COPY = 0,         ///< no mask, no shift
+    DECODE_MASK = 1,         ///< mask only
+    DECODE_MASK_RSHIFT = 2,  ///< mask, then shift right
+    DECODE_MASK_LSHIFT = 3,  ///< mask, then shift left
+    N_DECODE_OPS = 4
+};
+
+/**
+ * FieldInfo precompiled for the decode kernels.
+ */
+struct FieldDecoder {
+    ChanFieldType ty_tag;
+    size_t offset;
+    DecodeOp op;
+    uint64_t mask;
+    int shift;           ///< shift amount, direction is given by op
+    bool simd;           ///< field can be decoded from 32-bit word loads
+    uint32_t simd_mask;  ///< mask combined with the width of the source type
+};
+
+/**
+ * Precompile a field.
+ *
+ * @param[in] f field info from the profile table.
+ * @param[in] load_limit number of bytes that can safely be read starting at
+ * any pixel of the packet.
+ */
+static FieldDecoder compile_decoder(const FieldInfo& f, size_t load_limit) {
+    DecodeOp op = DECODE_COPY;
+    if (f.shift > 0)
+        op = DECODE_MASK_RSHIFT;
+    else if (f.shift < 0)
+        op = DECODE_MASK_LSHIFT;
+    else if (f.mask)
+        op = DECODE_MASK;
+    uint64_t mask = f.mask ? f.mask : ~uint64_t{0};
+
+    bool unsigned_src = f.ty_tag == UINT8 || f.ty_tag == UINT16 ||
+                        f.ty_tag == UINT32;
+    bool simd = unsigned_src && f.offset + sizeof(uint32_t) <= load_limit;
+    uint64_t src_mask =
+        simd ? (uint64_t{1} << (8 * field_type_size(f.ty_tag))) - 1 : 0;
+
+    return {f.ty_tag,
+            f.offset,
+            op,
+            mask,
+            std::abs(f.shift),
+            simd,
+            static_cast<uint32_t>(mask & src_mask)};
+}
+
 struct ProfileEntry {
     const std::pair<std::string, FieldInfo>* fields;
     size_t n_fields;
@@ -193,6 +259,10 @@ struct packet_format::Impl {
 
     std::map<std::string, impl::FieldInfo> fields;
 
+    // decoders by position of the field in `fields`
+    std::vector<impl::FieldDecoder> decoders;
+    std::map<std::string, size_t> positions;
+
     Impl(UDPProfileLidar profile, size_t pixels_per_column,
          size_t columns_per_packet) {
         bool legacy = (profile == UDPProfileLidar::PROFILE_LIDAR_LEGACY);
@@ -221,11 +291,21 @@ struct packet_format::Impl {
                 "lidar_packet_size cannot exceed 65535");
 
         fields = {entry.fields, entry.fields + entry.n_fields};
+        for (const auto& kv : fields) {
+            positions.emplace(kv.first, decoders.size());
+            decoders.push_back(impl::compile_decoder(
+                kv.second,
+                channel_data_size + col_footer_size + packet_footer_size));
+        }
 
         timestamp_offset = 0;
         measurement_id_offset = 8;
         status_offset = legacy ? col_size - col_footer_size : 10;
     }
+
+    const impl::FieldDecoder& decoder(const std::string& f) const {
+        return decoders[positions.at(f)];
+    }
 };
 
 packet_format::packet_format(UDPProfileLidar udp_profile_lidar,
@@ -272,87 +352,405 @@ class SameSizeInt<double> {
     typedef uint64_t value;
 };
 
-template <typename T, typename SRC, int N>
-void packet_format::block_field_impl(Eigen::Ref<img_t<T>> field,
-                                     const std::string& chan,
-                                     const uint8_t* packet_buf) const {
-    if (sizeof(T) < sizeof(SRC))
+namespace impl {
+
+/**
+ * Decode a single pixel value with the operation OP.
+ *
+ * The raw value is loaded with memcpy since fields are not guaranteed to be
+ * aligned within the channel data block.
+ */
+template <typename T, typename SRC, int OP>
+inline typename SameSizeInt<T>::value decode_px(const uint8_t* px_src,
+                                                uint64_t mask, int shift) {
+    typename SameSizeInt<SRC>::value raw;
+    std::memcpy(&raw, px_src, sizeof(raw));
+    typename SameSizeInt<T>::value dst = raw;
+    if (OP != DECODE_COPY) dst &= mask;
+    if (OP == DECODE_MASK_RSHIFT) dst >>= shift;
+    if (OP == DECODE_MASK_LSHIFT) dst <<= shift;
+    return dst;
+}
+
+// Decoder parameters are copied to locals in the kernels below: the
+// destination may alias anything, so reading them through the FieldDecoder
+// reference would force a reload on every pixel.
+
+/**
+ * Decode a tile of `rows` pixel rows by N columns of a measurement block.
+ *
+ * @param[out] dst first destination pixel of the tile.
+ * @param[in] dst_stride distance between destination rows, in elements.
+ * @param[in] px_src field of the first pixel of the first column of the tile.
+ * @param[in] col_size distance between columns in the packet.
+ * @param[in] channel_data_size distance between pixels in a column.
+ * @param[in] rows number of pixel rows to decode.
+ * @param[in] d field decoder.
+ */
+template <typename T, typename SRC, int N, int OP>
+static void decode_tile(void* dst, int dst_stride, const uint8_t* px_src,
+                        size_t col_size, size_t channel_data_size, int rows,
+                        const FieldDecoder& d) {
+    const uint64_t mask = d.mask;
+    const int shift = d.shift;
+    T* out = static_cast<T*>(dst);
+    for (int px = 0; px < rows; ++px) {
+        for (int x = 0; x < N; ++x) {
+            out[x] = decode_px<T, SRC, OP>(px_src + x * col_size, mask, shift);
+        }
+        px_src += channel_data_size;
+        out += dst_stride;
+    }
+}
+
+template <typename T, typename SRC, int OP>
+static void decode_col(const uint8_t* col_buf, T* dst, int dst_stride,
+                       const FieldDecoder& d, int pixels_per_column,
+                       size_t channel_data_size, size_t col_header_size) {
+    const uint64_t mask = d.mask;
+    const int shift = d.shift;
+    const uint8_t* px_src = col_buf + col_header_size + d.offset;
+    for (int px = 0; px < pixels_per_column; ++px) {
+        // bit copy rather than value conversion to match px_field semantics
+        // for floating point destinations
+        auto value = decode_px<T, SRC, OP>(px_src, mask, shift);
+        std::memcpy(dst, &value, sizeof(T));
+        px_src += channel_data_size;
+        dst += dst_stride;
+    }
+}
+
+using tile_decoder_t = void (*)(void*, int, const uint8_t*, size_t, size_t,
+                                int, const FieldDecoder&);
+
+template <typename T>
+using col_decoder_t = void (*)(const uint8_t*, T*, int, const FieldDecoder&,
+                               int, size_t, size_t);
+
+template <typename F>
+using DecoderRow = std::array<F, N_DECODE_OPS>;
+
+template <typename F>
+using DecoderTable = std::array<DecoderRow<F>, FLOAT64 + 1>;
+
+/**
+ * Kernel tables indexed by source ChanFieldType and DecodeOp. Rows for sources
+ * wider than the destination type are left null and never instantiated.
+ */
+template <typename T, int N>
+struct BlockDecoders {
+    template <typename SRC>
+    static constexpr DecoderRow<tile_decoder_t> row(std::true_type) {
+        return {{&decode_tile<T, SRC, N, DECODE_COPY>,
+                 &decode_tile<T, SRC, N, DECODE_MASK>,
+                 &decode_tile<T, SRC, N, DECODE_MASK_RSHIFT>,
+                 &decode_tile<T, SRC, N, DECODE_MASK_LSHIFT>}};
+    }
+
+    template <typename SRC>
+    static constexpr DecoderRow<tile_decoder_t> row(std::false_type) {
+        return {{}};
+    }
+
+    template <typename SRC>
+    static constexpr DecoderRow<tile_decoder_t> row() {
+        return row<SRC>(
+            std::integral_constant<bool, sizeof(T) >= sizeof(SRC)>{});
+    }
+
+    static constexpr DecoderTable<tile_decoder_t> table{
+        {{}, row<uint8_t>(), row<uint16_t>(), row<uint32_t>(),
+         row<uint64_t>(), row<int8_t>(), row<int16_t>(), row<int32_t>(),
+         row<int64_t>(), row<float>(), row<double>()}};
+};
+
+template <typename T, int N>
+constexpr DecoderTable<tile_decoder_t> BlockDecoders<T, N>::table;
+
+template <typename T>
+struct ColDecoders {
+    template <typename SRC>
+    static constexpr DecoderRow<col_decoder_t<T>> row(std::true_type) {
+        return {{&decode_col<T, SRC, DECODE_COPY>,
+                 &decode_col<T, SRC, DECODE_MASK>,
+                 &decode_col<T, SRC, DECODE_MASK_RSHIFT>,
+                 &decode_col<T, SRC, DECODE_MASK_LSHIFT>}};
+    }
+
+    template <typename SRC>
+    static constexpr DecoderRow<col_decoder_t<T>> row(std::false_type) {
+        return {{}};
+    }
+
+    template <typename SRC>
+    static constexpr DecoderRow<col_decoder_t<T>> row() {
+        return row<SRC>(
+            std::integral_constant<bool, sizeof(T) >= sizeof(SRC)>{});
+    }
+
+    static constexpr DecoderTable<col_decoder_t<T>> table{
+        {{}, row<uint8_t>(), row<uint16_t>(), row<uint32_t>(),
+         row<uint64_t>(), row<int8_t>(), row<int16_t>(), row<int32_t>(),
+         row<int64_t>(), row<float>(), row<double>()}};
+};
+
+template <typename T>
+constexpr DecoderTable<col_decoder_t<T>> ColDecoders<T>::table;
+
+/**
+ * Look up the decode kernel for a field, reporting the same errors as the
+ * per-type dispatch it replaces.
+ */
+template <typename F>
+static F lookup_decoder(const DecoderTable<F>& table, const FieldDecoder& d) {
+    if (d.ty_tag <= VOID || d.ty_tag > FLOAT64)
+        throw std::invalid_argument("Invalid field for packet format");
+    F decoder = table[d.ty_tag][d.op];
+    if (!decoder)
         throw std::invalid_argument("Dest type too small for specified field");
+    return decoder;
+}
 
-    const auto& f = impl_->fields.at(chan);
+/*
+ * SIMD block decoders.
+ *
+ * Within a block all N columns are col_size bytes apart, so one pixel row of
+ * the destination is a strided gather of 32-bit words from the packet. The
+ * kernels below load four such words into one vector, apply mask and shift in
+ * 32-bit lanes and narrow the result to the destination type. They are used
+ * for unsigned sources of up to 32 bits decoded into unsigned destinations,
+ * which covers every field of the built-in profiles; anything else goes
+ * through the scalar kernels above.
+ *
+ * On x86 SSE4.1 support is checked at runtime, so the library itself does not
+ * need to be built with -msse4.1. AVX2 gathers were tried as well and turned
+ * out slower than four scalar loads on current Intel microcode.
+ */
 
-    size_t offset = f.offset;
-    uint64_t mask = f.mask;
-    int shift = f.shift;
-    size_t channel_data_size = impl_->channel_data_size;
+static inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-    int cols = field.cols();
-    T* data = field.data();
-    std::array<const uint8_t*, N> col_buf;
+// all ones for the width of T, used to emulate truncation after left shifts
+template <typename T>
+constexpr uint32_t lane_mask() {
+    return sizeof(T) < sizeof(uint32_t)
+               ? (uint32_t{1} << (8 * sizeof(T))) - 1
+               : std::numeric_limits<uint32_t>::max();
+}
+
+#if defined(OUSTER_PARSING_SIMD_X86)
+
+#define OUSTER_TARGET_SSE41 __attribute__((target("sse4.1")))
+
+static bool cpu_has_sse41() {
+    static const bool has_sse41 = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1") != 0;
+    }();
+    return has_sse41;
+}
+
+template <int OP, typename T>
+OUSTER_TARGET_SSE41 inline __m128i apply_op(__m128i v, __m128i mask,
+                                            __m128i shift) {
+    v = _mm_and_si128(v, mask);
+    if (OP == DECODE_MASK_RSHIFT) v = _mm_srl_epi32(v, shift);
+    if (OP == DECODE_MASK_LSHIFT) {
+        v = _mm_sll_epi32(v, shift);
+        if (sizeof(T) < sizeof(uint32_t))
+            v = _mm_and_si128(v, _mm_set1_epi32(lane_mask<T>()));
+    }
+    return v;
+}
+
+// store four 32-bit lanes, narrowed to the destination type. Lanes are
+// already within range of T, so the saturating packs never saturate
+OUSTER_TARGET_SSE41 inline void store4(uint32_t* dst, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+OUSTER_TARGET_SSE41 inline void store4(uint16_t* dst, __m128i v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi32(v, v));
+}
 
-    for (int icol = 0; icol < columns_per_packet; icol += N) {
-        for (int i = 0; i < N; ++i) {
-            col_buf[i] = nth_col(icol + i, packet_buf);
+OUSTER_TARGET_SSE41 inline void store4(uint8_t* dst, __m128i v) {
+    v = _mm_packus_epi32(v, v);
+    uint32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    std::memcpy(dst, &packed, sizeof(packed));
+}
+
+template <typename T, int N, int OP>
+OUSTER_TARGET_SSE41 static void decode_tile_sse41(
+    void* dst, int dst_stride, const uint8_t* px_src, size_t col_size,
+    size_t channel_data_size, int rows, const FieldDecoder& d) {
+    const __m128i mask = _mm_set1_epi32(d.simd_mask);
+    const __m128i shift = _mm_cvtsi32_si128(d.shift);
+    T* out = static_cast<T*>(dst);
+    for (int px = 0; px < rows; ++px) {
+        for (int x = 0; x < N; x += 4) {
+            const uint8_t* src = px_src + x * col_size;
+            __m128i v = _mm_cvtsi32_si128(load_u32(src));
+            v = _mm_insert_epi32(v, load_u32(src + col_size), 1);
+            v = _mm_insert_epi32(v, load_u32(src + 2 * col_size), 2);
+            v = _mm_insert_epi32(v, load_u32(src + 3 * col_size), 3);
+            store4(out + x, apply_op<OP, T>(v, mask, shift));
         }
+        px_src += channel_data_size;
+        out += dst_stride;
+    }
+}
 
-        uint16_t m_id = col_measurement_id(col_buf[0]);
-
-        for (int px = 0; px < pixels_per_column; ++px) {
-            std::ptrdiff_t f_offset = cols * px + m_id;
-            for (int x = 0; x < N; ++x) {
-                auto px_src =
-                    col_buf[x] + col_header_size + (px * channel_data_size);
-                typename SameSizeInt<T>::value dst =
-                    *reinterpret_cast<const typename SameSizeInt<SRC>::value*>(
-                        px_src + offset);
-                if (mask) dst &= mask;
-                if (shift > 0) dst >>= shift;
-                if (shift < 0) dst <<= std::abs(shift);
-                *(data + f_offset + x) = dst;
-            }
+#elif defined(OUSTER_PARSING_SIMD_NEON)
+
+template <int OP, typename T>
+inline uint32x4_t apply_op(uint32x4_t v, uint32x4_t mask, int32x4_t shift) {
+    v = vandq_u32(v, mask);
+    // vshlq shifts right for negative counts
+    if (OP == DECODE_MASK_RSHIFT) v = vshlq_u32(v, vnegq_s32(shift));
+    if (OP == DECODE_MASK_LSHIFT) v = vshlq_u32(v, shift);
+    return v;
+}
+
+// store four 32-bit lanes, truncated to the destination type
+inline void store4(uint32_t* dst, uint32x4_t v) { vst1q_u32(dst, v); }
+
+inline void store4(uint16_t* dst, uint32x4_t v) { vst1_u16(dst, vmovn_u32(v)); }
+
+inline void store4(uint8_t* dst, uint32x4_t v) {
+    uint16x4_t n = vmovn_u32(v);
+    uint8x8_t b = vmovn_u16(vcombine_u16(n, n));
+    uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(b), 0);
+    std::memcpy(dst, &packed, sizeof(packed));
+}
+
+template <typename T, int N, int OP>
+static void decode_tile_neon(void* dst, int dst_stride, const uint8_t* px_src,
+                             size_t col_size, size_t channel_data_size,
+                             int rows, const FieldDecoder& d) {
+    const uint32x4_t mask = vdupq_n_u32(d.simd_mask);
+    const int32x4_t shift = vdupq_n_s32(d.shift);
+    T* out = static_cast<T*>(dst);
+    for (int px = 0; px < rows; ++px) {
+        for (int x = 0; x < N; x += 4) {
+            const uint8_t* src = px_src + x * col_size;
+            uint32x4_t v = vdupq_n_u32(load_u32(src));
+            v = vsetq_lane_u32(load_u32(src + col_size), v, 1);
+            v = vsetq_lane_u32(load_u32(src + 2 * col_size), v, 2);
+            v = vsetq_lane_u32(load_u32(src + 3 * col_size), v, 3);
+            store4(out + x, apply_op<OP, T>(v, mask, shift));
         }
+        px_src += channel_data_size;
+        out += dst_stride;
     }
 }
 
-template <typename T, int BlockDim>
-void packet_format::block_field(Eigen::Ref<img_t<T>> field,
-                                const std::string& chan,
-                                const uint8_t* packet_buf) const {
-    const auto& f = impl_->fields.at(chan);
+#endif
 
-    switch (f.ty_tag) {
+template <typename T>
+using is_simd_dest =
+    std::integral_constant<bool, std::is_same<T, uint8_t>::value ||
+                                     std::is_same<T, uint16_t>::value ||
+                                     std::is_same<T, uint32_t>::value>;
+
+template <typename T, int N>
+static tile_decoder_t simd_tile_decoder(const FieldDecoder&,
+                                                std::false_type) {
+    return nullptr;
+}
+
+template <typename T, int N>
+static tile_decoder_t simd_tile_decoder(const FieldDecoder& d,
+                                                std::true_type) {
+    if (!d.simd || field_type_size(d.ty_tag) > sizeof(T)) return nullptr;
+#if defined(OUSTER_PARSING_SIMD_X86)
+    static constexpr DecoderRow<tile_decoder_t> sse41{
+        {&decode_tile_sse41<T, N, DECODE_COPY>,
+         &decode_tile_sse41<T, N, DECODE_MASK>,
+         &decode_tile_sse41<T, N, DECODE_MASK_RSHIFT>,
+         &decode_tile_sse41<T, N, DECODE_MASK_LSHIFT>}};
+    return cpu_has_sse41() ? sse41[d.op] : nullptr;
+#elif defined(OUSTER_PARSING_SIMD_NEON)
+    static constexpr DecoderRow<tile_decoder_t> neon{
+        {&decode_tile_neon<T, N, DECODE_COPY>,
+         &decode_tile_neon<T, N, DECODE_MASK>,
+         &decode_tile_neon<T, N, DECODE_MASK_RSHIFT>,
+         &decode_tile_neon<T, N, DECODE_MASK_LSHIFT>}};
+    return neon[d.op];
+#else
+    return nullptr;
+#endif
+}
+
+/**
+ * Get a SIMD kernel for decoding the field into T if one is available for
+ * this CPU, or nullptr.
+ */
+template <typename T, int N>
+static tile_decoder_t simd_tile_decoder(const FieldDecoder& d) {
+    return simd_tile_decoder<T, N>(d, is_simd_dest<T>{});
+}
+
+/**
+ * Get the fastest tile kernel decoding the field into T.
+ */
+template <typename T, int N>
+static tile_decoder_t tile_decoder(const FieldDecoder& d) {
+    if (auto simd = simd_tile_decoder<T, N>(d)) return simd;
+    return lookup_decoder(BlockDecoders<T, N>::table, d);
+}
+
+/**
+ * Get the fastest tile kernel decoding the field into a destination of the
+ * given type.
+ */
+template <int N>
+static tile_decoder_t tile_decoder(ChanFieldType dst_type,
+                                   const FieldDecoder& d) {
+    switch (dst_type) {
         case UINT8:
-            block_field_impl<T, uint8_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<uint8_t, N>(d);
         case UINT16:
-            block_field_impl<T, uint16_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<uint16_t, N>(d);
         case UINT32:
-            block_field_impl<T, uint32_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<uint32_t, N>(d);
         case UINT64:
-            block_field_impl<T, uint64_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<uint64_t, N>(d);
         case INT8:
-            block_field_impl<T, int8_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<int8_t, N>(d);
         case INT16:
-            block_field_impl<T, int16_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<int16_t, N>(d);
         case INT32:
-            block_field_impl<T, int32_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<int32_t, N>(d);
         case INT64:
-            block_field_impl<T, int64_t, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<int64_t, N>(d);
         case FLOAT32:
-            block_field_impl<T, float, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<float, N>(d);
         case FLOAT64:
-            block_field_impl<T, double, BlockDim>(field, chan, packet_buf);
-            break;
+            return tile_decoder<double, N>(d);
         default:
-            throw std::invalid_argument("Invalid field for packet format");
+            throw std::invalid_argument("Invalid destination field type");
+    }
+}
+
+}  // namespace impl
+
+template <typename T, int BlockDim>
+void packet_format::block_field(Eigen::Ref<img_t<T>> field,
+                                const std::string& chan,
+                                const uint8_t* packet_buf) const {
+    const auto& d = impl_->decoder(chan);
+    auto decode = impl::tile_decoder<T, BlockDim>(d);
+
+    T* data = field.data();
+    const int cols = field.cols();
+    for (int icol = 0; icol < columns_per_packet; icol += BlockDim) {
+        const uint8_t* col_buf = nth_col(icol, packet_buf);
+        const uint16_t m_id = col_measurement_id(col_buf);
+        decode(data + m_id, cols, col_buf + col_header_size + d.offset,
+               col_size, impl_->channel_data_size, pixels_per_column, d);
     }
 }
 
@@ -448,128 +846,80 @@ template void packet_format::block_field<double, 16>(
     Eigen::Ref<img_t<double>> field, const std::string& chan,
     const uint8_t* packet_buf) const;
 
-template <typename SRC, typename DST>
-static void col_field_impl(const uint8_t* col_buf, DST* dst, size_t offset,
-                           uint64_t mask, int shift, int pixels_per_column,
-                           int dst_stride, size_t channel_data_size,
-                           size_t col_header_size) {
-    if (sizeof(DST) < sizeof(SRC))
-        throw std::invalid_argument("Dest type too small for specified field");
+namespace impl {
 
-    for (int px = 0; px < pixels_per_column; px++) {
-        auto px_src =
-            col_buf + col_header_size + offset + (px * channel_data_size);
-        DST* px_dst = dst + px * dst_stride;
-        typename SameSizeInt<DST>::value dst =
-            *reinterpret_cast<const typename SameSizeInt<SRC>::value*>(px_src);
-        if (mask) dst &= mask;
-        if (shift > 0) dst >>= shift;
-        if (shift < 0) dst <<= std::abs(shift);
-        *px_dst = *reinterpret_cast<DST*>(&dst);
-    }
-}
+// rows per tile of the fused block parser: small enough that a tile of
+// a 16 column block stays in L1 across all fields of a profile
+constexpr int FUSED_TILE_ROWS = 32;
 
-template <typename SRC, typename DST>
-static void col_field_impl(const uint8_t* col_buf, float* dst, size_t offset,
-                           uint64_t mask, int shift, int pixels_per_column,
-                           int dst_stride, size_t channel_data_size,
-                           size_t col_header_size) {
-    if (sizeof(float) < sizeof(SRC))
-        throw std::invalid_argument("Dest type too small for specified field");
+// fields decoded per pass of the fused block parser
+constexpr size_t FUSED_MAX_FIELDS = 16;
 
-    for (int px = 0; px < pixels_per_column; px++) {
-        auto px_src =
-            col_buf + col_header_size + offset + (px * channel_data_size);
-        float* px_dst = dst + px * dst_stride;
-        typename SameSizeInt<float>::value dst =
-            *reinterpret_cast<const typename SameSizeInt<SRC>::value*>(px_src);
-        if (mask) dst &= mask;
-        if (shift > 0) dst >>= shift;
-        if (shift < 0) dst <<= std::abs(shift);
-        memcpy(px_dst, &dst, sizeof(float));
-    }
-}
+struct FusedField {
+    tile_decoder_t decode;
+    const FieldDecoder* d;
+    uint8_t* data;
+    size_t elem_size;
+    int cols;
+};
 
-template <typename SRC, typename DST>
-static void col_field_impl(const uint8_t* col_buf, double* dst, size_t offset,
-                           uint64_t mask, int shift, int pixels_per_column,
-                           int dst_stride, size_t channel_data_size,
-                           size_t col_header_size) {
-    if (sizeof(float) < sizeof(SRC))
-        throw std::invalid_argument("Dest type too small for specified field");
+}  // namespace impl
 
-    for (int px = 0; px < pixels_per_column; px++) {
-        auto px_src =
-            col_buf + col_header_size + offset + (px * channel_data_size);
-        double* px_dst = dst + px * dst_stride;
-        typename SameSizeInt<double>::value dst =
-            *reinterpret_cast<const typename SameSizeInt<SRC>::value*>(px_src);
-        if (mask) dst &= mask;
-        if (shift > 0) dst >>= shift;
-        if (shift < 0) dst <<= std::abs(shift);
-        memcpy(px_dst, &dst, sizeof(double));
+template <int BlockDim>
+void packet_format::block_fields(const std::vector<FieldDest>& dests,
+                                 const uint8_t* packet_buf) const {
+    const size_t channel_data_size = impl_->channel_data_size;
+    std::array<impl::FusedField, impl::FUSED_MAX_FIELDS> fused;
+
+    // resolve kernels up front; fields beyond FUSED_MAX_FIELDS take
+    // another pass over the packet
+    for (size_t first = 0; first < dests.size();
+         first += impl::FUSED_MAX_FIELDS) {
+        const size_t n_fields =
+            std::min(dests.size() - first, impl::FUSED_MAX_FIELDS);
+        for (size_t i = 0; i < n_fields; ++i) {
+            const auto& dest = dests[first + i];
+            const auto& d = impl_->decoders[dest.field];
+            fused[i] = {impl::tile_decoder<BlockDim>(dest.type, d), &d,
+                        static_cast<uint8_t*>(dest.data),
+                        field_type_size(dest.type), dest.cols};
+        }
+
+        for (int icol = 0; icol < columns_per_packet; icol += BlockDim) {
+            const uint8_t* col_buf = nth_col(icol, packet_buf);
+            const uint16_t m_id = col_measurement_id(col_buf);
+            const uint8_t* px_src = col_buf + col_header_size;
+
+            for (int px = 0; px < pixels_per_column;
+                 px += impl::FUSED_TILE_ROWS) {
+                const int rows =
+                    std::min(impl::FUSED_TILE_ROWS, pixels_per_column - px);
+                for (size_t i = 0; i < n_fields; ++i) {
+                    const auto& f = fused[i];
+                    f.decode(f.data + (px * f.cols + m_id) * f.elem_size,
+                             f.cols, px_src + f.d->offset, col_size,
+                             channel_data_size, rows, *f.d);
+                }
+                px_src += impl::FUSED_TILE_ROWS * channel_data_size;
+            }
+        }
     }
 }
 
+template void packet_format::block_fields<4>(
+    const std::vector<FieldDest>& dests, const uint8_t* packet_buf) const;
+template void packet_format::block_fields<8>(
+    const std::vector<FieldDest>& dests, const uint8_t* packet_buf) const;
+template void packet_format::block_fields<16>(
+    const std::vector<FieldDest>& dests, const uint8_t* packet_buf) const;
+
 template <typename T>
 void packet_format::col_field(const uint8_t* col_buf, const std::string& i,
                               T* dst, int dst_stride) const {
-    const auto& f = impl_->fields.at(i);
-
-    switch (f.ty_tag) {
-        case UINT8:
-            col_field_impl<uint8_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case UINT16:
-            col_field_impl<uint16_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case UINT32:
-            col_field_impl<uint32_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case UINT64:
-            col_field_impl<uint64_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case INT8:
-            col_field_impl<int8_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case INT16:
-            col_field_impl<int16_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case INT32:
-            col_field_impl<int32_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case INT64:
-            col_field_impl<int64_t, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case FLOAT32:
-            col_field_impl<float, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        case FLOAT64:
-            col_field_impl<double, T>(
-                col_buf, dst, f.offset, f.mask, f.shift, pixels_per_column,
-                dst_stride, impl_->channel_data_size, impl_->col_header_size);
-            break;
-        default:
-            throw std::invalid_argument("Invalid field for packet format");
-    }
+    const auto& d = impl_->decoder(i);
+    auto decode = impl::lookup_decoder(impl::ColDecoders<T>::table, d);
+    decode(col_buf, dst, dst_stride, d, pixels_per_column,
+           impl_->channel_data_size, impl_->col_header_size);
 }
 
 // explicitly instantiate for each field type
@@ -594,6 +944,63 @@ template void packet_format::col_field(const uint8_t*, const std::string&,
 template void packet_format::col_field(const uint8_t*, const std::string&,
                                        double*, int) const;
 
+namespace impl {
+
+template <typename T>
+static void decode_col_dest(const uint8_t* col_buf,
+                            const packet_format::FieldDest& dest, int col,
+                            const FieldDecoder& d, int pixels_per_column,
+                            size_t channel_data_size, size_t col_header_size) {
+    auto decode = lookup_decoder(ColDecoders<T>::table, d);
+    decode(col_buf, static_cast<T*>(dest.data) + col, dest.cols, d,
+           pixels_per_column, channel_data_size, col_header_size);
+}
+
+}  // namespace impl
+
+void packet_format::col_fields(const std::vector<FieldDest>& dests,
+                               const uint8_t* col_buf, int col) const {
+    for (const auto& dest : dests) {
+        const auto& d = impl_->decoders[dest.field];
+        auto decode = impl::decode_col_dest<uint8_t>;
+        switch (dest.type) {
+            case UINT8:
+                break;
+            case UINT16:
+                decode = impl::decode_col_dest<uint16_t>;
+                break;
+            case UINT32:
+                decode = impl::decode_col_dest<uint32_t>;
+                break;
+            case UINT64:
+                decode = impl::decode_col_dest<uint64_t>;
+                break;
+            case INT8:
+                decode = impl::decode_col_dest<int8_t>;
+                break;
+            case INT16:
+                decode = impl::decode_col_dest<int16_t>;
+                break;
+            case INT32:
+                decode = impl::decode_col_dest<int32_t>;
+                break;
+            case INT64:
+                decode = impl::decode_col_dest<int64_t>;
+                break;
+            case FLOAT32:
+                decode = impl::decode_col_dest<float>;
+                break;
+            case FLOAT64:
+                decode = impl::decode_col_dest<double>;
+                break;
+            default:
+                throw std::invalid_argument("Invalid destination field type");
+        }
+        decode(col_buf, dest, col, d, pixels_per_column,
+               impl_->channel_data_size, impl_->col_header_size);
+    }
+}
+
 ChanFieldType packet_format::field_type(const std::string& f) const {
     return impl_->fields.count(f) ? impl_->fields.at(f).ty_tag
                                   : ChanFieldType::VOID;
@@ -5,6 +5,7 @@
 
 #include "ouster/udp_packet_source.h"
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <memory>
@@ -148,15 +149,24 @@ bool Producer::_verify() const {
     return out;
 }
 
-static bool read_packet(const client& cli, Packet& packet, client_state st) {
-    switch (st) {
-        case client_state::LIDAR_DATA:
-            return read_lidar_packet(cli, packet.as<LidarPacket>());
-        case client_state::IMU_DATA:
-            return read_imu_packet(cli, packet.as<ImuPacket>());
-        default:
-            return false;
-    }
+// maximum number of packets drained from a socket per poll
+static constexpr size_t READ_BATCH_SIZE = 32;
+
+/*
+ * Read as many packets as currently available (up to READ_BATCH_SIZE) straight
+ * into the free slots of the ring buffer, without committing them. Clears the
+ * poll state of the socket once recvmmsg comes back short; packets dropped for
+ * their size leave the socket readable and must not clear it.
+ */
+static size_t read_packets(const client& cli, client_poller& poller,
+                           RingBufferMap<Event, Packet>& rb, Event e) {
+    Packet* slots[READ_BATCH_SIZE] = {};
+    size_t n = std::min(rb.space(e), READ_BATCH_SIZE);
+    for (size_t i = 0; i < n; ++i) slots[i] = &rb.back(e, i);
+    bool drained = false;
+    size_t read = read_packets(cli, e.state, slots, n, drained);
+    if (drained) clear_poll(poller, cli, e.state);
+    return read;
 }
 
 static client_state operator&(client_state a, client_state b) {
@@ -171,8 +181,10 @@ void Producer::run() {
 
     std::vector<bool> overflows(clients_.size(), false);
 
+    std::shared_ptr<client_poller> poller = make_poller();
+
     // this could be a private virtual instead
-    auto handle_event = [this, &overflows](Event e) {
+    auto handle_event = [this, &overflows, &poller](Event e) {
         const client_state overflow = client_state(Producer::CLIENT_OVERFLOW);
         switch (e.state) {
             case 0:
@@ -191,10 +203,10 @@ void Producer::run() {
                             pub->publish({e.source, overflow}, true);
                         }
                     }
-                } else if (read_packet(*clients_[e.source], rb_->back(e),
-                                       e.state)) {
-                    rb_->push(e);
-                    for (auto& pub : pubs_) pub->publish(e);
+                } else if (size_t n = read_packets(*clients_[e.source],
+                                                   *poller, *rb_, e)) {
+                    rb_->push(e, n);
+                    for (auto& pub : pubs_) pub->publish(e, n);
                     overflows[e.source] = false;
                 }
                 break;
@@ -205,7 +217,6 @@ void Producer::run() {
 
     std::lock_guard<std::mutex> lock{mtx_};
 
-    std::shared_ptr<client_poller> poller = make_poller();
     while (!stop_) {
         reset_poll(*poller);
 
@@ -321,6 +332,13 @@ client_state BufferedUDPSource::consume(LidarPacket& lidarp, ImuPacket& imup,
     return st;
 }
 
+client_state BufferedUDPSource::consume(PacketLease& lease, float timeout_sec) {
+    lease.release();
+    Event e = Subscriber::pop(timeout_sec);
+    lease = Subscriber::lease(e);
+    return e.state;
+}
+
 }  // namespace impl
 }  // namespace sensor
 }  // namespace ouster
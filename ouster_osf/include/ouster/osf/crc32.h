@@ -25,6 +25,9 @@ const uint32_t CRC_BYTES_SIZE = 4;
 /**
  * Caclulate CRC value for the buffer of given size. (ZLIB version)
  *
+ * Matches zlib's crc32, large buffers use carry-less multiplication (PCLMUL)
+ * on x86-64 CPUs that support it.
+ *
  * @ingroup OsfCRCFunctions
  *
  * @param[in] buf Pointer to the data buffer.
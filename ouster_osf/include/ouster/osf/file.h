@@ -9,7 +9,11 @@
 #pragma once
 
 #include <fstream>
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "ouster/osf/basics.h"
 
@@ -20,8 +24,11 @@ namespace osf {
  * Enum representing the available file opening modes.
  */
 enum class OpenMode : uint8_t {
-    READ = 0,  ///< Open the file in read-only mode.
-    WRITE = 1  ///< Open the file in write-only mode. (CURRENTLY NOT SUPPORTED)
+    READ = 0,   ///< Open the file in read-only mode.
+    WRITE = 1,  ///< Open the file in write-only mode. (CURRENTLY NOT SUPPORTED)
+    READ_BUFFERED = 2  ///< Open the file in read-only mode with buffered reads
+                       ///< and the chunk cache instead of mmap(), as READ
+                       ///< does in builds with OUSTER_OSF_NO_MMAP.
 };
 
 /**
@@ -37,6 +44,74 @@ enum class FileState : uint8_t {
  */
 using ChunkBuffer = std::vector<uint8_t>;
 
+/**
+ * Default capacity in bytes of the OsfFile chunk cache.
+ */
+static constexpr uint64_t DEFAULT_CHUNK_CACHE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Read-only view of a whole chunk as stored in the file (size prefix,
+ * flatbuffer and CRC). In mmap mode it points straight into the mapping and
+ * is valid until the OsfFile is closed, otherwise it shares the ownership of
+ * the buffer the chunk was read into.
+ */
+class ChunkView {
+   public:
+    /**
+     * Empty view.
+     */
+    ChunkView();
+
+    /**
+     * View of a chunk in memory not owned by the view (mmap).
+     *
+     * @param[in] data The beginning of the chunk.
+     * @param[in] size The size of the chunk in bytes.
+     */
+    ChunkView(const uint8_t* data, uint64_t size);
+
+    /**
+     * View of a chunk read into a buffer.
+     *
+     * @param[in] buf The buffer holding the chunk.
+     */
+    explicit ChunkView(std::shared_ptr<const ChunkBuffer> buf);
+
+    /**
+     * Get the beginning of the chunk.
+     *
+     * @return Pointer to the chunk, nullptr for an empty view.
+     */
+    const uint8_t* data() const;
+
+    /**
+     * Get the size of the chunk.
+     *
+     * @return The size of the chunk in bytes.
+     */
+    uint64_t size() const;
+
+    /**
+     * Whether the view points to any chunk.
+     *
+     * @return true for an empty view.
+     */
+    bool empty() const;
+
+    /**
+     * Whether the view owns the chunk memory, i.e. the chunk was read from
+     * the file and not mapped.
+     *
+     * @return true if the view holds a buffer.
+     */
+    bool owns_buffer() const;
+
+   private:
+    const uint8_t* data_;
+    uint64_t size_;
+    std::shared_ptr<const ChunkBuffer> buf_;
+};
+
 /**
  * Interface to abstract the way of how we handle file system read/write
  * operations.
@@ -50,7 +125,7 @@ class OsfFile {
 
     /**
      * Opens the OSF file.
-     * @note Only OpenMode::READ is supported
+     * @note Only OpenMode::READ and OpenMode::READ_BUFFERED are supported
      *
      * @param[in] filename The OSF file to open
      * @param[in] mode The mode to open the file in, this argument is optional.
@@ -236,28 +311,46 @@ class OsfFile {
     OsfFile& operator=(OsfFile&& other);
 
     /**
-     * Read chunk specified at offset.
+     * Read chunk specified at offset. In mmap mode the chunk isn't copied and
+     * the view points into the mapping, otherwise the chunk is read into a
+     * buffer and kept in the LRU chunk cache.
      *
      * @throws std::out_of_range Exception on out of range read.
      *
      * @param[in] offset The offset to read the chunk from.
-     * @return Shared pointer to the chunk. nullptr if osf file is bad
+     * @return View of the chunk. Empty view if osf file is bad
+     */
+    ChunkView read_chunk(uint64_t offset);
+
+    /**
+     * Set the capacity of the chunk cache used when the file isn't memory
+     * mapped. Least recently read chunks are dropped once the cached chunks
+     * take more bytes than that, the last read chunk is always kept.
+     *
+     * @param[in] bytes The capacity of the cache in bytes.
+     */
+    void set_chunk_cache_size(uint64_t bytes);
+
+    /**
+     * Get the capacity of the chunk cache.
+     *
+     * @return The capacity of the chunk cache in bytes.
      */
-    std::shared_ptr<ChunkBuffer> read_chunk(uint64_t offset);
+    uint64_t chunk_cache_size() const;
 
     /**
      * Get a pointer to the start of the header chunk.
      *
      * @return Pointer to the header chunk. nullptr if filestream is bad.
      */
-    uint8_t* get_header_chunk_ptr();
+    const uint8_t* get_header_chunk_ptr();
 
     /**
      * Get a pointer to the start of the header chunk.
      *
      * @return Pointer to the metadata chunk. nullptr if filestream is bad.
      */
-    uint8_t* get_metadata_chunk_ptr();
+    const uint8_t* get_metadata_chunk_ptr();
 
    private:
     /**
@@ -298,23 +391,45 @@ class OsfFile {
     std::ifstream file_stream_;
 
     /**
-     * Pointer for the osf file header chunk.
+     * Drop the least recently read chunks until the cache fits its capacity.
+     */
+    void trim_chunk_cache();
+
+    /**
+     * View of the osf file header chunk.
+     */
+    ChunkView header_chunk_;
+
+    /**
+     * View of the metadata chunk
      */
-    std::shared_ptr<ChunkBuffer> header_chunk_;
+    ChunkView metadata_chunk_;
 
     /**
-     * Pointer for the metadata chunk
+     * Read chunks by offset, most recently read first, to save re-reading
+     * them on verify and then read iterator access and on interleaved
+     * streams playback (used only with buffered reads, i.e. READ_BUFFERED or
+     * builds with OUSTER_OSF_NO_MMAP; with mmap we rely on the OS/kernel
+     * caching)
      */
-    std::shared_ptr<ChunkBuffer> metadata_chunk_;
+    using ChunkCacheList =
+        std::list<std::pair<uint64_t, std::shared_ptr<const ChunkBuffer>>>;
+    ChunkCacheList chunk_cache_;
 
     /**
-     * Last read chunk cached, to save the double read on the sequence of verify
-     * and then read iterator access (used only when compiled with
-     * OUSTER_OSF_NO_MMAP, and in mmap version we rely on the OS/kernel caching)
+     * Index of chunk_cache_ by chunk offset.
      */
-    std::shared_ptr<ChunkBuffer> chunk_cache_;
+    std::unordered_map<uint64_t, ChunkCacheList::iterator> chunk_cache_index_;
 
-    uint64_t chunk_cache_offset_;
+    /**
+     * Size in bytes of the chunks in chunk_cache_.
+     */
+    uint64_t chunk_cache_bytes_;
+
+    /**
+     * Capacity of chunk_cache_ in bytes.
+     */
+    uint64_t chunk_cache_size_;
 
     /**
      * Internal state of the OSF file.
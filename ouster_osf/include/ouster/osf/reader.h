@@ -10,6 +10,7 @@
 
 #include <queue>
 #include <unordered_map>
+#include <utility>
 
 #include "ouster/osf/file.h"
 #include "ouster/osf/metadata.h"
@@ -592,6 +593,14 @@ class Reader {
      */
     const MetadataStore& meta_store() const;
 
+    /**
+     * Set the capacity of the cache of read chunks, used only when the file
+     * isn't memory mapped. See OsfFile::set_chunk_cache_size()
+     *
+     * @param[in] bytes The capacity of the cache in bytes.
+     */
+    void set_chunk_cache_size(uint64_t bytes);
+
     /**
      * If the chunks can be read by stream and in non-decreasing timestamp
      * order.
@@ -689,10 +698,11 @@ class MessageRef {
      * @param[in] buf The buffer to use to make a MessageRef object.
      * @param[in] meta_provider The metadata store that is used in types
      *                          reconstruction
-     * @param[in,out] chunk_buf The pre-existing chunk buffer to use.
+     * @param[in] chunk_buf The chunk holding the message, keeps the chunk
+     *                      buffer alive when it was read from the file.
      */
     MessageRef(const uint8_t* buf, const MetadataStore& meta_provider,
-               std::shared_ptr<std::vector<uint8_t>> chunk_buf);
+               ChunkView chunk_buf);
 
     /**
      * Get the message stream id.
@@ -749,10 +759,14 @@ class MessageRef {
      * Reconstructs the underlying data to the class (copies data).
      *
      * @tparam Stream The type of the target data.
+     * @tparam Args Types of the extra decoding arguments.
+     * @param[in] args Extra arguments passed on to Stream::decode_msg(), e.g.
+     *                 the fields to decode for LidarScanStream.
      * @return A smart pointer to the new object.
      */
-    template <typename Stream>
-    std::unique_ptr<typename Stream::obj_type> decode_msg() const {
+    template <typename Stream, typename... Args>
+    std::unique_ptr<typename Stream::obj_type> decode_msg(
+        Args&&... args) const {
         auto meta = meta_provider_.get<typename Stream::meta_type>(id());
 
         if (meta == nullptr) {
@@ -760,7 +774,8 @@ class MessageRef {
             return nullptr;
         }
 
-        return Stream::decode_msg(buffer(), *meta, meta_provider_);
+        return Stream::decode_msg(buffer(), *meta, meta_provider_,
+                                  std::forward<Args>(args)...);
     }
 
     /**
@@ -800,7 +815,7 @@ class MessageRef {
     /**
      * The internal chunk buffer to use.
      */
-    std::shared_ptr<ChunkBuffer> chunk_buf_;
+    ChunkView chunk_buf_;
 };  // MessageRef
 
 /**
@@ -969,7 +984,7 @@ class ChunkRef {
     /**
      * Chunk buffer to use for reading.
      */
-    std::shared_ptr<ChunkBuffer> chunk_buf_;
+    ChunkView chunk_buf_;
 };  // ChunkRef
 
 /**
@@ -0,0 +1,197 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ *
+ * @file scan_prefetcher.h
+ * @brief Decoding LidarScan messages ahead of the playback
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ouster/lidar_scan.h"
+#include "ouster/osf/basics.h"
+#include "ouster/osf/reader.h"
+
+namespace ouster {
+namespace osf {
+
+/**
+ * LidarScanPrefetcher settings.
+ */
+struct ScanPrefetchOptions {
+    /**
+     * Number of LidarScan messages read and decoded ahead of the one that
+     * is consumed, i.e. the most scans held in memory by the prefetcher.
+     */
+    uint32_t read_ahead{8};
+
+    /**
+     * Number of decoder threads, 0 uses one per hardware thread.
+     */
+    uint32_t decoder_threads{0};
+
+    /**
+     * Fields to decode, empty decodes all of them. See
+     * LidarScanStream::decode_msg()
+     */
+    std::vector<std::string> fields{};
+};
+
+/**
+ * LidarScan decoded from a message.
+ */
+struct DecodedScan {
+    /**
+     * Stream id of the message.
+     */
+    uint32_t stream_id{0};
+
+    /**
+     * Timestamp of the message.
+     */
+    ts_t ts{0};
+
+    /**
+     * Decoded scan, nullptr if the message couldn't be decoded, the same as
+     * MessageRef::decode_msg() returns.
+     */
+    std::unique_ptr<LidarScan> scan{};
+};
+
+/**
+ * Reads the LidarScanStream messages of a MessagesStreamingRange on a
+ * background thread and decodes up to ScanPrefetchOptions::read_ahead of
+ * them in parallel, while the caller processes the previous ones. Scans are
+ * returned in the order of the range, i.e. by timestamp, and messages of the
+ * other stream types are skipped.
+ *
+ * The Reader the range comes from is used by the prefetcher thread, so it
+ * must outlive the prefetcher and can't be iterated by anything else
+ * meanwhile.
+ *
+ * When built with OUSTER_OSF_NO_THREADING messages are read and decoded on
+ * the calling thread by next().
+ *
+ * @code{.cpp}
+ * Reader reader(osf_file);
+ * LidarScanPrefetcher prefetcher(reader.messages(), {16, 4});
+ * for (const DecodedScan& s : prefetcher) {
+ *     if (s.scan) process(s.stream_id, *s.scan);
+ * }
+ * @endcode
+ */
+class LidarScanPrefetcher {
+   public:
+    /**
+     * Single pass iterator over the decoded scans.
+     */
+    struct iterator {
+        using iterator_category = std::input_iterator_tag;
+        using value_type = DecodedScan;
+        using difference_type = std::ptrdiff_t;
+        using pointer = DecodedScan*;
+        using reference = DecodedScan&;
+
+        /**
+         * Get the current scan.
+         *
+         * @return The current scan.
+         */
+        reference operator*() const;
+
+        /**
+         * Get the current scan.
+         *
+         * @return Pointer to the current scan.
+         */
+        pointer operator->() const;
+
+        /**
+         * Move to the next scan, waits for it to be decoded.
+         *
+         * @throws the exception raised while reading or decoding it.
+         *
+         * @return The updated iterator.
+         */
+        iterator& operator++();
+
+        /**
+         * Check if two iterators are equal, only end iterators are.
+         *
+         * @param[in] other The other iterator to check against.
+         * @return If the two iterators are equal.
+         */
+        bool operator==(const iterator& other) const;
+
+        /**
+         * @copydoc operator==
+         * @return If the two iterators are not equal.
+         */
+        bool operator!=(const iterator& other) const;
+
+       private:
+        explicit iterator(LidarScanPrefetcher* prefetcher);
+
+        LidarScanPrefetcher* prefetcher_;
+        friend class LidarScanPrefetcher;
+    };
+
+    /**
+     * Start reading and decoding the messages of the range.
+     *
+     * @throws std::invalid_argument if read_ahead is 0.
+     *
+     * @param[in] messages The messages to decode.
+     * @param[in] options Read ahead depth, decoder threads and fields.
+     */
+    explicit LidarScanPrefetcher(const MessagesStreamingRange& messages,
+                                 const ScanPrefetchOptions& options = {});
+
+    /**
+     * Stops reading and waits for the decoder threads, discarding the scans
+     * that weren't consumed.
+     */
+    ~LidarScanPrefetcher();
+
+    LidarScanPrefetcher(const LidarScanPrefetcher&) = delete;
+    LidarScanPrefetcher& operator=(const LidarScanPrefetcher&) = delete;
+
+    /**
+     * Get the next decoded scan, waits for it to be decoded.
+     *
+     * @throws the exception raised while reading or decoding it.
+     *
+     * @param[out] scan The next scan.
+     * @return false if all messages of the range were consumed.
+     */
+    bool next(DecodedScan& scan);
+
+    /**
+     * Begin function for std iterator support, moves to the first scan not
+     * consumed yet.
+     *
+     * @return An iterator at the next scan.
+     */
+    iterator begin();
+
+    /**
+     * End function for std iterator support.
+     *
+     * @return An iterator signifying the end of the scans.
+     */
+    iterator end();
+
+   private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    DecodedScan current_{};
+};
+
+}  // namespace osf
+}  // namespace ouster
@@ -8,6 +8,12 @@
  */
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "ouster/osf/basics.h"
 #include "ouster/osf/meta_lidar_sensor.h"
 #include "ouster/osf/metadata.h"
@@ -46,9 +52,13 @@ class LidarScanStreamMeta : public MetadataEntryHelper<LidarScanStreamMeta> {
      * @param[in] sensor_meta_id Reference to LidarSensor metadata that
      *                           describes the sensor configuration.
      * @param[in] field_types LidarScan fields specs, this argument is optional.
+     * @param[in] field_steps Quantisation step of the quantised fields by
+     *                        field name, this argument is optional.
      */
-    LidarScanStreamMeta(const uint32_t sensor_meta_id,
-                        const ouster::LidarScanFieldTypes field_types = {});
+    LidarScanStreamMeta(
+        const uint32_t sensor_meta_id,
+        const ouster::LidarScanFieldTypes field_types = {},
+        const std::map<std::string, uint32_t>& field_steps = {});
 
     /**
      * Return the sensor meta id.
@@ -57,6 +67,14 @@ class LidarScanStreamMeta : public MetadataEntryHelper<LidarScanStreamMeta> {
      */
     uint32_t sensor_meta_id() const;
 
+    /**
+     * Return the quantisation steps of the fields, the fields not listed are
+     * stored as is.
+     *
+     * @return The quantisation step by field name.
+     */
+    const std::map<std::string, uint32_t>& field_steps() const;
+
     /**
      * @copydoc MetadataEntry::buffer
      */
@@ -100,6 +118,14 @@ class LidarScanStreamMeta : public MetadataEntryHelper<LidarScanStreamMeta> {
      *   fb/os_sensor/lidar_scan_stream.fbs :: LidarScanStream :: field_types
      */
     ouster::LidarScanFieldTypes field_types_;
+
+    /**
+     * Internal store of the quantisation steps.
+     *
+     * Flat Buffer Reference:
+     *   fb/os_sensor/lidar_scan_stream.fbs :: LidarScanStream :: quantization
+     */
+    std::map<std::string, uint32_t> field_steps_;
 };
 
 /** @defgroup OSFTraitsLidarScanStreamMeta Templated struct for traits.*/
@@ -159,6 +185,22 @@ class LidarScanStream : public MessageStream<LidarScanStreamMeta, LidarScan> {
      */
     std::vector<uint8_t> make_msg(const obj_type& lidar_scan);
 
+    /**
+     * Get a scratch scan for the quantized fields of a scan being encoded.
+     *
+     * @param[in] w width of the scan being encoded.
+     * @param[in] h height of the scan being encoded.
+     * @return a scan reused from an earlier make_msg() when one is free.
+     */
+    std::unique_ptr<obj_type> take_scratch(size_t w, size_t h);
+
+    /**
+     * Keep a scratch scan for the next make_msg().
+     *
+     * @param[in] scratch scan returned by take_scratch().
+     */
+    void give_back_scratch(std::unique_ptr<obj_type> scratch);
+
     /**
      * Decode/deserialize the object from bytes buffer using the concrete
      * metadata type for the stream.
@@ -174,6 +216,25 @@ class LidarScanStream : public MessageStream<LidarScanStreamMeta, LidarScan> {
         const std::vector<uint8_t>& buf, const meta_type& meta,
         const MetadataStore& meta_provider);
 
+    /**
+     * Decode only some of the fields of the LidarScan message, the others
+     * are neither allocated nor decompressed, e.g. `{"RANGE"}` for range
+     * only replays. The column headers are always decoded.
+     *
+     * @param[in] buf The buffer to decode into an object.
+     * @param[in] meta The concrete metadata type to use for decoding.
+     * @param[in] meta_provider Used to reconstruct any references to other
+     *                          metadata entries dependencies
+     *                          (like sensor_meta_id)
+     * @param[in] fields Names of the fields to decode, those missing from
+     *                   the message are ignored. Empty decodes all fields.
+     * @return Pointer to the decoded object.
+     */
+    static std::unique_ptr<obj_type> decode_msg(
+        const std::vector<uint8_t>& buf, const meta_type& meta,
+        const MetadataStore& meta_provider,
+        const std::vector<std::string>& fields);
+
    public:
     /**
      * @param[in] key Private class used to prevent non-friends from calling
@@ -224,6 +285,13 @@ class LidarScanStream : public MessageStream<LidarScanStreamMeta, LidarScan> {
      * The internal field_types data.
      */
     ouster::LidarScanFieldTypes field_types_;
+
+    /**
+     * Scratch scans holding quantized fields, one per make_msg() running
+     * concurrently on the async writer's encoder threads.
+     */
+    std::mutex scratch_mutex_;
+    std::vector<std::unique_ptr<obj_type>> scratch_;
 };
 
 }  // namespace osf
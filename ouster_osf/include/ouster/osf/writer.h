@@ -7,8 +7,12 @@
  */
 #pragma once
 
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <string>
 
+#include "ouster/array_view.h"
 #include "ouster/osf/basics.h"
 #include "ouster/osf/metadata.h"
 
@@ -16,6 +20,192 @@ namespace ouster {
 namespace osf {
 
 class LidarScanStream;
+class OutputFile;
+class AsyncWriterPipeline;
+class ThreadPool;
+
+/**
+ * When the Writer asks the OS to persist written data to the storage device.
+ */
+enum WriterSyncPolicy {
+    SYNC_NONE = 0,        ///< leave it to the OS
+    SYNC_ON_CLOSE = 1,    ///< sync once when the file is finished
+    SYNC_EVERY_CHUNK = 2  ///< sync after every chunk and on close
+};
+
+/**
+ * What an async Writer does with a new scan when its queue is full.
+ */
+enum WriterQueuePolicy {
+    QUEUE_BLOCK = 0,        ///< save() waits for space in the queue
+    QUEUE_DROP_NEWEST = 1,  ///< the new scan is dropped
+    QUEUE_DROP_OLDEST = 2   ///< the oldest scan not being encoded is dropped
+};
+
+/**
+ * Compression of the lidar scan fields written by a Writer.
+ */
+enum FieldCodec {
+    CODEC_PNG = 0,      ///< PNG images, readable by every OSF reader
+    CODEC_DEFLATE = 1,  ///< zlib
+    CODEC_ZSTD = 2,     ///< zstd, if the SDK was built with it
+    CODEC_LZ4 = 3       ///< LZ4, if the SDK was built with it
+};
+
+/**
+ * Preconditioning of the field data before compression, flags that can be
+ * combined. Not used by CODEC_PNG, which filters rows on its own.
+ */
+enum FieldFilter {
+    FILTER_NONE = 0,
+    FILTER_DELTA = 1,   ///< store the difference to the left pixel of a row
+    FILTER_SHUFFLE = 2  ///< group the bytes of all pixels by significance
+};
+
+/**
+ * Check whether this build of the SDK can write and read a field codec.
+ *
+ * @param[in] codec The codec to check.
+ * @return true if the codec is supported.
+ */
+bool field_codec_supported(FieldCodec codec);
+
+/**
+ * Counters of an async Writer queue.
+ *
+ * Latency is measured from save() until the encoded scan is handed to the
+ * chunk writer.
+ */
+struct WriterQueueStats {
+    uint64_t queued{0};                      ///< scans accepted by save()
+    uint64_t dropped{0};                     ///< scans dropped, queue full
+    uint64_t written{0};                     ///< scans written to chunks
+    uint32_t depth{0};                       ///< scans currently queued
+    uint32_t max_depth{0};                   ///< highest depth seen
+    std::chrono::nanoseconds last_latency{0};   ///< latest scan latency
+    std::chrono::nanoseconds max_latency{0};    ///< highest scan latency
+    std::chrono::nanoseconds total_latency{0};  ///< sum of all latencies
+};
+
+/**
+ * Lossy quantisation of lidar scan fields, for recordings that don't need
+ * the full sensor precision. Fields store round(value / step) and readers
+ * scale them back, so the absolute error is at most step / 2. Non-zero
+ * values stay non-zero: values below step / 2, which are well under the
+ * sensor minimum range for RANGE, are read back as step.
+ *
+ * Only UINT16 and wider unsigned fields are quantised. REFLECTIVITY and every
+ * other field are always stored as is. The defaults keep all fields lossless.
+ */
+struct FieldQuantization {
+    /**
+     * Step of RANGE and RANGE2 in millimetres, 1 keeps millimetres.
+     */
+    uint32_t range_step{1};
+
+    /**
+     * Bits of the 16 bit SIGNAL and SIGNAL2 values to keep, 1 to 16. The step
+     * is 2^(16 - signal_bits).
+     */
+    uint32_t signal_bits{16};
+
+    /**
+     * Bits of the 16 bit NEAR_IR values to keep, 1 to 16. The step is
+     * 2^(16 - near_ir_bits).
+     */
+    uint32_t near_ir_bits{16};
+};
+
+/**
+ * File I/O options of a Writer.
+ */
+struct WriterOptions {
+    /**
+     * Bytes to stage in memory before writing to the file. With 0 every chunk
+     * is written as soon as it's finished.
+     */
+    uint32_t write_buffer_size{0};
+
+    /**
+     * Bypass the page cache (O_DIRECT) for full write buffers. Uses a 4MB
+     * buffer if write_buffer_size is 0, and falls back to regular writes where
+     * it's not supported.
+     */
+    bool direct_io{false};
+
+    /**
+     * When to flush written data to the storage device (fdatasync).
+     */
+    WriterSyncPolicy sync_policy{SYNC_NONE};
+
+    /**
+     * Encode and write scans on background threads. save() of a LidarScan
+     * then only copies it into a bounded queue; encoder threads compress
+     * queued scans in parallel and a dedicated I/O thread appends them to
+     * chunks in the order they were saved. Errors raised on the background
+     * threads, e.g. a decreasing timestamp, are rethrown by the next save()
+     * or logged by close().
+     */
+    bool async{false};
+
+    /**
+     * Number of encoder threads in async mode, 0 uses one per hardware
+     * thread.
+     */
+    uint32_t encoder_threads{0};
+
+    /**
+     * Maximum number of scans held by the async queue, including scans being
+     * encoded.
+     */
+    uint32_t queue_depth{8};
+
+    /**
+     * What save() does when the async queue is full.
+     */
+    WriterQueuePolicy queue_policy{QUEUE_BLOCK};
+
+    /**
+     * Number of threads in the pool that compresses scan fields, shared by
+     * all lidar streams of the writer. Threads saving a scan help with the
+     * encoding, so 0 starts one less than the number of hardware threads.
+     */
+    uint32_t field_encoder_threads{0};
+
+    /**
+     * Compression of the lidar scan fields. Only SDK versions supporting the
+     * codec can read fields written with something else than CODEC_PNG,
+     * older ones fail to decode these scans.
+     */
+    FieldCodec field_codec{CODEC_PNG};
+
+    /**
+     * FieldFilter flags applied before compressing with field_codec.
+     */
+    uint32_t field_filters{FILTER_NONE};
+
+    /**
+     * Codec specific compression level, 0 uses a fast default. For LZ4 it's
+     * the acceleration factor, so higher values compress less.
+     */
+    int field_codec_level{0};
+
+    /**
+     * Compress RANGE and RANGE2 with the lossless range image codec, which
+     * predicts every return from its neighbours. Other fields keep using
+     * field_codec. Readers need the same SDK support as for field_codec.
+     */
+    bool range_codec{false};
+
+    /**
+     * Lossy quantisation of the lidar scan fields, stored in the stream
+     * metadata so readers restore the original scale. Quantised fields are
+     * flagged in every message and never stored as PNG (CODEC_DEFLATE is
+     * used instead of CODEC_PNG), so SDK versions without quantisation
+     * support reject these scans.
+     */
+    FieldQuantization field_quantization{};
+};
 
 /**
  * Chunks writing strategy that decides when and how exactly write chunks
@@ -57,6 +247,7 @@ class ChunksWriter {
  */
 class Writer {
     friend class StreamingLayoutCW;
+    friend class LidarScanStream;
 
    public:
     /**
@@ -73,8 +264,10 @@ class Writer {
      *     chunk_size means more messages are indexed and a larger number of
      *     index entries. A more granular index allows for more precise
      *     seeking at the slight expense of a larger file.
+     * @param[in] options File I/O options, optional.
      */
-    Writer(const std::string& file_name, uint32_t chunk_size = 0);
+    Writer(const std::string& file_name, uint32_t chunk_size = 0,
+           const WriterOptions& options = WriterOptions());
 
     /**
      * @param[in] filename The filename to output to.
@@ -85,11 +278,13 @@ class Writer {
      *                            the OSF. If not provided uses the fields from
      *                            the first saved lidar scan for this sensor.
      *                            This parameter is optional.
+     * @param[in] options File I/O options, optional.
      */
     Writer(const std::string& filename, const ouster::sensor::sensor_info& info,
            const std::vector<std::string>& fields_to_write =
                std::vector<std::string>(),
-           uint32_t chunk_size = 0);
+           uint32_t chunk_size = 0,
+           const WriterOptions& options = WriterOptions());
 
     /**
      * @param[in] filename The filename to output to.
@@ -101,12 +296,14 @@ class Writer {
      *                            the OSF. If not provided uses the fields from
      *                            the first saved lidar scan for this sensor.
      *                            This parameter is optional.
+     * @param[in] options File I/O options, optional.
      */
     Writer(const std::string& filename,
            const std::vector<ouster::sensor::sensor_info>& info,
            const std::vector<std::string>& fields_to_write =
                std::vector<std::string>(),
-           uint32_t chunk_size = 0);
+           uint32_t chunk_size = 0,
+           const WriterOptions& options = WriterOptions());
 
     /**
      * Add metadata to the OSF file.
@@ -119,7 +316,7 @@ class Writer {
     template <typename MetaType, typename... MetaParams>
     uint32_t add_metadata(MetaParams&&... params) {
         MetaType entry(std::forward<MetaParams>(params)...);
-        return meta_store_.add(entry);
+        return add_metadata(entry);
     }
 
     /**
@@ -375,7 +572,15 @@ class Writer {
     uint32_t sensor_info_count() const;
 
     /**
-     * Finish file with a proper metadata object, and header.
+     * Counters of the async queue, all zero if the writer isn't async.
+     *
+     * @return a snapshot of the queue counters.
+     */
+    WriterQueueStats queue_stats() const;
+
+    /**
+     * Finish file with a proper metadata object, and header. In async mode
+     * waits for all queued scans to be written first.
      */
     void close();
 
@@ -454,17 +659,27 @@ class Writer {
      *
      * @param[in] start_ts The lowest timestamp in the chunk.
      * @param[in] end_ts The highest timestamp in the chunk.
-     * @param[in] chunk_buf The byte vector representation of the chunk.
+     * @param[in] chunk_buf The serialized chunk.
      * @return The result offset in the OSF file.
      */
     uint64_t emit_chunk(const ts_t start_ts, const ts_t end_ts,
-                        const std::vector<uint8_t>& chunk_buf);
+                        const ConstArrayView1<uint8_t>& chunk_buf);
 
     /**
      * Internal filename of the OSF file.
      */
     std::string file_name_;
 
+    /**
+     * File I/O options.
+     */
+    WriterOptions options_;
+
+    /**
+     * The output file, open from construction until close().
+     */
+    std::unique_ptr<OutputFile> file_;
+
     /**
      * The size of the flatbuffer header blob.
      */
@@ -548,10 +763,28 @@ class Writer {
     std::map<uint32_t, std::unique_ptr<ouster::osf::LidarScanStream>>
         lidar_streams_;
 
+    /**
+     * Guards the chunks writer and metadata store, which the async I/O thread
+     * uses concurrently with the caller.
+     */
+    std::mutex save_mutex_;
+
+    /**
+     * Thread pool encoding the fields of scans from all lidar streams.
+     */
+    std::unique_ptr<ThreadPool> encoder_pool_;
+
     /**
      * The internal sensor_info store ordered by stream_index.
      */
     std::vector<ouster::sensor::sensor_info> sensor_info_;
+
+    /**
+     * Encode/write pipeline, only in async mode. Its threads use the members
+     * above, so it's stopped explicitly in ~Writer() and declared last to be
+     * destroyed first all the same.
+     */
+    std::unique_ptr<AsyncWriterPipeline> async_;
 };
 
 /**
@@ -582,9 +815,14 @@ class ChunkBuilder {
      * Finish out the serialization of the chunk and return the raw
      * flatbuffer output.
      *
-     * @return The serialized chunk in a raw flatbuffer byte vector.
+     * The returned view points into the builder, it stays valid until
+     * reset() is called. The builder memory is kept by reset() and reused by
+     * the next chunk.
+     *
+     * @return The serialized chunk as a raw flatbuffer byte view, empty if
+     *         there are no messages.
      */
-    std::vector<uint8_t> finish();
+    ConstArrayView1<uint8_t> finish();
 
     /**
      * Returns the flatbufferbuilder size.
@@ -0,0 +1,187 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "async_writer.h"
+
+#include <algorithm>
+
+#include "ouster/impl/logging.h"
+
+using namespace ouster::sensor;
+
+namespace ouster {
+namespace osf {
+
+AsyncWriterPipeline::AsyncWriterPipeline(const WriterOptions& options,
+                                         encode_fn encode, write_fn write)
+    : options_(options), encode_(std::move(encode)), write_(std::move(write)) {
+    uint32_t n_encoders = options_.encoder_threads;
+    if (n_encoders == 0)
+        n_encoders = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t i = 0; i < n_encoders; ++i)
+        encoders_.emplace_back(&AsyncWriterPipeline::encode_loop, this);
+    io_thread_ = std::thread(&AsyncWriterPipeline::io_loop, this);
+}
+
+AsyncWriterPipeline::~AsyncWriterPipeline() {
+    try {
+        finish();
+    } catch (const std::exception& e) {
+        logger().error("ERROR: async writer failed: {}", e.what());
+    }
+}
+
+bool AsyncWriterPipeline::push(LidarScanStream& stream, const ts_t ts,
+                               const LidarScan& scan) {
+    const auto queued_at = clock::now();
+    // copy the scan outside of the lock, the caller is free to reuse it
+    std::unique_ptr<Job> job{new Job{0, &stream, ts, scan, queued_at}};
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error_) {
+        error_reported_ = true;
+        std::rethrow_exception(error_);
+    }
+    if (stopping_) throw std::logic_error("ERROR: async writer is finished");
+
+    const uint32_t depth = std::max(1u, options_.queue_depth);
+    bool dropped = false;
+    if (stats_.depth >= depth) {
+        if (options_.queue_policy == QUEUE_BLOCK) {
+            space_cv_.wait(lock, [&] {
+                return stats_.depth < depth || error_ != nullptr;
+            });
+            if (error_) {
+                error_reported_ = true;
+                std::rethrow_exception(error_);
+            }
+        } else if (options_.queue_policy == QUEUE_DROP_OLDEST &&
+                   !to_encode_.empty()) {
+            // the oldest scan that isn't being encoded yet gives up its place;
+            // its sequence number still has to reach the I/O thread
+            std::unique_ptr<Job> oldest = std::move(to_encode_.front());
+            to_encode_.pop_front();
+            oldest->dropped = true;
+            oldest->scan = LidarScan{};
+            encoded_.emplace(oldest->seq, std::move(oldest));
+            stats_.depth--;
+            stats_.dropped++;
+            dropped = true;
+            io_cv_.notify_one();
+        } else {
+            stats_.dropped++;
+            return false;
+        }
+    }
+
+    job->seq = next_seq_++;
+    to_encode_.push_back(std::move(job));
+    stats_.queued++;
+    stats_.depth++;
+    stats_.max_depth = std::max(stats_.max_depth, stats_.depth);
+    lock.unlock();
+    encode_cv_.notify_one();
+    return !dropped;
+}
+
+void AsyncWriterPipeline::encode_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        encode_cv_.wait(lock,
+                        [this] { return stopping_ || !to_encode_.empty(); });
+        if (to_encode_.empty()) return;  // stopping and drained
+
+        std::unique_ptr<Job> job = std::move(to_encode_.front());
+        to_encode_.pop_front();
+        lock.unlock();
+
+        try {
+            job->msg = encode_(*job->stream, job->scan);
+        } catch (...) {
+            set_error(std::current_exception());
+            job->failed = true;
+        }
+        job->scan = LidarScan{};  // release the copy early
+
+        lock.lock();
+        const bool next = job->seq == next_write_seq_;
+        encoded_.emplace(job->seq, std::move(job));
+        if (next) io_cv_.notify_one();
+    }
+}
+
+void AsyncWriterPipeline::io_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        io_cv_.wait(lock, [this] {
+            return encoded_.count(next_write_seq_) ||
+                   (stopping_ && next_write_seq_ == next_seq_);
+        });
+        auto it = encoded_.find(next_write_seq_);
+        if (it == encoded_.end()) return;  // stopping and drained
+
+        std::unique_ptr<Job> job = std::move(it->second);
+        encoded_.erase(it);
+        const bool write = !job->dropped && !job->failed && !error_;
+        lock.unlock();
+
+        if (write) {
+            try {
+                write_(*job->stream, job->ts, job->msg);
+            } catch (...) {
+                set_error(std::current_exception());
+            }
+        }
+        const auto latency = clock::now() - job->queued_at;
+
+        lock.lock();
+        next_write_seq_++;
+        if (write) {
+            stats_.written++;
+            stats_.last_latency =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(latency);
+            stats_.max_latency =
+                std::max(stats_.max_latency, stats_.last_latency);
+            stats_.total_latency += stats_.last_latency;
+        }
+        // dropped jobs left the queue already when they were dropped
+        if (!job->dropped) stats_.depth--;
+        space_cv_.notify_all();
+    }
+}
+
+void AsyncWriterPipeline::set_error(std::exception_ptr err) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = err;
+    space_cv_.notify_all();
+}
+
+void AsyncWriterPipeline::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && !io_thread_.joinable()) return;
+        stopping_ = true;
+    }
+    encode_cv_.notify_all();
+    io_cv_.notify_all();
+    for (auto& t : encoders_)
+        if (t.joinable()) t.join();
+    if (io_thread_.joinable()) io_thread_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_ && !error_reported_) {
+        // not seen by push() yet
+        error_reported_ = true;
+        std::rethrow_exception(error_);
+    }
+}
+
+WriterQueueStats AsyncWriterPipeline::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}  // namespace osf
+}  // namespace ouster
@@ -0,0 +1,131 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ouster/lidar_scan.h"
+#include "ouster/osf/basics.h"
+#include "ouster/osf/writer.h"
+
+namespace ouster {
+namespace osf {
+
+class LidarScanStream;
+
+/**
+ * Background encode and write pipeline used by Writer in async mode.
+ *
+ * Scans pushed by the caller are encoded by a pool of encoder threads, then
+ * handed to a single I/O thread in the order they were pushed, which builds
+ * and appends the chunks. The number of scans held by the pipeline is bounded
+ * by the queue depth; when it's reached push() blocks or drops a scan
+ * depending on the queue policy.
+ */
+class AsyncWriterPipeline {
+   public:
+    /// Encodes a scan into a message buffer, called on encoder threads
+    using encode_fn = std::function<std::vector<uint8_t>(LidarScanStream&,
+                                                         const LidarScan&)>;
+
+    /// Saves an encoded message, called on the I/O thread in push() order
+    using write_fn = std::function<void(LidarScanStream&, const ts_t,
+                                        const std::vector<uint8_t>&)>;
+
+    /**
+     * Start the encoder and I/O threads.
+     *
+     * @param[in] options writer options with the async settings.
+     * @param[in] encode function encoding a scan.
+     * @param[in] write function saving an encoded message.
+     */
+    AsyncWriterPipeline(const WriterOptions& options, encode_fn encode,
+                        write_fn write);
+
+    /**
+     * Stops the pipeline, see finish().
+     */
+    ~AsyncWriterPipeline();
+
+    AsyncWriterPipeline(const AsyncWriterPipeline&) = delete;
+    AsyncWriterPipeline& operator=(const AsyncWriterPipeline&) = delete;
+
+    /**
+     * Queue a copy of the scan for encoding and writing.
+     *
+     * @throws any exception raised by an earlier encode or write.
+     *
+     * @param[in] stream stream the scan belongs to.
+     * @param[in] ts timestamp of the scan.
+     * @param[in] scan the scan to save.
+     * @return false if the scan or an older one was dropped because the
+     *         queue was full.
+     */
+    bool push(LidarScanStream& stream, const ts_t ts, const LidarScan& scan);
+
+    /**
+     * Wait until all queued scans are written and stop the threads.
+     *
+     * @throws the first exception raised by an encode or write, if any.
+     */
+    void finish();
+
+    /**
+     * @return a snapshot of the queue counters.
+     */
+    WriterQueueStats stats() const;
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    struct Job {
+        uint64_t seq;
+        LidarScanStream* stream;
+        ts_t ts;
+        LidarScan scan;
+        clock::time_point queued_at;
+        std::vector<uint8_t> msg{};
+        bool dropped{false};  ///< dropped from a full queue
+        bool failed{false};   ///< encoding threw
+    };
+
+    void encode_loop();
+    void io_loop();
+    void set_error(std::exception_ptr err);
+
+    const WriterOptions options_;
+    encode_fn encode_;
+    write_fn write_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable encode_cv_;  ///< jobs to encode or stopping
+    std::condition_variable io_cv_;      ///< next job encoded or stopping
+    std::condition_variable space_cv_;   ///< a job left the pipeline
+
+    std::deque<std::unique_ptr<Job>> to_encode_{};
+    std::map<uint64_t, std::unique_ptr<Job>> encoded_{};
+    uint64_t next_seq_{0};
+    uint64_t next_write_seq_{0};
+    bool stopping_{false};
+    bool error_reported_{false};
+    std::exception_ptr error_{nullptr};
+    WriterQueueStats stats_{};
+
+    std::vector<std::thread> encoders_{};
+    std::thread io_thread_{};
+};
+
+}  // namespace osf
+}  // namespace ouster
@@ -5,8 +5,10 @@
 
 #include "compat_ops.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <string>
 
 #include "ouster/impl/logging.h"
@@ -17,6 +19,7 @@
 #include <io.h>
 #include <share.h>
 #include <shlwapi.h>
+#include <sys/stat.h>
 #include <tchar.h>
 #include <windows.h>
 #else
@@ -25,6 +28,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
 #endif
 
@@ -406,5 +410,76 @@ int64_t copy_file_trailing_bytes(const std::string& source_file,
     return saved_size;
 }
 
+int file_open_write(const std::string& path) {
+#ifdef _WIN32
+    int fd = -1;
+    if (_sopen_s(&fd, path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                 _SH_DENYWR, _S_IREAD | _S_IWRITE) != 0)
+        return -1;
+    return fd;
+#else
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+bool file_set_direct_io(int fd, bool direct_io) {
+#if defined(_WIN32)
+    (void)fd;
+    return !direct_io;
+#elif defined(O_DIRECT)
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) return false;
+    flags = direct_io ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    return fcntl(fd, F_SETFL, flags) == 0;
+#elif defined(F_NOCACHE)
+    return fcntl(fd, F_NOCACHE, direct_io ? 1 : 0) == 0;
+#else
+    (void)fd;
+    return !direct_io;
+#endif
+}
+
+bool file_pwrite(int fd, const uint8_t* buf, uint64_t size, uint64_t offset) {
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) return false;
+    while (size > 0) {
+        const unsigned int n = static_cast<unsigned int>(
+            std::min<uint64_t>(size, std::numeric_limits<int>::max()));
+        const int res = _write(fd, buf, n);
+        if (res <= 0) return false;
+        buf += res;
+        size -= res;
+    }
+#else
+    while (size > 0) {
+        const ssize_t res = pwrite(fd, buf, size, offset);
+        if (res < 0 && errno == EINTR) continue;
+        if (res <= 0) return false;
+        buf += res;
+        size -= res;
+        offset += res;
+    }
+#endif
+    return true;
+}
+
+bool file_sync(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+bool file_close(int fd) {
+#ifdef _WIN32
+    return _close(fd) == 0;
+#else
+    return close(fd) == 0;
+#endif
+}
+
 }  // namespace osf
 }  // namespace ouster
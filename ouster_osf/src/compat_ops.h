@@ -87,5 +87,23 @@ int64_t append_binary_file(const std::string& append_to_file_name,
 int64_t copy_file_trailing_bytes(const std::string& source_file,
                                  const std::string& target_file,
                                  uint64_t offset);
+
+/// Open (create or truncate) a file for writing, returns a file descriptor or
+/// -1 on error
+int file_open_write(const std::string& path);
+
+/// Enable or disable page cache bypass (O_DIRECT) on an open file, returns
+/// false if the platform doesn't support it. Direct writes require aligned
+/// buffers, sizes and offsets.
+bool file_set_direct_io(int fd, bool direct_io);
+
+/// Write the whole buffer at the file offset, returns false on error
+bool file_pwrite(int fd, const uint8_t* buf, uint64_t size, uint64_t offset);
+
+/// Flush written file data to the storage device
+bool file_sync(int fd);
+
+/// Close a file descriptor obtained from file_open_write
+bool file_close(int fd);
 }  // namespace osf
 }  // namespace ouster
@@ -13,20 +13,118 @@
 #include <cstring>
 #include <iostream>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define OUSTER_CRC32_CLMUL_X86
+#endif
+
 namespace ouster {
 namespace osf {
 
 const uint32_t CRC_INITIAL_VALUE = 0L;
 
+#if defined(OUSTER_CRC32_CLMUL_X86)
+
+#define OUSTER_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+
+// Buffers shorter than that go to zlib
+constexpr uint32_t CLMUL_MIN_SIZE = 64;
+
+static bool cpu_has_clmul() {
+    static const bool has_clmul = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") != 0 &&
+               __builtin_cpu_supports("sse4.1") != 0;
+    }();
+    return has_clmul;
+}
+
+OUSTER_TARGET_CLMUL static inline __m128i load(const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// a * k_lo ^ a * k_hi, moves 128 bits forward by the folding distance of k
+OUSTER_TARGET_CLMUL static inline __m128i fold(__m128i a, __m128i k) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x00),
+                         _mm_clmulepi64_si128(a, k, 0x11));
+}
+
+// CRC32 (zlib polynomial) folding 64 bytes per step with carry-less
+// multiplication, as in Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction". `crc` is the raw, not inverted, register and
+// `size` a multiple of 16 of at least CLMUL_MIN_SIZE.
+OUSTER_TARGET_CLMUL static uint32_t crc32_clmul(uint32_t crc,
+                                                const uint8_t* buf,
+                                                uint32_t size) {
+    // bit-reflected folding constants x^(k) mod P(x) and the Barrett
+    // reduction constants
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    __m128i x1 = _mm_xor_si128(load(buf), _mm_cvtsi32_si128(crc));
+    __m128i x2 = load(buf + 16);
+    __m128i x3 = load(buf + 32);
+    __m128i x4 = load(buf + 48);
+    buf += 64;
+    size -= 64;
+
+    __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    for (; size >= 64; buf += 64, size -= 64) {
+        x1 = _mm_xor_si128(fold(x1, k), load(buf));
+        x2 = _mm_xor_si128(fold(x2, k), load(buf + 16));
+        x3 = _mm_xor_si128(fold(x3, k), load(buf + 32));
+        x4 = _mm_xor_si128(fold(x4, k), load(buf + 48));
+    }
+
+    // four lanes into one
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x1 = _mm_xor_si128(fold(x1, k), x2);
+    x1 = _mm_xor_si128(fold(x1, k), x3);
+    x1 = _mm_xor_si128(fold(x1, k), x4);
+    for (; size >= 16; buf += 16, size -= 16) {
+        x1 = _mm_xor_si128(fold(x1, k), load(buf));
+    }
+
+    // 128 to 64 bits
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8),
+                       _mm_clmulepi64_si128(x1, k, 0x10));
+    k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x1 = _mm_xor_si128(
+        _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00),
+        _mm_srli_si128(x1, 4));
+
+    // Barrett reduction to 32 bits
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+#endif
+
 // =============== ZLIB functions wrappers ====================
 
 uint32_t crc32(const uint8_t* buf, uint32_t size) {
-    return crc32_z(CRC_INITIAL_VALUE, buf, size);
+    return crc32(CRC_INITIAL_VALUE, buf, size);
 }
 
 uint32_t crc32(uint32_t initial_crc, const uint8_t* buf, uint32_t size) {
+#if defined(OUSTER_CRC32_CLMUL_X86)
+    if (size >= CLMUL_MIN_SIZE && cpu_has_clmul()) {
+        const uint32_t n = size & ~uint32_t{15};
+        initial_crc = ~crc32_clmul(~initial_crc, buf, n);
+        buf += n;
+        size -= n;
+        if (size == 0) return initial_crc;
+    }
+#endif
     return crc32_z(initial_crc, buf, size);
 }
 
 }  // namespace osf
-}  // namespace ouster
\ No newline at end of file
+}  // namespace ouster
@@ -5,6 +5,7 @@
 
 #include "fb_utils.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -84,12 +85,20 @@ uint64_t builder_to_file(flatbuffers::FlatBufferBuilder& builder,
     return buffer_to_file(buf, size, filename, append);
 }
 
-uint64_t start_osf_file(const std::string& filename) {
-    auto header_fbb = flatbuffers::FlatBufferBuilder(1024);
+// Builds a size prefixed OSF v2 header
+static void build_osf_header(flatbuffers::FlatBufferBuilder& header_fbb,
+                             ouster::osf::HEADER_STATUS status,
+                             const uint64_t metadata_offset,
+                             const uint64_t file_size) {
     auto header = ouster::osf::gen::CreateHeader(
-        header_fbb, ouster::osf::OSF_VERSION::V_2_0,
-        ouster::osf::HEADER_STATUS::INVALID, 0, 0);
+        header_fbb, ouster::osf::OSF_VERSION::V_2_0, status, metadata_offset,
+        file_size);
     header_fbb.FinishSizePrefixed(header, ouster::osf::gen::HeaderIdentifier());
+}
+
+uint64_t start_osf_file(const std::string& filename) {
+    auto header_fbb = flatbuffers::FlatBufferBuilder(1024);
+    build_osf_header(header_fbb, ouster::osf::HEADER_STATUS::INVALID, 0, 0);
     return builder_to_file(header_fbb, filename, false);
 }
 
@@ -97,11 +106,8 @@ uint64_t finish_osf_file(const std::string& filename,
                          const uint64_t metadata_offset,
                          const uint32_t metadata_size) {
     auto header_fbb = flatbuffers::FlatBufferBuilder(1024);
-    auto header = ouster::osf::gen::CreateHeader(
-        header_fbb, ouster::osf::OSF_VERSION::V_2_0,
-        ouster::osf::HEADER_STATUS::VALID, metadata_offset,
-        metadata_offset + metadata_size);
-    header_fbb.FinishSizePrefixed(header, ouster::osf::gen::HeaderIdentifier());
+    build_osf_header(header_fbb, ouster::osf::HEADER_STATUS::VALID,
+                     metadata_offset, metadata_offset + metadata_size);
 
     const uint8_t* buf = header_fbb.GetBufferPointer();
     uint32_t size = header_fbb.GetSize();
@@ -135,5 +141,52 @@ uint64_t finish_osf_file(const std::string& filename,
     return saved_size;
 }
 
+uint64_t buffer_to_file(const uint8_t* buf, const uint64_t size,
+                        OutputFile& file) {
+    // CRC every slice right before writing it, so large chunks are read from
+    // memory once instead of once for the CRC and once for the write
+    constexpr uint64_t CRC_SLICE_SIZE = 256 * 1024;
+    uint32_t crc_res = osf::crc32(nullptr, 0);
+    for (uint64_t offset = 0; offset < size; offset += CRC_SLICE_SIZE) {
+        const uint64_t n = std::min(CRC_SLICE_SIZE, size - offset);
+        crc_res =
+            osf::crc32(crc_res, buf + offset, static_cast<uint32_t>(n));
+        if (!file.write(buf + offset, n)) {
+            logger().error("ERROR: Failed to write {} bytes", size + 4);
+            return 0;
+        }
+    }
+    if (!file.write(reinterpret_cast<const uint8_t*>(&crc_res),
+                    sizeof(uint32_t))) {
+        logger().error("ERROR: Failed to write {} bytes", size + 4);
+        return 0;
+    }
+    return size + 4;
+}
+
+uint64_t start_osf_file(OutputFile& file) {
+    auto header_fbb = flatbuffers::FlatBufferBuilder(1024);
+    build_osf_header(header_fbb, ouster::osf::HEADER_STATUS::INVALID, 0, 0);
+    return buffer_to_file(header_fbb.GetBufferPointer(), header_fbb.GetSize(),
+                          file);
+}
+
+uint64_t finish_osf_file(OutputFile& file, const uint64_t metadata_offset,
+                         const uint32_t metadata_size) {
+    auto header_fbb = flatbuffers::FlatBufferBuilder(1024);
+    build_osf_header(header_fbb, ouster::osf::HEADER_STATUS::VALID,
+                     metadata_offset, metadata_offset + metadata_size);
+
+    const uint8_t* buf = header_fbb.GetBufferPointer();
+    uint32_t size = header_fbb.GetSize();
+    uint32_t crc_res = osf::crc32(buf, size);
+
+    if (!file.write_at(0, buf, size)) return 0;
+    if (!file.write_at(size, reinterpret_cast<const uint8_t*>(&crc_res),
+                       sizeof(uint32_t)))
+        return size;
+    return size + sizeof(uint32_t);
+}
+
 }  // namespace osf
 }  // namespace ouster
@@ -8,6 +8,7 @@
 #include "header_generated.h"
 #include "metadata_generated.h"
 #include "ouster/osf/basics.h"
+#include "output_file.h"
 
 // OSF v2 basic types for LidarSensor and LidarScan/Imu Streams
 #include "os_sensor/lidar_scan_stream_generated.h"
@@ -123,5 +124,41 @@ uint64_t start_osf_file(const std::string& filename);
 uint64_t finish_osf_file(const std::string& filename,
                          const uint64_t metadata_offset,
                          const uint32_t metadata_size);
+
+/**
+ * Appends the buffer content with an additional 4 bytes of calculated CRC32
+ * field to an open output file. The CRC is computed slice by slice while the
+ * buffer is written.
+ *
+ * @param[in] buf pointer to the data to save, full content of the buffer used
+ *            to calculate CRC
+ * @param[in] size number of bytes to read from buffer and store to the file
+ * @param[in] file output file to append to
+ * @return Number of bytes actually written to the file. Successfull write is
+ *         size + 4 bytes (4 bytes for CRC field)
+ */
+uint64_t buffer_to_file(const uint8_t* buf, const uint64_t size,
+                        OutputFile& file);
+
+/**
+ * Starts the OSF v2 file with a header (in INVALID state), the file should be
+ * empty.
+ *
+ * @param[in] file output file to write the header to.
+ * @return Number of bytes actually written to the file.
+ */
+uint64_t start_osf_file(OutputFile& file);
+
+/**
+ * Finish OSF v2 file by overwriting the header with updated offset to
+ * metadata and filesize.
+ *
+ * @param[in] file output file started with start_osf_file.
+ * @param[in] metadata_offset The offset to the metadata blob.
+ * @param[in] metadata_size The size of the metadata blob.
+ * @return Number of bytes actually written to the file.
+ */
+uint64_t finish_osf_file(OutputFile& file, const uint64_t metadata_offset,
+                         const uint32_t metadata_size);
 }  // namespace osf
 }  // namespace ouster
@@ -0,0 +1,453 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "field_codecs.h"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "ouster/impl/logging.h"
+#include "ouster/osf/writer.h"
+#include "range_codec.h"
+#include "thread_pool.h"
+
+#ifdef OUSTER_OSF_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef OUSTER_OSF_WITH_LZ4
+#include <lz4.h>
+#endif
+
+using namespace ouster::sensor;
+
+namespace ouster {
+namespace osf {
+
+namespace {
+
+/**
+ * Compress `size` bytes of `src` into `dst`, resizing it to the compressed
+ * size. Returns true on error.
+ */
+using compress_fn = bool (*)(const uint8_t* src, size_t size, int level,
+                             ScanChannelData& dst);
+
+/**
+ * Decompress `size` bytes of `src` into exactly `dst_size` bytes of `dst`.
+ * Returns true on error, including a size mismatch.
+ */
+using decompress_fn = bool (*)(const uint8_t* src, size_t size, uint8_t* dst,
+                               size_t dst_size);
+
+struct ChannelCodecEntry {
+    gen::ChannelCodec codec;
+    const char* name;
+    compress_fn compress;
+    decompress_fn decompress;
+};
+
+// Level 1 everywhere by default: these codecs are picked for speed and the
+// preconditioning filters do most of the work on lidar data
+bool deflate_compress(const uint8_t* src, size_t size, int level,
+                      ScanChannelData& dst) {
+    uLongf dst_size = compressBound(size);
+    dst.resize(dst_size);
+    if (compress2(dst.data(), &dst_size, src, size, level ? level : 1) !=
+        Z_OK) {
+        return true;
+    }
+    dst.resize(dst_size);
+    return false;
+}
+
+bool deflate_decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                        size_t dst_size) {
+    uLongf res_size = dst_size;
+    return uncompress(dst, &res_size, src, size) != Z_OK ||
+           res_size != dst_size;
+}
+
+#ifdef OUSTER_OSF_WITH_ZSTD
+bool zstd_compress(const uint8_t* src, size_t size, int level,
+                   ScanChannelData& dst) {
+    dst.resize(ZSTD_compressBound(size));
+    size_t res =
+        ZSTD_compress(dst.data(), dst.size(), src, size, level ? level : 1);
+    if (ZSTD_isError(res)) return true;
+    dst.resize(res);
+    return false;
+}
+
+bool zstd_decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                     size_t dst_size) {
+    size_t res = ZSTD_decompress(dst, dst_size, src, size);
+    return ZSTD_isError(res) || res != dst_size;
+}
+#endif
+
+#ifdef OUSTER_OSF_WITH_LZ4
+// level is the LZ4 acceleration factor, higher is faster
+bool lz4_compress(const uint8_t* src, size_t size, int level,
+                  ScanChannelData& dst) {
+    if (size > LZ4_MAX_INPUT_SIZE) return true;
+    dst.resize(LZ4_compressBound(static_cast<int>(size)));
+    const int acceleration = level ? level : 1;
+    int res = LZ4_compress_fast(
+        reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst.data()),
+        static_cast<int>(size), static_cast<int>(dst.size()), acceleration);
+    if (res <= 0) return true;
+    dst.resize(res);
+    return false;
+}
+
+bool lz4_decompress(const uint8_t* src, size_t size, uint8_t* dst,
+                    size_t dst_size) {
+    if (size > LZ4_MAX_INPUT_SIZE || dst_size > LZ4_MAX_INPUT_SIZE) {
+        return true;
+    }
+    int res = LZ4_decompress_safe(reinterpret_cast<const char*>(src),
+                                  reinterpret_cast<char*>(dst),
+                                  static_cast<int>(size),
+                                  static_cast<int>(dst_size));
+    return res < 0 || static_cast<size_t>(res) != dst_size;
+}
+#endif
+
+// Codecs compiled in, besides PNG which goes through png_tools
+const ChannelCodecEntry channel_codecs[] = {
+    {gen::ChannelCodec::DEFLATE, "DEFLATE", deflate_compress,
+     deflate_decompress},
+#ifdef OUSTER_OSF_WITH_ZSTD
+    {gen::ChannelCodec::ZSTD, "ZSTD", zstd_compress, zstd_decompress},
+#endif
+#ifdef OUSTER_OSF_WITH_LZ4
+    {gen::ChannelCodec::LZ4, "LZ4", lz4_compress, lz4_decompress},
+#endif
+};
+
+const ChannelCodecEntry* find_channel_codec(gen::ChannelCodec codec) {
+    for (const auto& c : channel_codecs) {
+        if (c.codec == codec) return &c;
+    }
+    return nullptr;
+}
+
+constexpr uint8_t CHANNEL_FILTER_DELTA =
+    static_cast<uint8_t>(gen::ChannelFilter::DELTA);
+constexpr uint8_t CHANNEL_FILTER_SHUFFLE =
+    static_cast<uint8_t>(gen::ChannelFilter::SHUFFLE);
+constexpr uint8_t CHANNEL_FILTER_QUANTIZED =
+    static_cast<uint8_t>(gen::ChannelFilter::QUANTIZED);
+constexpr uint8_t CHANNEL_FILTERS_ALL =
+    CHANNEL_FILTER_DELTA | CHANNEL_FILTER_SHUFFLE | CHANNEL_FILTER_QUANTIZED;
+
+// Replace every pixel but the first in a row by the difference to its left
+// neighbour. Wraps around, so it's exactly reversible for unsigned types.
+template <typename T>
+void delta_rows(T* data, size_t rows, size_t cols) {
+    for (size_t u = 0; u < rows; ++u) {
+        T* row = data + u * cols;
+        for (size_t v = cols - 1; v > 0; --v) {
+            row[v] = static_cast<T>(row[v] - row[v - 1]);
+        }
+    }
+}
+
+template <typename T>
+void undelta_rows(T* data, size_t rows, size_t cols) {
+    for (size_t u = 0; u < rows; ++u) {
+        T* row = data + u * cols;
+        for (size_t v = 1; v < cols; ++v) {
+            row[v] = static_cast<T>(row[v] + row[v - 1]);
+        }
+    }
+}
+
+// Group the bytes of `n` elements of `size` bytes by significance
+void shuffle_bytes(const uint8_t* src, uint8_t* dst, size_t n, size_t size) {
+    for (size_t b = 0; b < size; ++b) {
+        uint8_t* plane = dst + b * n;
+        for (size_t i = 0; i < n; ++i) plane[i] = src[i * size + b];
+    }
+}
+
+void unshuffle_bytes(const uint8_t* src, uint8_t* dst, size_t n, size_t size) {
+    for (size_t b = 0; b < size; ++b) {
+        const uint8_t* plane = src + b * n;
+        for (size_t i = 0; i < n; ++i) dst[i * size + b] = plane[i];
+    }
+}
+
+template <typename T>
+bool encode_image(ScanChannelData& res_buf,
+                  const Eigen::Ref<const img_t<T>>& img,
+                  const std::vector<int>& px_offset,
+                  const ChannelCodecEntry& codec, uint8_t filters,
+                  int level) {
+    const size_t rows = img.rows();
+    const size_t cols = img.cols();
+    const size_t n = rows * cols;
+
+    // per-thread scratch buffers, reused across scans
+    thread_local img_t<T> destaggered;
+    thread_local std::vector<uint8_t> shuffled;
+
+    destaggered.resize(rows, cols);  // no-op if the size is unchanged
+    destagger_into<T>(destaggered, img, px_offset);
+
+    if (filters & CHANNEL_FILTER_DELTA) {
+        delta_rows(destaggered.data(), rows, cols);
+    }
+
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(destaggered.data());
+    if ((filters & CHANNEL_FILTER_SHUFFLE) && sizeof(T) > 1) {
+        shuffled.resize(n * sizeof(T));
+        shuffle_bytes(raw, shuffled.data(), n, sizeof(T));
+        raw = shuffled.data();
+    }
+
+    return codec.compress(raw, n * sizeof(T), level, res_buf);
+}
+
+template <typename T>
+bool decode_image(Eigen::Ref<img_t<T>> img, const uint8_t* buf, size_t size,
+                  const std::vector<int>& px_offset,
+                  const ChannelCodecEntry& codec, uint8_t filters) {
+    const size_t rows = img.rows();
+    const size_t cols = img.cols();
+    const size_t n = rows * cols;
+    uint8_t* raw = reinterpret_cast<uint8_t*>(img.data());
+
+    if ((filters & CHANNEL_FILTER_SHUFFLE) && sizeof(T) > 1) {
+        thread_local std::vector<uint8_t> shuffled;
+        shuffled.resize(n * sizeof(T));
+        if (codec.decompress(buf, size, shuffled.data(), shuffled.size())) {
+            return true;
+        }
+        unshuffle_bytes(shuffled.data(), raw, n, sizeof(T));
+    } else if (codec.decompress(buf, size, raw, n * sizeof(T))) {
+        return true;
+    }
+
+    if (filters & CHANNEL_FILTER_DELTA) undelta_rows(img.data(), rows, cols);
+
+    destagger_in_place<T>(img, px_offset, true);
+    return false;
+}
+
+const ChannelCodecEntry& checked_codec(gen::ChannelCodec codec) {
+    const auto* c = find_channel_codec(codec);
+    if (!c) {
+        throw std::invalid_argument("ERROR: channel codec " + to_string(codec) +
+                                    " is not supported by this build");
+    }
+    return *c;
+}
+
+}  // namespace
+
+bool channel_codec_supported(gen::ChannelCodec codec) {
+    return codec == gen::ChannelCodec::PNG ||
+           codec == gen::ChannelCodec::RANGE ||
+           find_channel_codec(codec) != nullptr;
+}
+
+bool field_codec_supported(FieldCodec codec) {
+    return channel_codec_supported(static_cast<gen::ChannelCodec>(codec));
+}
+
+std::string to_string(gen::ChannelCodec codec) {
+    switch (codec) {
+        case gen::ChannelCodec::PNG:
+            return "PNG";
+        case gen::ChannelCodec::DEFLATE:
+            return "DEFLATE";
+        case gen::ChannelCodec::ZSTD:
+            return "ZSTD";
+        case gen::ChannelCodec::LZ4:
+            return "LZ4";
+        case gen::ChannelCodec::RANGE:
+            return "RANGE";
+        default:
+            return "UNKNOWN(" + std::to_string(static_cast<int>(codec)) + ")";
+    }
+}
+
+bool fieldEncodeCodec(
+    ScanChannelData& res_buf, const LidarScan& lidar_scan,
+    const std::pair<std::string, sensor::ChanFieldType>& field_type,
+    const std::vector<int>& px_offset, gen::ChannelCodec codec,
+    uint8_t filters, int level) {
+    if (codec == gen::ChannelCodec::RANGE) {
+        if (field_type.second != sensor::ChanFieldType::UINT32) {
+            logger().error(
+                "ERROR: fieldEncodeCodec: RANGE codec needs a UINT32 field, "
+                "{} isn't",
+                field_type.first);
+            return true;
+        }
+        return encodeRangeImage(res_buf,
+                                lidar_scan.field<uint32_t>(field_type.first),
+                                px_offset);
+    }
+
+    const auto& c = checked_codec(codec);
+    bool res = true;
+    switch (field_type.second) {
+        case sensor::ChanFieldType::UINT8:
+            res = encode_image<uint8_t>(
+                res_buf, lidar_scan.field<uint8_t>(field_type.first),
+                px_offset, c, filters, level);
+            break;
+        case sensor::ChanFieldType::UINT16:
+            res = encode_image<uint16_t>(
+                res_buf, lidar_scan.field<uint16_t>(field_type.first),
+                px_offset, c, filters, level);
+            break;
+        case sensor::ChanFieldType::UINT32:
+            res = encode_image<uint32_t>(
+                res_buf, lidar_scan.field<uint32_t>(field_type.first),
+                px_offset, c, filters, level);
+            break;
+        case sensor::ChanFieldType::UINT64:
+            res = encode_image<uint64_t>(
+                res_buf, lidar_scan.field<uint64_t>(field_type.first),
+                px_offset, c, filters, level);
+            break;
+        default:
+            logger().error(
+                "ERROR: fieldEncodeCodec: UNKNOWN:"
+                "ChanFieldType not yet "
+                "implemented");
+            break;
+    }
+    if (res) {
+        logger().error("ERROR: fieldEncodeCodec: Can't encode field {} with {}",
+                       field_type.first, c.name);
+    }
+    return res;
+}
+
+bool fieldDecodeCodec(
+    LidarScan& lidar_scan,
+    const std::pair<std::string, sensor::ChanFieldType>& field_type,
+    const uint8_t* buf, size_t size, const std::vector<int>& px_offset,
+    gen::ChannelCodec codec, uint8_t filters) {
+    if (filters & ~CHANNEL_FILTERS_ALL) {
+        logger().error(
+            "ERROR: fieldDecodeCodec: field {} uses unknown channel filters "
+            "{:#x}",
+            field_type.first, filters);
+        return true;
+    }
+    if (codec == gen::ChannelCodec::RANGE) {
+        if (field_type.second != sensor::ChanFieldType::UINT32 ||
+            decodeRangeImage(lidar_scan.field<uint32_t>(field_type.first), buf,
+                             size, px_offset)) {
+            logger().error(
+                "ERROR: fieldDecodeCodec: Can't decode field {} (RANGE)",
+                field_type.first);
+            return true;
+        }
+        return false;
+    }
+
+    const auto* c = find_channel_codec(codec);
+    if (!c) {
+        logger().error(
+            "ERROR: fieldDecodeCodec: field {} uses channel codec {} which "
+            "is not supported by this build",
+            field_type.first, to_string(codec));
+        return true;
+    }
+
+    bool res = true;
+    switch (field_type.second) {
+        case sensor::ChanFieldType::UINT8:
+            res = decode_image<uint8_t>(
+                lidar_scan.field<uint8_t>(field_type.first), buf, size,
+                px_offset, *c, filters);
+            break;
+        case sensor::ChanFieldType::UINT16:
+            res = decode_image<uint16_t>(
+                lidar_scan.field<uint16_t>(field_type.first), buf, size,
+                px_offset, *c, filters);
+            break;
+        case sensor::ChanFieldType::UINT32:
+            res = decode_image<uint32_t>(
+                lidar_scan.field<uint32_t>(field_type.first), buf, size,
+                px_offset, *c, filters);
+            break;
+        case sensor::ChanFieldType::UINT64:
+            res = decode_image<uint64_t>(
+                lidar_scan.field<uint64_t>(field_type.first), buf, size,
+                px_offset, *c, filters);
+            break;
+        default:
+            logger().error(
+                "ERROR: fieldDecodeCodec: UNKNOWN:"
+                "ChanFieldType not yet "
+                "implemented");
+            break;
+    }
+    if (res) {
+        logger().error("ERROR: fieldDecodeCodec: Can't decode field {} ({})",
+                       field_type.first, c->name);
+    }
+    return res;
+}
+
+ScanData scanEncodeCodec(const LidarScan& lidar_scan,
+                         const std::vector<int>& px_offset,
+                         const LidarScanFieldTypes& field_types,
+                         const std::vector<gen::ChannelCodec>& codecs,
+                         uint8_t filters, int level, ThreadPool* pool,
+                         const LidarScan* substitute) {
+    if (codecs.size() != field_types.size()) {
+        throw std::invalid_argument(
+            "ERROR: in scanEncodeCodec field_types.size() should "
+            "match codecs.size()");
+    }
+    for (const auto codec : codecs) {
+        if (codec != gen::ChannelCodec::PNG &&
+            codec != gen::ChannelCodec::RANGE) {
+            checked_codec(codec);
+        }
+    }
+
+    ScanData fields_data(field_types.size());
+    auto encode = [&](size_t i) {
+        const auto& ls =
+            field_source(lidar_scan, substitute, field_types[i].first);
+        const bool err =
+            codecs[i] == gen::ChannelCodec::PNG
+                ? fieldEncode(ls, field_types[i], px_offset, fields_data, i)
+                : fieldEncodeCodec(fields_data[i], ls, field_types[i],
+                                   px_offset, codecs[i], filters, level);
+        if (err) {
+            throw std::runtime_error("ERROR: scanEncodeCodec: Can't encode " +
+                                     field_types[i].first);
+        }
+    };
+
+    try {
+#ifdef OUSTER_OSF_NO_THREADING
+        (void)pool;
+        for (size_t i = 0; i < field_types.size(); ++i) encode(i);
+#else
+        (pool ? *pool : ThreadPool::shared()).run(field_types.size(), encode);
+#endif
+    } catch (const std::runtime_error&) {
+        return {};
+    }
+
+    return fields_data;
+}
+
+}  // namespace osf
+}  // namespace ouster
@@ -0,0 +1,126 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "os_sensor/lidar_scan_stream_generated.h"
+#include "ouster/lidar_scan.h"
+#include "png_tools.h"
+
+namespace ouster {
+namespace osf {
+
+class ThreadPool;
+
+/**
+ * General purpose compressors for LidarScan fields, the faster alternative to
+ * PNG. A field is destaggered, optionally preconditioned with the
+ * gen::ChannelFilter filters, and its raw bytes are compressed as a whole.
+ */
+
+/**
+ * Check whether a channel codec is compiled in. PNG, DEFLATE and RANGE always
+ * are, ZSTD and LZ4 depend on the libraries found at build time.
+ *
+ * @param[in] codec The codec to check.
+ * @return true if fields encoded with `codec` can be written and read.
+ */
+bool channel_codec_supported(gen::ChannelCodec codec);
+
+/**
+ * Name of a channel codec for messages.
+ *
+ * @param[in] codec The codec.
+ * @return the codec name, "UNKNOWN" for values this version doesn't know.
+ */
+std::string to_string(gen::ChannelCodec codec);
+
+/**
+ * Encode a single lidar scan field with a non-PNG codec. RANGE only takes
+ * UINT32 fields and ignores the filters and level.
+ *
+ * @throws std::invalid_argument if the codec isn't supported or px_offset
+ *         doesn't match the field height.
+ *
+ * @param[out] res_buf The encoded field.
+ * @param[in] lidar_scan The lidar scan holding the field.
+ * @param[in] field_type The field to encode.
+ * @param[in] px_offset Pixel shift per row used to destagger the field.
+ * @param[in] codec The compressor to use.
+ * @param[in] filters gen::ChannelFilter flags applied before compression.
+ * @param[in] level Codec specific compression level, 0 for the default.
+ * @return false (0) if operation is successful true (1) if error occured
+ */
+bool fieldEncodeCodec(
+    ScanChannelData& res_buf, const LidarScan& lidar_scan,
+    const std::pair<std::string, sensor::ChanFieldType>& field_type,
+    const std::vector<int>& px_offset, gen::ChannelCodec codec,
+    uint8_t filters, int level);
+
+/**
+ * Decode a single lidar scan field encoded by fieldEncodeCodec().
+ *
+ * @param[out] lidar_scan The lidar scan to fill in, it must have the field.
+ * @param[in] field_type The field to decode.
+ * @param[in] buf The encoded field.
+ * @param[in] size Size of `buf` in bytes.
+ * @param[in] px_offset Pixel shift per row used to restagger the field.
+ * @param[in] codec The compressor the field was encoded with.
+ * @param[in] filters gen::ChannelFilter flags the field was encoded with.
+ *                    QUANTIZED values are not scaled back here.
+ * @return false (0) if operation is successful true (1) if error occured
+ */
+bool fieldDecodeCodec(
+    LidarScan& lidar_scan,
+    const std::pair<std::string, sensor::ChanFieldType>& field_type,
+    const uint8_t* buf, size_t size, const std::vector<int>& px_offset,
+    gen::ChannelCodec codec, uint8_t filters);
+
+/**
+ * Encode the lidar scan fields, each with its own codec, in parallel on a
+ * thread pool unless built without threading.
+ *
+ * @throws std::invalid_argument if a codec isn't supported.
+ *
+ * @param[in] lidar_scan The lidar scan to encode.
+ * @param[in] px_offset Pixel shift per row used to destagger the fields.
+ * @param[in] field_types The fields to encode.
+ * @param[in] codecs The codec of every field in field_types.
+ * @param[in] filters gen::ChannelFilter flags applied before compression,
+ *                    used by DEFLATE, ZSTD and LZ4 only.
+ * @param[in] level Codec specific compression level, 0 for the default.
+ * @param[in] pool thread pool to encode the fields on, nullptr uses the pool
+ *                 shared by the whole process.
+ * @param[in] substitute fields encoded in place of those of lidar_scan, see
+ *                       field_source().
+ * @return Encoded fields in the order of field_types, empty() if error
+ *         occured.
+ */
+ScanData scanEncodeCodec(const LidarScan& lidar_scan,
+                         const std::vector<int>& px_offset,
+                         const LidarScanFieldTypes& field_types,
+                         const std::vector<gen::ChannelCodec>& codecs,
+                         uint8_t filters, int level,
+                         ThreadPool* pool = nullptr,
+                         const LidarScan* substitute = nullptr);
+
+/**
+ * Check whether a codec compresses raw bytes and so uses the channel filters.
+ *
+ * @param[in] codec The codec to check.
+ * @return true for DEFLATE, ZSTD and LZ4.
+ */
+inline bool channel_codec_uses_filters(gen::ChannelCodec codec) {
+    return codec == gen::ChannelCodec::DEFLATE ||
+           codec == gen::ChannelCodec::ZSTD || codec == gen::ChannelCodec::LZ4;
+}
+
+}  // namespace osf
+}  // namespace ouster
@@ -35,6 +35,26 @@ inline void print_error(const std::string& filename, const std::string& msg) {
 
 }  // namespace
 
+// ======== ChunkView ============
+
+ChunkView::ChunkView() : data_(nullptr), size_(0), buf_{nullptr} {}
+
+ChunkView::ChunkView(const uint8_t* data, uint64_t size)
+    : data_(data), size_(size), buf_{nullptr} {}
+
+ChunkView::ChunkView(std::shared_ptr<const ChunkBuffer> buf)
+    : data_(buf ? buf->data() : nullptr),
+      size_(buf ? buf->size() : 0),
+      buf_(std::move(buf)) {}
+
+const uint8_t* ChunkView::data() const { return data_; }
+
+uint64_t ChunkView::size() const { return size_; }
+
+bool ChunkView::empty() const { return size_ == 0; }
+
+bool ChunkView::owns_buffer() const { return buf_ != nullptr; }
+
 // ======== Construction ============
 
 OsfFile::OsfFile()
@@ -43,17 +63,19 @@ OsfFile::OsfFile()
       size_(0),
       file_buf_(nullptr),
       file_stream_{},
-      header_chunk_{nullptr},
-      metadata_chunk_{nullptr},
-      chunk_cache_{nullptr},
-      chunk_cache_offset_{std::numeric_limits<uint64_t>::max()},
+      header_chunk_{},
+      metadata_chunk_{},
+      chunk_cache_{},
+      chunk_cache_index_{},
+      chunk_cache_bytes_{0},
+      chunk_cache_size_{DEFAULT_CHUNK_CACHE_SIZE},
       state_(FileState::BAD) {}
 
 OsfFile::OsfFile(const std::string& filename, OpenMode mode) : OsfFile() {
     filename_ = filename;
 
     // TODO[pb]: Extract to open function
-    if (mode == OpenMode::READ) {
+    if (mode == OpenMode::READ || mode == OpenMode::READ_BUFFERED) {
         if (is_dir(filename_)) {
             error("got a dir, but expected a file");
             return;
@@ -71,28 +93,29 @@ OsfFile::OsfFile(const std::string& filename, OpenMode mode) : OsfFile() {
         size_ = static_cast<uint64_t>(sz);
 
 #ifdef OUSTER_OSF_NO_MMAP
-        // TODO[pb]: Maybe consider adding a runtime parameter to open file
-        // with mmap or open/read? Also better handling/removing of class
-        // members for OsfFile can be done so we are not copying empty
-        // values when NO_MMAP is absent... But I can't make my mind
-        // about RUNTIME/COMPILATION time parametrization and for now
-        // will leave it in a half backed state: COMPILE time directive
-        // but some fields will be left empty and copied/check during runtime
-        // there is no hit in performance/memory due to this leftovers
-        // that I could spot.
-        file_stream_ =
-            std::ifstream(filename_, std::ios::in | std::ios::binary);
-        if (!file_stream_.good()) {
-            error();
-            return;
-        }
+        // TODO[pb]: Better handling/removing of class members for OsfFile
+        // can be done so we are not copying empty values when NO_MMAP is
+        // absent... For now it's left in a half backed state: some fields
+        // will be left empty and copied/check during runtime, there is no
+        // hit in performance/memory due to this leftovers that I could spot.
+        const bool use_mmap = false;
 #else
-        file_buf_ = mmap_open(filename_);
-        if (!file_buf_) {
-            error();
-            return;
-        }
+        const bool use_mmap = (mode == OpenMode::READ);
 #endif
+        if (use_mmap) {
+            file_buf_ = mmap_open(filename_);
+            if (!file_buf_) {
+                error();
+                return;
+            }
+        } else {
+            file_stream_ =
+                std::ifstream(filename_, std::ios::in | std::ios::binary);
+            if (!file_stream_.good()) {
+                error();
+                return;
+            }
+        }
 
         state_ = FileState::GOOD;
     } else {
@@ -280,7 +303,14 @@ OsfFile::OsfFile(OsfFile&& other)
       file_stream_(std::move(other.file_stream_)),
       header_chunk_(std::move(other.header_chunk_)),
       metadata_chunk_(std::move(other.metadata_chunk_)),
+      chunk_cache_(std::move(other.chunk_cache_)),
+      chunk_cache_index_(std::move(other.chunk_cache_index_)),
+      chunk_cache_bytes_(other.chunk_cache_bytes_),
+      chunk_cache_size_(other.chunk_cache_size_),
       state_(other.state_) {
+    other.chunk_cache_.clear();
+    other.chunk_cache_index_.clear();
+    other.chunk_cache_bytes_ = 0;
     other.file_buf_ = nullptr;
     other.state_ = FileState::BAD;
 }
@@ -295,7 +325,14 @@ OsfFile& OsfFile::operator=(OsfFile&& other) {
         file_stream_ = std::move(other.file_stream_);
         header_chunk_ = std::move(other.header_chunk_);
         metadata_chunk_ = std::move(other.metadata_chunk_);
+        chunk_cache_ = std::move(other.chunk_cache_);
+        chunk_cache_index_ = std::move(other.chunk_cache_index_);
+        chunk_cache_bytes_ = other.chunk_cache_bytes_;
+        chunk_cache_size_ = other.chunk_cache_size_;
         state_ = other.state_;
+        other.chunk_cache_.clear();
+        other.chunk_cache_index_.clear();
+        other.chunk_cache_bytes_ = 0;
         other.file_buf_ = nullptr;
         other.state_ = FileState::BAD;
     }
@@ -328,65 +365,98 @@ OsfFile::~OsfFile() {
     close();
 }
 
-std::shared_ptr<ChunkBuffer> OsfFile::read_chunk(const uint64_t offset) {
+ChunkView OsfFile::read_chunk(const uint64_t offset) {
     if (!good()) {
-        return nullptr;
+        return ChunkView{};
+    }
+
+    auto check_chunk_size = [this, offset](uint64_t full_chunk_size) {
+        if (offset + full_chunk_size > size_) {
+            std::stringstream ss;
+            ss << "read till " << (offset + full_chunk_size)
+               << " but the file size is " << size_;
+            throw std::out_of_range(ss.str());
+        }
+    };
+
+    if (is_memory_mapped()) {
+        check_chunk_size(FLATBUFFERS_PREFIX_LENGTH);
+        const uint8_t* chunk = buf(offset);
+        const uint64_t full_chunk_size = get_prefixed_size(chunk) +
+                                         FLATBUFFERS_PREFIX_LENGTH +
+                                         CRC_BYTES_SIZE;
+        check_chunk_size(full_chunk_size);
+        return ChunkView{chunk, full_chunk_size};
     }
-    // check whether it was read last and we have it in cache already
-    if (chunk_cache_offset_ == offset && chunk_cache_) {
-        return chunk_cache_;
+
+    // check whether it was read recently and we have it in cache already
+    auto cached = chunk_cache_index_.find(offset);
+    if (cached != chunk_cache_index_.end()) {
+        chunk_cache_.splice(chunk_cache_.begin(), chunk_cache_,
+                            cached->second);
+        return ChunkView{cached->second->second};
     }
+
     auto chunk_buf = std::make_shared<ChunkBuffer>(FLATBUFFERS_PREFIX_LENGTH);
     seek(offset);
     read(chunk_buf->data(), FLATBUFFERS_PREFIX_LENGTH);
     uint32_t full_chunk_size = get_prefixed_size(chunk_buf->data()) +
                                FLATBUFFERS_PREFIX_LENGTH + CRC_BYTES_SIZE;
-    if (offset + full_chunk_size > size_) {
-        std::stringstream ss;
-        ss << "read till " << (offset + full_chunk_size)
-           << " but the file size is " << size_;
-        throw std::out_of_range(ss.str());
-    }
+    check_chunk_size(full_chunk_size);
     chunk_buf->resize(full_chunk_size);
     read(chunk_buf->data() + FLATBUFFERS_PREFIX_LENGTH,
          full_chunk_size - FLATBUFFERS_PREFIX_LENGTH);
 
-    // update cached chunk
-    if (chunk_cache_) {
-        chunk_cache_.swap(chunk_buf);
-    } else {
-        chunk_cache_ = std::move(chunk_buf);
+    // update cached chunks
+    chunk_cache_.emplace_front(offset, chunk_buf);
+    chunk_cache_index_[offset] = chunk_cache_.begin();
+    chunk_cache_bytes_ += full_chunk_size;
+    trim_chunk_cache();
+
+    return ChunkView{std::move(chunk_buf)};
+}
+
+void OsfFile::trim_chunk_cache() {
+    while (chunk_cache_bytes_ > chunk_cache_size_ && chunk_cache_.size() > 1) {
+        const auto& last = chunk_cache_.back();
+        chunk_cache_bytes_ -= last.second->size();
+        chunk_cache_index_.erase(last.first);
+        chunk_cache_.pop_back();
     }
-    chunk_cache_offset_ = offset;
+}
 
-    return chunk_cache_;
+void OsfFile::set_chunk_cache_size(uint64_t bytes) {
+    chunk_cache_size_ = bytes;
+    trim_chunk_cache();
 }
 
-uint8_t* OsfFile::get_header_chunk_ptr() {
+uint64_t OsfFile::chunk_cache_size() const { return chunk_cache_size_; }
+
+const uint8_t* OsfFile::get_header_chunk_ptr() {
     if (!file_stream_.good()) {
-        if (header_chunk_) header_chunk_.reset();
+        header_chunk_ = ChunkView{};
         return nullptr;
     }
-    if (header_chunk_) return header_chunk_->data();
+    if (!header_chunk_.empty()) return header_chunk_.data();
 
     auto tmp_offset = offset_;
     header_chunk_ = read_chunk(0);
     seek(tmp_offset);
-    return header_chunk_->data();
+    return header_chunk_.data();
 }
 
-uint8_t* OsfFile::get_metadata_chunk_ptr() {
+const uint8_t* OsfFile::get_metadata_chunk_ptr() {
     uint64_t meta_offset = metadata_offset();
     if (!file_stream_.good()) {
-        if (metadata_chunk_) metadata_chunk_.reset();
+        metadata_chunk_ = ChunkView{};
         return nullptr;
     }
-    if (metadata_chunk_) return metadata_chunk_->data();
+    if (!metadata_chunk_.empty()) return metadata_chunk_.data();
 
     auto tmp_offset = offset_;
     metadata_chunk_ = read_chunk(meta_offset);
     seek(tmp_offset);
-    return metadata_chunk_->data();
+    return metadata_chunk_.data();
 }
 
 }  // namespace osf
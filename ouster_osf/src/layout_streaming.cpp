@@ -69,8 +69,8 @@ void StreamingLayoutCW::stats_message(const uint32_t stream_id, const ts_t ts,
 
 void StreamingLayoutCW::finish_chunk(
     uint32_t stream_id, const std::shared_ptr<ChunkBuilder>& chunk_builder) {
-    std::vector<uint8_t> bb = chunk_builder->finish();
-    if (!bb.empty()) {
+    const auto bb = chunk_builder->finish();
+    if (bb.shape[0] > 0) {
         uint64_t chunk_offset = writer_.emit_chunk(chunk_builder->start_ts(),
                                                    chunk_builder->end_ts(), bb);
         chunk_stream_id_.emplace_back(
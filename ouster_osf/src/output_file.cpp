@@ -0,0 +1,147 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "output_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "compat_ops.h"
+#include "ouster/impl/logging.h"
+
+using namespace ouster::sensor;
+
+namespace ouster {
+namespace osf {
+
+constexpr size_t OutputFile::DIRECT_IO_ALIGNMENT;
+constexpr size_t OutputFile::DEFAULT_DIRECT_IO_BUFFER_SIZE;
+
+OutputFile::OutputFile(const std::string& filename, size_t buffer_size,
+                       bool direct_io)
+    : filename_(filename) {
+    fd_ = file_open_write(filename);
+    if (fd_ < 0) {
+        logger().error("ERROR: Failed to open {} for writing: {}", filename,
+                       get_last_error());
+        return;
+    }
+
+    if (direct_io) {
+        if (file_set_direct_io(fd_, true)) {
+            direct_io_ = true;
+            if (buffer_size == 0) buffer_size = DEFAULT_DIRECT_IO_BUFFER_SIZE;
+            buffer_size = (buffer_size + DIRECT_IO_ALIGNMENT - 1) /
+                          DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        } else {
+            logger().warn("Direct I/O is not supported for {}, using page cache",
+                          filename);
+        }
+    }
+
+    if (buffer_size > 0) {
+        storage_.resize(buffer_size + DIRECT_IO_ALIGNMENT);
+        auto addr = reinterpret_cast<uintptr_t>(storage_.data());
+        addr = (addr + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT *
+               DIRECT_IO_ALIGNMENT;
+        buf_ = reinterpret_cast<uint8_t*>(addr);
+        capacity_ = buffer_size;
+    }
+}
+
+OutputFile::~OutputFile() { close(); }
+
+bool OutputFile::is_open() const { return fd_ >= 0; }
+
+bool OutputFile::direct_io() const { return direct_io_; }
+
+uint64_t OutputFile::size() const { return file_pos_ + buffered_; }
+
+bool OutputFile::write(const uint8_t* buf, uint64_t size) {
+    if (!is_open()) return false;
+    while (size > 0) {
+        // large writes skip the staging buffer when it's empty and the page
+        // cache is used anyway
+        if (capacity_ == 0 ||
+            (!direct_io_ && buffered_ == 0 && size >= capacity_)) {
+            if (!file_pwrite(fd_, buf, size, file_pos_)) return false;
+            file_pos_ += size;
+            return true;
+        }
+
+        const size_t n =
+            static_cast<size_t>(std::min<uint64_t>(size, capacity_ - buffered_));
+        std::memcpy(buf_ + buffered_, buf, n);
+        buffered_ += n;
+        buf += n;
+        size -= n;
+
+        if (buffered_ == capacity_) {
+            if (!file_pwrite(fd_, buf_, capacity_, file_pos_)) return false;
+            file_pos_ += capacity_;
+            buffered_ = 0;
+        }
+    }
+    return true;
+}
+
+bool OutputFile::write_uncached(const uint8_t* buf, uint64_t size,
+                                uint64_t offset) {
+    // unaligned writes have to go through the page cache
+    if (direct_io_) file_set_direct_io(fd_, false);
+    const bool res = file_pwrite(fd_, buf, size, offset);
+    if (direct_io_) file_set_direct_io(fd_, true);
+    return res;
+}
+
+bool OutputFile::write_at(uint64_t offset, const uint8_t* buf, uint64_t size) {
+    if (!is_open()) return false;
+    const uint64_t end = offset + size;
+    if (end > this->size()) return false;
+
+    // part of the range that is still in the staging buffer
+    if (end > file_pos_) {
+        const uint64_t begin = std::max(offset, file_pos_);
+        std::memcpy(buf_ + (begin - file_pos_), buf + (begin - offset),
+                    static_cast<size_t>(end - begin));
+    }
+    // part of the range that is already in the file
+    if (offset < file_pos_) {
+        return write_uncached(buf, std::min(end, file_pos_) - offset, offset);
+    }
+    return true;
+}
+
+bool OutputFile::flush() {
+    if (!is_open()) return false;
+    if (buffered_ == 0) return true;
+    if (direct_io_) {
+        // The tail isn't block aligned: write it through the page cache but
+        // keep it buffered, so the next full buffer is written at an aligned
+        // offset and simply overwrites it.
+        return write_uncached(buf_, buffered_, file_pos_);
+    }
+    if (!file_pwrite(fd_, buf_, buffered_, file_pos_)) return false;
+    file_pos_ += buffered_;
+    buffered_ = 0;
+    return true;
+}
+
+bool OutputFile::sync() { return flush() && file_sync(fd_); }
+
+bool OutputFile::close() {
+    if (!is_open()) return true;
+    bool res = flush();
+    if (!res) {
+        logger().error("ERROR: Failed to write {}: {}", filename_,
+                       get_last_error());
+    }
+    res = file_close(fd_) && res;
+    fd_ = -1;
+    return res;
+}
+
+}  // namespace osf
+}  // namespace ouster
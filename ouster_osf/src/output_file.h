@@ -0,0 +1,123 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ouster {
+namespace osf {
+
+/**
+ * Append-only output file that stays open for the lifetime of a Writer.
+ *
+ * Appended bytes are staged in an optional in-memory buffer and written to the
+ * file when it fills up, so a recording costs one open/close and a write per
+ * buffer instead of per chunk. With direct I/O the buffer is block aligned and
+ * full buffers bypass the page cache.
+ */
+class OutputFile {
+   public:
+    /// Alignment of buffers, sizes and offsets for direct I/O writes
+    static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+    /// Buffer size used with direct I/O when none is specified
+    static constexpr size_t DEFAULT_DIRECT_IO_BUFFER_SIZE = 4 * 1024 * 1024;
+
+    /**
+     * Create or truncate the file.
+     *
+     * @param[in] filename path to the file.
+     * @param[in] buffer_size bytes to stage before writing, 0 writes every
+     *            append through immediately. Rounded up to the block size
+     *            with direct I/O.
+     * @param[in] direct_io bypass the page cache for full buffers, falls back
+     *            to regular writes if the platform doesn't support it.
+     */
+    OutputFile(const std::string& filename, size_t buffer_size = 0,
+               bool direct_io = false);
+
+    /**
+     * Flushes and closes the file.
+     */
+    ~OutputFile();
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    /**
+     * @return true if the file was opened and is not closed yet.
+     */
+    bool is_open() const;
+
+    /**
+     * @return true if full buffers are written with direct I/O.
+     */
+    bool direct_io() const;
+
+    /**
+     * @return number of bytes appended so far, including buffered ones.
+     */
+    uint64_t size() const;
+
+    /**
+     * Append bytes to the end of the file.
+     *
+     * @param[in] buf data to append.
+     * @param[in] size number of bytes in buf.
+     * @return false on write error.
+     */
+    bool write(const uint8_t* buf, uint64_t size);
+
+    /**
+     * Overwrite bytes that were already appended, e.g. the file header.
+     *
+     * @param[in] offset file offset to write at, offset + size must not
+     *            exceed size().
+     * @param[in] buf data to write.
+     * @param[in] size number of bytes in buf.
+     * @return false on write error or if the range is out of bounds.
+     */
+    bool write_at(uint64_t offset, const uint8_t* buf, uint64_t size);
+
+    /**
+     * Write out any buffered bytes.
+     *
+     * @return false on write error.
+     */
+    bool flush();
+
+    /**
+     * Flush, then ask the OS to persist the file data (fdatasync).
+     *
+     * @return false on error.
+     */
+    bool sync();
+
+    /**
+     * Flush and close the file. Further writes fail.
+     *
+     * @return false if flushing or closing failed.
+     */
+    bool close();
+
+   private:
+    bool write_uncached(const uint8_t* buf, uint64_t size, uint64_t offset);
+
+    std::string filename_;
+    int fd_{-1};
+    bool direct_io_{false};
+    std::vector<uint8_t> storage_{};  ///< backing memory of buf_
+    uint8_t* buf_{nullptr};           ///< staging buffer, aligned for O_DIRECT
+    size_t capacity_{0};
+    size_t buffered_{0};
+    uint64_t file_pos_{0};  ///< file offset of buf_[0]
+};
+
+}  // namespace osf
+}  // namespace ouster
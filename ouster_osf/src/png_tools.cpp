@@ -6,15 +6,23 @@
 #include "png_tools.h"
 
 #include <png.h>
+#include <zlib.h>
 
 #include <Eigen/Eigen>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <numeric>
 
 #include "ouster/impl/logging.h"
 #include "ouster/lidar_scan.h"
+#include "thread_pool.h"
 
 using namespace ouster::sensor;
 
@@ -187,63 +195,404 @@ void png_osf_write_start(png_structp png_ptr, png_infop png_info_ptr,
     png_write_info(png_ptr, png_info_ptr);
 }
 
+/**
+ * Destagger an image into a per-thread scratch buffer, reused across calls so
+ * encoding doesn't allocate a new image per field per scan.
+ *
+ * @tparam T The type for the image.
+ * @param[in] img The staggered image.
+ * @param[in] px_offset Pixel shift per row used to destagger the image.
+ * @return Reference to the destaggered image, valid until the next call on
+ *         the same thread.
+ */
+template <typename T>
+static const img_t<T>& destagger_scratch(const Eigen::Ref<const img_t<T>>& img,
+                                         const std::vector<int>& px_offset) {
+    thread_local img_t<T> scratch;
+    scratch.resize(img.rows(), img.cols());  // no-op if the size is unchanged
+    destagger_into<T>(scratch, img, px_offset);
+    return scratch;
+}
+
 // ========== Encode Functions ===================================
 #ifdef OUSTER_OSF_NO_THREADING
 ScanData scanEncodeFieldsSingleThread(const LidarScan& lidar_scan,
                                       const std::vector<int>& px_offset,
-                                      const LidarScanFieldTypes& field_types) {
+                                      const LidarScanFieldTypes& field_types,
+                                      const LidarScan* substitute) {
     // Prepare scan data of size that fits all field_types we are about to
     // encode
     ScanData fields_data(field_types.size());
 
     size_t scan_idx = 0;
     for (const auto& f : field_types) {
-        fieldEncode(lidar_scan, f, px_offset, fields_data, scan_idx);
+        fieldEncode(field_source(lidar_scan, substitute, f.first), f,
+                    px_offset, fields_data, scan_idx);
         scan_idx += 1;
     }
 
     return fields_data;
 }
 #else
+/**
+ * Large fields are split into bands of rows that are compressed in parallel,
+ * the way pigz does it. The rows of a field are filtered first, then every
+ * band is deflated to a raw stream ending with Z_SYNC_FLUSH (Z_FINISH for
+ * the last one), with the preceding 32 KiB of rows as the dictionary.
+ * Concatenated behind one zlib header and followed by the combined adler32
+ * of the bands they form a regular zlib stream, so the result is a plain PNG
+ * for any decoder.
+ */
+namespace {
+
+// Fields with less image data are encoded by libpng as a single task
+constexpr size_t PNG_BAND_MIN_BYTES = 128 * 1024;
+
+// Image data compressed by one band task
+constexpr size_t PNG_BAND_BYTES = 32 * 1024;
+
+// deflate window, the dictionary of a band
+constexpr size_t PNG_DEFLATE_WINDOW = 32 * 1024;
+
+struct BandedImage {
+    uint32_t width{0};
+    uint32_t height{0};
+    int sample_depth{8};
+    int color_type{PNG_COLOR_TYPE_GRAY};
+    size_t bpp{1};                       ///< bytes per pixel
+    std::vector<uint8_t> raw;            ///< unfiltered rows, PNG byte order
+    std::vector<uint8_t> filtered;       ///< rows with their filter type
+    std::vector<uint32_t> band_rows;     ///< first row of bands, then height
+    std::vector<ScanChannelData> bands;  ///< raw deflate stream of bands
+    std::vector<uLong> band_adler;       ///< adler32 of filtered band rows
+    std::vector<size_t> band_size;       ///< size of filtered band rows
+    std::atomic<bool> failed{false};
+
+    size_t row_bytes() const { return width * bpp; }
+    size_t num_bands() const { return band_rows.size() - 1; }
+};
+
+// Destagger a field and lay its rows out the way fieldEncode() stores them:
+// 8 bit gray, 16 bit gray, 8 bit RGBA or 16 bit RGBA, samples big endian
+template <typename T>
+void pack_png_rows(BandedImage& bi, const Eigen::Ref<const img_t<T>>& field,
+                   const std::vector<int>& px_offset, size_t bpp) {
+    const auto& img = destagger_scratch<T>(field, px_offset);
+    bi.width = static_cast<uint32_t>(img.cols());
+    bi.height = static_cast<uint32_t>(img.rows());
+    bi.bpp = bpp;
+    bi.sample_depth = bpp == 2 || bpp == 8 ? 16 : 8;
+    bi.color_type = bpp <= 2 ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB_ALPHA;
+    bi.raw.resize(bi.height * bi.row_bytes());
+
+    uint8_t* out = bi.raw.data();
+    for (Eigen::Index u = 0; u < img.rows(); ++u) {
+        for (Eigen::Index v = 0; v < img.cols(); ++v) {
+            const uint64_t val = img(u, v);
+            switch (bpp) {
+                case 1:
+                    *out++ = static_cast<uint8_t>(val);
+                    break;
+                case 2:
+                    *out++ = static_cast<uint8_t>(val >> 8u);
+                    *out++ = static_cast<uint8_t>(val);
+                    break;
+                case 4:
+                    for (int b = 0; b < 4; ++b) {
+                        *out++ = static_cast<uint8_t>(val >> (8u * b));
+                    }
+                    break;
+                default:
+                    for (int w = 0; w < 4; ++w) {
+                        const uint64_t sample = val >> (16u * w);
+                        *out++ = static_cast<uint8_t>(sample >> 8u);
+                        *out++ = static_cast<uint8_t>(sample);
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+bool pack_png_rows(BandedImage& bi, const LidarScan& lidar_scan,
+                   const std::pair<std::string, sensor::ChanFieldType>& ft,
+                   const std::vector<int>& px_offset) {
+    switch (ft.second) {
+        case sensor::ChanFieldType::UINT8:
+            pack_png_rows<uint8_t>(bi, lidar_scan.field<uint8_t>(ft.first),
+                                   px_offset, 1);
+            return false;
+        case sensor::ChanFieldType::UINT16:
+            pack_png_rows<uint16_t>(bi, lidar_scan.field<uint16_t>(ft.first),
+                                    px_offset, 2);
+            return false;
+        case sensor::ChanFieldType::UINT32:
+            pack_png_rows<uint32_t>(bi, lidar_scan.field<uint32_t>(ft.first),
+                                    px_offset, 4);
+            return false;
+        case sensor::ChanFieldType::UINT64:
+            pack_png_rows<uint64_t>(bi, lidar_scan.field<uint64_t>(ft.first),
+                                    px_offset, 8);
+            return false;
+        default:
+            return true;
+    }
+}
+
+inline uint8_t paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Apply one PNG filter to a row, up is the unfiltered row above it. The
+// first pixel has no left neighbour, so it's handled on its own to keep the
+// main loops simple enough to vectorize
+void apply_png_filter(int filter, const uint8_t* row, const uint8_t* up,
+                      size_t n, size_t bpp, uint8_t* dst) {
+    switch (filter) {
+        case PNG_FILTER_VALUE_NONE:
+            std::memcpy(dst, row, n);
+            break;
+        case PNG_FILTER_VALUE_SUB:
+            std::memcpy(dst, row, bpp);
+            for (size_t i = bpp; i < n; ++i) dst[i] = row[i] - row[i - bpp];
+            break;
+        case PNG_FILTER_VALUE_UP:
+            for (size_t i = 0; i < n; ++i) dst[i] = row[i] - up[i];
+            break;
+        case PNG_FILTER_VALUE_AVG:
+            for (size_t i = 0; i < bpp; ++i) dst[i] = row[i] - (up[i] >> 1);
+            for (size_t i = bpp; i < n; ++i) {
+                dst[i] = row[i] - ((row[i - bpp] + up[i]) >> 1);
+            }
+            break;
+        default:
+            for (size_t i = 0; i < bpp; ++i) dst[i] = row[i] - up[i];
+            for (size_t i = bpp; i < n; ++i) {
+                dst[i] = row[i] - paeth(row[i - bpp], up[i], up[i - bpp]);
+            }
+            break;
+    }
+}
+
+// Filter the rows of a band to bi.filtered, picking for every row the
+// filter with the smallest sum of absolute values like libpng does
+void filter_png_band(BandedImage& bi, size_t band) {
+    const size_t n = bi.row_bytes();
+    thread_local std::vector<uint8_t> zeros;
+    thread_local std::vector<uint8_t> cand;
+    if (zeros.size() < n) zeros.assign(n, 0);
+    cand.resize(n);
+
+    const uint32_t r0 = bi.band_rows[band];
+    const uint32_t r1 = bi.band_rows[band + 1];
+    uint8_t* dst = bi.filtered.data() + r0 * (n + 1);
+    for (uint32_t r = r0; r < r1; ++r) {
+        const uint8_t* row = bi.raw.data() + r * n;
+        const uint8_t* up = r ? row - n : zeros.data();
+
+        // the best filter so far is kept in dst, behind the filter type
+        uint64_t best_sum = std::numeric_limits<uint64_t>::max();
+        for (int f = PNG_FILTER_VALUE_NONE; f < PNG_FILTER_VALUE_LAST; ++f) {
+            apply_png_filter(f, row, up, n, bi.bpp, cand.data());
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; ++i) {
+                sum += std::abs(static_cast<int8_t>(cand[i]));
+            }
+            if (sum < best_sum) {
+                best_sum = sum;
+                dst[0] = static_cast<uint8_t>(f);
+                std::memcpy(dst + 1, cand.data(), n);
+            }
+        }
+        dst += n + 1;
+    }
+}
+
+// Deflate one band of filtered rows, with the filtered rows before it as the
+// dictionary
+bool deflate_png_band(BandedImage& bi, size_t band) {
+    const size_t row_size = bi.row_bytes() + 1;
+    const size_t begin = bi.band_rows[band] * row_size;
+    const size_t size = bi.band_rows[band + 1] * row_size - begin;
+    const uint8_t* data = bi.filtered.data() + begin;
+    const bool last = band + 1 == bi.num_bands();
+
+    z_stream zs{};
+    if (deflateInit2(&zs, PNG_OSF_ZLIB_COMPRESSION_LEVEL, Z_DEFLATED, -15, 8,
+                     Z_FILTERED) != Z_OK) {
+        return true;
+    }
+
+    bool err = false;
+    if (begin > 0) {
+        const size_t dict_len = std::min(begin, PNG_DEFLATE_WINDOW);
+        err = deflateSetDictionary(&zs, data - dict_len,
+                                   static_cast<uInt>(dict_len)) != Z_OK;
+    }
+
+    bi.band_size[band] = size;
+    bi.band_adler[band] =
+        adler32(adler32(0L, Z_NULL, 0), data, static_cast<uInt>(size));
+
+    auto& out = bi.bands[band];
+    out.resize(deflateBound(&zs, static_cast<uLong>(size)) + 16);
+    zs.next_in = const_cast<uint8_t*>(data);
+    zs.avail_in = static_cast<uInt>(size);
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    while (!err) {
+        zs.next_out = out.data() + zs.total_out;
+        zs.avail_out = static_cast<uInt>(out.size() - zs.total_out);
+        const int res = deflate(&zs, flush);
+        if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR) {
+            err = true;
+        } else if (res == Z_STREAM_END || (!last && zs.avail_out)) {
+            break;
+        } else {
+            out.resize(out.size() * 2);
+        }
+    }
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return err;
+}
+
+void append_be32(ScanChannelData& buf, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) {
+        buf.push_back(static_cast<uint8_t>(v >> s));
+    }
+}
+
+void append_png_chunk(ScanChannelData& buf, const char* type,
+                      const uint8_t* data, size_t size) {
+    append_be32(buf, static_cast<uint32_t>(size));
+    const size_t type_pos = buf.size();
+    buf.insert(buf.end(), type, type + 4);
+    buf.insert(buf.end(), data, data + size);
+    append_be32(buf, static_cast<uint32_t>(
+                         crc32(0L, buf.data() + type_pos,
+                               static_cast<uInt>(buf.size() - type_pos))));
+}
+
+// Join the deflated bands to a PNG with a single IDAT chunk
+void assemble_png(const BandedImage& bi, ScanChannelData& res_buf) {
+    ScanChannelData ihdr;
+    append_be32(ihdr, bi.width);
+    append_be32(ihdr, bi.height);
+    ihdr.push_back(static_cast<uint8_t>(bi.sample_depth));
+    ihdr.push_back(static_cast<uint8_t>(bi.color_type));
+    ihdr.insert(ihdr.end(), {PNG_COMPRESSION_TYPE_BASE,
+                             PNG_FILTER_TYPE_BASE, PNG_INTERLACE_NONE});
+
+    // zlib header: deflate, 32K window, no dictionary, "fast" level, which
+    // is what zlib itself writes for levels 2 to 5
+    ScanChannelData idat{0x78, 0x5e};
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (size_t b = 0; b < bi.num_bands(); ++b) {
+        idat.insert(idat.end(), bi.bands[b].begin(), bi.bands[b].end());
+        adler = adler32_combine(adler, bi.band_adler[b],
+                                static_cast<z_off_t>(bi.band_size[b]));
+    }
+    append_be32(idat, static_cast<uint32_t>(adler));
+
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    res_buf.clear();
+    res_buf.insert(res_buf.end(), signature, signature + 8);
+    append_png_chunk(res_buf, "IHDR", ihdr.data(), ihdr.size());
+    append_png_chunk(res_buf, "IDAT", idat.data(), idat.size());
+    append_png_chunk(res_buf, "IEND", nullptr, 0);
+}
+
+}  // namespace
+
 ScanData scanEncodeFields(const LidarScan& lidar_scan,
                           const std::vector<int>& px_offset,
-                          const LidarScanFieldTypes& field_types) {
+                          const LidarScanFieldTypes& field_types,
+                          ThreadPool* pool, const LidarScan* substitute) {
     // Prepare scan data of size that fits all field_types we are about to
     // encode
     ScanData fields_data(field_types.size());
+    auto& tp = pool ? *pool : ThreadPool::shared();
 
-    unsigned int con_num = std::thread::hardware_concurrency();
-    // looking for at least 4 cores if can't determine
-    if (!con_num) con_num = 4;
-
-    const size_t fields_num = field_types.size();
-    // Number of fields to pack into a single thread coder
-    size_t per_thread_num = (fields_num + con_num - 1) / con_num;
-    std::vector<std::future<void>> futures{};
-    size_t scan_idx = 0;
-    for (size_t t = 0; t < con_num && t * per_thread_num < fields_num; ++t) {
-        // Per every thread we pack the `per_thread_num` field_types encodings
-        // job
-        const size_t start_idx = t * per_thread_num;
-        // Fields list for a thread to encode
-        LidarScanFieldTypes thread_fields{};
-        // Scan indices for the corresponding fields where result will be stored
-        std::vector<size_t> thread_idxs{};
-        for (size_t i = 0; i < per_thread_num && i + start_idx < fields_num;
-             ++i) {
-            thread_fields.push_back(field_types[start_idx + i]);
-            thread_idxs.push_back(scan_idx);
-            scan_idx += 1;
+    // With helper threads, large fields are encoded in row bands, the others
+    // as a whole by libpng
+    std::vector<size_t> whole;
+    std::vector<size_t> banded;
+    for (size_t i = 0; i < field_types.size(); ++i) {
+        const auto& ft = field_types[i];
+        const auto& ls = field_source(lidar_scan, substitute, ft.first);
+        const size_t bytes = ls.w * ls.h * field_type_size(ft.second);
+        auto& tasks = tp.size() && bytes >= PNG_BAND_MIN_BYTES ? banded : whole;
+        tasks.push_back(i);
+    }
+
+    std::vector<std::unique_ptr<BandedImage>> images(banded.size());
+    tp.run(banded.size(), [&](size_t i) {
+        const auto& ft = field_types[banded[i]];
+        images[i] = std::make_unique<BandedImage>();
+        auto& bi = *images[i];
+        if (pack_png_rows(bi, field_source(lidar_scan, substitute, ft.first),
+                          ft, px_offset)) {
+            bi.failed = true;
+            bi.band_rows = {0, 0};
+        } else {
+            bi.filtered.resize(bi.height * (bi.row_bytes() + 1));
+            const size_t rows_per_band = std::max<size_t>(
+                1, PNG_BAND_BYTES / std::max<size_t>(1, bi.row_bytes()));
+            for (uint32_t r = 0; r < bi.height; r += rows_per_band) {
+                bi.band_rows.push_back(r);
+            }
+            bi.band_rows.push_back(bi.height);
+        }
+        bi.bands.resize(bi.num_bands());
+        bi.band_adler.resize(bi.num_bands());
+        bi.band_size.resize(bi.num_bands());
+    });
+
+    // Whole fields and bands share one batch, widest fields first since PNG
+    // compression time grows with the sample depth
+    std::stable_sort(whole.begin(), whole.end(), [&](size_t a, size_t b) {
+        return field_type_size(field_types[a].second) >
+               field_type_size(field_types[b].second);
+    });
+    std::vector<std::pair<size_t, size_t>> band_tasks;
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (images[i]->failed) continue;
+        for (size_t b = 0; b < images[i]->num_bands(); ++b) {
+            band_tasks.emplace_back(i, b);
         }
-        // Start an encoder thread with selected fields and corresponding
-        // indices list
-        futures.emplace_back(std::async(fieldEncodeMulti, std::cref(lidar_scan),
-                                        thread_fields, std::cref(px_offset),
-                                        std::ref(fields_data), thread_idxs));
     }
 
-    for (auto& t : futures) {
-        t.get();
+    // PNG filters look at the row above only, so bands are filtered
+    // independently before any of them is deflated
+    tp.run(band_tasks.size(), [&](size_t t) {
+        filter_png_band(*images[band_tasks[t].first], band_tasks[t].second);
+    });
+
+    // fieldEncode logs its own errors
+    tp.run(whole.size() + band_tasks.size(), [&](size_t t) {
+        if (t < whole.size()) {
+            const auto& ft = field_types[whole[t]];
+            fieldEncode(field_source(lidar_scan, substitute, ft.first), ft,
+                        px_offset, fields_data, whole[t]);
+            return;
+        }
+        const auto& task = band_tasks[t - whole.size()];
+        auto& bi = *images[task.first];
+        if (deflate_png_band(bi, task.second)) bi.failed = true;
+    });
+
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (images[i]->failed) {
+            logger().error("ERROR: fieldEncode: Can't encode field {}",
+                           field_types[banded[i]].first);
+            continue;
+        }
+        assemble_png(*images[i], fields_data[banded[i]]);
     }
 
     return fields_data;
@@ -254,7 +603,7 @@ template <typename T>
 bool encode8bitImage(ScanChannelData& res_buf,
                      const Eigen::Ref<const img_t<T>>& img,
                      const std::vector<int>& px_offset) {
-    return encode8bitImage<T>(res_buf, destagger(img, px_offset));
+    return encode8bitImage<T>(res_buf, destagger_scratch<T>(img, px_offset));
 }
 
 template bool encode8bitImage<uint8_t>(ScanChannelData&,
@@ -391,7 +740,7 @@ template <typename T>
 bool encode16bitImage(ScanChannelData& res_buf,
                       const Eigen::Ref<const img_t<T>>& img,
                       const std::vector<int>& px_offset) {
-    return encode16bitImage<T>(res_buf, destagger(img, px_offset));
+    return encode16bitImage<T>(res_buf, destagger_scratch<T>(img, px_offset));
 }
 
 template bool encode16bitImage<uint8_t>(ScanChannelData&,
@@ -411,7 +760,7 @@ template <typename T>
 bool encode24bitImage(ScanChannelData& res_buf,
                       const Eigen::Ref<const img_t<T>>& img,
                       const std::vector<int>& px_offset) {
-    return encode24bitImage<T>(res_buf, destagger(img, px_offset));
+    return encode24bitImage<T>(res_buf, destagger_scratch<T>(img, px_offset));
 }
 
 template bool encode24bitImage<uint8_t>(ScanChannelData&,
@@ -490,7 +839,7 @@ template <typename T>
 bool encode32bitImage(ScanChannelData& res_buf,
                       const Eigen::Ref<const img_t<T>>& img,
                       const std::vector<int>& px_offset) {
-    return encode32bitImage<T>(res_buf, destagger(img, px_offset));
+    return encode32bitImage<T>(res_buf, destagger_scratch<T>(img, px_offset));
 }
 
 template bool encode32bitImage<uint8_t>(ScanChannelData&,
@@ -570,7 +919,7 @@ template <typename T>
 bool encode64bitImage(ScanChannelData& res_buf,
                       const Eigen::Ref<const img_t<T>>& img,
                       const std::vector<int>& px_offset) {
-    return encode64bitImage<T>(res_buf, destagger(img, px_offset));
+    return encode64bitImage<T>(res_buf, destagger_scratch<T>(img, px_offset));
 }
 
 template bool encode64bitImage<uint8_t>(ScanChannelData&,
@@ -722,11 +1071,15 @@ bool fieldEncode(
 
 ScanData scanEncode(const LidarScan& lidar_scan,
                     const std::vector<int>& px_offset,
-                    const LidarScanFieldTypes& field_types) {
+                    const LidarScanFieldTypes& field_types,
+                    ThreadPool* pool, const LidarScan* substitute) {
 #ifdef OUSTER_OSF_NO_THREADING
-    return scanEncodeFieldsSingleThread(lidar_scan, px_offset, field_types);
+    (void)pool;
+    return scanEncodeFieldsSingleThread(lidar_scan, px_offset, field_types,
+                                        substitute);
 #else
-    return scanEncodeFields(lidar_scan, px_offset, field_types);
+    return scanEncodeFields(lidar_scan, px_offset, field_types, pool,
+                            substitute);
 #endif
 }
 
@@ -888,7 +1241,7 @@ bool decode24bitImage(Eigen::Ref<img_t<T>> img,
                       const ScanChannelData& channel_buf,
                       const std::vector<int>& px_offset) {
     if (!decode24bitImage<T>(img, channel_buf)) {
-        img = stagger<T>(img, px_offset);
+        destagger_in_place<T>(img, px_offset, true);
         return false;  // SUCCESS
     }
     return true;  // ERROR
@@ -988,7 +1341,7 @@ bool decode32bitImage(Eigen::Ref<img_t<T>> img,
                       const ScanChannelData& channel_buf,
                       const std::vector<int>& px_offset) {
     if (!decode32bitImage<T>(img, channel_buf)) {
-        img = stagger<T>(img, px_offset);
+        destagger_in_place<T>(img, px_offset, true);
         return false;  // SUCCESS
     }
     return true;  // ERROR
@@ -1092,7 +1445,7 @@ bool decode64bitImage(Eigen::Ref<img_t<T>> img,
                       const ScanChannelData& channel_buf,
                       const std::vector<int>& px_offset) {
     if (!decode64bitImage<T>(img, channel_buf)) {
-        img = stagger<T>(img, px_offset);
+        destagger_in_place<T>(img, px_offset, true);
         return false;  // SUCCESS
     }
     return true;  // ERROR
@@ -1204,7 +1557,7 @@ bool decode16bitImage(Eigen::Ref<img_t<T>> img,
                       const ScanChannelData& channel_buf,
                       const std::vector<int>& px_offset) {
     if (!decode16bitImage<T>(img, channel_buf)) {
-        img = stagger<T>(img, px_offset);
+        destagger_in_place<T>(img, px_offset, true);
         return false;  // SUCCESS
     }
     return true;  // ERROR
@@ -1306,7 +1659,7 @@ bool decode8bitImage(Eigen::Ref<img_t<T>> img,
                      const ScanChannelData& channel_buf,
                      const std::vector<int>& px_offset) {
     if (!decode8bitImage<T>(img, channel_buf)) {
-        img = stagger<T>(img, px_offset);
+        destagger_in_place<T>(img, px_offset, true);
         return false;  // SUCCESS
     }
     return true;  // ERROR
@@ -15,6 +15,8 @@
 namespace ouster {
 namespace osf {
 
+class ThreadPool;
+
 // Encoded single PNG buffer
 using ScanChannelData = std::vector<uint8_t>;
 
@@ -242,6 +244,22 @@ bool decode64bitImage(Eigen::Ref<img_t<T>> img,
 
 // ========== Encode Functions ===================================
 
+/**
+ * Pick the scan to encode a field from.
+ *
+ * @param[in] lidar_scan The LidarScan object to encode.
+ * @param[in] substitute Scan with fields replacing those of lidar_scan, e.g.
+ *                       quantized copies, may be nullptr.
+ * @param[in] name The field to encode.
+ * @return substitute if it has the field, lidar_scan otherwise.
+ */
+inline const LidarScan& field_source(const LidarScan& lidar_scan,
+                                     const LidarScan* substitute,
+                                     const std::string& name) {
+    return substitute && substitute->has_field(name) ? *substitute
+                                                     : lidar_scan;
+}
+
 /**
  * Encode LidarScan to PNG buffers storing all field_types present in an object.
  *
@@ -249,11 +267,17 @@ bool decode64bitImage(Eigen::Ref<img_t<T>> img,
  * @param[in] px_offset Pixel shift per row used to
  *                      destaggered LidarScan data.
  * @param[in] field_types the list of fields to encode.
+ * @param[in] pool thread pool to encode the fields on, nullptr uses a pool
+ *                 shared by the whole process. Ignored without threading.
+ * @param[in] substitute fields encoded in place of those of lidar_scan, see
+ *                       field_source().
  * @return encoded PNG buffers, empty() if error occured.
  */
 ScanData scanEncode(const LidarScan& lidar_scan,
                     const std::vector<int>& px_offset,
-                    const LidarScanFieldTypes& field_types);
+                    const LidarScanFieldTypes& field_types,
+                    ThreadPool* pool = nullptr,
+                    const LidarScan* substitute = nullptr);
 
 #ifdef OUSTER_OSF_NO_THREADING
 /**
@@ -264,25 +288,36 @@ ScanData scanEncode(const LidarScan& lidar_scan,
  * @param[in] px_offset Pixel shift per row used to construct de-staggered range
  *                      image form.
  * @param[in] field_types the list of fields to encode.
+ * @param[in] substitute fields encoded in place of those of lidar_scan, see
+ *                       field_source().
  * @return Encoded PNGs in ScanData in order of field_types.
  */
 ScanData scanEncodeFieldsSingleThread(const LidarScan& lidar_scan,
                                       const std::vector<int>& px_offset,
-                                      const LidarScanFieldTypes& field_types);
+                                      const LidarScanFieldTypes& field_types,
+                                      const LidarScan* substitute = nullptr);
 #else
 /**
  * Encode the lidar scan fields to PNGs channel buffers (ScanData).
- * Multi-threaded implementation.
+ * Multi-threaded implementation, every field is a task on the thread pool.
+ * With helper threads in the pool, fields of 128 KiB and more are split into
+ * row bands that are filtered and deflated as separate tasks.
  *
  * @param[in] lidar_scan A lidar scan object to encode.
  * @param[in] px_offset Pixel shift per row used to construct de-staggered range
  *                      image form.
  * @param[in] field_types The field types to use for encoding.
+ * @param[in] pool thread pool to encode the fields on, nullptr uses a pool
+ *                 shared by the whole process.
+ * @param[in] substitute fields encoded in place of those of lidar_scan, see
+ *                       field_source().
  * @return Encoded PNGs in ScanData in order of field_types.
  */
 ScanData scanEncodeFields(const LidarScan& lidar_scan,
                           const std::vector<int>& px_offset,
-                          const LidarScanFieldTypes& field_types);
+                          const LidarScanFieldTypes& field_types,
+                          ThreadPool* pool = nullptr,
+                          const LidarScan* substitute = nullptr);
 #endif
 /**
  * Encode a single lidar scan field to PNGs channel buffer and place it to a
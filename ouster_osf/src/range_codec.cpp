@@ -0,0 +1,342 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "range_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ouster {
+namespace osf {
+
+namespace {
+
+constexpr uint8_t RANGE_CODEC_VERSION = 1;
+constexpr size_t HEADER_SIZE = 9;  // version, rows, cols
+
+// Rice codes with a quotient of RICE_LIMIT or more are escaped: RICE_LIMIT
+// ones followed by the 32 bit value
+constexpr uint32_t RICE_LIMIT = 24;
+
+// Adaptive Rice contexts: 12 buckets of local gradient, plus one for pixels
+// missing neighbours
+constexpr int GRADIENT_CONTEXTS = 12;
+constexpr int FALLBACK_CONTEXT = GRADIENT_CONTEXTS;
+constexpr int NUM_CONTEXTS = GRADIENT_CONTEXTS + 1;
+
+// Running statistics are halved every RESET_COUNT samples, so the code adapts
+// to the part of the scene it's in
+constexpr uint32_t RESET_COUNT = 64;
+
+class BitWriter {
+   public:
+    explicit BitWriter(std::vector<uint8_t>& buf, size_t pos)
+        : buf_(buf), pos_(pos) {}
+
+    // len <= 32
+    void put(uint32_t bits, int len) {
+        acc_ |= static_cast<uint64_t>(bits) << n_;
+        n_ += len;
+        if (n_ >= 32) {
+            if (pos_ + 4 > buf_.size()) buf_.resize(2 * buf_.size() + 4);
+            const uint32_t word = static_cast<uint32_t>(acc_);
+            for (int i = 0; i < 4; ++i) buf_[pos_++] = (word >> (8 * i)) & 0xff;
+            acc_ >>= 32;
+            n_ -= 32;
+        }
+    }
+
+    void put_rice(uint32_t u, int k) {
+        const uint32_t q = u >> k;
+        if (q < RICE_LIMIT) {
+            // q ones and a terminating zero
+            put((1u << q) - 1, q + 1);
+            if (k) put(u & ((1u << k) - 1), k);
+        } else {
+            put((1u << RICE_LIMIT) - 1, RICE_LIMIT);
+            put(u, 32);
+        }
+    }
+
+    // Exp-Golomb of order 0
+    void put_golomb(uint32_t v) {
+        const uint64_t x = static_cast<uint64_t>(v) + 1;
+        int len = 0;
+        while ((x >> len) > 1) ++len;
+        put(0, len);
+        // high bit first, so the decoder can stop at the first one
+        for (int i = len; i >= 0; --i) put((x >> i) & 1, 1);
+    }
+
+    size_t finish() {
+        while (n_ > 0) {
+            if (pos_ + 1 > buf_.size()) buf_.resize(buf_.size() + 8);
+            buf_[pos_++] = acc_ & 0xff;
+            acc_ >>= 8;
+            n_ -= 8;
+        }
+        return pos_;
+    }
+
+   private:
+    std::vector<uint8_t>& buf_;
+    size_t pos_;
+    uint64_t acc_{0};
+    int n_{0};
+};
+
+class BitReader {
+   public:
+    BitReader(const uint8_t* buf, size_t size) : buf_(buf), size_(size) {}
+
+    bool failed() const { return failed_; }
+
+    uint32_t get(int len) {
+        refill();
+        if (len > n_) {
+            failed_ = true;
+            return 0;
+        }
+        const uint32_t res =
+            static_cast<uint32_t>(acc_ & ((uint64_t{1} << len) - 1));
+        acc_ >>= len;
+        n_ -= len;
+        return res;
+    }
+
+    uint32_t get_rice(int k) {
+        refill();
+        // number of leading ones, the bits above n_ are zero
+        uint32_t q = 0;
+        while (q < RICE_LIMIT && ((acc_ >> q) & 1)) ++q;
+        if (q == RICE_LIMIT) {
+            get(RICE_LIMIT);
+            return get(32);
+        }
+        get(q + 1);
+        return (q << k) | (k ? get(k) : 0);
+    }
+
+    uint32_t get_golomb() {
+        int len = 0;
+        while (!get(1)) {
+            if (++len > 32 || failed_) {
+                failed_ = true;
+                return 0;
+            }
+        }
+        uint64_t x = 1;
+        for (int i = 0; i < len; ++i) x = (x << 1) | get(1);
+        return static_cast<uint32_t>(x - 1);
+    }
+
+   private:
+    void refill() {
+        while (n_ <= 56 && pos_ < size_) {
+            acc_ |= static_cast<uint64_t>(buf_[pos_++]) << n_;
+            n_ += 8;
+        }
+    }
+
+    const uint8_t* buf_;
+    size_t size_;
+    size_t pos_{0};
+    uint64_t acc_{0};
+    int n_{0};
+    bool failed_{false};
+};
+
+struct RiceContext {
+    uint64_t sum{32};
+    uint32_t count{1};
+
+    int k() const {
+        int k = 0;
+        while ((static_cast<uint64_t>(count) << k) < sum && k < 31) ++k;
+        return k;
+    }
+
+    void update(uint32_t u) {
+        sum += u;
+        if (++count == RESET_COUNT) {
+            sum >>= 1;
+            count >>= 1;
+        }
+    }
+};
+
+inline uint32_t zigzag(uint32_t v, uint32_t pred) {
+    // wrapping difference, so every uint32 value round trips
+    const int32_t e = static_cast<int32_t>(v - pred);
+    return (static_cast<uint32_t>(e) << 1) ^ static_cast<uint32_t>(e >> 31);
+}
+
+inline uint32_t unzigzag(uint32_t u, uint32_t pred) {
+    const uint32_t e = (u >> 1) ^ (0u - (u & 1));
+    return pred + e;
+}
+
+inline uint32_t absdiff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+inline int gradient_context(uint64_t d) {
+    int len = 0;
+    while (d) {
+        d >>= 1;
+        ++len;
+    }
+    return std::min(len / 3, GRADIENT_CONTEXTS - 1);
+}
+
+/**
+ * Predict a destaggered pixel from its left (a), upper (b) and upper-left
+ * (c) neighbours, skipping the ones without a return.
+ *
+ * @param[in] a, b, c the neighbours, 0 if missing.
+ * @param[in] last the last return seen in the row, used without neighbours.
+ * @param[out] ctx Rice context of the residual.
+ * @return the prediction.
+ */
+inline uint32_t predict(uint32_t a, uint32_t b, uint32_t c, uint32_t last,
+                        int& ctx) {
+    if (a && b && c) {
+        ctx = gradient_context(static_cast<uint64_t>(absdiff(a, c)) +
+                               absdiff(b, c));
+        // LOCO-I median edge detector
+        const uint32_t mn = std::min(a, b);
+        const uint32_t mx = std::max(a, b);
+        if (c >= mx) return mn;
+        if (c <= mn) return mx;
+        return a + b - c;
+    }
+    if (a && b) {
+        ctx = gradient_context(absdiff(a, b));
+        return static_cast<uint32_t>((static_cast<uint64_t>(a) + b) / 2);
+    }
+    ctx = FALLBACK_CONTEXT;
+    if (a) return a;
+    if (b) return b;
+    return last;
+}
+
+}  // namespace
+
+bool encodeRangeImage(std::vector<uint8_t>& res_buf,
+                      const Eigen::Ref<const img_t<uint32_t>>& img,
+                      const std::vector<int>& px_offset) {
+    const size_t rows = img.rows();
+    const size_t cols = img.cols();
+
+    thread_local img_t<uint32_t> destaggered;
+    destaggered.resize(rows, cols);  // no-op if the size is unchanged
+    destagger_into<uint32_t>(destaggered, img, px_offset);
+
+    // range images usually take 1.5 - 2 bytes per pixel, it grows if needed
+    res_buf.resize(HEADER_SIZE + rows * cols * 2);
+    res_buf[0] = RANGE_CODEC_VERSION;
+    const uint32_t dims[2] = {static_cast<uint32_t>(rows),
+                              static_cast<uint32_t>(cols)};
+    for (int d = 0; d < 2; ++d) {
+        for (int i = 0; i < 4; ++i) {
+            res_buf[1 + 4 * d + i] = (dims[d] >> (8 * i)) & 0xff;
+        }
+    }
+
+    BitWriter bw(res_buf, HEADER_SIZE);
+    RiceContext contexts[NUM_CONTEXTS];
+
+    const uint32_t* data = destaggered.data();
+    for (size_t u = 0; u < rows; ++u) {
+        const uint32_t* row = data + u * cols;
+        const uint32_t* up = u ? row - cols : nullptr;
+
+        // no-return mask: alternating zero / non-zero run lengths
+        size_t v = 0;
+        bool zero = true;
+        while (v < cols) {
+            size_t end = v;
+            while (end < cols && (row[end] == 0) == zero) ++end;
+            bw.put_golomb(static_cast<uint32_t>(end - v));
+            v = end;
+            zero = !zero;
+        }
+
+        uint32_t last = up ? up[0] : 0;
+        for (v = 0; v < cols; ++v) {
+            const uint32_t x = row[v];
+            if (!x) continue;
+            const uint32_t a = v ? row[v - 1] : 0;
+            const uint32_t b = up ? up[v] : 0;
+            const uint32_t c = up && v ? up[v - 1] : 0;
+            int ctx;
+            const uint32_t pred = predict(a, b, c, last, ctx);
+            const uint32_t res = zigzag(x, pred);
+            bw.put_rice(res, contexts[ctx].k());
+            contexts[ctx].update(res);
+            last = x;
+        }
+    }
+
+    res_buf.resize(bw.finish());
+    return false;
+}
+
+bool decodeRangeImage(Eigen::Ref<img_t<uint32_t>> img, const uint8_t* buf,
+                      size_t size, const std::vector<int>& px_offset) {
+    const size_t rows = img.rows();
+    const size_t cols = img.cols();
+
+    if (size < HEADER_SIZE || buf[0] != RANGE_CODEC_VERSION) return true;
+    uint32_t dims[2] = {0, 0};
+    for (int d = 0; d < 2; ++d) {
+        for (int i = 0; i < 4; ++i) {
+            dims[d] |= static_cast<uint32_t>(buf[1 + 4 * d + i]) << (8 * i);
+        }
+    }
+    if (dims[0] != rows || dims[1] != cols) return true;
+    if (img.outerStride() != static_cast<Eigen::Index>(cols)) return true;
+
+    BitReader br(buf + HEADER_SIZE, size - HEADER_SIZE);
+    RiceContext contexts[NUM_CONTEXTS];
+
+    uint32_t* data = img.data();
+    for (size_t u = 0; u < rows; ++u) {
+        uint32_t* row = data + u * cols;
+        const uint32_t* up = u ? row - cols : nullptr;
+
+        // mark returns with 1, zeros stay
+        size_t v = 0;
+        bool zero = true;
+        while (v < cols) {
+            const uint32_t len = br.get_golomb();
+            if (br.failed() || len > cols - v) return true;
+            std::fill(row + v, row + v + len, zero ? 0u : 1u);
+            v += len;
+            zero = !zero;
+        }
+
+        uint32_t last = up ? up[0] : 0;
+        for (v = 0; v < cols; ++v) {
+            if (!row[v]) continue;
+            const uint32_t a = v ? row[v - 1] : 0;
+            const uint32_t b = up ? up[v] : 0;
+            const uint32_t c = up && v ? up[v - 1] : 0;
+            int ctx;
+            const uint32_t pred = predict(a, b, c, last, ctx);
+            const uint32_t res = br.get_rice(contexts[ctx].k());
+            contexts[ctx].update(res);
+            row[v] = unzigzag(res, pred);
+            last = row[v];
+        }
+        if (br.failed()) return true;
+    }
+
+    destagger_in_place<uint32_t>(img, px_offset, true);
+    return false;
+}
+
+}  // namespace osf
+}  // namespace ouster
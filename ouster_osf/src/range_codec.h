@@ -0,0 +1,56 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ouster/lidar_scan.h"
+
+namespace ouster {
+namespace osf {
+
+/**
+ * Lossless codec for range images (RANGE, RANGE2).
+ *
+ * The image is destaggered so that neighbouring pixels see neighbouring
+ * surfaces. No-return pixels (0) are stored as a mask of run lengths per row.
+ * Every other pixel is predicted from its left, upper and upper-left
+ * returns with the LOCO-I median edge detector, and the residual is written
+ * with an adaptive Rice code whose context is the local gradient.
+ *
+ * Any uint32 image round trips exactly; 19/20 bit ranges get the benefit.
+ */
+
+/**
+ * Encode a range image.
+ *
+ * @throws std::invalid_argument if px_offset doesn't match the image height.
+ *
+ * @param[out] res_buf The encoded image.
+ * @param[in] img The staggered range image.
+ * @param[in] px_offset Pixel shift per row used to destagger the image.
+ * @return false (0) if operation is successful true (1) if error occured
+ */
+bool encodeRangeImage(std::vector<uint8_t>& res_buf,
+                      const Eigen::Ref<const img_t<uint32_t>>& img,
+                      const std::vector<int>& px_offset);
+
+/**
+ * Decode a range image encoded by encodeRangeImage().
+ *
+ * @param[out] img The staggered range image, of the encoded size.
+ * @param[in] buf The encoded image.
+ * @param[in] size Size of `buf` in bytes.
+ * @param[in] px_offset Pixel shift per row used to restagger the image.
+ * @return false (0) if operation is successful true (1) if error occured,
+ *         including truncated or corrupted input.
+ */
+bool decodeRangeImage(Eigen::Ref<img_t<uint32_t>> img, const uint8_t* buf,
+                      size_t size, const std::vector<int>& px_offset);
+
+}  // namespace osf
+}  // namespace ouster
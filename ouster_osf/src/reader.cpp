@@ -525,6 +525,10 @@ ts_t Reader::end_ts() const {
 
 const MetadataStore& Reader::meta_store() const { return meta_store_; }
 
+void Reader::set_chunk_cache_size(uint64_t bytes) {
+    file_.set_chunk_cache_size(bytes);
+}
+
 bool Reader::has_stream_info() const { return has_streaming_info_; }
 
 bool Reader::verify_chunk(uint64_t chunk_offset) {
@@ -533,7 +537,7 @@ bool Reader::verify_chunk(uint64_t chunk_offset) {
     if (cs->status == ChunkValidity::UNKNOWN) {
         auto chunk_buf = file_.read_chunk(chunks_base_offset_ + chunk_offset);
         cs->status =
-            osf::check_osf_chunk_buf(chunk_buf->data(), chunk_buf->size())
+            osf::check_osf_chunk_buf(chunk_buf.data(), chunk_buf.size())
                 ? ChunkValidity::VALID
                 : ChunkValidity::INVALID;
     }
@@ -544,11 +548,13 @@ bool Reader::verify_chunk(uint64_t chunk_offset) {
 // ========= MessageRef ====================================
 // =========================================================
 MessageRef::MessageRef(const uint8_t* buf, const MetadataStore& meta_provider)
-    : buf_(buf), meta_provider_(meta_provider), chunk_buf_{nullptr} {}
+    : buf_(buf), meta_provider_(meta_provider), chunk_buf_{} {}
 
 MessageRef::MessageRef(const uint8_t* buf, const MetadataStore& meta_provider,
-                       std::shared_ptr<std::vector<uint8_t>> chunk_buf)
-    : buf_(buf), meta_provider_(meta_provider), chunk_buf_{chunk_buf} {}
+                       ChunkView chunk_buf)
+    : buf_(buf),
+      meta_provider_(meta_provider),
+      chunk_buf_{std::move(chunk_buf)} {}
 
 uint32_t MessageRef::id() const {
     const ouster::osf::v2::StampedMessage* sm =
@@ -606,15 +612,13 @@ std::vector<uint8_t> MessageRef::buffer() const {
 ChunkRef::ChunkRef()
     : chunk_offset_{std::numeric_limits<uint64_t>::max()},
       reader_{nullptr},
-      chunk_buf_{nullptr} {}
+      chunk_buf_{} {}
 
 ChunkRef::ChunkRef(const uint64_t offset, Reader* reader)
     : chunk_offset_(offset), reader_(reader) {
     if (!reader->file_.is_memory_mapped()) {
-        // NOTE[pb]: We just rely on OS file operations caching thus not
-        // trying to cache the read chunks in reader, however we might
-        // reconsider it if we will discover the our caching might give
-        // us better results (for now it's as is)
+        // Recently read chunks are cached by OsfFile, so verify and then
+        // read, as well as interleaved streams, don't read a chunk twice
         chunk_buf_ = reader->file_.read_chunk(reader_->chunks_base_offset_ +
                                               chunk_offset_);
     }
@@ -690,8 +694,8 @@ std::string ChunkRef::to_string() const {
        << "msgs_size = " << size() << ", state = ("
        << (chunk_state ? osf::to_string(*chunk_state) : "no state") << ")"
        << ", chunk_buf_ = "
-       << (chunk_buf_ ? "size=" + std::to_string(chunk_buf_->size())
-                      : "nullptr")
+       << (!chunk_buf_.empty() ? "size=" + std::to_string(chunk_buf_.size())
+                               : "nullptr")
        << "]";
     return ss.str();
 }
@@ -707,8 +711,8 @@ const uint8_t* ChunkRef::get_chunk_ptr() const {
         return reader_->file_.buf() + reader_->chunks_base_offset_ +
                chunk_offset_;
     }
-    if (chunk_buf_ && !chunk_buf_->empty()) {
-        return chunk_buf_->data();
+    if (!chunk_buf_.empty()) {
+        return chunk_buf_.data();
     }
 
     return nullptr;
@@ -0,0 +1,269 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "ouster/osf/scan_prefetcher.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ouster/osf/stream_lidar_scan.h"
+
+namespace ouster {
+namespace osf {
+
+/**
+ * Read ahead pipeline, the same scheme as AsyncWriterPipeline the other way
+ * around: a single reader thread walks the messages and queues the
+ * LidarScanStream ones in order, decoder threads decode them and next()
+ * hands them out by the order they were read. The reader thread stops once
+ * read_ahead messages are queued, decoded or decoding.
+ */
+struct LidarScanPrefetcher::Impl {
+    struct Job {
+        uint64_t seq;
+        std::unique_ptr<const MessageRef> msg;
+        DecodedScan res{};
+        std::exception_ptr error{nullptr};  ///< decoding threw
+    };
+
+    Impl(const MessagesStreamingRange& messages,
+         const ScanPrefetchOptions& options);
+    ~Impl();
+
+    bool next(DecodedScan& scan);
+
+    static void decode(Job& job, const std::vector<std::string>& fields);
+
+    const MessagesStreamingRange messages_;
+    const ScanPrefetchOptions options_;
+
+#ifdef OUSTER_OSF_NO_THREADING
+    MessagesStreamingIter it_;
+    MessagesStreamingIter end_;
+#else
+    void read_loop();
+    void decode_loop();
+    void stop();
+
+    std::mutex mutex_;
+    std::condition_variable decode_cv_;  ///< jobs to decode or stopping
+    std::condition_variable ready_cv_;   ///< next job decoded or read all
+    std::condition_variable space_cv_;   ///< a job was consumed or stopping
+
+    std::deque<std::unique_ptr<Job>> to_decode_{};
+    std::map<uint64_t, std::unique_ptr<Job>> decoded_{};
+    uint64_t next_seq_{0};
+    uint64_t next_read_seq_{0};
+    bool read_all_{false};
+    bool stopping_{false};
+    std::exception_ptr read_error_{nullptr};  ///< reading messages threw
+
+    std::vector<std::thread> decoders_{};
+    std::thread read_thread_{};
+#endif
+};
+
+void LidarScanPrefetcher::Impl::decode(Job& job,
+                                       const std::vector<std::string>& fields) {
+    job.res.stream_id = job.msg->id();
+    job.res.ts = job.msg->ts();
+    try {
+        job.res.scan = job.msg->decode_msg<LidarScanStream>(fields);
+    } catch (...) {
+        job.error = std::current_exception();
+    }
+    job.msg.reset();  // release the chunk early
+}
+
+#ifdef OUSTER_OSF_NO_THREADING
+
+LidarScanPrefetcher::Impl::Impl(const MessagesStreamingRange& messages,
+                                const ScanPrefetchOptions& options)
+    : messages_(messages),
+      options_(options),
+      it_(messages_.begin()),
+      end_(messages_.end()) {}
+
+LidarScanPrefetcher::Impl::~Impl() {}
+
+bool LidarScanPrefetcher::Impl::next(DecodedScan& scan) {
+    for (; it_ != end_; ++it_) {
+        if (!it_->is<LidarScanStream>()) continue;
+        Job job{0, std::make_unique<const MessageRef>(*it_)};
+        ++it_;
+        decode(job, options_.fields);
+        if (job.error) std::rethrow_exception(job.error);
+        scan = std::move(job.res);
+        return true;
+    }
+    return false;
+}
+
+#else
+
+LidarScanPrefetcher::Impl::Impl(const MessagesStreamingRange& messages,
+                                const ScanPrefetchOptions& options)
+    : messages_(messages), options_(options) {
+    uint32_t n_decoders = options_.decoder_threads;
+    if (n_decoders == 0)
+        n_decoders = std::max(1u, std::thread::hardware_concurrency());
+    // more decoders than jobs in flight would only sit idle
+    n_decoders = std::min(n_decoders, options_.read_ahead);
+    for (uint32_t i = 0; i < n_decoders; ++i)
+        decoders_.emplace_back(&Impl::decode_loop, this);
+    read_thread_ = std::thread(&Impl::read_loop, this);
+}
+
+LidarScanPrefetcher::Impl::~Impl() { stop(); }
+
+void LidarScanPrefetcher::Impl::read_loop() {
+    try {
+        for (const MessageRef msg : messages_) {
+            if (!msg.is<LidarScanStream>()) continue;
+            std::unique_ptr<Job> job{
+                new Job{0, std::make_unique<const MessageRef>(msg)}};
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_cv_.wait(lock, [this] {
+                return stopping_ ||
+                       next_seq_ - next_read_seq_ < options_.read_ahead;
+            });
+            if (stopping_) break;
+            job->seq = next_seq_++;
+            to_decode_.push_back(std::move(job));
+            lock.unlock();
+            decode_cv_.notify_one();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        read_error_ = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_all_ = true;
+    ready_cv_.notify_all();
+}
+
+void LidarScanPrefetcher::Impl::decode_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        decode_cv_.wait(lock,
+                        [this] { return stopping_ || !to_decode_.empty(); });
+        if (stopping_) return;
+
+        std::unique_ptr<Job> job = std::move(to_decode_.front());
+        to_decode_.pop_front();
+        lock.unlock();
+
+        decode(*job, options_.fields);
+
+        lock.lock();
+        const bool next = job->seq == next_read_seq_;
+        decoded_.emplace(job->seq, std::move(job));
+        if (next) ready_cv_.notify_all();
+    }
+}
+
+bool LidarScanPrefetcher::Impl::next(DecodedScan& scan) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait(lock, [this] {
+        return decoded_.count(next_read_seq_) ||
+               (read_all_ && next_read_seq_ == next_seq_);
+    });
+    auto it = decoded_.find(next_read_seq_);
+    if (it == decoded_.end()) {
+        // read all and consumed all, report the reading error if any
+        if (read_error_) {
+            std::exception_ptr err = read_error_;
+            read_error_ = nullptr;
+            std::rethrow_exception(err);
+        }
+        return false;
+    }
+
+    std::unique_ptr<Job> job = std::move(it->second);
+    decoded_.erase(it);
+    next_read_seq_++;
+    lock.unlock();
+    space_cv_.notify_one();
+
+    if (job->error) std::rethrow_exception(job->error);
+    scan = std::move(job->res);
+    return true;
+}
+
+void LidarScanPrefetcher::Impl::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    space_cv_.notify_all();
+    decode_cv_.notify_all();
+    for (auto& t : decoders_)
+        if (t.joinable()) t.join();
+    if (read_thread_.joinable()) read_thread_.join();
+}
+
+#endif
+
+// ==========================================================
+// ========= LidarScanPrefetcher ============================
+// ==========================================================
+
+LidarScanPrefetcher::LidarScanPrefetcher(
+    const MessagesStreamingRange& messages,
+    const ScanPrefetchOptions& options) {
+    if (options.read_ahead == 0) {
+        throw std::invalid_argument(
+            "ERROR: scan prefetcher read_ahead must be at least 1");
+    }
+    impl_ = std::make_unique<Impl>(messages, options);
+}
+
+LidarScanPrefetcher::~LidarScanPrefetcher() = default;
+
+bool LidarScanPrefetcher::next(DecodedScan& scan) { return impl_->next(scan); }
+
+LidarScanPrefetcher::iterator LidarScanPrefetcher::begin() {
+    return iterator(next(current_) ? this : nullptr);
+}
+
+LidarScanPrefetcher::iterator LidarScanPrefetcher::end() {
+    return iterator(nullptr);
+}
+
+LidarScanPrefetcher::iterator::iterator(LidarScanPrefetcher* prefetcher)
+    : prefetcher_(prefetcher) {}
+
+DecodedScan& LidarScanPrefetcher::iterator::operator*() const {
+    return prefetcher_->current_;
+}
+
+DecodedScan* LidarScanPrefetcher::iterator::operator->() const {
+    return &prefetcher_->current_;
+}
+
+LidarScanPrefetcher::iterator& LidarScanPrefetcher::iterator::operator++() {
+    if (!prefetcher_->next(prefetcher_->current_)) prefetcher_ = nullptr;
+    return *this;
+}
+
+bool LidarScanPrefetcher::iterator::operator==(const iterator& other) const {
+    return prefetcher_ == other.prefetcher_;
+}
+
+bool LidarScanPrefetcher::iterator::operator!=(const iterator& other) const {
+    return !this->operator==(other);
+}
+
+}  // namespace osf
+}  // namespace ouster
@@ -6,13 +6,18 @@
 #include "ouster/osf/stream_lidar_scan.h"
 
 #include <algorithm>
+#include <limits>
+#include <map>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
 
 #include "ouster/impl/logging.h"
 #include "ouster/lidar_scan.h"
 #include "ouster/osf/basics.h"
 #include "ouster/strings.h"
 #include "ouster/types.h"
+#include "field_codecs.h"
 #include "png_tools.h"
 
 using namespace ouster::sensor;
@@ -41,6 +46,63 @@ ouster::FieldClass from_osf_enum(gen::FIELD_CLASS ff) {
     return static_cast<ouster::FieldClass>(ff);
 }
 
+// Field types that FieldQuantization applies to, the same on write and read
+bool quantizable(sensor::ChanFieldType t) {
+    return t == sensor::ChanFieldType::UINT16 ||
+           t == sensor::ChanFieldType::UINT32 ||
+           t == sensor::ChanFieldType::UINT64;
+}
+
+// Stores round(value / step) to dest, keeping non-zero values non-zero
+struct quantize_field {
+    template <typename T>
+    void operator()(Eigen::Ref<const img_t<T>> field, Field& dest,
+                    uint32_t step) const {
+        if (!std::is_unsigned<T>::value) return;
+        const uint64_t half = step / 2;
+        Eigen::Map<img_t<T>>(dest.get<T>(), field.rows(), field.cols()) =
+            field.unaryExpr([=](T v) {
+                if (!v) return v;
+                const uint64_t q = (static_cast<uint64_t>(v) + half) / step;
+                return static_cast<T>(std::max<uint64_t>(q, 1));
+            });
+    }
+};
+
+// Scales quantised values back, saturating at the field type max
+struct dequantize_field {
+    template <typename T>
+    void operator()(Eigen::Ref<img_t<T>> field, uint32_t step) const {
+        if (!std::is_unsigned<T>::value) return;
+        using U = typename std::conditional<std::is_unsigned<T>::value, T,
+                                            uint64_t>::type;
+        const uint64_t max = std::numeric_limits<U>::max();
+        field = field.unaryExpr([=](T q) {
+            return static_cast<T>(
+                std::min<uint64_t>(static_cast<uint64_t>(q) * step, max));
+        });
+    }
+};
+
+// Quantisation steps by field name for the writer options, lossless fields
+// are left out
+std::map<std::string, uint32_t> quantization_steps(
+    const FieldQuantization& quantization) {
+    std::map<std::string, uint32_t> steps;
+    const uint32_t signal_step = 1u << (16 - quantization.signal_bits);
+    const uint32_t near_ir_step = 1u << (16 - quantization.near_ir_bits);
+    const std::pair<const char*, uint32_t> all_steps[] = {
+        {ChanField::RANGE, quantization.range_step},
+        {ChanField::RANGE2, quantization.range_step},
+        {ChanField::SIGNAL, signal_step},
+        {ChanField::SIGNAL2, signal_step},
+        {ChanField::NEAR_IR, near_ir_step}};
+    for (const auto& s : all_steps) {
+        if (s.second > 1) steps[s.first] = s.second;
+    }
+    return steps;
+}
+
 }  // namespace
 
 bool poses_present(const LidarScan& ls) {
@@ -199,7 +261,9 @@ std::string from_osf_enum(gen::CHAN_FIELD f) {
 flatbuffers::Offset<gen::LidarScanMsg> create_lidar_scan_msg(
     flatbuffers::FlatBufferBuilder& fbb, const LidarScan& lidar_scan,
     const ouster::sensor::sensor_info& info,
-    const ouster::LidarScanFieldTypes meta_field_types) {
+    const ouster::LidarScanFieldTypes meta_field_types, ThreadPool* pool,
+    gen::ChannelCodec codec, uint8_t filters, int level, bool range_codec,
+    const LidarScan* substitute) {
     const auto& ls = lidar_scan;
 
     // Prepare field_types for LidarScanMsg
@@ -253,13 +317,59 @@ flatbuffers::Offset<gen::LidarScanMsg> create_lidar_scan_msg(
         }
     }
 
-    // Encode LidarScan to PNG buffers
-    ScanData scan_data =
-        scanEncode(ls, info.format.pixel_shift_by_row, standard_fields);
-    // Prepare PNG encoded channels for LidarScanMsg.channels vector
+    // Pick the codec of every field, range images may use their own.
+    // Quantised fields are never stored as PNG: SDKs predating
+    // ChannelData.codec then fail the PNG check instead of reading them
+    // without scaling, newer ones reject the QUANTIZED flag if they don't
+    // know it.
+    std::vector<gen::ChannelCodec> codecs;
+    std::vector<bool> quantized;
+    bool png_only = true;
+    for (const auto& f : standard_fields) {
+        const bool is_range = f.first == ChanField::RANGE ||
+                              f.first == ChanField::RANGE2;
+        quantized.push_back(substitute && substitute->has_field(f.first));
+        auto c = range_codec && is_range &&
+                         f.second == sensor::ChanFieldType::UINT32
+                     ? gen::ChannelCodec::RANGE
+                     : codec;
+        if (quantized.back() && c == gen::ChannelCodec::PNG) {
+            c = gen::ChannelCodec::DEFLATE;
+        }
+        codecs.push_back(c);
+        png_only = png_only && c == gen::ChannelCodec::PNG;
+    }
+
+    // Encode LidarScan to PNG buffers, or with one of the faster codecs
+    ScanData scan_data;
+    if (png_only) {
+        scan_data = scanEncode(ls, info.format.pixel_shift_by_row,
+                               standard_fields, pool, substitute);
+    } else {
+        scan_data = scanEncodeCodec(ls, info.format.pixel_shift_by_row,
+                                    standard_fields, codecs, filters, level,
+                                    pool, substitute);
+    }
+    // Encoders signal failure with empty ScanData, and a message without its
+    // channels is rejected on read, so don't write one
+    if (scan_data.size() != standard_fields.size()) {
+        throw std::runtime_error(
+            "ERROR: create_lidar_scan_msg: failed to encode LidarScan "
+            "fields");
+    }
+    // Prepare encoded channels for LidarScanMsg.channels vector
     std::vector<flatbuffers::Offset<gen::ChannelData>> channels;
-    for (const auto& channel_data : scan_data) {
-        channels.emplace_back(gen::CreateChannelDataDirect(fbb, &channel_data));
+    for (size_t i = 0; i < scan_data.size(); ++i) {
+        // PNG and RANGE have their own filtering
+        uint8_t channel_filters =
+            channel_codec_uses_filters(codecs[i]) ? filters : 0;
+        if (quantized[i]) {
+            channel_filters |=
+                static_cast<uint8_t>(gen::ChannelFilter::QUANTIZED);
+        }
+        channels.emplace_back(gen::CreateChannelDataDirect(
+            fbb, &scan_data[i], codecs[i],
+            static_cast<gen::ChannelFilter>(channel_filters)));
     }
 
     auto channels_off =
@@ -293,7 +403,9 @@ flatbuffers::Offset<gen::LidarScanMsg> create_lidar_scan_msg(
 }
 
 std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
-    const std::vector<uint8_t> buf, const ouster::sensor::sensor_info& info) {
+    const std::vector<uint8_t>& buf, const ouster::sensor::sensor_info& info,
+    const std::vector<std::string>& fields,
+    const std::map<std::string, uint32_t>& field_steps) {
     auto ls_msg =
         flatbuffers::GetSizePrefixedRoot<ouster::osf::gen::LidarScanMsg>(
             buf.data());
@@ -301,6 +413,12 @@ std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
     uint32_t width = info.format.columns_per_frame;
     uint32_t height = info.format.pixels_per_column;
 
+    // Fields not asked for are neither allocated nor decoded
+    auto wanted = [&fields](const std::string& name) {
+        return fields.empty() ||
+               std::find(fields.begin(), fields.end(), name) != fields.end();
+    };
+
     // read field_types
     ouster::LidarScanFieldTypes field_types;
     if (ls_msg->field_types() && ls_msg->field_types()->size()) {
@@ -313,10 +431,15 @@ std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
                                  FieldClass::PIXEL_FIELD};
             });
     }
+    ouster::LidarScanFieldTypes decoded_field_types;
+    std::copy_if(field_types.begin(), field_types.end(),
+                 std::back_inserter(decoded_field_types),
+                 [&](const FieldType& ft) { return wanted(ft.name); });
 
     // Init lidar scan with recovered fields
-    auto ls = std::make_unique<LidarScan>(width, height, field_types.begin(),
-                                          field_types.end());
+    auto ls = std::make_unique<LidarScan>(width, height,
+                                          decoded_field_types.begin(),
+                                          decoded_field_types.end());
 
     ls->frame_id = ls_msg->frame_id();
 
@@ -413,16 +536,99 @@ std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
             "have scan field or it's empty.");
         return nullptr;
     }
-    ScanData scan_data;
+    if (msg_scan_vec->size() != field_types.size()) {
+        logger().error(
+            "ERROR: lidar_scan msg has {} channels, expected: {}",
+            msg_scan_vec->size(), field_types.size());
+        return nullptr;
+    }
+
+    // Check the channel codecs before decoding anything, so scans written
+    // with a codec this build doesn't know are rejected as a whole
+    bool png_only = true;
+    std::vector<bool> quantized(msg_scan_vec->size(), false);
     for (uint32_t i = 0; i < msg_scan_vec->size(); ++i) {
-        auto channel_buffer = msg_scan_vec->Get(i)->buffer();
-        scan_data.emplace_back(channel_buffer->begin(), channel_buffer->end());
+        const auto codec = msg_scan_vec->Get(i)->codec();
+        if (!channel_codec_supported(codec)) {
+            logger().error(
+                "ERROR: lidar_scan msg field {} is encoded with channel "
+                "codec {} which is not supported by this build",
+                field_types[i].name, to_string(codec));
+            return nullptr;
+        }
+        // PNG channels have no filters, QUANTIZED ones included
+        if (codec == gen::ChannelCodec::PNG &&
+            static_cast<uint8_t>(msg_scan_vec->Get(i)->filters())) {
+            logger().error(
+                "ERROR: lidar_scan msg field {} is a PNG with channel filters "
+                "{:#x}",
+                field_types[i].name,
+                static_cast<uint8_t>(msg_scan_vec->Get(i)->filters()));
+            return nullptr;
+        }
+        // QUANTIZED marks exactly the channels the stream has a step for
+        quantized[i] = static_cast<uint8_t>(msg_scan_vec->Get(i)->filters()) &
+                       static_cast<uint8_t>(gen::ChannelFilter::QUANTIZED);
+        const bool has_step = field_steps.count(field_types[i].name) &&
+                              quantizable(field_types[i].element_type);
+        if (quantized[i] != has_step) {
+            logger().error(
+                "ERROR: lidar_scan msg field {} is {}flagged as quantized "
+                "but the stream has {} step for it",
+                field_types[i].name, quantized[i] ? "" : "not ",
+                has_step ? "a" : "no");
+            return nullptr;
+        }
+        png_only = png_only && codec == gen::ChannelCodec::PNG;
     }
 
-    // Decode PNGs data to LidarScan
-    if (scanDecode(*ls, scan_data, info.format.pixel_shift_by_row,
-                   field_types)) {
-        return nullptr;
+    if (png_only) {
+        ScanData scan_data;
+        for (uint32_t i = 0; i < msg_scan_vec->size(); ++i) {
+            if (!wanted(field_types[i].name)) continue;
+            auto channel_buffer = msg_scan_vec->Get(i)->buffer();
+            scan_data.emplace_back(channel_buffer->begin(),
+                                   channel_buffer->end());
+        }
+
+        // Decode PNGs data to LidarScan
+        if (!scan_data.empty() &&
+            scanDecode(*ls, scan_data, info.format.pixel_shift_by_row,
+                       decoded_field_types)) {
+            return nullptr;
+        }
+    } else {
+        for (uint32_t i = 0; i < msg_scan_vec->size(); ++i) {
+            if (!wanted(field_types[i].name)) continue;
+            auto channel = msg_scan_vec->Get(i);
+            auto channel_buffer = channel->buffer();
+            if (!channel_buffer) {
+                logger().error("ERROR: lidar_scan msg channel {} is empty", i);
+                return nullptr;
+            }
+            const std::pair<std::string, sensor::ChanFieldType> field_type{
+                field_types[i].name, field_types[i].element_type};
+            bool err;
+            if (channel->codec() == gen::ChannelCodec::PNG) {
+                ScanData png_data{{channel_buffer->begin(),
+                                   channel_buffer->end()}};
+                err = fieldDecode(*ls, png_data, 0, field_type,
+                                  info.format.pixel_shift_by_row);
+            } else {
+                err = fieldDecodeCodec(
+                    *ls, field_type, channel_buffer->data(),
+                    channel_buffer->size(), info.format.pixel_shift_by_row,
+                    channel->codec(), static_cast<uint8_t>(channel->filters()));
+            }
+            if (err) return nullptr;
+        }
+    }
+
+    // Scale the quantised channels back
+    for (uint32_t i = 0; i < msg_scan_vec->size(); ++i) {
+        if (!quantized[i] || !wanted(field_types[i].name)) continue;
+        ouster::impl::visit_field(*ls, field_types[i].name, dequantize_field(),
+                                  field_steps.at(field_types[i].name));
     }
 
     auto msg_custom_fields = ls_msg->custom_fields();
@@ -431,6 +637,7 @@ std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
             auto custom_field = msg_custom_fields->Get(i);
 
             std::string name{custom_field->name()->c_str()};
+            if (!wanted(name)) continue;
             ChanFieldType tag = from_osf_enum(custom_field->tag());
             std::vector<size_t> shape{custom_field->shape()->begin(),
                                       custom_field->shape()->end()};
@@ -450,12 +657,19 @@ std::unique_ptr<ouster::LidarScan> restore_lidar_scan(
 
 LidarScanStreamMeta::LidarScanStreamMeta(
     const uint32_t sensor_meta_id,
-    const ouster::LidarScanFieldTypes field_types)
+    const ouster::LidarScanFieldTypes field_types,
+    const std::map<std::string, uint32_t>& field_steps)
     : sensor_meta_id_{sensor_meta_id},
-      field_types_{field_types.begin(), field_types.end()} {}
+      field_types_{field_types.begin(), field_types.end()},
+      field_steps_{field_steps} {}
 
 uint32_t LidarScanStreamMeta::sensor_meta_id() const { return sensor_meta_id_; }
 
+const std::map<std::string, uint32_t>& LidarScanStreamMeta::field_steps()
+    const {
+    return field_steps_;
+}
+
 std::vector<uint8_t> LidarScanStreamMeta::buffer() const {
     flatbuffers::FlatBufferBuilder fbb = flatbuffers::FlatBufferBuilder(512);
 
@@ -472,8 +686,23 @@ std::vector<uint8_t> LidarScanStreamMeta::buffer() const {
     auto field_types_off = osf::CreateVectorOfStructs<gen::ChannelField>(
         fbb, field_types.data(), field_types.size());
 
+    // Only standard fields are quantised, see quantization_steps()
+    std::vector<gen::FieldQuantization> quantization;
+    for (const auto& fs : field_steps_) {
+        auto field_enum = to_osf_enum(fs.first);
+        if (field_enum) {
+            quantization.emplace_back(field_enum.value(), fs.second);
+        }
+    }
+    flatbuffers::Offset<flatbuffers::Vector<const gen::FieldQuantization*>>
+        quantization_off = 0;
+    if (!quantization.empty()) {
+        quantization_off = osf::CreateVectorOfStructs<gen::FieldQuantization>(
+            fbb, quantization.data(), quantization.size());
+    }
+
     auto lss_offset = ouster::osf::gen::CreateLidarScanStream(
-        fbb, sensor_meta_id_, field_types_off);
+        fbb, sensor_meta_id_, field_types_off, quantization_off);
 
     fbb.FinishSizePrefixed(lss_offset);
 
@@ -500,8 +729,17 @@ std::unique_ptr<MetadataEntry> LidarScanStreamMeta::from_buffer(
             });
     }
 
+    std::map<std::string, uint32_t> field_steps;
+    auto quantization_vec = lidar_scan_stream->quantization();
+    if (quantization_vec) {
+        for (const auto* q : *quantization_vec) {
+            field_steps[from_osf_enum(q->chan_field())] = q->step();
+        }
+    }
+
     // auto frame_mode = lidar_scan_stream->lidar_frame_mode();
-    return std::make_unique<LidarScanStreamMeta>(sensor_meta_id, field_types);
+    return std::make_unique<LidarScanStreamMeta>(sensor_meta_id, field_types,
+                                                 field_steps);
 };
 
 std::string LidarScanStreamMeta::repr() const {
@@ -515,6 +753,16 @@ std::string LidarScanStreamMeta::repr() const {
         first = false;
     }
     ss << "}";
+    if (!field_steps_.empty()) {
+        ss << ", quantization = {";
+        first = true;
+        for (const auto& fs : field_steps_) {
+            if (!first) ss << ", ";
+            ss << fs.first << ":" << fs.second;
+            first = false;
+        }
+        ss << "}";
+    }
     return ss.str();
 }
 
@@ -524,7 +772,8 @@ LidarScanStream::LidarScanStream(Token /*key*/, Writer& writer,
                                  const uint32_t sensor_meta_id,
                                  const ouster::LidarScanFieldTypes& field_types)
     : writer_{writer},
-      meta_(sensor_meta_id, field_types),
+      meta_(sensor_meta_id, field_types,
+            quantization_steps(writer.options_.field_quantization)),
       sensor_meta_id_(sensor_meta_id),
       field_types_(field_types) {
     // Note key is ignored and just used to gatekeep.
@@ -550,21 +799,96 @@ void LidarScanStream::save(const ouster::osf::ts_t ts,
 }
 
 std::vector<uint8_t> LidarScanStream::make_msg(const LidarScan& lidar_scan) {
+    // Quantise into scratch fields, the caller's scan is left untouched
+    std::unique_ptr<LidarScan> quantized;
+
+    // hands the scratch scan back even if encoding throws
+    struct ScratchGuard {
+        LidarScanStream& stream;
+        std::unique_ptr<LidarScan>& scratch;
+        ~ScratchGuard() {
+            if (scratch) stream.give_back_scratch(std::move(scratch));
+        }
+    } scratch_guard{*this, quantized};
+
+    for (const auto& fs : meta_.field_steps()) {
+        if (!lidar_scan.has_field(fs.first)) continue;
+        const auto& field = lidar_scan.field(fs.first);
+        if (!quantizable(field.tag())) continue;
+
+        if (!quantized) quantized = take_scratch(lidar_scan.w, lidar_scan.h);
+        if (quantized->has_field(fs.first) &&
+            !(quantized->field(fs.first).desc() == field.desc())) {
+            quantized->del_field(fs.first);
+        }
+        if (!quantized->has_field(fs.first)) {
+            quantized->add_field(fs.first, field.desc());
+        }
+        ouster::impl::visit_field(lidar_scan, fs.first, quantize_field(),
+                                  quantized->field(fs.first), fs.second);
+    }
+    // scratch fields left from other scans must not stand in for this one's
+    if (quantized) {
+        std::vector<std::string> stale;
+        for (const auto& f : quantized->fields()) {
+            if (!lidar_scan.has_field(f.first) ||
+                !quantizable(lidar_scan.field(f.first).tag())) {
+                stale.push_back(f.first);
+            }
+        }
+        for (const auto& name : stale) quantized->del_field(name);
+    }
+
     flatbuffers::FlatBufferBuilder fbb = flatbuffers::FlatBufferBuilder(32768);
     auto ls_msg_offset =
-        create_lidar_scan_msg(fbb, lidar_scan, sensor_info_, field_types_);
+        create_lidar_scan_msg(
+            fbb, lidar_scan, sensor_info_, field_types_,
+            writer_.encoder_pool_.get(),
+            static_cast<gen::ChannelCodec>(writer_.options_.field_codec),
+            static_cast<uint8_t>(writer_.options_.field_filters),
+            writer_.options_.field_codec_level,
+            writer_.options_.range_codec, quantized.get());
     fbb.FinishSizePrefixed(ls_msg_offset);
     const uint8_t* buf = fbb.GetBufferPointer();
     const size_t size = fbb.GetSize();
     return {buf, buf + size};
 }
 
+std::unique_ptr<LidarScan> LidarScanStream::take_scratch(size_t w, size_t h) {
+    std::unique_ptr<LidarScan> scratch;
+    {
+        std::lock_guard<std::mutex> lock(scratch_mutex_);
+        if (!scratch_.empty()) {
+            scratch = std::move(scratch_.back());
+            scratch_.pop_back();
+        }
+    }
+    if (!scratch || scratch->w != w || scratch->h != h) {
+        const LidarScanFieldTypes no_fields;
+        scratch = std::make_unique<LidarScan>(w, h, no_fields.begin(),
+                                              no_fields.end());
+    }
+    return scratch;
+}
+
+void LidarScanStream::give_back_scratch(std::unique_ptr<LidarScan> scratch) {
+    std::lock_guard<std::mutex> lock(scratch_mutex_);
+    scratch_.push_back(std::move(scratch));
+}
+
 std::unique_ptr<LidarScanStream::obj_type> LidarScanStream::decode_msg(
     const std::vector<uint8_t>& buf, const LidarScanStream::meta_type& meta,
     const MetadataStore& meta_provider) {
+    return decode_msg(buf, meta, meta_provider, {});
+}
+
+std::unique_ptr<LidarScanStream::obj_type> LidarScanStream::decode_msg(
+    const std::vector<uint8_t>& buf, const LidarScanStream::meta_type& meta,
+    const MetadataStore& meta_provider,
+    const std::vector<std::string>& fields) {
     auto sensor = meta_provider.get<LidarSensor>(meta.sensor_meta_id());
-    auto info = sensor->info();
-    return restore_lidar_scan(buf, info);
+    const auto& info = sensor->info();
+    return restore_lidar_scan(buf, info, fields, meta.field_steps());
 }
 
 }  // namespace osf
@@ -0,0 +1,150 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "thread_pool.h"
+
+#include <exception>
+
+namespace ouster {
+namespace osf {
+
+struct ThreadPool::Batch {
+    Batch(const std::function<void(size_t)>& f, size_t n)
+        : fn(f), remaining(n) {}
+
+    const std::function<void(size_t)>& fn;
+    std::atomic<size_t> remaining;
+    std::mutex mutex;
+    std::condition_variable done;
+    std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (!threads) {
+        unsigned int con_num = std::thread::hardware_concurrency();
+        // looking for at least 4 cores if can't determine
+        if (!con_num) con_num = 4;
+        threads = con_num - 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+size_t ThreadPool::size() const { return workers_.size(); }
+
+void ThreadPool::run(size_t n, const std::function<void(size_t)>& fn) {
+    if (!n) return;
+
+    auto batch = std::make_shared<Batch>(fn, n);
+
+    if (workers_.empty() || n == 1) {
+        for (size_t i = 0; i < n; ++i) {
+            Task task{batch, i};
+            execute(task);
+        }
+    } else {
+        // spread the batch over the workers starting from a rotating offset,
+        // so concurrent batches don't all pile up on the first deques
+        const size_t start = next_worker_.fetch_add(1);
+        for (size_t i = 0; i < n; ++i) {
+            auto& w = *workers_[(start + i) % workers_.size()];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.tasks.push_back({batch, i});
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            pending_ += n;
+        }
+        wake_cv_.notify_all();
+
+        // help out until every task of the batch is taken, then wait for the
+        // ones still running on the workers
+        Task task;
+        while (batch->remaining.load() > 0) {
+            if (pop(start, task)) {
+                execute(task);
+                task.batch.reset();
+            } else {
+                std::unique_lock<std::mutex> lock(batch->mutex);
+                batch->done.wait(
+                    lock, [&batch] { return batch->remaining.load() == 0; });
+            }
+        }
+    }
+
+    if (batch->error) std::rethrow_exception(batch->error);
+}
+
+bool ThreadPool::pop(size_t start, Task& task) {
+    const size_t num = workers_.size();
+    for (size_t k = 0; k < num; ++k) {
+        auto& w = *workers_[(start + k) % num];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (w.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+            } else {
+                // steal from the other end to keep away from the owner
+                task = std::move(w.tasks.back());
+                w.tasks.pop_back();
+            }
+        }
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        --pending_;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task& task) {
+    auto& batch = *task.batch;
+    try {
+        batch.fn(task.idx);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        if (!batch.error) batch.error = std::current_exception();
+    }
+    if (batch.remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        batch.done.notify_all();
+    }
+}
+
+void ThreadPool::work(size_t id) {
+    Task task;
+    while (true) {
+        if (pop(id, task)) {
+            execute(task);
+            task.batch.reset();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+        if (stop_ && !pending_) return;
+    }
+}
+
+}  // namespace osf
+}  // namespace ouster
@@ -0,0 +1,103 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ouster {
+namespace osf {
+
+/**
+ * Long-lived work-stealing thread pool for short, non-blocking tasks such as
+ * encoding a single scan field.
+ *
+ * Every worker owns a task deque. Batches submitted with run() are spread
+ * over the deques, workers take tasks from the front of their own deque and
+ * steal from the back of the others when it runs dry. The submitting thread
+ * executes tasks too while it waits, so run() can be called concurrently
+ * from several threads (e.g. async writer encoder threads) without starving.
+ */
+class ThreadPool {
+   public:
+    /**
+     * Start the worker threads.
+     *
+     * @param[in] threads number of workers, 0 uses one per hardware thread
+     *                    minus one for the submitting thread.
+     */
+    explicit ThreadPool(size_t threads = 0);
+
+    /**
+     * Stops the workers, waiting for the queued tasks to finish.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Pool shared by the whole process, for callers that don't own one.
+     *
+     * @return the shared pool, started on first use.
+     */
+    static ThreadPool& shared();
+
+    /**
+     * Number of worker threads.
+     *
+     * @return the number of workers, not counting the submitting threads.
+     */
+    size_t size() const;
+
+    /**
+     * Call `fn(i)` for every `i` in [0, n) on the pool and wait for all of
+     * the calls to finish. Tasks are started roughly in index order, so
+     * putting the heavier ones first gives a better balance.
+     *
+     * @throws the first exception thrown by `fn`, after all tasks finished.
+     *
+     * @param[in] n number of tasks.
+     * @param[in] fn task body, must not block on other pool tasks.
+     */
+    void run(size_t n, const std::function<void(size_t)>& fn);
+
+   private:
+    struct Batch;
+
+    struct Task {
+        std::shared_ptr<Batch> batch;
+        size_t idx;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(size_t start, Task& task);
+    void execute(Task& task);
+    void work(size_t id);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_{0};
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    size_t pending_{0};
+    bool stop_{false};
+};
+
+}  // namespace osf
+}  // namespace ouster
@@ -7,12 +7,15 @@
 
 #include <sstream>
 
+#include "async_writer.h"
 #include "fb_utils.h"
 #include "ouster/impl/logging.h"
 #include "ouster/osf/basics.h"
 #include "ouster/osf/crc32.h"
 #include "ouster/osf/layout_streaming.h"
 #include "ouster/osf/stream_lidar_scan.h"
+#include "output_file.h"
+#include "thread_pool.h"
 
 using namespace ouster::sensor;
 
@@ -21,10 +24,30 @@ constexpr size_t MAX_CHUNK_SIZE = 500 * 1024 * 1024;
 namespace ouster {
 namespace osf {
 
-Writer::Writer(const std::string& filename, uint32_t chunk_size)
+Writer::Writer(const std::string& filename, uint32_t chunk_size,
+               const WriterOptions& options)
     : file_name_(filename),
+      options_(options),
       metadata_id_{"ouster_sdk"},
       chunks_layout_{ChunksLayout::LAYOUT_STREAMING} {
+    if (!field_codec_supported(options_.field_codec)) {
+        throw std::invalid_argument(
+            "ERROR: field codec " + std::to_string(options_.field_codec) +
+            " is not supported by this build");
+    }
+    if (options_.field_filters & ~(FILTER_DELTA | FILTER_SHUFFLE)) {
+        throw std::invalid_argument("ERROR: unknown field filters " +
+                                    std::to_string(options_.field_filters));
+    }
+    const auto& quantization = options_.field_quantization;
+    if (quantization.range_step < 1 || quantization.signal_bits < 1 ||
+        quantization.signal_bits > 16 || quantization.near_ir_bits < 1 ||
+        quantization.near_ir_bits > 16) {
+        throw std::invalid_argument(
+            "ERROR: field quantization needs range_step >= 1 and 1 to 16 "
+            "signal and near_ir bits");
+    }
+
     // chunks STREAMING_LAYOUT
     chunks_writer_ = std::make_shared<StreamingLayoutCW>(*this, chunk_size);
 
@@ -34,27 +57,46 @@ Writer::Writer(const std::string& filename, uint32_t chunk_size)
 
     // TODO[pb]: Check if file exists, add flag overwrite/not overwrite, etc
 
-    header_size_ = start_osf_file(file_name_);
+    file_ = std::make_unique<OutputFile>(
+        file_name_, options_.write_buffer_size, options_.direct_io);
+    if (file_->is_open()) header_size_ = start_osf_file(*file_);
 
     if (header_size_ > 0) {
         pos_ = static_cast<int>(header_size_);
     } else {
         throw std::runtime_error("ERROR: Can't write to file :(");
     }
+
+#ifndef OUSTER_OSF_NO_THREADING
+    encoder_pool_ =
+        std::make_unique<ThreadPool>(options_.field_encoder_threads);
+#endif
+
+    if (options_.async) {
+        async_ = std::make_unique<AsyncWriterPipeline>(
+            options_,
+            [](LidarScanStream& stream, const LidarScan& scan) {
+                return stream.make_msg(scan);
+            },
+            [this](LidarScanStream& stream, const ts_t ts,
+                   const std::vector<uint8_t>& msg) {
+                save_message(stream.meta().id(), ts, msg);
+            });
+    }
 }
 
 Writer::Writer(const std::string& filename,
                const ouster::sensor::sensor_info& info,
                const std::vector<std::string>& desired_fields,
-               uint32_t chunk_size)
+               uint32_t chunk_size, const WriterOptions& options)
     : Writer(filename, std::vector<ouster::sensor::sensor_info>{info},
-             desired_fields, chunk_size) {}
+             desired_fields, chunk_size, options) {}
 
 Writer::Writer(const std::string& filename,
                const std::vector<ouster::sensor::sensor_info>& info,
                const std::vector<std::string>& desired_fields,
-               uint32_t chunk_size)
-    : Writer(filename, chunk_size) {
+               uint32_t chunk_size, const WriterOptions& options)
+    : Writer(filename, chunk_size, options) {
     sensor_info_ = info;
     for (uint32_t i = 0; i < info.size(); i++) {
         lidar_meta_id_[i] = add_metadata(ouster::osf::LidarSensor(info[i]));
@@ -149,7 +191,11 @@ void Writer::_save(uint32_t stream_index, const LidarScan& scan,
             }
         }
 
-        lidar_streams_[stream_index]->save(time, scan);
+        if (async_) {
+            async_->push(*lidar_streams_[stream_index], time, scan);
+        } else {
+            lidar_streams_[stream_index]->save(time, scan);
+        }
     } else {
         throw std::logic_error("ERROR: Bad Stream ID");
     }
@@ -191,6 +237,7 @@ uint32_t Writer::add_metadata(MetadataEntry&& entry) {
 }
 
 uint32_t Writer::add_metadata(MetadataEntry& entry) {
+    std::lock_guard<std::mutex> lock(save_mutex_);
     return meta_store_.add(entry);
 }
 
@@ -210,7 +257,7 @@ uint64_t Writer::append(const uint8_t* buf, const uint64_t size) {
         logger().info("Writer::append has nothing to append");
         return 0;
     }
-    uint64_t saved_bytes = buffer_to_file(buf, size, file_name_, true);
+    uint64_t saved_bytes = buffer_to_file(buf, size, *file_);
     pos_ += static_cast<int>(saved_bytes);
     return saved_bytes;
 }
@@ -219,6 +266,7 @@ uint64_t Writer::append(const uint8_t* buf, const uint64_t size) {
 
 void Writer::save_message(const uint32_t stream_id, const ts_t ts,
                           const std::vector<uint8_t>& msg_buf) {
+    std::lock_guard<std::mutex> lock(save_mutex_);
     if (!meta_store_.get(stream_id)) {
         std::stringstream ss;
         ss << "ERROR: Attempt to save the non existent stream: id = "
@@ -243,10 +291,11 @@ const std::string& Writer::filename() const { return file_name_; }
 ChunksLayout Writer::chunks_layout() const { return chunks_layout_; }
 
 uint64_t Writer::emit_chunk(const ts_t chunk_start_ts, const ts_t chunk_end_ts,
-                            const std::vector<uint8_t>& chunk_buf) {
-    uint64_t saved_bytes = append(chunk_buf.data(), chunk_buf.size());
+                            const ConstArrayView1<uint8_t>& chunk_buf) {
+    const uint64_t chunk_size = chunk_buf.shape[0];
+    uint64_t saved_bytes = append(chunk_buf.data(), chunk_size);
     uint64_t res_chunk_offset{0};
-    if (saved_bytes && saved_bytes == chunk_buf.size() + CRC_BYTES_SIZE) {
+    if (saved_bytes && saved_bytes == chunk_size + CRC_BYTES_SIZE) {
         chunks_.emplace_back(chunk_start_ts.count(), chunk_end_ts.count(),
                              next_chunk_offset_);
         res_chunk_offset = next_chunk_offset_;
@@ -254,6 +303,9 @@ uint64_t Writer::emit_chunk(const ts_t chunk_start_ts, const ts_t chunk_end_ts,
         if (end_ts_ < chunk_end_ts) end_ts_ = chunk_end_ts;
         next_chunk_offset_ += saved_bytes;
         started_ = true;
+        if (options_.sync_policy == SYNC_EVERY_CHUNK && !file_->sync()) {
+            logger().error("ERROR: Failed to sync {}", file_name_);
+        }
     } else {
         std::stringstream ss;
         ss << "ERROR: Can't save to file. saved_bytes = " << saved_bytes
@@ -287,11 +339,20 @@ std::vector<uint8_t> Writer::make_metadata() const {
 }
 
 void Writer::close() {
-    if (finished_) {
+    if (finished_ || !file_->is_open()) {
         // already did everything
         return;
     }
 
+    // Write out all queued scans
+    if (async_) {
+        try {
+            async_->finish();
+        } catch (const std::exception& e) {
+            logger().error("ERROR: Failed to save queued scans: {}", e.what());
+        }
+    }
+
     // Finish all chunks in flight
     chunks_writer_->finish();
 
@@ -303,7 +364,7 @@ void Writer::close() {
         append(metadata_buf.data(), metadata_buf.size());
     if (metadata_saved_size &&
         metadata_saved_size == metadata_buf.size() + CRC_BYTES_SIZE) {
-        if (finish_osf_file(file_name_, metadata_offset, metadata_saved_size) ==
+        if (finish_osf_file(*file_, metadata_offset, metadata_saved_size) ==
             header_size_) {
             finished_ = true;
         } else {
@@ -317,11 +378,27 @@ void Writer::close() {
             "ERROR: Oh, why we are here and "
             "didn't finish correctly?");
     }
+
+    if (options_.sync_policy != SYNC_NONE && !file_->sync()) {
+        logger().error("ERROR: Failed to sync {}", file_name_);
+    }
+    if (!file_->close()) {
+        logger().error("ERROR: Failed to close {}", file_name_);
+    }
 }
 
 uint32_t Writer::chunk_size() const { return chunks_writer_->chunk_size(); }
 
-Writer::~Writer() { close(); }
+WriterQueueStats Writer::queue_stats() const {
+    return async_ ? async_->stats() : WriterQueueStats{};
+}
+
+Writer::~Writer() {
+    close();
+    // close() skips a writer whose file failed to open, stop the pipeline
+    // threads regardless
+    async_.reset();
+}
 
 // ================================================================
 
@@ -371,10 +448,10 @@ void ChunkBuilder::update_start_end(const ts_t ts) {
     if (end_ts_ < ts) end_ts_ = ts;
 }
 
-std::vector<uint8_t> ChunkBuilder::finish() {
+ConstArrayView1<uint8_t> ChunkBuilder::finish() {
     if (messages_.empty()) {
         finished_ = true;
-        return {};
+        return {nullptr, {0}};
     }
 
     if (!finished_) {
@@ -383,10 +460,7 @@ std::vector<uint8_t> ChunkBuilder::finish() {
         finished_ = true;
     }
 
-    const uint8_t* buf = fbb_.GetBufferPointer();
-    uint32_t size = fbb_.GetSize();
-
-    return {buf, buf + size};
+    return {fbb_.GetBufferPointer(), {static_cast<int>(fbb_.GetSize())}};
 }
 
 // ================================================================
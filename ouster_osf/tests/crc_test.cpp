@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 #include <zlib.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -34,6 +35,32 @@ TEST_F(CrcTest, SmokeSanityCheckAltInit) {
     const uint32_t crc = osf::crc32(0L, data.data(), data.size());
     EXPECT_EQ(0x88aa689f, crc);
 }
+
+// Large and odd sized buffers, including incremental use over slices, match
+// zlib whichever implementation is picked for the CPU
+TEST_F(CrcTest, MatchesZlib) {
+    std::vector<uint8_t> data(100000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+    }
+
+    for (uint32_t size : {0u, 1u, 15u, 63u, 64u, 65u, 127u, 1000u, 99999u}) {
+        for (uint32_t offset : {0u, 1u, 7u}) {
+            const uint8_t* buf = data.data() + offset;
+            const uint32_t expected =
+                static_cast<uint32_t>(::crc32_z(0, buf, size));
+            EXPECT_EQ(expected, osf::crc32(buf, size))
+                << "size = " << size << ", offset = " << offset;
+
+            uint32_t crc = 0;
+            for (uint32_t pos = 0; pos < size; pos += 333) {
+                crc = osf::crc32(crc, buf + pos, std::min(333u, size - pos));
+            }
+            EXPECT_EQ(expected, crc)
+                << "size = " << size << ", offset = " << offset;
+        }
+    }
+}
 }  // namespace
 }  // namespace osf
 }  // namespace ouster
@@ -5,11 +5,16 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <vector>
 
 #include "common.h"
 #include "osf_test.h"
+#include "output_file.h"
 #include "ouster/osf/meta_lidar_sensor.h"
 #include "ouster/osf/reader.h"
 #include "ouster/osf/stream_lidar_scan.h"
@@ -265,6 +270,55 @@ TEST_F(FileOpsTest, CopyTrailingBytes) {
     remove_dir(temp_dir);
 }
 
+TEST_F(FileOpsTest, OutputFileWrites) {
+    std::string temp_dir;
+    EXPECT_TRUE(make_tmp_dir(temp_dir));
+    std::string temp_file = path_concat(temp_dir, "output_file");
+
+    std::vector<uint8_t> data(3 * OutputFile::DIRECT_IO_ALIGNMENT + 123);
+    for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 7);
+    const std::vector<uint8_t> header{0xde, 0xad, 0xbe, 0xef};
+
+    // unbuffered, small, aligned and larger than the data buffers, with and
+    // without direct io
+    for (const auto& params : std::vector<std::pair<size_t, bool>>{
+             {0, false}, {100, false}, {4096, false}, {1 << 16, false},
+             {0, true}, {4096, true}}) {
+        std::vector<uint8_t> expected = data;
+        std::copy(header.begin(), header.end(), expected.begin() + 10);
+        {
+            OutputFile file(temp_file, params.first, params.second);
+            EXPECT_TRUE(file.is_open());
+            // uneven pieces to cross buffer boundaries
+            size_t pos = 0;
+            for (size_t piece = 1; pos < data.size(); piece = piece * 3 + 1) {
+                size_t n = std::min(piece, data.size() - pos);
+                EXPECT_TRUE(file.write(data.data() + pos, n));
+                pos += n;
+                if (pos > 5000 && pos - n <= 5000) {
+                    EXPECT_TRUE(file.sync());
+                }
+            }
+            EXPECT_EQ(file.size(), data.size());
+            EXPECT_TRUE(file.write_at(10, header.data(), header.size()));
+            EXPECT_FALSE(file.write_at(data.size() - 2, header.data(),
+                                       header.size()));
+            EXPECT_TRUE(file.close());
+            EXPECT_FALSE(file.write(data.data(), 1));
+        }
+
+        EXPECT_EQ(file_size(temp_file), (int64_t)expected.size());
+        std::ifstream test_file(temp_file, std::ios::in | std::ios::binary);
+        std::vector<uint8_t> contents(
+            (std::istreambuf_iterator<char>(test_file)),
+            std::istreambuf_iterator<char>());
+        EXPECT_EQ(contents, expected);
+    }
+
+    unlink_path(temp_file);
+    remove_dir(temp_dir);
+}
+
 }  // namespace
 }  // namespace osf
 }  // namespace ouster
@@ -7,9 +7,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "fb_utils.h"
 #include "osf_test.h"
 #include "ouster/osf/basics.h"
+#include "ouster/osf/crc32.h"
 
 namespace ouster {
 namespace osf {
@@ -165,6 +168,107 @@ TEST_F(OsfFileTest, OsfFileCheckOutOfRangeAccess) {
     ASSERT_THROW(osf_file.read(buf, 100000000), std::out_of_range);
 }
 
+TEST_F(OsfFileTest, ReadChunkView) {
+    OsfFile osf_file(
+        path_concat(test_data_dir(), "osfs/OS-1-128_v2.3.0_1024x10_lb_n3.osf"));
+    ASSERT_TRUE(osf_file);
+
+    const uint64_t offset = osf_file.chunks_offset();
+    const ChunkView chunk = osf_file.read_chunk(offset);
+    ASSERT_FALSE(chunk.empty());
+    EXPECT_EQ(chunk.size(), get_prefixed_size(chunk.data()) +
+                                FLATBUFFERS_PREFIX_LENGTH + CRC_BYTES_SIZE);
+    EXPECT_TRUE(check_prefixed_size_block_crc(chunk.data(), chunk.size()));
+
+    if (osf_file.is_memory_mapped()) {
+        // no copy, the view points into the mapping
+        EXPECT_FALSE(chunk.owns_buffer());
+        EXPECT_EQ(chunk.data(), osf_file.buf(offset));
+    } else {
+        EXPECT_TRUE(chunk.owns_buffer());
+    }
+
+    // second read is mapped or served from the cache, no new buffer
+    EXPECT_EQ(chunk.data(), osf_file.read_chunk(offset).data());
+
+    EXPECT_EQ(DEFAULT_CHUNK_CACHE_SIZE, osf_file.chunk_cache_size());
+    osf_file.set_chunk_cache_size(0);
+    EXPECT_EQ(0, osf_file.chunk_cache_size());
+
+    // views stay valid after their chunk is dropped from the cache
+    const ChunkView next = osf_file.read_chunk(offset + chunk.size());
+    ASSERT_FALSE(next.empty());
+    EXPECT_TRUE(check_prefixed_size_block_crc(next.data(), next.size()));
+    EXPECT_TRUE(check_prefixed_size_block_crc(chunk.data(), chunk.size()));
+
+    EXPECT_THROW(osf_file.read_chunk(osf_file.size()), std::out_of_range);
+
+    OsfFile bad_file;
+    EXPECT_TRUE(bad_file.read_chunk(0).empty());
+}
+
+TEST_F(OsfFileTest, ReadChunkBufferedCache) {
+    OsfFile osf_file(
+        path_concat(test_data_dir(), "osfs/OS-1-128_v2.3.0_1024x10_lb_n3.osf"),
+        OpenMode::READ_BUFFERED);
+    ASSERT_TRUE(osf_file);
+    EXPECT_FALSE(osf_file.is_memory_mapped());
+
+    // header, data and metadata chunks
+    const uint64_t header_offset = 0;
+    const uint64_t data_offset = osf_file.chunks_offset();
+    const uint64_t meta_offset = osf_file.metadata_offset();
+
+    // start from an empty cache: header and metadata were read on open
+    osf_file.set_chunk_cache_size(0);
+
+    const ChunkView header = osf_file.read_chunk(header_offset);
+    const ChunkView data = osf_file.read_chunk(data_offset);
+    ASSERT_FALSE(header.empty());
+    ASSERT_FALSE(data.empty());
+    EXPECT_TRUE(header.owns_buffer());
+    EXPECT_TRUE(data.owns_buffer());
+
+    // a zero size cache still keeps the last read chunk
+    const ChunkView data_again = osf_file.read_chunk(data_offset);
+    EXPECT_EQ(data.data(), data_again.data());
+    const ChunkView header_again = osf_file.read_chunk(header_offset);
+    EXPECT_NE(header.data(), header_again.data());
+
+    // room for the header and data chunks only
+    osf_file.set_chunk_cache_size(header.size() + data.size());
+    EXPECT_EQ(header_again.data(), osf_file.read_chunk(header_offset).data());
+    const ChunkView data_cached = osf_file.read_chunk(data_offset);
+    EXPECT_NE(data.data(), data_cached.data());
+
+    // cache hits return the same buffer, the header is now most recent
+    EXPECT_EQ(data_cached.data(), osf_file.read_chunk(data_offset).data());
+    EXPECT_EQ(header_again.data(), osf_file.read_chunk(header_offset).data());
+
+    // reading the metadata chunk evicts the least recently read data chunk
+    const ChunkView meta = osf_file.read_chunk(meta_offset);
+    ASSERT_FALSE(meta.empty());
+    EXPECT_TRUE(check_prefixed_size_block_crc(meta.data(), meta.size()));
+    EXPECT_EQ(header_again.data(), osf_file.read_chunk(header_offset).data());
+
+    // the evicted chunk is read back from the file into a new buffer
+    const ChunkView data_reread = osf_file.read_chunk(data_offset);
+    ASSERT_EQ(data_cached.size(), data_reread.size());
+    EXPECT_NE(data_cached.data(), data_reread.data());
+    EXPECT_TRUE(
+        check_prefixed_size_block_crc(data_reread.data(), data_reread.size()));
+    EXPECT_TRUE(std::equal(data_cached.data(),
+                           data_cached.data() + data_cached.size(),
+                           data_reread.data()));
+    EXPECT_EQ(data_reread.data(), osf_file.read_chunk(data_offset).data());
+
+    // views of evicted chunks stay valid
+    EXPECT_TRUE(check_prefixed_size_block_crc(data.data(), data.size()));
+    EXPECT_TRUE(
+        check_prefixed_size_block_crc(data_cached.data(), data_cached.size()));
+    EXPECT_TRUE(check_prefixed_size_block_crc(header.data(), header.size()));
+}
+
 }  // namespace
 }  // namespace osf
 }  // namespace ouster
@@ -16,6 +16,7 @@
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <thread>
 
 #include "common.h"
 #include "osf_test.h"
@@ -23,6 +24,7 @@
 #include "ouster/lidar_scan.h"
 #include "ouster/osf/basics.h"
 #include "ouster/types.h"
+#include "thread_pool.h"
 
 namespace ouster {
 namespace osf {
@@ -350,6 +352,82 @@ TEST_F(OsfPngToolsTest, scanDecodeFields) {
         },
         std::invalid_argument);
 }
+
+TEST_F(OsfPngToolsTest, scanEncodeFieldsSharedPool) {
+    const sensor_info si = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+    const auto& px_offset = si.format.pixel_shift_by_row;
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 3; ++i) scans.push_back(get_random_lidar_scan(si));
+
+    ouster::LidarScanFieldTypes fields;
+    LidarScanFieldTypes encode_fields;
+    for (const auto& f : scans[0].field_types()) {
+        fields.push_back(f);
+        encode_fields.push_back({f.name, f.element_type});
+    }
+
+    // several scans encoded at once on the same pool, like the async writer
+    ThreadPool pool(2);
+    std::vector<ScanData> encoded(scans.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < scans.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            encoded[i] =
+                scanEncodeFields(scans[i], px_offset, encode_fields, &pool);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    for (size_t i = 0; i < scans.size(); ++i) {
+        ASSERT_EQ(encoded[i].size(), fields.size());
+        LidarScan decoded(si.format.columns_per_frame,
+                          si.format.pixels_per_column, fields.begin(),
+                          fields.end());
+        EXPECT_FALSE(scanDecode(decoded, encoded[i], px_offset, fields));
+        for (const auto& f : fields) {
+            EXPECT_EQ(decoded.field(f.name), scans[i].field(f.name));
+        }
+    }
+}
+
+TEST_F(OsfPngToolsTest, scanEncodeFieldsRowBands) {
+    // large fields are deflated in row bands, an odd height leaves a short
+    // last band
+    const size_t w = 2048;
+    const size_t h = 131;
+    const ouster::LidarScanFieldTypes fields = {
+        {"RANGE", sensor::ChanFieldType::UINT32},
+        {"SIGNAL", sensor::ChanFieldType::UINT16},
+        {"REFLECTIVITY", sensor::ChanFieldType::UINT8},
+        {"CUSTOM64", sensor::ChanFieldType::UINT64}};
+    const LidarScan scan = get_random_lidar_scan(w, h, fields);
+    const std::vector<int> px_offset(h, 0);
+
+    LidarScanFieldTypes encode_fields;
+    for (const auto& f : fields) {
+        encode_fields.push_back({f.name, f.element_type});
+    }
+
+    ThreadPool pool(3);
+    const ScanData banded =
+        scanEncodeFields(scan, px_offset, encode_fields, &pool);
+    ASSERT_EQ(banded.size(), fields.size());
+
+    for (size_t i = 0; i < encode_fields.size(); ++i) {
+        // plain libpng output of the same field
+        ScanData whole(1);
+        ASSERT_FALSE(fieldEncode(scan, encode_fields[i], px_offset, whole, 0));
+        EXPECT_LT(banded[i].size(), whole[0].size() * 101 / 100);
+
+        LidarScan decoded(w, h, fields.begin(), fields.end());
+        ScanData png{banded[i]};
+        EXPECT_FALSE(
+            fieldDecode(decoded, png, 0, encode_fields[i], px_offset));
+        EXPECT_EQ(decoded.field(fields[i].name), scan.field(fields[i].name));
+    }
+}
 #endif
 
 TEST(OsfFieldEncodeTest, field_encode_decode_test) {
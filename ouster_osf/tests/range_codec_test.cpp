@@ -0,0 +1,323 @@
+/**
+ * Copyright(c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "range_codec.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "common.h"
+#include "osf_test.h"
+#include "ouster/lidar_scan.h"
+#include "ouster/pcap.h"
+#include "ouster/types.h"
+#include "png_tools.h"
+
+namespace ouster {
+namespace osf {
+namespace {
+
+class OsfRangeCodecTest : public OsfTestWithData {};
+
+using ouster::sensor::sensor_info;
+
+std::vector<int> test_px_offset(size_t rows) {
+    std::vector<int> px_offset(rows);
+    for (size_t i = 0; i < rows; ++i) px_offset[i] = (i % 4) * 6;
+    return px_offset;
+}
+
+// Range-like image: smooth surfaces with holes and a few far outliers
+img_t<uint32_t> make_range_image(size_t rows, size_t cols, double zero_ratio) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 15.0);
+    img_t<uint32_t> img(rows, cols);
+    for (size_t u = 0; u < rows; ++u) {
+        for (size_t v = 0; v < cols; ++v) {
+            if (uni(gen) < zero_ratio) {
+                img(u, v) = 0;
+            } else if (uni(gen) < 0.01) {
+                img(u, v) = static_cast<uint32_t>(uni(gen) * 0xfffff) + 1;
+            } else {
+                const double r = 5000 + 3000 * std::sin(v * 0.01 + u * 0.02);
+                img(u, v) = static_cast<uint32_t>(r + noise(gen));
+            }
+        }
+    }
+    return img;
+}
+
+TEST_F(OsfRangeCodecTest, RoundTrip) {
+    const size_t rows = 64;
+    const size_t cols = 1024;
+    const auto px_offset = test_px_offset(rows);
+
+    for (double zero_ratio : {0.0, 0.3, 0.95, 1.0}) {
+        const img_t<uint32_t> img = make_range_image(rows, cols, zero_ratio);
+
+        std::vector<uint8_t> encoded;
+        EXPECT_FALSE(encodeRangeImage(encoded, img, px_offset));
+        EXPECT_LT(encoded.size(), rows * cols * sizeof(uint32_t));
+
+        img_t<uint32_t> decoded(rows, cols);
+        EXPECT_FALSE(decodeRangeImage(decoded, encoded.data(), encoded.size(),
+                                      px_offset));
+        EXPECT_TRUE((img == decoded).all()) << "zero_ratio = " << zero_ratio;
+    }
+}
+
+// Values that don't look like ranges at all still round trip
+TEST_F(OsfRangeCodecTest, RoundTripFullRange) {
+    const size_t rows = 16;
+    const size_t cols = 512;
+    const auto px_offset = test_px_offset(rows);
+
+    std::mt19937 gen(7);
+    img_t<uint32_t> img(rows, cols);
+    img = img.unaryExpr([&](uint32_t) { return static_cast<uint32_t>(gen()); });
+    img(0, 0) = 0xffffffff;
+    img(0, 1) = 1;
+
+    std::vector<uint8_t> encoded;
+    EXPECT_FALSE(encodeRangeImage(encoded, img, px_offset));
+
+    img_t<uint32_t> decoded(rows, cols);
+    EXPECT_FALSE(
+        decodeRangeImage(decoded, encoded.data(), encoded.size(), px_offset));
+    EXPECT_TRUE((img == decoded).all());
+}
+
+TEST_F(OsfRangeCodecTest, DecodeBadInput) {
+    const size_t rows = 32;
+    const size_t cols = 256;
+    const auto px_offset = test_px_offset(rows);
+    const img_t<uint32_t> img = make_range_image(rows, cols, 0.2);
+
+    std::vector<uint8_t> encoded;
+    EXPECT_FALSE(encodeRangeImage(encoded, img, px_offset));
+
+    img_t<uint32_t> decoded(rows, cols);
+    // truncated
+    EXPECT_TRUE(decodeRangeImage(decoded, encoded.data(), encoded.size() / 2,
+                                 px_offset));
+    EXPECT_TRUE(decodeRangeImage(decoded, encoded.data(), 4, px_offset));
+
+    // wrong size of the destination
+    img_t<uint32_t> other(rows, cols * 2);
+    EXPECT_TRUE(
+        decodeRangeImage(other, encoded.data(), encoded.size(), px_offset));
+
+    // unknown version
+    encoded[0] = 0xff;
+    EXPECT_TRUE(
+        decodeRangeImage(decoded, encoded.data(), encoded.size(), px_offset));
+}
+
+// Scans batched from a test recording, or the partial scan if it doesn't
+// hold a whole frame
+std::vector<LidarScan> batch_pcap_scans(const std::string& pcap_path,
+                                        const sensor_info& info) {
+    const auto pf = sensor::get_format(info);
+    LidarScan ls(info.format.columns_per_frame, info.format.pixels_per_column,
+                 info.format.udp_profile_lidar);
+    ScanBatcher batcher(info);
+    std::vector<LidarScan> scans;
+
+    sensor_utils::PcapReader pcap(pcap_path);
+    while (pcap.next_packet()) {
+        if (pcap.current_info().dst_port != 7502 ||
+            pcap.current_length() != pf.lidar_packet_size) {
+            continue;
+        }
+        if (batcher(pcap.current_data(), 0, ls)) scans.push_back(ls);
+    }
+    if (scans.empty()) scans.push_back(ls);
+    return scans;
+}
+
+// The range codec compresses recorded RANGE fields better than PNG
+TEST_F(OsfRangeCodecTest, SmallerThanPngOnPcaps) {
+    struct pcap_case {
+        std::string pcap;
+        std::string json;
+        // the FUSA recording is almost all no-returns, where the deflate
+        // stage of PNG is slightly ahead
+        double max_png_ratio;
+    };
+    const std::vector<pcap_case> pcaps = {
+        {"OS-0-128-U1_v2.3.0_1024x10.pcap", "OS-0-128-U1_v2.3.0_1024x10.json",
+         1.0},
+        {"OS-0-32-U1_v2.2.0_1024x10.pcap", "OS-0-32-U1_v2.2.0_1024x10.json",
+         1.0},
+        {"OS-1-128_767798045_1024x10_20230712_120049.pcap",
+         "OS-1-128_767798045_1024x10_20230712_120049.json", 1.1},
+        {"OS-1-128_v2.3.0_1024x10_lb_n3.pcap", "OS-1-128_v2.3.0_1024x10.json",
+         1.0},
+        {"OS-2-128-U1_v2.3.0_1024x10.pcap", "OS-2-128-U1_v2.3.0_1024x10.json",
+         1.0}};
+
+    for (const auto& p : pcaps) {
+        const sensor_info info = sensor::metadata_from_json(
+            path_concat(test_data_dir(), "pcaps/" + p.json));
+        const auto& px_offset = info.format.pixel_shift_by_row;
+        const auto scans = batch_pcap_scans(
+            path_concat(test_data_dir(), "pcaps/" + p.pcap), info);
+
+        size_t png_bytes = 0, range_bytes = 0;
+        for (const auto& scan : scans) {
+            const auto range = scan.field<uint32_t>(sensor::ChanField::RANGE);
+
+            ScanChannelData png_buf;
+            EXPECT_FALSE(encode32bitImage<uint32_t>(png_buf, range, px_offset));
+            png_bytes += png_buf.size();
+
+            std::vector<uint8_t> range_buf;
+            EXPECT_FALSE(encodeRangeImage(range_buf, range, px_offset));
+            range_bytes += range_buf.size();
+
+            img_t<uint32_t> decoded(range.rows(), range.cols());
+            EXPECT_FALSE(decodeRangeImage(decoded, range_buf.data(),
+                                          range_buf.size(), px_offset));
+            EXPECT_TRUE((decoded == range).all()) << p.pcap;
+        }
+
+        EXPECT_LT(range_bytes, png_bytes * p.max_png_ratio) << p.pcap;
+    }
+}
+
+using str_pair = std::pair<std::string, std::string>;
+class OsfRangeCodecBenchmarkTest
+    : public OsfTestWithData,
+      public ::testing::WithParamInterface<str_pair> {};
+
+// clang-format off
+INSTANTIATE_TEST_CASE_P(
+    RangeCodecBenchmarkTests,
+    OsfRangeCodecBenchmarkTest,
+    ::testing::Values(
+        str_pair{"OS-0-128-U1_v2.3.0_1024x10.pcap",
+                 "OS-0-128-U1_v2.3.0_1024x10.json"},
+        str_pair{"OS-0-32-U1_v2.2.0_1024x10.pcap",
+                 "OS-0-32-U1_v2.2.0_1024x10.json"},
+        str_pair{"OS-1-128_767798045_1024x10_20230712_120049.pcap",
+                 "OS-1-128_767798045_1024x10_20230712_120049.json"},
+        str_pair{"OS-1-128_v2.3.0_1024x10_lb_n3.pcap",
+                 "OS-1-128_v2.3.0_1024x10.json"},
+        str_pair{"OS-2-128-U1_v2.3.0_1024x10.pcap",
+                 "OS-2-128-U1_v2.3.0_1024x10.json"})
+);
+// clang-format on
+
+// Reports compression ratio and throughput of the range codec and of the
+// PNG path on the RANGE field of recorded data
+TEST_P(OsfRangeCodecBenchmarkTest, RangeCodecBenchTest) {
+    const auto test_params = GetParam();
+    const sensor_info info = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/" + test_params.second));
+    const auto& px_offset = info.format.pixel_shift_by_row;
+
+    std::cout << "CHECKING RANGE CODEC PERFORMANCE WITH: " << test_params.first
+              << std::endl;
+
+    // batch the scans up front so pcap I/O doesn't skew the numbers
+    std::vector<img_t<uint32_t>> ranges;
+    for (const auto& scan : batch_pcap_scans(
+             path_concat(test_data_dir(), "pcaps/" + test_params.first),
+             info)) {
+        ranges.push_back(scan.field<uint32_t>(sensor::ChanField::RANGE));
+    }
+    const double raw_mb = static_cast<double>(ranges.size()) *
+                          ranges[0].size() * sizeof(uint32_t) / 1e6;
+
+    constexpr int N_RUNS = 50;
+    constexpr int REPORT_EVERY = 10;
+
+    using clock = std::chrono::steady_clock;
+    std::map<std::string, clock::duration> elapsed;
+    std::map<std::string, size_t> encoded_bytes;
+
+    std::vector<ScanChannelData> png_bufs(ranges.size());
+    std::vector<std::vector<uint8_t>> range_bufs(ranges.size());
+    img_t<uint32_t> decoded(ranges[0].rows(), ranges[0].cols());
+
+    auto timed = [&](const std::string& name, const std::function<void()>& fn) {
+        const auto t0 = clock::now();
+        fn();
+        elapsed[name] += clock::now() - t0;
+    };
+
+    // the range decoder needs the encoded buffers of the same run
+    std::vector<std::function<void()>> all_methods = {
+        [&]() {
+            timed("png", [&]() {
+                for (size_t i = 0; i < ranges.size(); ++i) {
+                    png_bufs[i].clear();
+                    encode32bitImage<uint32_t>(png_bufs[i], ranges[i],
+                                               px_offset);
+                }
+            });
+        },
+        [&]() {
+            timed("range", [&]() {
+                for (size_t i = 0; i < ranges.size(); ++i) {
+                    range_bufs[i].clear();
+                    encodeRangeImage(range_bufs[i], ranges[i], px_offset);
+                }
+            });
+            timed("range decode", [&]() {
+                for (const auto& buf : range_bufs) {
+                    decodeRangeImage(decoded, buf.data(), buf.size(),
+                                     px_offset);
+                }
+            });
+        }};
+
+    std::default_random_engine g;
+    for (int run = 1; run <= N_RUNS; ++run) {
+        std::shuffle(all_methods.begin(), all_methods.end(), g);
+        for (auto& m : all_methods) m();
+
+        if (run % REPORT_EVERY) continue;
+        encoded_bytes["png"] = 0;
+        encoded_bytes["range"] = 0;
+        for (const auto& b : png_bufs) encoded_bytes["png"] += b.size();
+        for (const auto& b : range_bufs) encoded_bytes["range"] += b.size();
+
+        std::stringstream ss;
+        ss << "runs: " << std::setw(3) << run << std::fixed
+           << std::setprecision(2);
+        for (const auto& name : {"png", "range"}) {
+            const double secs =
+                std::chrono::duration<double>(elapsed[name]).count();
+            ss << ", " << name << "[ratio]: "
+               << raw_mb * 1e6 / encoded_bytes[name] << ", " << name
+               << "[encode]: " << std::setw(7) << raw_mb * run / secs
+               << " MB/s";
+        }
+        const double decode_secs =
+            std::chrono::duration<double>(elapsed["range decode"]).count();
+        ss << ", range[decode]: " << std::setw(7) << raw_mb * run / decode_secs
+           << " MB/s";
+        std::cout << ss.str() << std::endl;
+    }
+
+    EXPECT_GT(encoded_bytes["range"], 0u);
+    EXPECT_GT(encoded_bytes["png"], 0u);
+}
+
+}  // namespace
+}  // namespace osf
+}  // namespace ouster
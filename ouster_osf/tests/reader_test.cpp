@@ -14,6 +14,7 @@
 #include "ouster/impl/logging.h"
 #include "ouster/osf/meta_lidar_sensor.h"
 #include "ouster/osf/meta_streaming_info.h"
+#include "ouster/osf/scan_prefetcher.h"
 #include "ouster/osf/stream_lidar_scan.h"
 
 namespace ouster {
@@ -337,6 +338,93 @@ TEST_F(ReaderTest, MetadataFromBufferTest) {
     EXPECT_EQ(result->type(), "ouster/v1/os_sensor/LidarSensor");
 }
 
+TEST_F(ReaderTest, DecodeFieldsSubset) {
+    OsfFile osf_file(
+        path_concat(test_data_dir(), "osfs/OS-1-128_v2.3.0_1024x10_lb_n3.osf"));
+    Reader reader(osf_file);
+
+    const std::vector<std::string> range_only{sensor::ChanField::RANGE,
+                                              "NOT_A_FIELD"};
+    int cnt = 0;
+    for (const auto msg : reader.messages()) {
+        if (!msg.is<LidarScanStream>()) continue;
+        auto full = msg.decode_msg<LidarScanStream>();
+        auto part = msg.decode_msg<LidarScanStream>(range_only);
+        ASSERT_TRUE(full);
+        ASSERT_TRUE(part);
+        ASSERT_GT(full->fields().size(), 1);
+
+        EXPECT_EQ(1, part->fields().size());
+        ASSERT_TRUE(part->has_field(sensor::ChanField::RANGE));
+        EXPECT_FALSE(part->has_field("NOT_A_FIELD"));
+        EXPECT_TRUE((full->field<uint32_t>(sensor::ChanField::RANGE) ==
+                     part->field<uint32_t>(sensor::ChanField::RANGE))
+                        .all());
+        EXPECT_EQ(full->frame_id, part->frame_id);
+        EXPECT_TRUE((full->timestamp() == part->timestamp()).all());
+        EXPECT_TRUE((full->status() == part->status()).all());
+
+        // empty list decodes everything
+        auto all = msg.decode_msg<LidarScanStream>(std::vector<std::string>{});
+        ASSERT_TRUE(all);
+        EXPECT_EQ(*full, *all);
+        ++cnt;
+    }
+    EXPECT_EQ(3, cnt);
+}
+
+TEST_F(ReaderTest, PrefetchedScansMatchSequentialDecode) {
+    OsfFile osf_file(
+        path_concat(test_data_dir(), "osfs/OS-1-128_v2.3.0_1024x10_lb_n3.osf"));
+    Reader reader(osf_file);
+
+    std::vector<uint32_t> ids;
+    std::vector<ts_t> tss;
+    std::vector<LidarScan> scans;
+    for (const auto msg : reader.messages()) {
+        if (!msg.is<LidarScanStream>()) continue;
+        auto ls = msg.decode_msg<LidarScanStream>();
+        ASSERT_TRUE(ls);
+        ids.push_back(msg.id());
+        tss.push_back(msg.ts());
+        scans.push_back(*ls);
+    }
+    ASSERT_EQ(3, scans.size());
+
+    for (uint32_t read_ahead : {1, 2, 8}) {
+        for (uint32_t threads : {0, 1, 3}) {
+            LidarScanPrefetcher prefetcher(reader.messages(),
+                                           {read_ahead, threads});
+            size_t i = 0;
+            for (const DecodedScan& s : prefetcher) {
+                ASSERT_LT(i, scans.size());
+                EXPECT_EQ(ids[i], s.stream_id);
+                EXPECT_EQ(tss[i], s.ts);
+                ASSERT_TRUE(s.scan);
+                EXPECT_EQ(scans[i], *s.scan);
+                ++i;
+            }
+            EXPECT_EQ(scans.size(), i)
+                << "read_ahead = " << read_ahead << ", threads = " << threads;
+
+            DecodedScan s;
+            EXPECT_FALSE(prefetcher.next(s));
+        }
+    }
+
+    // stops in the middle without consuming everything
+    {
+        LidarScanPrefetcher prefetcher(reader.messages(), {2, 2});
+        DecodedScan s;
+        EXPECT_TRUE(prefetcher.next(s));
+        EXPECT_EQ(tss[0], s.ts);
+    }
+
+    const ScanPrefetchOptions no_read_ahead{0, 1};
+    EXPECT_THROW(LidarScanPrefetcher(reader.messages(), no_read_ahead),
+                 std::invalid_argument);
+}
+
 }  // namespace
 }  // namespace osf
 }  // namespace ouster
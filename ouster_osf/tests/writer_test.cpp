@@ -7,9 +7,11 @@
 
 #include <gtest/gtest.h>
 
+#include <functional>
 #include <string>
 
 #include "common.h"
+#include "os_sensor/lidar_scan_stream_generated.h"
 #include "osf_test.h"
 #include "ouster/lidar_scan.h"
 #include "ouster/osf/file.h"
@@ -29,6 +31,52 @@ using ouster::sensor::sensor_info;
 
 class WriterTest : public osf::OsfTestWithDataAndFiles {};
 
+void expect_same_scan(const LidarScan& ls, const LidarScan& recovered) {
+    EXPECT_EQ(recovered, ls);
+}
+
+/**
+ * Save scans to a new file with the given writer options, read them back and
+ * check each one against the scan it was saved from.
+ *
+ * @param[in] filename file to write.
+ * @param[in] sinfo sensor of the lidar scan stream.
+ * @param[in] scans scans to save, with timestamps 100, 101, ...
+ * @param[in] options writer options.
+ * @param[in] compare called with each saved scan and the scan read back.
+ * @param[in] chunk_size writer chunk size, 0 for the default.
+ * @param[in] on_saved called with the writer after the last save.
+ */
+template <typename Compare>
+void write_and_compare(
+    const std::string& filename, const sensor_info& sinfo,
+    const std::vector<LidarScan>& scans, const WriterOptions& options,
+    Compare compare, uint32_t chunk_size = 0,
+    const std::function<void(Writer&)>& on_saved = {}) {
+    {
+        Writer writer(filename, sinfo, {}, chunk_size, options);
+        for (size_t i = 0; i < scans.size(); ++i) {
+            writer.save(0, scans[i], ts_t(100 + i));
+        }
+        if (on_saved) on_saved(writer);
+    }
+
+    OsfFile osf_file(filename);
+    EXPECT_TRUE(osf_file.good());
+
+    Reader reader(osf_file);
+    size_t i = 0;
+    for (const auto& msg : reader.messages()) {
+        EXPECT_EQ(msg.ts(), ts_t(100 + i));
+        auto ls_recovered = msg.decode_msg<LidarScanStream>();
+        ASSERT_TRUE(ls_recovered);
+        ASSERT_LT(i, scans.size());
+        compare(scans[i], *ls_recovered);
+        ++i;
+    }
+    EXPECT_EQ(i, scans.size());
+}
+
 TEST_F(WriterTest, ChunksLayoutEnum) {
     ChunksLayout cl = ChunksLayout::LAYOUT_STANDARD;
     EXPECT_EQ(to_string(cl), "STANDARD");
@@ -193,6 +241,194 @@ TEST_F(WriterTest, WriteSingleLidarScanStreamingLayout) {
     EXPECT_EQ(metadata_recovered, sinfo_str);
 }
 
+TEST_F(WriterTest, WriteWithFileOptions) {
+    const sensor_info sinfo = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 5; ++i) scans.push_back(get_random_lidar_scan(sinfo));
+
+    WriterOptions buffered;
+    buffered.write_buffer_size = 100000;  // not block aligned on purpose
+    buffered.sync_policy = SYNC_ON_CLOSE;
+
+    WriterOptions direct;
+    direct.direct_io = true;
+    direct.sync_policy = SYNC_EVERY_CHUNK;
+
+    // small chunk size to emit a chunk per scan
+    write_and_compare(tmp_file("writer_options_0.osf"), sinfo, scans,
+                      buffered, expect_same_scan, 1024);
+    write_and_compare(tmp_file("writer_options_1.osf"), sinfo, scans, direct,
+                      expect_same_scan, 1024);
+}
+
+TEST_F(WriterTest, WriteAsync) {
+    const sensor_info sinfo = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 10; ++i) scans.push_back(get_random_lidar_scan(sinfo));
+
+    WriterOptions options;
+    options.async = true;
+    options.encoder_threads = 3;
+    options.queue_depth = 2;
+    options.queue_policy = QUEUE_BLOCK;
+
+    // encoding is parallel, but messages land in the order they were saved
+    write_and_compare(tmp_file("writer_async.osf"), sinfo, scans, options,
+                      expect_same_scan, 1024, [&](Writer& writer) {
+                          writer.close();
+                          auto stats = writer.queue_stats();
+                          EXPECT_EQ(stats.queued, scans.size());
+                          EXPECT_EQ(stats.written, scans.size());
+                          EXPECT_EQ(stats.dropped, 0u);
+                          EXPECT_EQ(stats.depth, 0u);
+                          EXPECT_LE(stats.max_depth, options.queue_depth);
+                      });
+}
+
+TEST_F(WriterTest, WriteFieldCodecs) {
+    const sensor_info sinfo = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 3; ++i) scans.push_back(get_random_lidar_scan(sinfo));
+
+    for (auto codec : {CODEC_DEFLATE, CODEC_ZSTD, CODEC_LZ4}) {
+        if (!field_codec_supported(codec)) continue;
+        for (uint32_t filters = FILTER_NONE;
+             filters <= (FILTER_DELTA | FILTER_SHUFFLE); ++filters) {
+            WriterOptions options;
+            options.field_codec = codec;
+            options.field_filters = filters;
+            write_and_compare(
+                tmp_file("writer_codec_" + std::to_string(codec) + "_" +
+                         std::to_string(filters) + ".osf"),
+                sinfo, scans, options, expect_same_scan);
+        }
+    }
+
+    // codecs unknown to this build are refused up front
+    WriterOptions options;
+    options.field_codec = static_cast<FieldCodec>(100);
+    EXPECT_THROW(Writer(tmp_file("writer_codec_unknown.osf"), sinfo, {}, 0,
+                        options),
+                 std::invalid_argument);
+}
+
+TEST_F(WriterTest, WriteRangeCodec) {
+    const sensor_info sinfo = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 3; ++i) scans.push_back(get_random_lidar_scan(sinfo));
+
+    // RANGE fields with the range codec, the rest with PNG or DEFLATE
+    for (auto codec : {CODEC_PNG, CODEC_DEFLATE}) {
+        WriterOptions options;
+        options.field_codec = codec;
+        options.range_codec = true;
+        write_and_compare(
+            tmp_file("writer_range_codec_" + std::to_string(codec) + ".osf"),
+            sinfo, scans, options, expect_same_scan);
+    }
+}
+
+TEST_F(WriterTest, WriteQuantized) {
+    const sensor_info sinfo = sensor::metadata_from_json(
+        path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
+
+    std::vector<LidarScan> scans;
+    for (int i = 0; i < 3; ++i) scans.push_back(get_random_lidar_scan(sinfo));
+
+    WriterOptions options;
+    options.field_quantization.range_step = 10;
+    options.field_quantization.signal_bits = 8;
+    options.field_quantization.near_ir_bits = 12;
+
+    // every value is within step / 2, except the small non-zero ones that
+    // are read back as step
+    auto check_field = [](auto orig, auto restored, uint32_t step) {
+        for (Eigen::Index i = 0; i < orig.size(); ++i) {
+            const int64_t v = orig.data()[i];
+            const int64_t r = restored.data()[i];
+            EXPECT_EQ(v == 0, r == 0);
+            if (v >= step / 2) {
+                EXPECT_LE(std::abs(v - r), step / 2);
+            } else if (v != 0) {
+                EXPECT_EQ(r, step);
+            }
+        }
+    };
+    auto expect_quantized = [&](const LidarScan& ls,
+                                const LidarScan& recovered) {
+        check_field(ls.field<uint32_t>(sensor::ChanField::RANGE),
+                    recovered.field<uint32_t>(sensor::ChanField::RANGE), 10);
+        check_field(ls.field<uint16_t>(sensor::ChanField::SIGNAL),
+                    recovered.field<uint16_t>(sensor::ChanField::SIGNAL),
+                    256);
+        check_field(ls.field<uint16_t>(sensor::ChanField::NEAR_IR),
+                    recovered.field<uint16_t>(sensor::ChanField::NEAR_IR),
+                    16);
+        EXPECT_TRUE(ls.field(sensor::ChanField::REFLECTIVITY) ==
+                    recovered.field(sensor::ChanField::REFLECTIVITY));
+    };
+
+    const std::string lossless_filename = tmp_file("writer_lossless.osf");
+    const std::string quantized_filename = tmp_file("writer_quantized.osf");
+    write_and_compare(lossless_filename, sinfo, scans, {}, expect_same_scan);
+    write_and_compare(quantized_filename, sinfo, scans, options,
+                      expect_quantized);
+
+    OsfFile osf_file(quantized_filename);
+    EXPECT_LT(osf_file.size(), OsfFile(lossless_filename).size());
+
+    Reader reader(osf_file);
+    auto lsm = reader.meta_store().get<LidarScanStreamMeta>();
+    ASSERT_TRUE(lsm);
+    const std::map<std::string, uint32_t> expected_steps = {
+        {sensor::ChanField::RANGE, 10},
+        {sensor::ChanField::RANGE2, 10},
+        {sensor::ChanField::SIGNAL, 256},
+        {sensor::ChanField::SIGNAL2, 256},
+        {sensor::ChanField::NEAR_IR, 16}};
+    EXPECT_EQ(lsm->field_steps(), expected_steps);
+
+    // quantised channels are flagged and not PNGs, which readers without
+    // quantisation support would decode without scaling
+    int msg_cnt = 0;
+    for (const auto msg : reader.messages()) {
+        const auto buf = msg.buffer();
+        auto ls_msg =
+            flatbuffers::GetSizePrefixedRoot<ouster::osf::gen::LidarScanMsg>(
+                buf.data());
+        ASSERT_EQ(ls_msg->channels()->size(), ls_msg->field_types()->size());
+        for (uint32_t i = 0; i < ls_msg->channels()->size(); ++i) {
+            const auto field = ls_msg->field_types()->Get(i)->chan_field();
+            const auto channel = ls_msg->channels()->Get(i);
+            const bool quantized = field != gen::CHAN_FIELD::REFLECTIVITY &&
+                                   field != gen::CHAN_FIELD::REFLECTIVITY2 &&
+                                   field != gen::CHAN_FIELD::FLAGS &&
+                                   field != gen::CHAN_FIELD::FLAGS2;
+            EXPECT_EQ(quantized,
+                      static_cast<bool>(channel->filters() &
+                                        gen::ChannelFilter::QUANTIZED));
+            EXPECT_EQ(quantized,
+                      channel->codec() != gen::ChannelCodec::PNG);
+        }
+        ++msg_cnt;
+    }
+    EXPECT_EQ(msg_cnt, 3);
+
+    WriterOptions bad_options;
+    bad_options.field_quantization.signal_bits = 17;
+    EXPECT_THROW(Writer(tmp_file("writer_quantized_bad.osf"), sinfo, {}, 0,
+                        bad_options),
+                 std::invalid_argument);
+}
+
 TEST_F(WriterTest, WriteSlicedLidarScan) {
     const sensor_info sinfo = sensor::metadata_from_json(
         path_concat(test_data_dir(), "pcaps/OS-1-128_v2.3.0_1024x10.json"));
@@ -4,6 +4,10 @@
 
 #pragma once
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "ouster/os_pcap.h"
 #include "ouster/pcap.h"
 #include "ouster/types.h"
@@ -89,8 +93,43 @@ struct IndexedPcapReader : public PcapReader {
     /**
      * This method constructs the index. Call this method before requesting the
      * index information using get_index()
+     *
+     * The file is split in byte ranges indexed in parallel, each starting at
+     * the first record after the range boundary. The ranges are read with
+     * 1 MiB of overlap so that packets fragmented across a boundary are
+     * still reassembled. The file is indexed serially instead if the ranges
+     * don't line up or a datagram in progress at a boundary started before
+     * the overlap, so the index is the same as a serial one. pcapng files
+     * are always indexed serially.
+     *
+     * @param[in] n_threads Number of threads to use, 0 for one per core with
+     * ranges of at least 16 MiB.
+     * @return The number of ranges indexed in parallel, 1 if the file was
+     * indexed serially.
+     */
+    size_t build_index(unsigned int n_threads = 0);
+
+    /**
+     * Load an index saved by save_index().
+     *
+     * The index is only loaded if it was saved for a pcap of the same size
+     * and modification time and the same sensors, by a compatible version.
+     *
+     * @param[in] index_file The index file, usually next to the pcap.
+     * @return true if the index was loaded, false if the file doesn't exist
+     * or doesn't match.
      */
-    void build_index();
+    bool load_index(const std::string& index_file);
+
+    /**
+     * Save the index to a file, to be loaded instead of building it again
+     * the next time the pcap is opened.
+     *
+     * @throws std::runtime_error if the file can't be written.
+     *
+     * @param[in] index_file The index file, replaced atomically.
+     */
+    void save_index(const std::string& index_file) const;
 
     /**
      * Get index for the underlying pcap
@@ -101,16 +140,20 @@ struct IndexedPcapReader : public PcapReader {
 
     /**
      * Attempts to match the current packet to one of the sensor info objects
-     * and returns the appropriate packet format if there is one
+     * by its destination port, in constant time. Sensors sharing a port are
+     * told apart by the serial number of their lidar packets.
      *
-     * @return An optional packet format for the current packet
+     * @return An optional index of the sensor of the current packet
      */
     nonstd::optional<size_t> sensor_idx_for_current_packet() const;
 
     /**
+     * Only the packet header is read, with the cached packet format of the
+     * sensor.
+     *
      * @return the current packet's frame_id
      * if the packet is associated with a sensor (and its corresponding packet
-     * format)
+     * format) and has the size of its lidar packets
      */
     nonstd::optional<uint16_t> current_frame_id() const;
 
@@ -140,6 +183,30 @@ struct IndexedPcapReader : public PcapReader {
     // TODO: remove, this should be a transient variable
     std::vector<nonstd::optional<uint16_t>>
         previous_frame_ids_;  ///< previous frame id for each sensor
+
+   private:
+    struct range_index;
+
+    void init_sensor_dispatch();
+    bool is_lidar_packet(size_t sensor_idx) const;
+    void reset_frame_ids();
+    bool is_new_frame(size_t sensor_idx, uint16_t frame_id,
+                      uint32_t init_id) const;
+    void add_frame(size_t sensor_idx, uint64_t offset, uint64_t timestamp,
+                   uint16_t frame_id, uint32_t init_id);
+    bool build_index_parallel(size_t n_ranges);
+    void index_range(uint64_t read_from, uint64_t begin, uint64_t end,
+                     range_index& result);
+    uint64_t sensors_key() const;
+
+    std::string pcap_filename_;
+
+    /// sensor indices by lidar port, built from sensor_infos_ on construction
+    std::unordered_map<int, std::vector<size_t>> sensors_by_port_;
+    std::vector<uint64_t> serial_numbers_;  ///< prod_sn of each sensor
+    std::vector<const ouster::sensor::packet_format*>
+        formats_;  ///< cached packet format of each sensor
+    std::vector<uint32_t> previous_init_ids_;  ///< init_id of the last frame
 };
 
 }  // namespace sensor_utils
@@ -25,10 +25,10 @@ namespace sensor_utils {
  * Structure representing a hash key/sorting key for a udp stream
  */
 struct stream_key {
-    std::string dst_ip;  ///< The destination IP
-    std::string src_ip;  ///< The source IP
-    int src_port;        ///< The src port
-    int dst_port;        ///< The destination port
+    ip_address dst_ip;  ///< The destination IP
+    ip_address src_ip;  ///< The source IP
+    int src_port;       ///< The src port
+    int dst_port;       ///< The destination port
 
     bool operator==(const struct stream_key& other) const;
 };
@@ -39,8 +39,9 @@ template <>
 struct std::hash<ouster::sensor_utils::stream_key> {
     std::size_t operator()(
         const ouster::sensor_utils::stream_key& key) const noexcept {
-        return std::hash<std::string>{}(key.src_ip) ^
-               (std::hash<std::string>{}(key.src_ip) << 1) ^
+        using ouster::sensor_utils::ip_address;
+        return std::hash<ip_address>{}(key.src_ip) ^
+               (std::hash<ip_address>{}(key.dst_ip) << 1) ^
                (std::hash<int>{}(key.src_port << 2)) ^
                (std::hash<int>{}(key.dst_port << 3));
     }
@@ -6,13 +6,22 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ouster {
+namespace sensor {
+class packet_format;
+}  // namespace sensor
+
 namespace sensor_utils {
 
 struct pcap_impl;
@@ -20,12 +29,68 @@ struct pcap_writer_impl;
 
 static constexpr int IANA_UDP = 17;
 
+/**
+ * IPv4 or IPv6 address, stored in network byte order.
+ */
+struct ip_address {
+    int version{0};                   ///< 4 or 6, 0 for no address
+    std::array<uint8_t, 16> bytes{};  ///< The first 4 are used for IPv4
+
+    ip_address() = default;
+
+    /**
+     * Parse an address in dotted decimal or IPv6 notation, an empty string
+     * is no address.
+     *
+     * @throws std::invalid_argument if the string isn't an IP address.
+     *
+     * @param[in] ip The address.
+     */
+    ip_address(const std::string& ip);
+
+    /**
+     * @copydoc ip_address(const std::string&)
+     */
+    ip_address(const char* ip);
+
+    /**
+     * @param[in] version 4 or 6.
+     * @param[in] addr The 4 or 16 bytes of the address, in network byte
+     * order.
+     */
+    ip_address(int version, const uint8_t* addr);
+
+    /**
+     * @return The address in dotted decimal or IPv6 notation, empty for no
+     * address.
+     */
+    std::string to_string() const;
+
+    /**
+     * @return true if this is no address.
+     */
+    bool empty() const { return version == 0; }
+
+    bool operator==(const ip_address& other) const;
+    bool operator!=(const ip_address& other) const;
+    bool operator<(const ip_address& other) const;
+};
+
+/**
+ * To string method for ip addresses.
+ *
+ * @param[inout] stream_in The pre-existing ostream to concat with data.
+ * @param[in] data The address to output.
+ *
+ * @return The new output stream containing concatted stream_in and data.
+ */
+std::ostream& operator<<(std::ostream& stream_in, const ip_address& data);
+
 struct packet_info {
     using ts = std::chrono::microseconds;
 
-    // TODO: use numerical IPs for efficient filtering
-    std::string dst_ip;          ///< The destination IP
-    std::string src_ip;          ///< The source IP
+    ip_address dst_ip;           ///< The destination IP
+    ip_address src_ip;           ///< The source IP
     int dst_port;                ///< The destination port
     int src_port;                ///< The source port
     size_t payload_size;         ///< The size of the packet payload
@@ -39,6 +104,34 @@ struct packet_info {
     int network_protocol;  ///< IANA protocol number. Always 17 (UDP)
 };
 
+/**
+ * Selects the packets PcapReader::next_packet() returns, in the spirit of a
+ * BPF program: PcapReader compiles it once into lookup tables and checks
+ * the headers of each packet before reassembling or parsing it further.
+ *
+ * Each criterion left empty matches any packet, a packet must match all of
+ * the others to be returned.
+ */
+struct packet_filter {
+    std::vector<int> dst_ports{};       ///< Destination ports to keep
+    std::vector<int> src_ports{};       ///< Source ports to keep
+    std::vector<ip_address> dst_ips{};  ///< Destination addresses to keep
+    std::vector<ip_address> src_ips{};  ///< Source addresses to keep
+
+    /**
+     * Serial numbers of the sensors to keep the lidar packets of, read with
+     * packet_format::prod_sn(). Only packets with the size of a lidar packet
+     * of one of lidar_formats are checked, other packets are kept.
+     */
+    std::vector<uint64_t> serial_numbers{};
+
+    /**
+     * Formats of the lidar packets serial numbers are read from, e.g. from
+     * sensor::get_format(). They must outlive the reader.
+     */
+    std::vector<const sensor::packet_format*> lidar_formats{};
+};
+
 /**
  * Class for dealing with reading pcap files
  */
@@ -46,10 +139,16 @@ class PcapReader {
     std::unique_ptr<pcap_impl> impl;    ///< Private implementation pointer
     packet_info info;                   ///< Cached packet info
     std::map<int, int> fragment_count;  ///< Map to count fragments per packet
-    uint8_t* data;                      ///< Cached packet data
+    const uint8_t* data;                ///< Cached packet data
 
    public:
     /**
+     * Reads pcap and pcapng files, the file is memory mapped and packets are
+     * parsed in place.
+     *
+     * @throws std::runtime_error if the file can't be opened or isn't a pcap
+     * or pcapng file.
+     *
      * @param[in] file A filepath of the pcap to read
      */
     PcapReader(const std::string& file);
@@ -66,6 +165,7 @@ class PcapReader {
 
     /**
      * Return the current packets data.
+     * The data is only valid until the next call to next_packet()
      * To advance to a new packet please use next_packet()
      * To get the size of the data use current_length()
      *
@@ -115,6 +215,43 @@ class PcapReader {
 
     int64_t current_offset() const;
 
+    /**
+     * Find the first record at or after an arbitrary offset, to split the
+     * file in ranges read independently.
+     *
+     * Classic pcap records aren't framed, the offset returned is the first
+     * one a chain of valid looking record headers starts at.
+     *
+     * @param[in] offset The position to search from in bytes.
+     * @return The offset of the record, the file size if there is none.
+     */
+    uint64_t next_record_offset(uint64_t offset) const;
+
+    /**
+     * Find the IPv4 datagrams that are still being reassembled after the
+     * current packet, which a reader seeking past their first fragment
+     * would miss.
+     *
+     * @return The offsets of the earliest record read of each datagram,
+     * sorted.
+     */
+    std::vector<uint64_t> pending_fragment_offsets() const;
+
+    /**
+     * @return true if the file is pcapng rather than classic pcap.
+     */
+    bool is_pcapng() const;
+
+    /**
+     * Only return the packets matching the filter from now on.
+     *
+     * @throws std::invalid_argument if serial numbers are given without
+     * lidar formats.
+     *
+     * @param[in] filter The packets to keep, an empty filter keeps all.
+     */
+    void set_filter(const packet_filter& filter);
+
    private:
     int64_t file_size_{};
     int64_t file_start_{};
@@ -204,3 +341,15 @@ class PcapWriter {
 std::ostream& operator<<(std::ostream& stream_in, const packet_info& data);
 }  // namespace sensor_utils
 }  // namespace ouster
+
+template <>
+struct std::hash<ouster::sensor_utils::ip_address> {
+    std::size_t operator()(
+        const ouster::sensor_utils::ip_address& addr) const noexcept {
+        uint64_t lo, hi;
+        std::memcpy(&lo, addr.bytes.data(), sizeof(lo));
+        std::memcpy(&hi, addr.bytes.data() + 8, sizeof(hi));
+        return std::hash<uint64_t>{}(lo ^ (hi * 0x9e3779b97f4a7c15ULL) ^
+                                     static_cast<uint64_t>(addr.version));
+    }
+};
@@ -1,18 +1,117 @@
 #include "ouster/indexed_pcap_reader.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
 namespace ouster {
 namespace sensor_utils {
 
+namespace {
+
+// ranges indexed in parallel are at least this big, unless a number of
+// threads is given
+constexpr uint64_t MIN_INDEX_RANGE = 16 * 1024 * 1024;
+
+// bytes read before a range to reassemble the packets fragmented across its
+// start, plenty for the 64 KiB datagrams of a few sensors. Datagrams starting
+// further back make the file indexed serially.
+constexpr uint64_t INDEX_RANGE_LOOKBACK = 1024 * 1024;
+
+constexpr char INDEX_FILE_MAGIC[8] = {'O', 'S', 'P', 'C', 'A', 'P', 'I', 'X'};
+// bump when the index format or the way frames are found changes
+constexpr uint32_t INDEX_FILE_VERSION = 1;
+
+struct file_stat {
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+bool stat_file(const std::string& path, file_stat& st) {
+#if defined _WIN32
+    struct _stat64 s;
+    if (_stat64(path.c_str(), &s) != 0) return false;
+    st.mtime_ns = static_cast<int64_t>(s.st_mtime) * 1000000000;
+#else
+    struct stat s;
+    if (stat(path.c_str(), &s) != 0) return false;
+#if defined __APPLE__
+    st.mtime_ns = static_cast<int64_t>(s.st_mtimespec.tv_sec) * 1000000000 +
+                  s.st_mtimespec.tv_nsec;
+#else
+    st.mtime_ns = static_cast<int64_t>(s.st_mtim.tv_sec) * 1000000000 +
+                  s.st_mtim.tv_nsec;
+#endif
+#endif
+    st.size = static_cast<uint64_t>(s.st_size);
+    return true;
+}
+
+// FNV-1a
+void hash_bytes(uint64_t& h, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3;
+    }
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& buf, T v) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+bool get(const std::vector<uint8_t>& buf, size_t& pos, T& v) {
+    if (buf.size() - pos < sizeof(T)) return false;
+    std::memcpy(&v, buf.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+}  // namespace
+
+/**
+ * Frames found in a range of the file, see index_range().
+ */
+struct IndexedPcapReader::range_index {
+    struct frame_start {
+        uint64_t offset;
+        uint64_t timestamp;
+        uint16_t frame_id;
+        uint32_t init_id;
+    };
+
+    /// per sensor, packets with another frame_id or init_id than the one
+    /// before, candidates for frame starts
+    std::vector<std::vector<frame_start>> frames;
+    uint64_t first_offset{0};  ///< first packet at or after the range start
+    uint64_t next_offset{0};   ///< first packet at or after the range end
+    /// first fragments read of the datagrams in progress at next_offset
+    std::vector<uint64_t> pending_offsets;
+};
+
 IndexedPcapReader::IndexedPcapReader(
     const std::string& pcap_filename,
     const std::vector<std::string>& metadata_filenames)
     : PcapReader(pcap_filename),
       index_(metadata_filenames.size()),
-      previous_frame_ids_(metadata_filenames.size()) {
+      previous_frame_ids_(metadata_filenames.size()),
+      pcap_filename_(pcap_filename) {
     for (const std::string& metadata_filename : metadata_filenames) {
         sensor_infos_.push_back(
             ouster::sensor::metadata_from_json(metadata_filename));
     }
+    init_sensor_dispatch();
 }
 
 IndexedPcapReader::IndexedPcapReader(
@@ -21,27 +120,54 @@ IndexedPcapReader::IndexedPcapReader(
     : PcapReader(pcap_filename),
       sensor_infos_(sensor_infos),
       index_(sensor_infos.size()),
-      previous_frame_ids_(sensor_infos.size()) {}
+      previous_frame_ids_(sensor_infos.size()),
+      pcap_filename_(pcap_filename) {
+    init_sensor_dispatch();
+}
+
+void IndexedPcapReader::init_sensor_dispatch() {
+    sensors_by_port_.clear();
+    serial_numbers_.assign(sensor_infos_.size(), 0);
+    formats_.clear();
+    previous_init_ids_.assign(sensor_infos_.size(), 0);
+    for (size_t i = 0; i < sensor_infos_.size(); i++) {
+        formats_.push_back(&ouster::sensor::get_format(sensor_infos_[i]));
+        const auto& port = sensor_infos_[i].config.udp_port_lidar;
+        if (port) sensors_by_port_[*port].push_back(i);
+        try {
+            serial_numbers_[i] = std::stoull(sensor_infos_[i].sn);
+        } catch (const std::exception&) {
+            // no serial number, match by port only
+        }
+    }
+}
 
 nonstd::optional<size_t> IndexedPcapReader::sensor_idx_for_current_packet()
     const {
-    const auto& pkt_info = current_info();
-    for (size_t i = 0; i < sensor_infos_.size(); i++) {
-        if (pkt_info.dst_port == sensor_infos_[i].config.udp_port_lidar) {
-            // TODO use the packet format and match serial number if it's
-            // available this will allow us to have multiple sensors on the same
-            // port
-            return i;
+    auto it = sensors_by_port_.find(current_info().dst_port);
+    if (it == sensors_by_port_.end()) return nonstd::nullopt;
+
+    const std::vector<size_t>& sensors = it->second;
+    if (sensors.size() > 1) {
+        // several sensors on the same port, match the serial number
+        for (size_t i : sensors) {
+            if (is_lidar_packet(i) &&
+                formats_[i]->prod_sn(current_data()) == serial_numbers_[i]) {
+                return i;
+            }
         }
     }
-    return nonstd::nullopt;
+    return sensors.front();
+}
+
+bool IndexedPcapReader::is_lidar_packet(size_t sensor_idx) const {
+    return current_length() == formats_[sensor_idx]->lidar_packet_size;
 }
 
 nonstd::optional<uint16_t> IndexedPcapReader::current_frame_id() const {
-    if (nonstd::optional<size_t> sensor_idx = sensor_idx_for_current_packet()) {
-        const ouster::sensor::packet_format& pf =
-            ouster::sensor::packet_format(sensor_infos_[*sensor_idx]);
-        return pf.frame_id(current_data());
+    nonstd::optional<size_t> sensor_idx = sensor_idx_for_current_packet();
+    if (sensor_idx && is_lidar_packet(*sensor_idx)) {
+        return formats_[*sensor_idx]->frame_id(current_data());
     }
     return nonstd::nullopt;
 }
@@ -52,23 +178,39 @@ bool IndexedPcapReader::frame_id_rolled_over(uint16_t previous,
     return previous > 0xff00 && current < 0x00ff;
 }
 
+bool IndexedPcapReader::is_new_frame(size_t sensor_idx, uint16_t frame_id,
+                                     uint32_t init_id) const {
+    const auto& previous = previous_frame_ids_[sensor_idx];
+    // frame ids restart when the sensor is reinitialized
+    return !previous || init_id != previous_init_ids_[sensor_idx] ||
+           *previous < frame_id || frame_id_rolled_over(*previous, frame_id);
+}
+
+void IndexedPcapReader::add_frame(size_t sensor_idx, uint64_t offset,
+                                  uint64_t timestamp, uint16_t frame_id,
+                                  uint32_t init_id) {
+    index_.frame_indices_[sensor_idx].push_back(offset);
+    index_.frame_timestamp_indices_[sensor_idx].insert({timestamp, offset});
+    index_.frame_id_indices_[sensor_idx].insert({frame_id, offset});
+    previous_frame_ids_[sensor_idx] = frame_id;
+    previous_init_ids_[sensor_idx] = init_id;
+}
+
+void IndexedPcapReader::reset_frame_ids() {
+    for (auto& frame_id : previous_frame_ids_) frame_id = nonstd::nullopt;
+    previous_init_ids_.assign(previous_init_ids_.size(), 0);
+}
+
 int IndexedPcapReader::update_index_for_current_packet() {
-    if (nonstd::optional<size_t> sensor_info_idx =
-            sensor_idx_for_current_packet()) {
-        if (nonstd::optional<uint16_t> frame_id = current_frame_id()) {
-            if (!previous_frame_ids_[*sensor_info_idx] ||
-                *previous_frame_ids_[*sensor_info_idx] < *frame_id ||
-                frame_id_rolled_over(*previous_frame_ids_[*sensor_info_idx],
-                                     *frame_id)) {
-                index_.frame_indices_[*sensor_info_idx].push_back(
-                    current_info().file_offset);
-                index_.frame_timestamp_indices_[*sensor_info_idx].insert(
-                    {current_info().timestamp.count(),
-                     current_info().file_offset});
-                index_.frame_id_indices_[*sensor_info_idx].insert(
-                    {*frame_id, current_info().file_offset});
-                previous_frame_ids_[*sensor_info_idx] = *frame_id;
-            }
+    nonstd::optional<size_t> sensor_info_idx = sensor_idx_for_current_packet();
+    if (sensor_info_idx && is_lidar_packet(*sensor_info_idx)) {
+        const size_t i = *sensor_info_idx;
+        const uint8_t* buf = current_data();
+        const uint16_t frame_id = formats_[i]->frame_id(buf);
+        const uint32_t init_id = formats_[i]->init_id(buf);
+        if (is_new_frame(i, frame_id, init_id)) {
+            add_frame(i, current_info().file_offset,
+                      current_info().timestamp.count(), frame_id, init_id);
         }
     }
 
@@ -76,11 +218,270 @@ int IndexedPcapReader::update_index_for_current_packet() {
                             file_size());
 }
 
-void IndexedPcapReader::build_index() {
+size_t IndexedPcapReader::build_index(unsigned int n_threads) {
+    reset();
+    const uint64_t start = static_cast<uint64_t>(current_offset());
+    const uint64_t size = static_cast<uint64_t>(file_size());
+    const uint64_t length = size > start ? size - start : 0;
+
+    uint64_t n_ranges = n_threads;
+    if (n_threads == 0) {
+        n_ranges = std::min<uint64_t>(
+            std::max(1u, std::thread::hardware_concurrency()),
+            length / MIN_INDEX_RANGE);
+    }
+    n_ranges = std::min(n_ranges, length);
+    // a range reader would walk the pcapng blocks from the start of the file
+    // to find the section and interfaces of its first packet
+    if (is_pcapng()) n_ranges = 1;
+
+    index_.clear();
+    reset_frame_ids();
+    if (n_ranges > 1 && build_index_parallel(n_ranges)) {
+        reset();
+        return n_ranges;
+    }
+
+    // a single range, or the ranges didn't line up or missed fragments
     index_.clear();
+    reset_frame_ids();
     reset();
     while (next_packet() != 0) update_index_for_current_packet();
     reset();
+    return 1;
+}
+
+bool IndexedPcapReader::build_index_parallel(size_t n_ranges) {
+    reset();
+    const uint64_t start = static_cast<uint64_t>(current_offset());
+    const uint64_t size = static_cast<uint64_t>(file_size());
+
+    // ranges are read from read_from[i] to reassemble the packets
+    // fragmented across bounds[i]
+    std::vector<uint64_t> bounds(n_ranges + 1, size);
+    std::vector<uint64_t> read_from(n_ranges, start);
+    bounds[0] = start;
+    for (size_t i = 1; i < n_ranges; ++i) {
+        const uint64_t offset = start + (size - start) / n_ranges * i;
+        bounds[i] = std::max(bounds[i - 1], next_record_offset(offset));
+        if (bounds[i] - start > INDEX_RANGE_LOOKBACK) {
+            const uint64_t lookback = bounds[i] - INDEX_RANGE_LOOKBACK;
+            read_from[i] = std::min(bounds[i], next_record_offset(lookback));
+        }
+    }
+
+    std::vector<range_index> ranges(n_ranges);
+    std::vector<std::exception_ptr> errors(n_ranges);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n_ranges; ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                IndexedPcapReader reader(pcap_filename_, sensor_infos_);
+                reader.index_range(read_from[i], bounds[i], bounds[i + 1],
+                                   ranges[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+
+    // each range must start with the packet the one before stopped at, or
+    // records were skipped resyncing
+    for (size_t i = 1; i < n_ranges; ++i) {
+        if (ranges[i].first_offset != ranges[i - 1].next_offset) return false;
+    }
+
+    // and must have read all the fragments of the datagrams in progress at
+    // its start. A range read from the middle of a datagram can't complete
+    // it, so its datagrams in progress are only known to be read from their
+    // first fragment if they started in the range, or if the range before
+    // had them in progress from the same fragment.
+    std::vector<uint64_t> pending;
+    for (size_t i = 0; i + 1 < n_ranges; ++i) {
+        std::vector<uint64_t> whole;
+        for (uint64_t offset : ranges[i].pending_offsets) {
+            if (offset >= bounds[i] ||
+                std::binary_search(pending.begin(), pending.end(), offset)) {
+                if (offset < read_from[i + 1]) return false;
+                whole.push_back(offset);
+            }
+        }
+        pending = std::move(whole);
+    }
+
+    // in file order, consecutive packets of the same frame were dropped by
+    // the ranges and wouldn't start a frame either
+    for (const range_index& range : ranges) {
+        for (size_t s = 0; s < range.frames.size(); ++s) {
+            for (const auto& f : range.frames[s]) {
+                if (is_new_frame(s, f.frame_id, f.init_id)) {
+                    add_frame(s, f.offset, f.timestamp, f.frame_id, f.init_id);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void IndexedPcapReader::index_range(uint64_t read_from, uint64_t begin,
+                                    uint64_t end, range_index& result) {
+    const uint64_t size = static_cast<uint64_t>(file_size());
+    result.frames.assign(sensor_infos_.size(), {});
+    result.first_offset = size;
+    result.next_offset = size;
+
+    // frame_id and init_id of the previous packet of each sensor
+    std::vector<nonstd::optional<std::pair<uint16_t, uint32_t>>> previous(
+        sensor_infos_.size());
+    bool first = true;
+    seek(read_from);
+    while (next_packet() != 0) {
+        const uint64_t offset = current_info().file_offset;
+        if (offset < begin) continue;
+        if (first) {
+            result.first_offset = offset;
+            first = false;
+        }
+        if (offset >= end) {
+            result.next_offset = offset;
+            result.pending_offsets = pending_fragment_offsets();
+            break;
+        }
+
+        nonstd::optional<size_t> sensor_idx = sensor_idx_for_current_packet();
+        if (!sensor_idx || !is_lidar_packet(*sensor_idx)) continue;
+        const size_t i = *sensor_idx;
+        const std::pair<uint16_t, uint32_t> ids{
+            formats_[i]->frame_id(current_data()),
+            formats_[i]->init_id(current_data())};
+        if (previous[i] && *previous[i] == ids) continue;
+        previous[i] = ids;
+        result.frames[i].push_back(
+            {offset, static_cast<uint64_t>(current_info().timestamp.count()),
+             ids.first, ids.second});
+    }
+}
+
+uint64_t IndexedPcapReader::sensors_key() const {
+    uint64_t h = 0xcbf29ce484222325;
+    for (const auto& info : sensor_infos_) {
+        const int64_t fields[] = {
+            info.config.udp_port_lidar ? *info.config.udp_port_lidar : -1,
+            static_cast<int64_t>(info.format.udp_profile_lidar),
+            static_cast<int64_t>(info.format.pixels_per_column),
+            static_cast<int64_t>(info.format.columns_per_packet)};
+        hash_bytes(h, fields, sizeof(fields));
+        hash_bytes(h, info.sn.data(), info.sn.size() + 1);
+    }
+    return h;
+}
+
+bool IndexedPcapReader::load_index(const std::string& index_file) {
+    file_stat pcap;
+    if (!stat_file(pcap_filename_, pcap)) return false;
+    std::ifstream in(index_file, std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> buf((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+
+    size_t pos = 0;
+    char magic[sizeof(INDEX_FILE_MAGIC)];
+    uint32_t version, n_sensors;
+    uint64_t size, key;
+    int64_t mtime_ns;
+    if (!get(buf, pos, magic) || !get(buf, pos, version) ||
+        !get(buf, pos, n_sensors) || !get(buf, pos, size) ||
+        !get(buf, pos, mtime_ns) || !get(buf, pos, key)) {
+        return false;
+    }
+    if (std::memcmp(magic, INDEX_FILE_MAGIC, sizeof(magic)) != 0 ||
+        version != INDEX_FILE_VERSION || n_sensors != sensor_infos_.size() ||
+        size != pcap.size || mtime_ns != pcap.mtime_ns ||
+        key != sensors_key()) {
+        return false;
+    }
+
+    PcapIndex index(n_sensors);
+    for (uint32_t s = 0; s < n_sensors; ++s) {
+        uint64_t n;
+        if (!get(buf, pos, n) || n > (buf.size() - pos) / 8) return false;
+        index.frame_indices_[s].resize(n);
+        for (auto& offset : index.frame_indices_[s]) get(buf, pos, offset);
+
+        if (!get(buf, pos, n) || n > (buf.size() - pos) / 16) return false;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t ts = 0, offset = 0;
+            get(buf, pos, ts);
+            get(buf, pos, offset);
+            index.frame_timestamp_indices_[s].insert({ts, offset});
+        }
+
+        if (!get(buf, pos, n) || n > (buf.size() - pos) / 12) return false;
+        for (uint64_t i = 0; i < n; ++i) {
+            int32_t frame_id = 0;
+            uint64_t offset = 0;
+            get(buf, pos, frame_id);
+            get(buf, pos, offset);
+            index.frame_id_indices_[s].insert({frame_id, offset});
+        }
+    }
+    if (pos != buf.size()) return false;
+
+    index_ = std::move(index);
+    reset_frame_ids();
+    return true;
+}
+
+void IndexedPcapReader::save_index(const std::string& index_file) const {
+    file_stat pcap;
+    if (!stat_file(pcap_filename_, pcap)) {
+        throw std::runtime_error("pcap: can't stat file " + pcap_filename_);
+    }
+
+    std::vector<uint8_t> buf(INDEX_FILE_MAGIC,
+                             INDEX_FILE_MAGIC + sizeof(INDEX_FILE_MAGIC));
+    put(buf, INDEX_FILE_VERSION);
+    put(buf, static_cast<uint32_t>(sensor_infos_.size()));
+    put(buf, pcap.size);
+    put(buf, pcap.mtime_ns);
+    put(buf, sensors_key());
+    for (size_t s = 0; s < sensor_infos_.size(); ++s) {
+        put(buf, static_cast<uint64_t>(index_.frame_indices_[s].size()));
+        for (uint64_t offset : index_.frame_indices_[s]) put(buf, offset);
+        put(buf,
+            static_cast<uint64_t>(index_.frame_timestamp_indices_[s].size()));
+        for (const auto& kv : index_.frame_timestamp_indices_[s]) {
+            put(buf, kv.first);
+            put(buf, kv.second);
+        }
+        put(buf, static_cast<uint64_t>(index_.frame_id_indices_[s].size()));
+        for (const auto& kv : index_.frame_id_indices_[s]) {
+            put(buf, kv.first);
+            put(buf, kv.second);
+        }
+    }
+
+    // write next to it and rename, not to leave a partial index behind
+    const std::string tmp_file = index_file + ".tmp";
+    {
+        std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(buf.data()), buf.size());
+        if (!out) {
+            std::remove(tmp_file.c_str());
+            throw std::runtime_error("pcap: can't write index " + index_file);
+        }
+    }
+#if defined _WIN32
+    std::remove(index_file.c_str());
+#endif
+    if (std::rename(tmp_file.c_str(), index_file.c_str()) != 0) {
+        std::remove(tmp_file.c_str());
+        throw std::runtime_error("pcap: can't write index " + index_file);
+    }
 }
 
 const PcapIndex& IndexedPcapReader::get_index() const { return index_; }
@@ -1,238 +1,156 @@
-/*
- * Copyright (c) 2017, Matias Fontanini
+/**
+ * Copyright (c) 2024, Ouster, Inc.
  * All rights reserved.
- *
- * Redistribution and use in source and binary forms, with or without
- * modification, are permitted provided that the following conditions are
- * met:
- *
- * * Redistributions of source code must retain the above copyright
- *   notice, this list of conditions and the following disclaimer.
- * * Redistributions in binary form must reproduce the above
- *   copyright notice, this list of conditions and the following disclaimer
- *   in the documentation and/or other materials provided with the
- *   distribution.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
- * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
- * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
- * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
- * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
- * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
- * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
- * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- *
  */
 
 #include "ip_reassembler.h"
 
-#include <tins/arp.h>
-#include <tins/constants.h>
-#include <tins/detail/pdu_helpers.h>
-#include <tins/dot11/dot11_base.h>
-#include <tins/dot1q.h>
-#include <tins/eapol.h>
-#include <tins/ethernetII.h>
-#include <tins/icmp.h>
-#include <tins/icmpv6.h>
-#include <tins/ieee802_3.h>
-#include <tins/ip.h>
-#include <tins/ipsec.h>
-#include <tins/ipv6.h>
-#include <tins/loopback.h>
-#include <tins/mpls.h>
-#include <tins/pdu_allocator.h>
-#include <tins/ppi.h>
-#include <tins/pppoe.h>
-#include <tins/radiotap.h>
-#include <tins/rawpdu.h>
-#include <tins/sll.h>
-#include <tins/tcp.h>
-#include <tins/udp.h>
-using std::make_pair;
-
-namespace Tins {
-namespace Internals {
+#include <algorithm>
+#include <cstring>
+
+namespace ouster {
+namespace sensor_utils {
+namespace impl {
 
 static const std::chrono::microseconds fragment_timeout(2000000);
 
-IPv4Stream2::IPv4Stream2()
-    : received_size_(), total_size_(), received_end_(false) {}
-
-void IPv4Stream2::add_fragment(const std::chrono::microseconds& timestamp,
-                               IP* ip) {
-    // handle timeout
-    if (fragments_.size()) {
-        if ((timestamp - last_timestamp_) > fragment_timeout) {
-            // if we timed out, clear out all old packets
-            received_size_ = 0;
-            total_size_ = 0;
-            received_end_ = false;
-            fragments_.clear();
-            first_fragment_ = IP();
-        }
-    }
-    last_timestamp_ = timestamp;
+// Reuse the oldest slot if too many datagrams are in flight, we only expect
+// one per lidar in practice
+static constexpr size_t MAX_STREAMS = 100;
+
+constexpr size_t IPv4Reassembler::MAX_DATAGRAM_SIZE;
+constexpr size_t IPv4Reassembler::BLOCK_SIZE;
+constexpr size_t IPv4Reassembler::BITMAP_WORDS;
+
+void IPv4Reassembler::slot::clear() {
+    in_use = false;
+    blocks_received = 0;
+    end = 0;
+    total_size = 0;
+    received_end = false;
+    std::memset(bitmap, 0, sizeof(bitmap));
+}
 
-    const uint16_t offset = extract_offset(ip);
-    fragments_type::iterator it = fragments_.begin();
-    while (it != fragments_.end() && offset > it->offset()) {
-        ++it;
+void IPv4Reassembler::slot::add_fragment(std::chrono::microseconds timestamp,
+                                         uint64_t record_offset,
+                                         const ip_frame& frame) {
+    // if we timed out, clear out all old fragments
+    if (timestamp - last_timestamp > fragment_timeout) {
+        clear();
+        in_use = true;
     }
-    // Replace duplicates
-    if (it != fragments_.end() && it->offset() == offset) {
-        it = fragments_.erase(it);
-        fragments_.insert(it, IPv4Fragment2(ip->inner_pdu(), offset));
-    } else {
-        fragments_.insert(it, IPv4Fragment2(ip->inner_pdu(), offset));
-        received_size_ += ip->inner_pdu()->size();
+    last_timestamp = timestamp;
+    if (blocks_received == 0 || record_offset < first_offset) {
+        first_offset = record_offset;
     }
-    // If the MF flag is not set, this is the end of the packet
-    if ((ip->flags() & IP::MORE_FRAGMENTS) == 0) {
-        total_size_ = offset + ip->inner_pdu()->size();
-        received_end_ = true;
+
+    const size_t offset = frame.frag_offset;
+    const size_t size = frame.payload_size;
+    if (offset + size > MAX_DATAGRAM_SIZE) return;  // bogus, drop it
+
+    // Duplicates just overwrite the same bytes
+    if (size) std::memcpy(buf.get() + offset, frame.payload, size);
+    const size_t last_block = (offset + size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (size_t b = offset / BLOCK_SIZE; b < last_block; ++b) {
+        const uint64_t bit = uint64_t{1} << (b % 64);
+        if (!(bitmap[b / 64] & bit)) {
+            bitmap[b / 64] |= bit;
+            ++blocks_received;
+        }
     }
-    if (offset == 0) {
-        // Release the inner PDU, store this first fragment and restore the
-        // inner PDU
-        PDU* inner_pdu = ip->release_inner_pdu();
-        first_fragment_ = *ip;
-        ip->inner_pdu(inner_pdu);
+    end = std::max(end, offset + size);
+
+    // If the MF flag is not set, this is the end of the packet
+    if (!frame.more_fragments) {
+        total_size = offset + size;
+        received_end = true;
     }
 }
 
-bool IPv4Stream2::is_complete() const {
-    // If we haven't received the last chunk of we haven't received all the
-    // data, then we're not complete
-    if (!received_end_ || received_size_ != total_size_) {
-        return false;
-    }
-    // Make sure the first fragment has offset 0
-    return fragments_.begin()->offset() == 0;
+bool IPv4Reassembler::slot::is_complete() const {
+    // all the blocks up to the end of the last fragment and none past it
+    return received_end && end == total_size &&
+           blocks_received == (total_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
 }
 
-static Tins::PDU* pdu_from_flag2(Constants::IP::e flag, const uint8_t* buffer,
-                                 uint32_t size,
-                                 bool rawpdu_on_no_match = true) {
-    switch (flag) {
-        case Constants::IP::PROTO_IPIP:
-            return new Tins::IP(buffer, size);
-        case Constants::IP::PROTO_TCP:
-            return new Tins::TCP(buffer, size);
-        case Constants::IP::PROTO_UDP:
-            return new Tins::UDP(buffer, size);
-        case Constants::IP::PROTO_ICMP:
-            return new Tins::ICMP(buffer, size);
-        case Constants::IP::PROTO_ICMPV6:
-            return new Tins::ICMPv6(buffer, size);
-        case Constants::IP::PROTO_IPV6:
-            return new Tins::IPv6(buffer, size);
-        case Constants::IP::PROTO_AH:
-            return new Tins::IPSecAH(buffer, size);
-        case Constants::IP::PROTO_ESP:
-            return new Tins::IPSecESP(buffer, size);
-        default:
-            break;
-    }
-    if (rawpdu_on_no_match) {
-        return new Tins::RawPDU(buffer, size);
+IPv4Reassembler::slot& IPv4Reassembler::find_slot(
+    std::chrono::microseconds timestamp, uint16_t id, uint32_t addr_lo,
+    uint32_t addr_hi) {
+    slot* free_slot = nullptr;
+    for (slot& s : slots_) {
+        if (s.in_use && s.id == id && s.addr_lo == addr_lo &&
+            s.addr_hi == addr_hi) {
+            return s;
+        }
+        // drop datagrams that timed out
+        if (s.in_use && timestamp - s.last_timestamp > fragment_timeout) {
+            s.clear();
+        }
+        if (!s.in_use && !free_slot) free_slot = &s;
     }
-    return 0;
-}
 
-PDU* IPv4Stream2::allocate_pdu() const {
-    PDU::serialization_type buffer;
-    buffer.reserve(total_size_);
-    // Check if we actually have all the data we need. Otherwise return nullptr;
-    size_t expected = 0;
-    for (fragments_type::const_iterator it = fragments_.begin();
-         it != fragments_.end(); ++it) {
-        if (expected != it->offset()) {
-            return 0;
+    if (!free_slot) {
+        if (slots_.size() < MAX_STREAMS) {
+            slots_.emplace_back();
+            free_slot = &slots_.back();
+        } else {
+            free_slot = &*std::min_element(
+                slots_.begin(), slots_.end(),
+                [](const slot& a, const slot& b) {
+                    return a.last_timestamp < b.last_timestamp;
+                });
+            free_slot->clear();
         }
-        expected = it->offset() + it->payload().size();
-        buffer.insert(buffer.end(), it->payload().begin(), it->payload().end());
     }
-    return pdu_from_flag2(
-        static_cast<Constants::IP::e>(first_fragment_.protocol()),
-        buffer.empty() ? 0 : &buffer[0], static_cast<uint32_t>(buffer.size()));
+    free_slot->in_use = true;
+    free_slot->id = id;
+    free_slot->addr_lo = addr_lo;
+    free_slot->addr_hi = addr_hi;
+    free_slot->last_timestamp = timestamp;
+    return *free_slot;
 }
 
-const IP& IPv4Stream2::first_fragment() const { return first_fragment_; }
+IPv4Reassembler::PacketStatus IPv4Reassembler::process(
+    std::chrono::microseconds timestamp, uint64_t offset, ip_frame& frame) {
+    if (frame.ip_version != 4 ||
+        (!frame.more_fragments && frame.frag_offset == 0)) {
+        return NOT_FRAGMENTED;
+    }
 
-uint16_t IPv4Stream2::extract_offset(const IP* ip) {
-    return ip->fragment_offset() * 8;
+    uint32_t src, dst;
+    std::memcpy(&src, frame.src_addr, sizeof(src));
+    std::memcpy(&dst, frame.dst_addr, sizeof(dst));
+    slot& s =
+        find_slot(timestamp, frame.id, std::min(src, dst), std::max(src, dst));
+    s.add_fragment(timestamp, offset, frame);
+    if (!s.is_complete()) return FRAGMENTED;
+
+    frame.payload = s.buf.get();
+    frame.payload_size = static_cast<uint32_t>(s.total_size);
+    // The slot is free again, its buffer is only reused by a later call
+    s.clear();
+    frame.frag_offset = 0;
+    frame.more_fragments = false;
+    return REASSEMBLED;
 }
 
-}  // namespace Internals
-
-IPv4Reassembler2::IPv4Reassembler2() : technique_(NONE) {}
-
-IPv4Reassembler2::IPv4Reassembler2(OverlappingTechnique technique)
-    : technique_(technique) {}
-
-IPv4Reassembler2::PacketStatus IPv4Reassembler2::process(
-    const std::chrono::microseconds& timestamp, PDU& pdu) {
-    IP* ip = pdu.find_pdu<IP>();
-    if (ip && ip->inner_pdu()) {
-        // There's fragmentation
-        if (ip->is_fragmented()) {
-            key_type key = make_key(ip);
-            // Delete old streams if too many build up, we only expect one per
-            // lidar in practice We just want to keep from building up too much
-            // memory If we didnt do this we could end up with 99 MB or so in
-            // junk worst case
-            if (streams_.size() > 100) {
-                for (auto it = streams_.cbegin(); it != streams_.cend();) {
-                    auto age = timestamp - it->second.last_timestamp_;
-                    if (age > Tins::Internals::fragment_timeout) {
-                        it = streams_.erase(it);
-                    } else {
-                        ++it;
-                    }
-                }
-            }
-            // Create it or look it up, it's the same
-            Internals::IPv4Stream2& stream = streams_[key];
-            stream.add_fragment(timestamp, ip);
-            if (stream.is_complete()) {
-                PDU* pdu = stream.allocate_pdu();
-                // Use all field values from the first fragment
-                *ip = stream.first_fragment();
-
-                // Erase this stream, since it's already assembled
-                streams_.erase(key);
-                // The packet is corrupt
-                if (!pdu) {
-                    return FRAGMENTED;
-                }
-                ip->inner_pdu(pdu);
-                ip->fragment_offset(0);
-                ip->flags(static_cast<IP::Flags>(0));
-                return REASSEMBLED;
-            } else {
-                return FRAGMENTED;
-            }
+std::vector<uint64_t> IPv4Reassembler::pending_offsets(
+    std::chrono::microseconds timestamp) const {
+    std::vector<uint64_t> offsets;
+    for (const slot& s : slots_) {
+        if (s.in_use && s.blocks_received > 0 &&
+            timestamp - s.last_timestamp <= fragment_timeout) {
+            offsets.push_back(s.first_offset);
         }
     }
-    return NOT_FRAGMENTED;
-}
-
-IPv4Reassembler2::key_type IPv4Reassembler2::make_key(const IP* ip) const {
-    return make_pair(ip->id(),
-                     make_address_pair(ip->src_addr(), ip->dst_addr()));
+    std::sort(offsets.begin(), offsets.end());
+    return offsets;
 }
 
-IPv4Reassembler2::address_pair IPv4Reassembler2::make_address_pair(
-    IPv4Address addr1, IPv4Address addr2) const {
-    if (addr1 < addr2) {
-        return make_pair(addr1, addr2);
-    } else {
-        return make_pair(addr2, addr1);
-    }
+void IPv4Reassembler::clear() {
+    for (slot& s : slots_) s.clear();
 }
 
-}  // namespace Tins
+}  // namespace impl
+}  // namespace sensor_utils
+}  // namespace ouster
@@ -1,125 +1,34 @@
-/*
- * Copyright (c) 2017, Matias Fontanini
+/**
+ * Copyright (c) 2024, Ouster, Inc.
  * All rights reserved.
- *
- * Redistribution and use in source and binary forms, with or without
- * modification, are permitted provided that the following conditions are
- * met:
- *
- * * Redistributions of source code must retain the above copyright
- *   notice, this list of conditions and the following disclaimer.
- * * Redistributions in binary form must reproduce the above
- *   copyright notice, this list of conditions and the following disclaimer
- *   in the documentation and/or other materials provided with the
- *   distribution.
- *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
- * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
- * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
- * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
- * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
- * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
- * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
- * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- *
  */
 
-#ifndef TINS_IP_REASSEMBLER2_H
-#define TINS_IP_REASSEMBLER2_H
-
-#include <tins/ip.h>
-#include <tins/ip_address.h>
-#include <tins/macros.h>
-#include <tins/pdu.h>
+#pragma once
 
 #include <chrono>
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
-namespace Tins {
-
-/**
- * \cond
- */
-namespace Internals {
-class IPv4Fragment2 {
-   public:
-    typedef PDU::serialization_type payload_type;
-
-    IPv4Fragment2() : offset_() {}
-
-    template <typename T>
-    IPv4Fragment2(T* pdu, uint16_t offset)
-        : payload_(pdu->serialize()), offset_(offset) {}
-
-    const payload_type& payload() const { return payload_; }
-
-    uint16_t offset() const { return offset_; }
-
-   private:
-    payload_type payload_;
-    uint16_t offset_;
-};
-
-class IPv4Stream2 {
-   public:
-    IPv4Stream2();
-
-    std::chrono::microseconds last_timestamp_;
+#include "pcap_file.h"
 
-    void add_fragment(const std::chrono::microseconds& timestamp, IP* ip);
-    bool is_complete() const;
-    PDU* allocate_pdu() const;
-    const IP& first_fragment() const;
-
-   private:
-    typedef std::vector<IPv4Fragment2> fragments_type;
-
-    uint16_t extract_offset(const IP* ip);
-    bool extract_more_frag(const IP* ip);
-
-    fragments_type fragments_;
-    size_t received_size_;
-    size_t total_size_;
-    IP first_fragment_;
-    bool received_end_;
-};
-}  // namespace Internals
+namespace ouster {
+namespace sensor_utils {
+namespace impl {
 
 /**
- * \endcond
- */
-
-/**
- * \brief Reassembles fragmented IP packets.
+ * Reassembles fragmented IPv4 datagrams.
  *
- * This class is fairly simple: just feed packets into it using
- * IPv4Reassembler::process. If the return value is IPv4Reassembler::FRAGMENTED,
- * then the packet is fragmented and we haven't yet seen the missing fragments,
- * hence we can't reassemble it. If the function returns either
- * IPv4Reassembler::NOT_FRAGMENTED (meaning the packet wasn't fragmented) or
- * IPv4Reassembler::REASSEMBLED (meaning the packet was fragmented but it's now
- * reassembled), then you can process the packet normally.
+ * Each datagram in progress gets a slot from a pool, with a buffer of the
+ * maximum datagram size that fragments are copied into at their offsets
+ * and a bitmap of the 8 byte blocks received. Slots are reused, so once
+ * the pool has grown to the number of datagrams in flight no allocation
+ * happens.
  *
- * Simple example:
- *
- * \code
- * IPv4Reassembler reassembler;
- * Sniffer sniffer = ...;
- * sniffer.sniff_loop([&](PDU& pdu) {
- *     // Process it in any case, unless it's fragmented (and can't be
- * reassembled yet) if (reassembler.process(pdu) != IPv4Reassembler::FRAGMENTED)
- * {
- *         // Now actually process the packet
- *         process_packet(pdu);
- *     }
- * });
- * \endcode
+ * Incomplete datagrams are dropped when no fragment arrives for 2 seconds,
+ * duplicated fragments replace the previous ones.
  */
-class IPv4Reassembler2 {
+class IPv4Reassembler {
    public:
     /**
      * The status of each processed packet.
@@ -131,56 +40,69 @@ class IPv4Reassembler2 {
         REASSEMBLED  ///< The given packet was fragmented but is now reassembled
     };
 
-    TINS_DEPRECATED(typedef PacketStatus packet_status);
-
     /**
-     * The type used to represent the overlapped segment reassembly
-     * technique to be used.
-     */
-    enum OverlappingTechnique { NONE, REPLACE };
-
-    /**
-     * Default constructor
+     * Process a packet and try to reassemble it.
+     *
+     * When REASSEMBLED is returned, frame.payload and frame.payload_size are
+     * replaced by the span of the reassembled datagram, which is valid until
+     * the next call.
+     *
+     * @param[in] timestamp The packet capture timestamp, used for timeouts.
+     * @param[in] offset File offset of the packet record.
+     * @param[in,out] frame The packet.
+     * @return The status of the packet.
      */
-    IPv4Reassembler2();
+    PacketStatus process(std::chrono::microseconds timestamp, uint64_t offset,
+                         ip_frame& frame);
 
     /**
-     * Constructs an IPV4Reassembler.
+     * Find the datagrams still in progress, that a later fragment could
+     * complete.
      *
-     * \param technique The technique to be used for reassembling
-     * overlapped fragments.
+     * @param[in] timestamp The current capture timestamp, datagrams timed out
+     * by then are left out.
+     * @return File offsets of the earliest fragment record of each datagram,
+     * sorted.
      */
-    IPv4Reassembler2(OverlappingTechnique technique);
+    std::vector<uint64_t> pending_offsets(
+        std::chrono::microseconds timestamp) const;
 
     /**
-     * \brief Processes a PDU and tries to reassemble it.
-     *
-     * This method tries to reassemble the provided packet. If
-     * the packet is successfully reassembled using previously
-     * processed packets, its contents will be modified so that
-     * it contains the whole payload and not just a fragment.
-     *
-     * \param timestamp The timestamp of the packet. Used for timeouts.
-     * \param pdu The PDU to process.
-     * \return NOT_FRAGMENTED if the PDU does not contain an IP
-     * layer or is not fragmented, FRAGMENTED if the packet is
-     * fragmented or REASSEMBLED if the packet was fragmented
-     * but has now been reassembled.
+     * Drop the datagrams in progress, keeping the pool.
      */
-    PacketStatus process(const std::chrono::microseconds& timestamp, PDU& pdu);
+    void clear();
 
    private:
-    typedef std::pair<IPv4Address, IPv4Address> address_pair;
-    typedef std::pair<uint16_t, address_pair> key_type;
-    typedef std::map<key_type, Internals::IPv4Stream2> streams_type;
+    static constexpr size_t MAX_DATAGRAM_SIZE = 65536;
+    static constexpr size_t BLOCK_SIZE = 8;  ///< fragment offset unit
+    static constexpr size_t BITMAP_WORDS = MAX_DATAGRAM_SIZE / BLOCK_SIZE / 64;
+
+    struct slot {
+        bool in_use{false};
+        uint16_t id{0};
+        uint32_t addr_lo{0};  ///< smaller of the source and destination
+        uint32_t addr_hi{0};
+        std::chrono::microseconds last_timestamp{0};
+        uint64_t first_offset{0};  ///< file offset of the earliest fragment
+        size_t blocks_received{0};
+        size_t end{0};         ///< end of the furthest fragment received
+        size_t total_size{0};  ///< known once the last fragment arrived
+        bool received_end{false};
+        uint64_t bitmap[BITMAP_WORDS]{};
+        std::unique_ptr<uint8_t[]> buf{new uint8_t[MAX_DATAGRAM_SIZE]};
+
+        void clear();
+        void add_fragment(std::chrono::microseconds timestamp,
+                          uint64_t offset, const ip_frame& frame);
+        bool is_complete() const;
+    };
 
-    key_type make_key(const IP* ip) const;
-    address_pair make_address_pair(IPv4Address addr1, IPv4Address addr2) const;
+    slot& find_slot(std::chrono::microseconds timestamp, uint16_t id,
+                    uint32_t addr_lo, uint32_t addr_hi);
 
-    streams_type streams_;
-    OverlappingTechnique technique_;
+    std::vector<slot> slots_{};
 };
 
-}  // namespace Tins
-
-#endif  // TINS_IP_REASSEMBLER2_H
+}  // namespace impl
+}  // namespace sensor_utils
+}  // namespace ouster
@@ -285,8 +285,8 @@ std::vector<guessed_ports> guess_ports(stream_info& info,
 
     std::vector<stream_key> lidar_keys;
     std::vector<stream_key> imu_keys;
-    std::vector<std::string> lidar_src_ips;
-    std::vector<std::string> imu_src_ips;
+    std::vector<ip_address> lidar_src_ips;
+    std::vector<ip_address> imu_src_ips;
 
     for (auto it : info.udp_streams) {
         if (it.second.payload_size_counts.count(lidar_packet_sizes) > 0) {
@@ -5,25 +5,15 @@
  * @todo check that the header casting is idiomatic libpcap
  * @todo warn on dropped packets when pcap contains garbage, when fragments
  * missing, buffer reused before sending
- * @todo split up reading / playback
  * @todo improve error reporting
  */
 
-#define _FILE_OFFSET_BITS 64
 #include "ouster/pcap.h"
 
 #if defined _WIN32
 #include <winsock2.h>
-#define FTELL _ftelli64
-#define FSEEK _fseeki64
-#elif defined __EMSCRIPTEN__
-#define FTELL ftell
-#define FSEEK fseek
-#else
-#include <arpa/inet.h>  // inet_ntop
-#include <sys/time.h>   // timeval
-#define FTELL ftello
-#define FSEEK fseeko
+#elif !defined __EMSCRIPTEN__
+#include <sys/time.h>  // timeval
 #endif
 
 #include <pcap.h>
@@ -38,11 +28,8 @@
 
 #include <chrono>
 #include <cstring>
-#include <fstream>
 #include <stdexcept>
 
-#include "ip_reassembler.h"
-
 using us = std::chrono::microseconds;
 using timepoint = std::chrono::system_clock::time_point;
 using namespace Tins;
@@ -53,17 +40,6 @@ static constexpr int PROTOCOL_UDP = 17;
 namespace ouster {
 namespace sensor_utils {
 
-struct pcap_impl {
-    pcap_t* handle;
-    std::unique_ptr<Tins::FileSniffer>
-        pcap_reader;  ///< Object that holds the unified pcap reader
-    FILE* pcap_reader_internals;
-    Tins::Packet packet_cache;
-    IPv4Reassembler2 reassembler;  ///< The reassembler mainly for lidar packets
-    bool have_new_packet;
-    int encap_proto;
-};
-
 struct pcap_writer_impl {
     pcap_t* handle;
     pcap_dumper* dumper;
@@ -71,116 +47,6 @@ struct pcap_writer_impl {
         pcap_file_writer;  ///< Object that holds the pcap writer
 };
 
-PcapReader::PcapReader(const std::string& file) : impl(new pcap_impl) {
-    std::ifstream fileSizeStream(file, std::ios::binary);
-    if (fileSizeStream) {
-        fileSizeStream.seekg(0, std::ios::end);
-        file_size_ = fileSizeStream.tellg();
-    }
-    impl->pcap_reader = std::make_unique<Tins::FileSniffer>(file);
-    impl->encap_proto = impl->pcap_reader->link_type();
-    impl->pcap_reader_internals =
-        pcap_file(impl->pcap_reader->get_pcap_handle());
-    file_start_ = FTELL(impl->pcap_reader_internals);
-}
-
-PcapReader::~PcapReader() {}
-
-const uint8_t* PcapReader::current_data() const { return data; }
-
-size_t PcapReader::current_length() const { return info.payload_size; }
-
-const packet_info& PcapReader::current_info() const { return info; }
-
-void PcapReader::seek(uint64_t offset) {
-    if (offset < sizeof(struct pcap_file_header)) {
-        offset = sizeof(struct pcap_file_header);
-    }
-    if (FSEEK(impl->pcap_reader_internals, offset, SEEK_SET)) {
-        throw std::runtime_error("pcap seek failed");
-    }
-}
-
-int64_t PcapReader::file_size() const { return file_size_; }
-
-int64_t PcapReader::current_offset() const {
-    int64_t ret = FTELL(impl->pcap_reader_internals);
-
-    if (ret == -1L) {
-        fclose(impl->pcap_reader_internals);
-        throw std::runtime_error("ftell error: errno " + std::to_string(errno));
-    }
-    return ret;
-}
-
-void PcapReader::reset() { seek(file_start_); }
-
-size_t PcapReader::next_packet() {
-    size_t result = 0;
-
-    bool reassm = false;
-    int reassm_packets = 0;
-    while (!reassm) {
-        reassm_packets++;
-        info.file_offset = current_offset();
-        impl->packet_cache = impl->pcap_reader->next_packet();
-        if (impl->packet_cache) {
-            auto pdu = impl->packet_cache.pdu();
-            if (pdu) {
-                info.packet_size = pdu->size();
-                IP* ip = pdu->find_pdu<IP>();
-                IPv6* ipv6 = pdu->find_pdu<IPv6>();
-                // Using short circuiting here
-                if ((ip && ip->protocol() == PROTOCOL_UDP) ||
-                    (ipv6 && ipv6->next_header() == PROTOCOL_UDP)) {
-                    // reassm is also used in the while loop
-                    reassm = (impl->reassembler.process(
-                                  impl->packet_cache.timestamp(), *pdu) !=
-                              IPv4Reassembler2::FRAGMENTED);
-                    if (reassm) {
-                        info.fragments_in_packet = reassm_packets;
-                        info.encapsulation_protocol = impl->encap_proto;
-
-                        if (ip) {
-                            info.dst_ip = ip->dst_addr().to_string();
-                            info.src_ip = ip->src_addr().to_string();
-                            info.ip_version = 4;
-                            info.network_protocol = ip->protocol();
-                        } else if (ipv6) {
-                            info.dst_ip = ipv6->dst_addr().to_string();
-                            info.src_ip = ipv6->src_addr().to_string();
-                            info.ip_version = 6;
-                            info.network_protocol = ipv6->next_header();
-                        }
-
-                        // find_pdu<UDP> will only return NULL when the ipv4
-                        // reassembly succeeds on an ipv6 packet, leading to a
-                        // malformed packet
-                        UDP* udp = pdu->find_pdu<UDP>();
-                        if (udp != nullptr) {
-                            auto raw = pdu->find_pdu<RawPDU>();
-                            info.dst_port = udp->dport();
-                            info.src_port = udp->sport();
-                            info.payload_size = raw->payload_size();
-                            result = info.payload_size;
-                            data = (uint8_t*)&(raw->payload()[0]);
-                            info.timestamp = impl->packet_cache.timestamp();
-                            impl->have_new_packet = true;
-                        } else {
-                            throw std::runtime_error(
-                                "Malformed Packet: No UDP Detected");
-                        }
-                    }
-                }
-            }
-        } else {
-            reassm = true;
-        }
-    }
-
-    return result;
-}
-
 PcapWriter::PcapWriter(
     const std::string& file,
     PcapWriter::PacketEncapsulation encap = PcapWriter::ETHERNET,
@@ -363,8 +229,9 @@ void PcapWriter::write_packet(const uint8_t* buf, size_t buf_size,
 
 void PcapWriter::write_packet(const uint8_t* buf, size_t buf_size,
                               const packet_info& info) {
-    write_packet(buf, buf_size, info.src_ip, info.dst_ip, info.src_port,
-                 info.dst_port, info.timestamp);
+    write_packet(buf, buf_size, info.src_ip.to_string(),
+                 info.dst_ip.to_string(), info.src_port, info.dst_port,
+                 info.timestamp);
 }
 
 }  // namespace sensor_utils
@@ -0,0 +1,602 @@
+/**
+ * Copyright (c) 2024, Ouster, Inc.
+ * All rights reserved.
+ */
+
+#include "pcap_file.h"
+
+#if defined _WIN32
+#include <windows.h>
+#elif defined __EMSCRIPTEN__
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace ouster {
+namespace sensor_utils {
+namespace impl {
+
+namespace {
+
+constexpr uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+constexpr uint64_t PCAP_FILE_HEADER_SIZE = 24;
+constexpr uint64_t PCAP_RECORD_HEADER_SIZE = 16;
+
+constexpr uint32_t PCAPNG_SHB = 0x0a0d0d0a;
+constexpr uint32_t PCAPNG_IDB = 0x00000001;
+constexpr uint32_t PCAPNG_PB = 0x00000002;  // obsolete Packet Block
+constexpr uint32_t PCAPNG_SPB = 0x00000003;
+constexpr uint32_t PCAPNG_EPB = 0x00000006;
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+constexpr uint16_t PCAPNG_OPT_END = 0;
+constexpr uint16_t PCAPNG_OPT_IF_TSRESOL = 9;
+
+// the largest snaplen libpcap accepts, anything bigger is garbage
+constexpr uint32_t MAX_CAPLEN = 262144;
+
+// consecutive record headers to check when looking for a record boundary
+constexpr int RESYNC_RECORDS = 16;
+// largest gap between the timestamps of consecutive records when resyncing
+constexpr uint32_t RESYNC_MAX_GAP_S = 3600;
+
+constexpr int LINKTYPE_NULL = 0;
+constexpr int LINKTYPE_ETHERNET = 1;
+constexpr int LINKTYPE_RAW = 101;
+constexpr int DLT_RAW = 12;
+constexpr int DLT_RAW_OPENBSD = 14;
+constexpr int LINKTYPE_LOOP = 108;
+constexpr int LINKTYPE_LINUX_SLL = 113;
+constexpr int LINKTYPE_IPV4 = 228;
+constexpr int LINKTYPE_IPV6 = 229;
+constexpr int LINKTYPE_LINUX_SLL2 = 276;
+
+constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint16_t ETHERTYPE_IPV6 = 0x86dd;
+constexpr uint16_t ETHERTYPE_VLAN = 0x8100;
+constexpr uint16_t ETHERTYPE_QINQ = 0x88a8;
+constexpr uint16_t ETHERTYPE_QINQ_OLD = 0x9100;
+
+constexpr uint32_t IPV4_HEADER_SIZE = 20;
+constexpr uint32_t IPV6_HEADER_SIZE = 40;
+
+// IPv6 extension headers that may come before the upper layer header
+constexpr int IPV6_HOP_BY_HOP = 0;
+constexpr int IPV6_ROUTING = 43;
+constexpr int IPV6_FRAGMENT = 44;
+constexpr int IPV6_DEST_OPTS = 60;
+constexpr uint32_t IPV6_FRAGMENT_HEADER_SIZE = 8;
+
+inline uint16_t load_u16(const uint8_t* p) {
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint16_t swap16(uint16_t v) {
+    return static_cast<uint16_t>((v >> 8) | (v << 8));
+}
+
+inline uint32_t swap32(uint32_t v) {
+    return ((v >> 24) & 0xff) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) |
+           (v << 24);
+}
+
+// network byte order
+inline uint16_t be16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// timestamp in units per second to microseconds
+inline std::chrono::microseconds to_us(uint64_t ts, uint64_t units) {
+    constexpr uint64_t US = 1000000;
+    if (units == US) return std::chrono::microseconds{ts};
+    if (units > US && units % US == 0)
+        return std::chrono::microseconds{ts / (units / US)};
+    return std::chrono::microseconds{ts / units * US +
+                                     (ts % units) * US / units};
+}
+
+}  // namespace
+
+// ==========================================================
+// ========= MappedFile =====================================
+// ==========================================================
+
+MappedFile::MappedFile(const std::string& path) {
+#if defined _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("pcap: can't open file " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("pcap: can't get the size of " + path);
+    }
+    size_ = static_cast<uint64_t>(size.QuadPart);
+    if (size_ > 0) {
+        HANDLE mapping =
+            CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            data_ = static_cast<const uint8_t*>(
+                MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        if (data_ == nullptr) {
+            CloseHandle(file);
+            throw std::runtime_error("pcap: can't map file " + path);
+        }
+        mapped_ = true;
+    }
+    CloseHandle(file);
+#elif defined __EMSCRIPTEN__
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) throw std::runtime_error("pcap: can't open file " + path);
+    buf_.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buf_.data()), buf_.size())) {
+        throw std::runtime_error("pcap: can't read file " + path);
+    }
+    data_ = buf_.data();
+    size_ = buf_.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("pcap: can't open file " + path);
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw std::runtime_error("pcap: not a regular file " + path);
+    }
+    size_ = static_cast<uint64_t>(st.st_size);
+    if (size_ > std::numeric_limits<size_t>::max()) {
+        ::close(fd);
+        throw std::runtime_error("pcap: file too big to map " + path);
+    }
+    if (size_ > 0) {
+        void* addr = mmap(nullptr, static_cast<size_t>(size_), PROT_READ,
+                          MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("pcap: can't map file " + path);
+        }
+        // packets are mostly read front to back
+        madvise(addr, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t*>(addr);
+        mapped_ = true;
+    }
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    if (!mapped_) return;
+#if defined _WIN32
+    UnmapViewOfFile(data_);
+#elif !defined __EMSCRIPTEN__
+    munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+#endif
+}
+
+// ==========================================================
+// ========= PcapFile =======================================
+// ==========================================================
+
+PcapFile::PcapFile(const std::string& path) : file_(path) {
+    const uint8_t* p = file_.data();
+    if (file_.size() < PCAP_FILE_HEADER_SIZE) {
+        throw std::runtime_error("pcap: truncated file " + path);
+    }
+
+    const uint32_t magic = load_u32(p);
+    if (magic == PCAPNG_SHB) {
+        pcapng_ = true;
+        if (!read_section_header(0, 0)) {
+            throw std::runtime_error("pcap: bad pcapng section header in " +
+                                     path);
+        }
+        // the link type of the file is the one of the first interface
+        uint64_t offset = 0;
+        while (offset + 12 <= file_.size()) {
+            const uint32_t type = u32(p + offset);
+            const uint32_t len = u32(p + offset + 4);
+            if (len < 12 || len % 4 != 0 || len > file_.size() - offset) {
+                break;
+            }
+            if (type == PCAPNG_IDB) {
+                if (len >= 20) link_type_ = u16(p + offset + 8);
+                break;
+            }
+            if (type == PCAPNG_EPB || type == PCAPNG_SPB || type == PCAPNG_PB) {
+                break;
+            }
+            offset += len;
+        }
+        first_record_ = 0;
+        return;
+    }
+
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        swapped_ = false;
+    } else if (swap32(magic) == PCAP_MAGIC_US ||
+               swap32(magic) == PCAP_MAGIC_NS) {
+        swapped_ = true;
+    } else {
+        throw std::runtime_error("pcap: unknown file format " + path);
+    }
+    nanosecond_ = u32(p) == PCAP_MAGIC_NS;
+    // upper bits are the FCS length
+    link_type_ = static_cast<int>(u32(p + 20) & 0x03ffffff);
+    first_record_ = PCAP_FILE_HEADER_SIZE;
+}
+
+uint16_t PcapFile::u16(const uint8_t* p) const {
+    return swapped_ ? swap16(load_u16(p)) : load_u16(p);
+}
+
+uint32_t PcapFile::u32(const uint8_t* p) const {
+    return swapped_ ? swap32(load_u32(p)) : load_u32(p);
+}
+
+bool PcapFile::read_record(uint64_t& offset, pcap_record& record) {
+    if (pcapng_) return read_pcapng_block(offset, record);
+    return read_pcap_record(offset, record);
+}
+
+bool PcapFile::read_pcap_record(uint64_t& offset, pcap_record& record) const {
+    if (offset < first_record_ || offset > file_.size() ||
+        file_.size() - offset < PCAP_RECORD_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t* p = file_.data() + offset;
+    const uint32_t caplen = u32(p + 8);
+    if (caplen > MAX_CAPLEN ||
+        caplen > file_.size() - offset - PCAP_RECORD_HEADER_SIZE) {
+        return false;
+    }
+
+    const uint64_t sec = u32(p);
+    const uint64_t frac = u32(p + 4);
+    record.timestamp = std::chrono::microseconds{
+        sec * 1000000 + (nanosecond_ ? frac / 1000 : frac)};
+    record.data = p + PCAP_RECORD_HEADER_SIZE;
+    record.caplen = caplen;
+    record.link_type = link_type_;
+    offset += PCAP_RECORD_HEADER_SIZE + caplen;
+    return true;
+}
+
+uint64_t PcapFile::next_record(uint64_t offset) const {
+    offset = std::max(offset, first_record_);
+    const uint64_t size = file_.size();
+    if (pcapng_) {
+        const uint8_t* base = file_.data();
+        bool swapped = swapped_;
+        uint64_t pos = 0;
+        while (pos < offset && size - pos >= 12) {
+            const uint8_t* p = base + pos;
+            if (load_u32(p) == PCAPNG_SHB) {
+                swapped = load_u32(p + 8) != PCAPNG_BYTE_ORDER_MAGIC;
+            }
+            const uint32_t len =
+                swapped ? swap32(load_u32(p + 4)) : load_u32(p + 4);
+            if (len < 12 || len % 4 != 0 || len > size - pos) return size;
+            pos += len;
+        }
+        return std::min(pos, size);
+    }
+
+    for (uint64_t pos = offset; pos < size; ++pos) {
+        if (is_record_chain(pos)) return pos;
+    }
+    return size;
+}
+
+bool PcapFile::is_record_chain(uint64_t offset) const {
+    const uint64_t size = file_.size();
+    const uint32_t max_frac = nanosecond_ ? 1000000000 : 1000000;
+    uint32_t prev_sec = 0;
+    uint64_t pos = offset;
+    for (int i = 0; i < RESYNC_RECORDS; ++i) {
+        // the chain ends exactly with the file
+        if (pos == size) return i > 0;
+        if (size - pos < PCAP_RECORD_HEADER_SIZE) return false;
+        const uint8_t* p = file_.data() + pos;
+        const uint32_t sec = u32(p);
+        const uint32_t frac = u32(p + 4);
+        const uint32_t caplen = u32(p + 8);
+        const uint32_t len = u32(p + 12);
+        if (caplen == 0 || caplen > MAX_CAPLEN || len < caplen ||
+            frac >= max_frac ||
+            caplen > size - pos - PCAP_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        if (i > 0 && (sec > prev_sec + uint64_t{RESYNC_MAX_GAP_S} ||
+                      prev_sec > sec + uint64_t{RESYNC_MAX_GAP_S})) {
+            return false;
+        }
+        prev_sec = sec;
+        pos += PCAP_RECORD_HEADER_SIZE + caplen;
+    }
+    return true;
+}
+
+bool PcapFile::read_pcapng_block(uint64_t& offset, pcap_record& record) {
+    // seeking back before the current section
+    if (offset < section_ && !restore_sections(offset)) return false;
+
+    const uint8_t* base = file_.data();
+    uint64_t pos = offset;
+    bool restored = false;
+    while (pos <= file_.size() && file_.size() - pos >= 12) {
+        const uint8_t* p = base + pos;
+        const uint32_t type = load_u32(p);  // SHB type reads the same
+        if (type == PCAPNG_SHB) {
+            if (!read_section_header(pos, file_.size() - pos)) return false;
+        }
+        const uint32_t len = u32(p + 4);
+        if (len < 12 || len % 4 != 0 || len > file_.size() - pos) return false;
+
+        switch (u32(p)) {
+            case PCAPNG_IDB:
+                if (!read_interface(pos, len)) return false;
+                break;
+            case PCAPNG_EPB:
+            case PCAPNG_PB: {
+                if (len < 32) return false;
+                const bool epb = u32(p) == PCAPNG_EPB;
+                const uint32_t id = epb ? u32(p + 8) : u16(p + 8);
+                if (id >= interfaces_.size()) {
+                    // interface described before the offset seeked to
+                    if (restored || !restore_sections(pos)) return false;
+                    restored = true;
+                    continue;
+                }
+                const uint32_t caplen = u32(p + 20);
+                if (caplen > MAX_CAPLEN || caplen > len - 32) return false;
+                const uint64_t ts =
+                    (static_cast<uint64_t>(u32(p + 12)) << 32) | u32(p + 16);
+                record.timestamp = to_us(ts, interfaces_[id].ts_units);
+                record.data = p + 28;
+                record.caplen = caplen;
+                record.link_type = interfaces_[id].link_type;
+                offset = pos + len;
+                return true;
+            }
+            case PCAPNG_SPB: {
+                if (len < 16) return false;
+                if (interfaces_.empty()) {
+                    if (restored || !restore_sections(pos)) return false;
+                    restored = true;
+                    continue;
+                }
+                const uint32_t orig_len = u32(p + 8);
+                record.timestamp = std::chrono::microseconds{0};
+                record.data = p + 12;
+                record.caplen = std::min(orig_len, len - 16);
+                if (record.caplen > MAX_CAPLEN) return false;
+                record.link_type = interfaces_[0].link_type;
+                offset = pos + len;
+                return true;
+            }
+            default:
+                break;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+bool PcapFile::read_section_header(uint64_t offset, uint64_t block_len) {
+    const uint8_t* p = file_.data() + offset;
+    if (file_.size() - offset < 28) return false;
+    const uint32_t magic = load_u32(p + 8);
+    if (magic == PCAPNG_BYTE_ORDER_MAGIC) {
+        swapped_ = false;
+    } else if (swap32(magic) == PCAPNG_BYTE_ORDER_MAGIC) {
+        swapped_ = true;
+    } else {
+        return false;
+    }
+    if (block_len != 0 && u32(p + 4) > block_len) return false;
+    if (offset != section_) {
+        section_ = offset;
+        interfaces_.clear();
+    }
+    return true;
+}
+
+bool PcapFile::read_interface(uint64_t offset, uint64_t block_len) {
+    if (block_len < 20) return false;
+    // seen already, when reading the section again after a seek
+    for (const interface& i : interfaces_) {
+        if (i.offset == offset) return true;
+    }
+
+    const uint8_t* p = file_.data() + offset;
+    interface iface{offset, u16(p + 8), 1000000};
+    // options follow the 8 bytes of link type, reserved and snaplen
+    uint64_t pos = 16;
+    while (pos + 4 <= block_len - 4) {
+        const uint16_t code = u16(p + pos);
+        const uint16_t len = u16(p + pos + 2);
+        if (code == PCAPNG_OPT_END || pos + 4 + len > block_len - 4) break;
+        if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1) {
+            const uint8_t res = p[pos + 4];
+            const uint8_t exp = res & 0x7f;
+            if (res & 0x80) {
+                if (exp < 64) iface.ts_units = uint64_t{1} << exp;
+            } else if (exp <= 19) {
+                iface.ts_units = 1;
+                for (uint8_t i = 0; i < exp; ++i) iface.ts_units *= 10;
+            }
+        }
+        pos += 4 + ((len + 3u) & ~3u);
+    }
+    interfaces_.push_back(iface);
+    return true;
+}
+
+bool PcapFile::restore_sections(uint64_t offset) {
+    // walk the blocks from the start of the file up to offset to find the
+    // section and the interfaces offset is in
+    section_ = 0;
+    interfaces_.clear();
+    uint64_t pos = 0;
+    while (pos < offset && file_.size() - pos >= 12) {
+        const uint8_t* p = file_.data() + pos;
+        if (load_u32(p) == PCAPNG_SHB &&
+            !read_section_header(pos, file_.size() - pos)) {
+            return false;
+        }
+        const uint32_t len = u32(p + 4);
+        if (len < 12 || len % 4 != 0 || len > file_.size() - pos) return false;
+        if (u32(p) == PCAPNG_IDB && !read_interface(pos, len)) return false;
+        pos += len;
+    }
+    return pos == offset;
+}
+
+// ==========================================================
+// ========= Frames =========================================
+// ==========================================================
+
+bool parse_ip_frame(const pcap_record& record, ip_frame& frame) {
+    const uint8_t* p = record.data;
+    const uint32_t n = record.caplen;
+    uint32_t off = 0;
+    uint16_t ethertype = 0;  // 0 to tell by the IP version
+
+    switch (record.link_type) {
+        case LINKTYPE_ETHERNET:
+            if (n < 14) return false;
+            ethertype = be16(p + 12);
+            off = 14;
+            while (ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ ||
+                   ethertype == ETHERTYPE_QINQ_OLD) {
+                if (n < off + 4) return false;
+                ethertype = be16(p + off + 2);
+                off += 4;
+            }
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (n < 16) return false;
+            ethertype = be16(p + 14);
+            off = 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if (n < 20) return false;
+            ethertype = be16(p);
+            off = 20;
+            break;
+        case LINKTYPE_NULL:
+        case LINKTYPE_LOOP:
+            // address family values differ between platforms
+            off = 4;
+            break;
+        case LINKTYPE_RAW:
+        case DLT_RAW:
+        case DLT_RAW_OPENBSD:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            off = 0;
+            break;
+        default:
+            return false;
+    }
+    if (n <= off) return false;
+
+    const uint8_t* ip = p + off;
+    const uint32_t avail = n - off;
+    int version = ip[0] >> 4;
+    if (ethertype == ETHERTYPE_IPV4 && version != 4) return false;
+    if (ethertype == ETHERTYPE_IPV6 && version != 6) return false;
+    if (ethertype != 0 && ethertype != ETHERTYPE_IPV4 &&
+        ethertype != ETHERTYPE_IPV6) {
+        return false;
+    }
+
+    if (version == 4) {
+        if (avail < IPV4_HEADER_SIZE) return false;
+        const uint32_t ihl = (ip[0] & 0x0f) * 4u;
+        const uint32_t total = be16(ip + 2);
+        if (ihl < IPV4_HEADER_SIZE || total < ihl || avail < ihl) return false;
+        // frames may be padded or truncated by the capture
+        const uint32_t ip_len = std::min(total, avail);
+        const uint16_t flags_offset = be16(ip + 6);
+        frame.ip_version = 4;
+        frame.protocol = ip[9];
+        std::memcpy(frame.src_addr, ip + 12, 4);
+        std::memcpy(frame.dst_addr, ip + 16, 4);
+        frame.id = be16(ip + 4);
+        frame.frag_offset = static_cast<uint16_t>((flags_offset & 0x1fff) * 8);
+        frame.more_fragments = (flags_offset & 0x2000) != 0;
+        frame.payload = ip + ihl;
+        frame.payload_size = ip_len - ihl;
+        frame.packet_size = off + ip_len;
+        return true;
+    }
+    if (version == 6) {
+        if (avail < IPV6_HEADER_SIZE) return false;
+        const uint32_t payload_len =
+            std::min<uint32_t>(be16(ip + 4), avail - IPV6_HEADER_SIZE);
+        const uint8_t* payload = ip + IPV6_HEADER_SIZE;
+        uint32_t payload_size = payload_len;
+        int next_header = ip[6];
+        for (;;) {
+            uint32_t ext_len = 0;
+            if (next_header == IPV6_HOP_BY_HOP ||
+                next_header == IPV6_ROUTING || next_header == IPV6_DEST_OPTS) {
+                if (payload_size < 8) return false;
+                ext_len = (payload[1] + 1u) * 8u;
+            } else if (next_header == IPV6_FRAGMENT) {
+                if (payload_size < IPV6_FRAGMENT_HEADER_SIZE) return false;
+                // IPv6 fragments aren't reassembled, keep the fragment
+                // header as the protocol unless it's an atomic fragment
+                // holding the whole datagram
+                if ((be16(payload + 2) & 0xfff9) != 0) break;
+                ext_len = IPV6_FRAGMENT_HEADER_SIZE;
+            } else {
+                break;
+            }
+            if (payload_size < ext_len) return false;
+            next_header = payload[0];
+            payload += ext_len;
+            payload_size -= ext_len;
+        }
+        frame.ip_version = 6;
+        frame.protocol = next_header;
+        std::memcpy(frame.src_addr, ip + 8, 16);
+        std::memcpy(frame.dst_addr, ip + 24, 16);
+        frame.id = 0;
+        frame.frag_offset = 0;
+        frame.more_fragments = false;
+        frame.payload = payload;
+        frame.payload_size = payload_size;
+        frame.packet_size = off + IPV6_HEADER_SIZE + payload_len;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace impl
+}  // namespace sensor_utils
+}  // namespace ouster
@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2024, Ouster, Inc.
+ * All rights reserved.
+ *
+ * Native pcap / pcapng parsing, used by PcapReader to read packets in place
+ * from the memory mapped file.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ouster {
+namespace sensor_utils {
+namespace impl {
+
+/**
+ * Read only view of a whole file, memory mapped where the platform allows
+ * it and read into memory otherwise.
+ */
+class MappedFile {
+   public:
+    /**
+     * @throws std::runtime_error if the file can't be opened or mapped.
+     *
+     * @param[in] path The file to map.
+     */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    uint64_t size() const { return size_; }
+
+   private:
+    const uint8_t* data_{nullptr};
+    uint64_t size_{0};
+    bool mapped_{false};
+    std::vector<uint8_t> buf_{};  ///< file contents when not mapped
+};
+
+/**
+ * A captured link layer frame.
+ */
+struct pcap_record {
+    std::chrono::microseconds timestamp;
+    const uint8_t* data;  ///< captured bytes, in the file mapping
+    uint32_t caplen;      ///< number of captured bytes
+    int link_type;        ///< LINKTYPE_* of the interface
+};
+
+/**
+ * Reads the packet records of a pcap or pcapng file in place.
+ *
+ * Classic pcap files of both byte orders and micro/nanosecond resolution
+ * are supported. For pcapng files Enhanced and Simple Packet Blocks are
+ * returned and the other blocks skipped, tracking the Section Header and
+ * Interface Description Blocks for byte order, link type and timestamp
+ * resolution.
+ */
+class PcapFile {
+   public:
+    /**
+     * @throws std::runtime_error if the file can't be opened or isn't a
+     * pcap or pcapng file.
+     *
+     * @param[in] path The pcap file.
+     */
+    explicit PcapFile(const std::string& path);
+
+    /**
+     * Read the record at offset, skipping non packet pcapng blocks.
+     *
+     * @param[in,out] offset Offset of the record to read, moved past it when
+     *                a record is read.
+     * @param[out] record The record read.
+     * @return false at the end of the file or if offset doesn't point to a
+     *         valid record, offset is left unchanged then.
+     */
+    bool read_record(uint64_t& offset, pcap_record& record);
+
+    /**
+     * Find the first record at or after offset, to start reading from an
+     * arbitrary offset.
+     *
+     * pcapng blocks are walked from the start of the file. Classic pcap
+     * records aren't framed, so the first offset that a chain of plausible
+     * record headers starts at is taken.
+     *
+     * @param[in] offset The offset to search from.
+     * @return Offset of the record, the file size if there is none.
+     */
+    uint64_t next_record(uint64_t offset) const;
+
+    /**
+     * @return Offset of the first record.
+     */
+    uint64_t first_record() const { return first_record_; }
+
+    /**
+     * @return Link type of the first interface.
+     */
+    int link_type() const { return link_type_; }
+
+    uint64_t size() const { return file_.size(); }
+
+    /**
+     * @return true for pcapng, false for classic pcap files.
+     */
+    bool pcapng() const { return pcapng_; }
+
+   private:
+    struct interface {
+        uint64_t offset;  ///< offset of the IDB, to not add one twice
+        int link_type;
+        uint64_t ts_units;  ///< timestamp units per second
+    };
+
+    bool read_pcap_record(uint64_t& offset, pcap_record& record) const;
+    bool is_record_chain(uint64_t offset) const;
+    bool read_pcapng_block(uint64_t& offset, pcap_record& record);
+    bool read_section_header(uint64_t offset, uint64_t block_len);
+    bool read_interface(uint64_t offset, uint64_t block_len);
+    bool restore_sections(uint64_t offset);
+
+    uint16_t u16(const uint8_t* p) const;
+    uint32_t u32(const uint8_t* p) const;
+
+    MappedFile file_;
+    bool pcapng_{false};
+    bool swapped_{false};  ///< file byte order differs from the host one
+    bool nanosecond_{false};
+    int link_type_{0};
+    uint64_t first_record_{0};
+
+    // pcapng state of the current section
+    uint64_t section_{0};
+    std::vector<interface> interfaces_{};
+};
+
+/**
+ * IP and UDP headers of a frame, with the addresses kept in network byte
+ * order.
+ */
+struct ip_frame {
+    int ip_version;
+    int protocol;             ///< IANA protocol of the IP payload
+    uint8_t src_addr[16];     ///< 4 bytes used for IPv4
+    uint8_t dst_addr[16];     ///< 4 bytes used for IPv4
+    uint16_t id;              ///< IPv4 identification
+    uint16_t frag_offset;     ///< IPv4 fragment offset in bytes
+    bool more_fragments;      ///< IPv4 MF flag
+    const uint8_t* payload;   ///< IP payload after any skipped extension
+                              ///< headers, trimmed to the IP length
+    uint32_t payload_size;    ///< size of the IP payload
+    uint32_t packet_size;     ///< link and IP headers plus the IP payload
+};
+
+/**
+ * Parse the link and IP layers of a frame.
+ *
+ * Supported link types are Ethernet (with 802.1Q tags), Linux cooked
+ * capture v1 and v2, BSD loopback and raw IP.
+ *
+ * IPv6 Hop-by-Hop, Routing and Destination Options headers are skipped.
+ * IPv6 fragments aren't reassembled: the protocol of a fragment is the
+ * Fragment header (44), unless it is an atomic fragment.
+ *
+ * @param[in] record The captured frame.
+ * @param[out] frame The IP headers and payload.
+ * @return false if the frame doesn't hold an IPv4 or IPv6 packet.
+ */
+bool parse_ip_frame(const pcap_record& record, ip_frame& frame);
+
+}  // namespace impl
+}  // namespace sensor_utils
+}  // namespace ouster
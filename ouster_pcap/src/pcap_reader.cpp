@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2024, Ouster, Inc.
+ * All rights reserved.
+ *
+ * PcapReader parsing the pcap file in place: records are read from the file
+ * mapping and the payload returned points into it, except for reassembled
+ * IPv4 datagrams.
+ */
+
+#if defined _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>  // inet_ntop, inet_pton
+#else
+#include <arpa/inet.h>  // inet_ntop, inet_pton
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+
+#include "ip_reassembler.h"
+#include "ouster/pcap.h"
+#include "ouster/types.h"
+#include "pcap_file.h"
+
+namespace ouster {
+namespace sensor_utils {
+
+static constexpr uint32_t UDP_HEADER_SIZE = 8;
+
+// ==========================================================
+// ========= ip_address =====================================
+// ==========================================================
+
+ip_address::ip_address(const std::string& ip) : ip_address(ip.c_str()) {}
+
+ip_address::ip_address(const char* ip) {
+    if (ip == nullptr || *ip == '\0') return;
+    if (inet_pton(AF_INET, ip, bytes.data()) == 1) {
+        version = 4;
+    } else if (inet_pton(AF_INET6, ip, bytes.data()) == 1) {
+        version = 6;
+    } else {
+        throw std::invalid_argument("invalid IP address: " + std::string(ip));
+    }
+}
+
+ip_address::ip_address(int version, const uint8_t* addr) : version(version) {
+    std::memcpy(bytes.data(), addr, version == 4 ? 4 : 16);
+}
+
+std::string ip_address::to_string() const {
+    if (version == 4) {
+        char buf[16];
+        char* c = buf;
+        for (int i = 0; i < 4; ++i) {
+            if (i) *c++ = '.';
+            const uint8_t b = bytes[i];
+            if (b >= 100) *c++ = static_cast<char>('0' + b / 100);
+            if (b >= 10) *c++ = static_cast<char>('0' + b / 10 % 10);
+            *c++ = static_cast<char>('0' + b % 10);
+        }
+        return std::string(buf, c);
+    }
+    if (version == 6) {
+        char buf[INET6_ADDRSTRLEN];
+        if (inet_ntop(AF_INET6, bytes.data(), buf, sizeof(buf)) != nullptr) {
+            return buf;
+        }
+    }
+    return {};
+}
+
+bool ip_address::operator==(const ip_address& other) const {
+    return version == other.version && bytes == other.bytes;
+}
+
+bool ip_address::operator!=(const ip_address& other) const {
+    return !(*this == other);
+}
+
+bool ip_address::operator<(const ip_address& other) const {
+    return version < other.version ||
+           (version == other.version && bytes < other.bytes);
+}
+
+std::ostream& operator<<(std::ostream& stream_in, const ip_address& data) {
+    return stream_in << data.to_string();
+}
+
+// ==========================================================
+// ========= PcapReader =====================================
+// ==========================================================
+
+/**
+ * packet_filter compiled to bitsets of the ports and sorted addresses and
+ * serial numbers.
+ */
+struct compiled_filter {
+    bool active{false};
+    std::vector<uint64_t> dst_ports{};  ///< bitset, empty for any port
+    std::vector<uint64_t> src_ports{};  ///< bitset, empty for any port
+    std::vector<ip_address> dst_ips{};
+    std::vector<ip_address> src_ips{};
+    std::vector<uint64_t> serial_numbers{};
+    std::vector<const sensor::packet_format*> lidar_formats{};
+
+    static std::vector<uint64_t> port_set(const std::vector<int>& ports) {
+        std::vector<uint64_t> set;
+        if (ports.empty()) return set;
+        set.resize(65536 / 64, 0);
+        for (int p : ports) {
+            if (p < 0 || p > 65535) continue;
+            set[p / 64] |= uint64_t{1} << (p % 64);
+        }
+        return set;
+    }
+
+    static bool has_port(const std::vector<uint64_t>& set, int port) {
+        return set.empty() || (set[port / 64] >> (port % 64)) & 1;
+    }
+
+    static bool has_ip(const std::vector<ip_address>& ips,
+                       const ip_address& ip) {
+        return ips.empty() || std::binary_search(ips.begin(), ips.end(), ip);
+    }
+
+    // addresses are in every fragment, checked before reassembly
+    bool match_addresses(const impl::ip_frame& frame) const {
+        return has_ip(dst_ips, ip_address(frame.ip_version, frame.dst_addr)) &&
+               has_ip(src_ips, ip_address(frame.ip_version, frame.src_addr));
+    }
+
+    bool match_ports(int dst_port, int src_port) const {
+        return has_port(dst_ports, dst_port) && has_port(src_ports, src_port);
+    }
+
+    bool match_serial_number(const uint8_t* buf, size_t size) const {
+        if (serial_numbers.empty()) return true;
+        for (const sensor::packet_format* pf : lidar_formats) {
+            if (size != pf->lidar_packet_size) continue;
+            return std::binary_search(serial_numbers.begin(),
+                                      serial_numbers.end(), pf->prod_sn(buf));
+        }
+        return true;
+    }
+};
+
+struct pcap_impl {
+    explicit pcap_impl(const std::string& file) : pcap_file(file) {}
+
+    impl::PcapFile pcap_file;
+    uint64_t offset{0};  ///< Offset of the next record to read
+    impl::IPv4Reassembler reassembler;  ///< Mainly for lidar packets
+    compiled_filter filter;
+};
+
+PcapReader::PcapReader(const std::string& file)
+    : impl(new pcap_impl(file)), info{}, data{nullptr} {
+    file_size_ = static_cast<int64_t>(impl->pcap_file.size());
+    file_start_ = static_cast<int64_t>(impl->pcap_file.first_record());
+    impl->offset = impl->pcap_file.first_record();
+}
+
+PcapReader::~PcapReader() {}
+
+const uint8_t* PcapReader::current_data() const { return data; }
+
+size_t PcapReader::current_length() const { return info.payload_size; }
+
+const packet_info& PcapReader::current_info() const { return info; }
+
+void PcapReader::seek(uint64_t offset) {
+    if (offset < static_cast<uint64_t>(file_start_)) {
+        offset = static_cast<uint64_t>(file_start_);
+    }
+    impl->offset = offset;
+    // fragments read before don't belong with the ones after
+    impl->reassembler.clear();
+}
+
+int64_t PcapReader::file_size() const { return file_size_; }
+
+int64_t PcapReader::current_offset() const {
+    return static_cast<int64_t>(impl->offset);
+}
+
+uint64_t PcapReader::next_record_offset(uint64_t offset) const {
+    return impl->pcap_file.next_record(offset);
+}
+
+std::vector<uint64_t> PcapReader::pending_fragment_offsets() const {
+    return impl->reassembler.pending_offsets(info.timestamp);
+}
+
+bool PcapReader::is_pcapng() const { return impl->pcap_file.pcapng(); }
+
+void PcapReader::reset() { seek(file_start_); }
+
+void PcapReader::set_filter(const packet_filter& filter) {
+    if (!filter.serial_numbers.empty() && filter.lidar_formats.empty()) {
+        throw std::invalid_argument(
+            "PcapReader: filtering by serial number requires lidar formats");
+    }
+
+    compiled_filter f;
+    f.dst_ports = compiled_filter::port_set(filter.dst_ports);
+    f.src_ports = compiled_filter::port_set(filter.src_ports);
+    f.dst_ips = filter.dst_ips;
+    f.src_ips = filter.src_ips;
+    f.serial_numbers = filter.serial_numbers;
+    f.lidar_formats = filter.lidar_formats;
+    std::sort(f.dst_ips.begin(), f.dst_ips.end());
+    std::sort(f.src_ips.begin(), f.src_ips.end());
+    std::sort(f.serial_numbers.begin(), f.serial_numbers.end());
+    f.active = !f.dst_ports.empty() || !f.src_ports.empty() ||
+               !f.dst_ips.empty() || !f.src_ips.empty() ||
+               !f.serial_numbers.empty();
+    impl->filter = std::move(f);
+}
+
+size_t PcapReader::next_packet() {
+    impl::pcap_record record;
+    impl::ip_frame frame;
+    const compiled_filter& filter = impl->filter;
+
+    int reassm_packets = 0;
+    while (true) {
+        reassm_packets++;
+        info.file_offset = impl->offset;
+        if (!impl->pcap_file.read_record(impl->offset, record)) return 0;
+
+        if (!impl::parse_ip_frame(record, frame) || frame.protocol != IANA_UDP)
+            continue;
+        if (filter.active && !filter.match_addresses(frame)) continue;
+
+        const uint32_t packet_size = frame.packet_size;
+        if (impl->reassembler.process(record.timestamp, info.file_offset,
+                                      frame) ==
+            impl::IPv4Reassembler::FRAGMENTED)
+            continue;
+
+        // a truncated capture or a bogus reassembled datagram
+        if (frame.payload_size < UDP_HEADER_SIZE) continue;
+
+        const uint8_t* udp = frame.payload;
+        const int dst_port = (udp[2] << 8) | udp[3];
+        const int src_port = (udp[0] << 8) | udp[1];
+        const uint8_t* payload = udp + UDP_HEADER_SIZE;
+        const size_t payload_size = frame.payload_size - UDP_HEADER_SIZE;
+        if (filter.active &&
+            (!filter.match_ports(dst_port, src_port) ||
+             !filter.match_serial_number(payload, payload_size)))
+            continue;
+
+        info.dst_ip = ip_address(frame.ip_version, frame.dst_addr);
+        info.src_ip = ip_address(frame.ip_version, frame.src_addr);
+        info.dst_port = dst_port;
+        info.src_port = src_port;
+        info.payload_size = payload_size;
+        info.packet_size = packet_size;
+        info.timestamp = record.timestamp;
+        info.fragments_in_packet = reassm_packets;
+        info.ip_version = frame.ip_version;
+        info.encapsulation_protocol = record.link_type;
+        info.network_protocol = frame.protocol;
+        data = payload;
+        return payload_size;
+    }
+}
+
+}  // namespace sensor_utils
+}  // namespace ouster
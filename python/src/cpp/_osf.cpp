@@ -245,14 +245,17 @@ to work with OSF files.
             "Checks whether the message belongs to the ``msg_stream`` type")
         .def(
             "decode",
-            [](const osf::MessageRef& msg) -> py::object {
+            [](const osf::MessageRef& msg,
+               const std::vector<std::string>& fields) -> py::object {
                 if (msg.is<osf::LidarScanStream>()) {
-                    auto decoded_obj = msg.decode_msg<osf::LidarScanStream>();
+                    auto decoded_obj =
+                        msg.decode_msg<osf::LidarScanStream>(fields);
                     return py::cast(*decoded_obj);
                 }
                 // TODO[pb]: Add dynamic check for Stream decoding functions ...
                 return py::none();
             },
+            py::arg("fields") = std::vector<std::string>{},
             py::return_value_policy::move,
             R"(
             Decodes the underlying object and returns it.
@@ -260,6 +263,10 @@ to work with OSF files.
             Currently supports only two stream types with a corresponding object types:
 
             - ``LidarScan`` - frame of lidar data (``client.LidarScan``)
+
+            Args:
+                fields: names of the LidarScan fields to decode, the other
+                    fields are skipped. Empty decodes all fields.
         )");
 
     // ChunkRef
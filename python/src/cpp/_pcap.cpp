@@ -60,8 +60,14 @@ This module is generated from the C++ code and not meant to be used directly.
                  result << data;
                  return result.str();
              })
-        .def_readwrite("dst_ip", &packet_info::dst_ip)
-        .def_readwrite("src_ip", &packet_info::src_ip)
+        .def_property(
+            "dst_ip",
+            [](const packet_info& info) { return info.dst_ip.to_string(); },
+            [](packet_info& info, const std::string& ip) { info.dst_ip = ip; })
+        .def_property(
+            "src_ip",
+            [](const packet_info& info) { return info.src_ip.to_string(); },
+            [](packet_info& info, const std::string& ip) { info.src_ip = ip; })
         .def_readwrite("dst_port", &packet_info::dst_port)
         .def_readwrite("src_port", &packet_info::src_port)
         .def_readonly("payload_size", &packet_info::payload_size)
@@ -95,8 +101,12 @@ This module is generated from the C++ code and not meant to be used directly.
                  result << data;
                  return result.str();
              })
-        .def_readonly("dst_ip", &stream_key::dst_ip)
-        .def_readonly("src_ip", &stream_key::src_ip)
+        .def_property_readonly(
+            "dst_ip",
+            [](const stream_key& key) { return key.dst_ip.to_string(); })
+        .def_property_readonly(
+            "src_ip",
+            [](const stream_key& key) { return key.src_ip.to_string(); })
         .def_readonly("dst_port", &stream_key::dst_port)
         .def_readonly("src_port", &stream_key::src_port);
 
@@ -254,12 +264,25 @@ This module is generated from the C++ code and not meant to be used directly.
              &IndexedPcapReader::reset)  // TODO move to PcapReader binding?
         .def("seek",
              &IndexedPcapReader::seek)  // TODO move to PcapReader binding?
-        .def("build_index", &IndexedPcapReader::build_index)
+        .def(
+            "build_index",
+            [](IndexedPcapReader& reader, unsigned int n_threads) {
+                py::gil_scoped_release release;
+                reader.build_index(n_threads);
+            },
+            py::arg("n_threads") = 0)
+        .def("load_index", &IndexedPcapReader::load_index,
+             py::arg("index_file"))
+        .def("save_index", &IndexedPcapReader::save_index,
+             py::arg("index_file"))
         .def("get_index", &IndexedPcapReader::get_index)
         .def("current_data", [](IndexedPcapReader& reader) -> py::array {
             uint8_t* data = const_cast<uint8_t*>(reader.current_data());
             size_t data_size = reader.current_length();
-            return py::array(py::dtype::of<uint8_t>(), data_size, data,
-                             py::cast(reader));
+            py::array arr(py::dtype::of<uint8_t>(), data_size, data,
+                          py::cast(reader));
+            // points into the read only mapping of the pcap file
+            arr.attr("flags").attr("writeable") = false;
+            return arr;
         });
 }
@@ -76,7 +76,7 @@ class Extrinsics(MetadataEntry):
 
 class MessageRef:
     def __init__(self, *args, **kwargs) -> None: ...
-    def decode(self) -> object: ...
+    def decode(self, fields: List[str] = ...) -> object: ...
     def of(self, arg0: object) -> bool: ...
     @property
     def id(self) -> int: ...
@@ -107,7 +107,13 @@ class IndexedPcapReader:
     def __init__(self, filename: str, metadata_filename: List[str]) -> None:
         ...
 
-    def build_index(self) -> None:
+    def build_index(self, n_threads: int = ...) -> None:
+        ...
+
+    def load_index(self, index_file: str) -> bool:
+        ...
+
+    def save_index(self, index_file: str) -> None:
         ...
 
     def next_packet(self) -> int:
@@ -28,6 +28,7 @@ class PcapMultiPacketReader(PacketMultiSource):
                  metadatas: Optional[List[SensorInfo]] = None,
                  rate: float = 0.0,
                  index: bool = False,
+                 index_file: Optional[str] = None,
                  soft_id_check: bool = False):
         """Read a single sensor data stream from a single packet capture file.
 
@@ -36,6 +37,9 @@ class PcapMultiPacketReader(PacketMultiSource):
             pcap_path: File path of recorded pcap
             rate: Output packets in real time, if non-zero
             index: Should index the source, may take extra time on startup
+            index_file: With index set, load the index from this file if it
+                            was saved for the same pcap and sensors, else
+                            build it and try to save it there
             soft_id_check: if True, don't skip lidar packets buffers on
                             init_id mismatch
         """
@@ -100,7 +104,14 @@ class PcapMultiPacketReader(PacketMultiSource):
         self._reader: Optional[_pcap.IndexedPcapReader] = \
             _pcap.IndexedPcapReader(pcap_path, self._metadata)   # type: ignore
         if self._indexed:
-            self._reader.build_index()
+            if index_file is None or not self._reader.load_index(index_file):
+                self._reader.build_index()
+                if index_file is not None:
+                    try:
+                        self._reader.save_index(index_file)
+                    except RuntimeError:
+                        # only saves indexing next time, e.g. a read only dir
+                        pass
         self._lock = Lock()
         self._pf = []
         for m in self._metadata:
@@ -19,6 +19,7 @@ class PcapScanSource(ScansMulti):
         dt: int = 10**8,
         complete: bool = False,
         index: bool = False,
+        index_file: Optional[str] = None,
         cycle: bool = False,
         flags: bool = True,
         raw_headers: bool = False,
@@ -37,6 +38,9 @@ class PcapScanSource(ScansMulti):
             index: if this flag is set to true an index will be built for the pcap
                 file enabling len, index and slice operations on the scan source, if
                 the flag is set to False indexing is skipped (default is False).
+            index_file: with index set, load the index from this file if it was
+                saved for the same pcap and sensors, else build it and try to
+                save it there (default is None, the index isn't saved).
             cycle: repeat infinitely after iteration is finished (default is False)
             flags: when this option is set, the FLAGS field will be added to the list
                 of fields of every scan, in case of dual returns FLAGS2 will also be
@@ -63,6 +67,7 @@ class PcapScanSource(ScansMulti):
             self._source = PcapMultiPacketReader(file_path,
                                                  metadata_paths=metadata_paths,
                                                  index=index,
+                                                 index_file=index_file,
                                                  soft_id_check=soft_id_check)
         except Exception:
             self._source = None
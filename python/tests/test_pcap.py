@@ -540,6 +540,38 @@ def test_indexed_pcap_reader(tmpdir):
                 frame_num += 1
 
 
+def test_pcap_multi_packet_reader_index_file(tmpdir):
+    """It should save the index to index_file and load it on the next open"""
+    meta_path = path.join(PCAPS_DATA_DIR, f"{TESTS['dual-2.2']}.json")
+
+    sensor_info = client.SensorInfo(open(meta_path).read())
+    num_frames = 10
+    in_packets = list(fake_packet_stream_with_frame_id(sensor_info, num_frames, 3, 3, lambda frame_num: frame_num))
+    file_path = path.join(tmpdir, "pcap_index_test.pcap")
+    pcap.record(in_packets, file_path)
+    index_path = path.join(tmpdir, "pcap_index_test.pcap.idx")
+
+    source = pcap.PcapMultiPacketReader(file_path, [meta_path], index=True, index_file=index_path)
+    assert path.exists(index_path)
+    assert source._index.frame_count(0) == num_frames
+    source.close()
+
+    reader = _pcap.IndexedPcapReader(file_path, [meta_path])
+    assert reader.load_index(index_path)
+    assert reader.get_index().frame_count(0) == num_frames
+
+    source = pcap.PcapMultiPacketReader(file_path, [meta_path], index=True, index_file=index_path)
+    assert source._index.frame_count(0) == num_frames
+    source.close()
+
+    # the index is still built if it can't be saved
+    missing_dir_path = path.join(tmpdir, "missing", "pcap_index_test.pcap.idx")
+    source = pcap.PcapMultiPacketReader(file_path, [meta_path], index=True, index_file=missing_dir_path)
+    assert not path.exists(missing_dir_path)
+    assert source._index.frame_count(0) == num_frames
+    source.close()
+
+
 def test_indexed_pcap_reader_seek(tmpdir):
     """After seeking to the start of a frame, next_packet should return the first packet of that frame"""
     meta_path = path.join(PCAPS_DATA_DIR, f"{TESTS['dual-2.2']}.json")
@@ -88,6 +88,97 @@ TEST(CartesianParametrisedTestFixture, CartesianFunctionsMatchF) {
     EXPECT_TRUE(pointsF.isApprox(points0F));
 }
 
+TEST(CartesianParametrisedTestFixture, CartesianIntoMatches) {
+    const auto WIDTH = 250;  // not a multiple of any vector width
+    const auto HEIGHT = 32;
+    const auto ROWS = WIDTH * HEIGHT;
+    const auto COLS = 3;
+
+    PointsD direction =
+        0.5 * PointsD::Random(ROWS, COLS) + PointsD::Constant(ROWS, COLS, 1.0);
+    PointsD offset = 0.005 * (PointsD::Random(ROWS, COLS) +
+                              PointsD::Constant(ROWS, COLS, 1.0));
+    XYZLut lut{direction, offset};
+    XYZLutF lutF = lut.cast<float>();
+
+    img_t<uint32_t> range = img_t<uint32_t>::Random(WIDTH, HEIGHT);
+    range.topRows(WIDTH / 2) = 0;
+
+    PointsD expected = PointsD::Zero(ROWS, COLS);
+    cartesianT(expected, range, direction, offset);
+    PointsF expectedF = PointsF::Zero(ROWS, COLS);
+    cartesianT(expectedF, range, lutF.direction, lutF.offset);
+
+    PointsD points;
+    cartesian_into(points, range, lut);
+    EXPECT_TRUE(points.isApprox(expected));
+    EXPECT_TRUE((points.topRows(ROWS / 2) == 0).all());
+
+    PointsF pointsF;
+    cartesian_into(pointsF, range, lutF);
+    EXPECT_TRUE(pointsF.isApprox(expectedF));
+    EXPECT_TRUE(cartesian(range, lutF).isApprox(expectedF));
+
+    // a correctly sized buffer is reused rather than reallocated
+    const float* data = pointsF.data();
+    range = img_t<uint32_t>::Random(WIDTH, HEIGHT);
+    cartesianT(expectedF, range, lutF.direction, lutF.offset);
+    cartesian_into(pointsF, range, lutF);
+    EXPECT_EQ(data, pointsF.data());
+    EXPECT_TRUE(pointsF.isApprox(expectedF));
+
+    img_t<uint32_t> wrong_size = img_t<uint32_t>::Zero(WIDTH, HEIGHT + 1);
+    EXPECT_THROW(cartesian_into(pointsF, wrong_size, lutF),
+                 std::invalid_argument);
+}
+
+TEST(CartesianParametrisedTestFixture, DestaggeredCartesianMatches) {
+    const auto WIDTH = 250;
+    const auto HEIGHT = 32;
+    const auto ROWS = WIDTH * HEIGHT;
+    const auto COLS = 3;
+
+    PointsD direction =
+        0.5 * PointsD::Random(ROWS, COLS) + PointsD::Constant(ROWS, COLS, 1.0);
+    PointsD offset = 0.005 * (PointsD::Random(ROWS, COLS) +
+                              PointsD::Constant(ROWS, COLS, 1.0));
+    XYZLut lut{direction, offset};
+
+    std::vector<int> shifts(HEIGHT);
+    for (int u = 0; u < HEIGHT; ++u) shifts[u] = (u % 4) * 13 - 20;
+    shifts[0] = 0;
+    shifts[1] = WIDTH - 1;
+
+    img_t<uint32_t> range = img_t<uint32_t>::Random(HEIGHT, WIDTH);
+    range.leftCols(WIDTH / 4) = 0;
+
+    // project, then destagger every coordinate
+    PointsD staggered = cartesian(range, lut);
+    PointsD expected(ROWS, COLS);
+    for (int c = 0; c < COLS; ++c) {
+        Eigen::Map<img_t<double>>(expected.col(c).data(), HEIGHT, WIDTH) =
+            destagger<double>(Eigen::Map<const img_t<double>>(
+                                  staggered.col(c).data(), HEIGHT, WIDTH),
+                              shifts);
+    }
+
+    DestaggeredXYZLut dlut = make_destaggered_xyz_lut(lut, shifts);
+    PointsD points;
+    cartesian_into(points, range, dlut);
+    EXPECT_TRUE((points == expected).all());
+
+    DestaggeredXYZLutF dlutF = dlut.cast<float>();
+    PointsF pointsF;
+    cartesian_into(pointsF, range, dlutF);
+    EXPECT_TRUE(pointsF.isApprox(expected.cast<float>()));
+
+    img_t<uint32_t> transposed = range.transpose();
+    EXPECT_THROW(cartesian_into(points, transposed, dlut),
+                 std::invalid_argument);
+    EXPECT_THROW(make_destaggered_xyz_lut(lut, std::vector<int>(HEIGHT + 1)),
+                 std::invalid_argument);
+}
+
 TEST_P(CartesianParametrisedTestFixture, SpeedCheck) {
     std::map<std::string, std::string> styles = term_styles();
 
@@ -105,14 +196,20 @@ TEST_P(CartesianParametrisedTestFixture, SpeedCheck) {
     PointsD offset = 0.005 * (PointsD::Random(ROWS, COLS) +
                               PointsD::Constant(ROWS, COLS, 1.0));
     XYZLut lut{direction, offset};
+    XYZLutF lutF = lut.cast<float>();
 
     PointsF directionF = direction.cast<float>();
     PointsF offsetF = offset.cast<float>();
 
+    std::vector<int> shifts(HEIGHT);
+    for (int u = 0; u < HEIGHT; ++u) shifts[u] = 12 - (u % 4) * 8;
+    DestaggeredXYZLutF dlutF =
+        make_destaggered_xyz_lut(lut, shifts).cast<float>();
+
     // create an empty arrays of points
     PointsD points = PointsD(ROWS, COLS);
     PointsF pointsF = PointsF(ROWS, COLS);
-    img_t<uint32_t> range = img_t<uint32_t>(WIDTH, HEIGHT);
+    img_t<uint32_t> range = img_t<uint32_t>(HEIGHT, WIDTH);
 
     constexpr int N_SCANS = 100;
     constexpr int MOVING_AVG_WINDOW = 30;
@@ -142,6 +239,18 @@ TEST_P(CartesianParametrisedTestFixture, SpeedCheck) {
         cartesianT(pointsF, range, directionF, offsetF);
     });
 
+    all_cartesians.emplace_back("ci", [&](const img_t<uint32_t>& range) {
+        cartesian_into(points, range, lut);
+    });
+
+    all_cartesians.emplace_back("cif", [&](const img_t<uint32_t>& range) {
+        cartesian_into(pointsF, range, lutF);
+    });
+
+    all_cartesians.emplace_back("cdf", [&](const img_t<uint32_t>& range) {
+        cartesian_into(pointsF, range, dlutF);
+    });
+
     std::default_random_engine g;
     std::uniform_real_distribution<double> d(0.0, 1.0);
     std::vector<int> ids(all_cartesians.size());
@@ -513,6 +513,41 @@ TEST(LidarScan, destagger) {
         std::invalid_argument);
 }
 
+TEST(LidarScan, destagger_into) {
+    const int w = 37;
+    const int h = 8;
+    std::vector<int> shifts{0, 3, -3, 12, -12, 36, -36, 74};
+
+    ouster::img_t<uint32_t> img(h, w);
+    std::iota(img.data(), img.data() + img.size(), 1u);
+
+    // reference implementation: rotate each row right by its shift
+    ouster::img_t<uint32_t> expected(h, w);
+    for (int u = 0; u < h; u++) {
+        for (int v = 0; v < w; v++) {
+            expected(u, ((v + shifts[u]) % w + w) % w) = img(u, v);
+        }
+    }
+
+    ouster::img_t<uint32_t> dst = ouster::img_t<uint32_t>::Zero(h, w);
+    ouster::destagger_into<uint32_t>(dst, img, shifts);
+    EXPECT_TRUE((dst == expected).all());
+    EXPECT_TRUE((ouster::destagger<uint32_t>(img, shifts) == expected).all());
+
+    ouster::destagger_into<uint32_t>(dst, expected, shifts, true);
+    EXPECT_TRUE((dst == img).all());
+
+    ouster::img_t<uint32_t> in_place = img;
+    ouster::destagger_in_place<uint32_t>(in_place, shifts);
+    EXPECT_TRUE((in_place == expected).all());
+    ouster::destagger_into<uint32_t>(in_place, in_place, shifts, true);
+    EXPECT_TRUE((in_place == img).all());
+
+    ouster::img_t<uint32_t> wrong_size(h, w + 1);
+    EXPECT_THROW(ouster::destagger_into<uint32_t>(wrong_size, img, shifts),
+                 std::invalid_argument);
+}
+
 TEST(LidarScan, lidar_scan_to_string_test) {
     ouster::LidarScan ls(128, 1024, PROFILE_RNG19_RFL8_SIG16_NIR16);
     ls.add_field("custom_field", ouster::fd_array<double>(33, 44, 55), {});
@@ -295,6 +295,85 @@ TEST_P(PacketWriterTest, packet_writer_randomize_test) {
     ouster::impl::foreach_channel_field(ls2, pf, cmp_field{ls});
 }
 
+TEST_P(PacketWriterTest, block_and_col_parse_match_test) {
+    auto param = GetParam();
+    UDPProfileLidar profile = std::get<0>(param);
+    size_t columns_per_frame = std::get<1>(param);
+    size_t pixels_per_column = std::get<2>(param);
+    size_t columns_per_packet = std::get<3>(param);
+
+    packet_format pf(profile, pixels_per_column, columns_per_packet);
+    packet_writer pw{pf};
+
+    // random bytes everywhere, so that bits outside of the field masks are
+    // set too, with valid measurement ids to keep parsing in bounds
+    LidarPacket p(pf.lidar_packet_size);
+    auto g = std::mt19937(0xdeadbeef);
+    std::generate(p.buf.begin(), p.buf.end(), [&g]() { return g(); });
+    for (size_t icol = 0; icol < columns_per_packet; ++icol) {
+        pw.set_col_measurement_id(pw.nth_col(icol, p.buf.data()),
+                                  columns_per_packet + icol);
+    }
+
+    auto parse = [&](auto parser) {
+        auto ls = LidarScan(columns_per_frame, pixels_per_column, profile,
+                            columns_per_packet);
+        ouster::impl::foreach_channel_field(ls, pf, parser, pf,
+                                            p.buf.data());
+        return ls;
+    };
+
+    auto by_col = parse([](auto ref_field, const std::string& i,
+                           const packet_format& pf, const uint8_t* buf) {
+        for (int icol = 0; icol < pf.columns_per_packet; ++icol) {
+            const uint8_t* col_buf = pf.nth_col(icol, buf);
+            const uint16_t m_id = pf.col_measurement_id(col_buf);
+            pf.col_field(col_buf, i, ref_field.col(m_id).data(),
+                         ref_field.cols());
+        }
+    });
+
+    auto verify_field = [&](auto ref_field, const std::string& i) {
+        using T = typename decltype(ref_field)::Scalar;
+        uint64_t value_mask = pf.field_value_mask(i);
+        for (int i = 0; i < ref_field.size(); ++i) {
+            T value = *(ref_field.data() + i);
+            uint64_t value_bits = 0;
+            memcpy(&value_bits, &value, sizeof(T));
+            EXPECT_EQ(value_bits, value_bits & value_mask);
+        }
+        EXPECT_FALSE((ref_field == 0).all());
+    };
+    auto verify_block = [&](auto ref_field, const std::string& i) {
+        using T = typename decltype(ref_field)::Scalar;
+        verify_field(ref_field, i);
+        EXPECT_TRUE((by_col.field<T>(i) == ref_field).all());
+    };
+
+    auto check_block = [&](auto block_dim) {
+        auto by_block = parse([](auto ref_field, const std::string& i,
+                                 const packet_format& pf, const uint8_t* buf) {
+            using T = typename decltype(ref_field)::Scalar;
+            pf.block_field<T, decltype(block_dim)::value>(ref_field, i, buf);
+        });
+        ouster::impl::foreach_channel_field(by_block, pf, verify_block);
+    };
+
+    ouster::impl::foreach_channel_field(by_col, pf, verify_field);
+    check_block(std::integral_constant<int, 4>{});
+    check_block(std::integral_constant<int, 8>{});
+    check_block(std::integral_constant<int, 16>{});
+
+    // destination too narrow for the source type of RANGE
+    img_t<uint8_t> narrow(pixels_per_column, columns_per_frame);
+    EXPECT_THROW((pf.block_field<uint8_t, 4>(narrow, ChanField::RANGE,
+                                             p.buf.data())),
+                 std::invalid_argument);
+    EXPECT_THROW(pf.col_field(pf.nth_col(0, p.buf.data()), ChanField::RANGE,
+                              narrow.data(), narrow.cols()),
+                 std::invalid_argument);
+}
+
 TEST_P(PacketWriterTest, scans_to_packets_skips_dropped_packets_test) {
     auto param = GetParam();
     UDPProfileLidar profile = std::get<0>(param);
@@ -64,6 +64,22 @@ struct parse_block {
     }
 };
 
+// destinations of all channel fields of ls for packet_format::block_fields
+std::vector<sensor::packet_format::FieldDest> block_dests(
+    LidarScan& ls, const sensor::packet_format& pf) {
+    std::vector<sensor::packet_format::FieldDest> dests;
+    size_t position = 0;
+    for (const auto& ft : pf) {
+        if (ls.has_field(ft.first)) {
+            auto& f = ls.field(ft.first);
+            dests.push_back({position, f.tag(), f.get(),
+                             static_cast<int>(f.shape()[1])});
+        }
+        ++position;
+    }
+    return dests;
+}
+
 using HashMap = std::map<std::string, size_t>;
 
 // picked up from
@@ -128,6 +144,28 @@ TEST_P(ParsingBenchmarkTestFixture, ParseBlockCorrectnessTest) {
     EXPECT_TRUE(hashes == parse_and_hash(parse_block<16>{}));
     EXPECT_TRUE(hashes == parse_and_hash(parse_block<8>{}));
     EXPECT_TRUE(hashes == parse_and_hash(parse_block<4>{}));
+
+    auto dests = block_dests(ls, pf);
+    auto fused_parse_and_hash = [&](auto block_dim) -> HashMap {
+        constexpr int N = decltype(block_dim)::value;
+        pcap.seek(0);
+        impl::foreach_channel_field(ls, pf, set_zero{});
+        while (pcap.next_packet()) {
+            if (pcap.current_info().dst_port == 7502)
+                pf.block_fields<N>(dests, pcap.current_data());
+        }
+
+        HashMap map;
+        impl::foreach_channel_field(ls, pf, matrix_hash{}, map);
+        return map;
+    };
+
+    EXPECT_TRUE(hashes ==
+                fused_parse_and_hash(std::integral_constant<int, 16>{}));
+    EXPECT_TRUE(hashes ==
+                fused_parse_and_hash(std::integral_constant<int, 8>{}));
+    EXPECT_TRUE(hashes ==
+                fused_parse_and_hash(std::integral_constant<int, 4>{}));
 }
 
 TEST_P(ParsingBenchmarkTestFixture, ScanBatcherBenchTest) {
@@ -178,11 +216,26 @@ TEST_P(ParsingBenchmarkTestFixture, ScanBatcherBenchTest) {
         mv[name](t.elapsed_microseconds());
     };
 
+    auto dests = block_dests(ls, pf);
+    auto parse_fused = [&](auto block_dim, std::string name) {
+        constexpr int N = decltype(block_dim)::value;
+        t.start();
+        for (const auto& packet : packets)
+            pf.block_fields<N>(dests, packet.data());
+        t.stop();
+        mv[name](t.elapsed_microseconds());
+    };
+
     std::vector<std::function<void()>> all_methods = {
         [&]() { parse(parse_col{}, "col"); },
         [&]() { parse(parse_block<4>{}, "block4"); },
         [&]() { parse(parse_block<8>{}, "block8"); },
-        [&]() { parse(parse_block<16>{}, "block16"); }};
+        [&]() { parse(parse_block<16>{}, "block16"); },
+        [&]() { parse_fused(std::integral_constant<int, 4>{}, "fused4"); },
+        [&]() { parse_fused(std::integral_constant<int, 8>{}, "fused8"); },
+        [&]() {
+            parse_fused(std::integral_constant<int, 16>{}, "fused16");
+        }};
 
     std::default_random_engine g;
     std::vector<int> ids(all_methods.size());
@@ -210,7 +263,8 @@ TEST_P(ParsingBenchmarkTestFixture, ScanBatcherBenchTest) {
                << "[time]:" << styles["reset"] << styles["cyan"] << std::setw(4)
                << lround(best_time->second) << "μs, " << styles["reset"];
 
-            for (std::string name : {"col", "block4", "block8", "block16"}) {
+            for (std::string name : {"col", "block4", "block8", "block16",
+                                     "fused4", "fused8", "fused16"}) {
                 auto speedup = lround(100.0f * mv["col"] / mv[name]);
                 auto color_modifier =
                     name == best_time->first
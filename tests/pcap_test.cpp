@@ -7,8 +7,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <set>
+#include <vector>
 
+#include "ouster/impl/packet_writer.h"
 #include "ouster/indexed_pcap_reader.h"
 #include "ouster/os_pcap.h"
 
@@ -114,6 +119,379 @@ TEST(PcapReader, seek_past_end_of_file) {
     EXPECT_EQ(pcap.next_packet(), 0);
 }
 
+namespace {
+
+using bytes = std::vector<uint8_t>;
+
+void put(bytes& b, uint64_t v, int n, bool big_endian = false) {
+    for (int i = 0; i < n; ++i) {
+        const int shift = big_endian ? 8 * (n - 1 - i) : 8 * i;
+        b.push_back(static_cast<uint8_t>(v >> shift));
+    }
+}
+
+// IPv4 fragments of a UDP datagram from 10.0.0.2:7502 to 10.0.0.1:7502
+std::vector<bytes> udp_fragments(const bytes& payload, size_t frag_size,
+                                 uint16_t id) {
+    bytes udp;
+    put(udp, 7502, 2, true);
+    put(udp, 7502, 2, true);
+    put(udp, static_cast<uint32_t>(payload.size() + 8), 2, true);
+    put(udp, 0, 2);
+    udp.insert(udp.end(), payload.begin(), payload.end());
+
+    std::vector<bytes> frags;
+    for (size_t off = 0; off < udp.size(); off += frag_size) {
+        const size_t n = std::min(frag_size, udp.size() - off);
+        const bool more = off + n < udp.size();
+        bytes ip;
+        put(ip, 0x4500, 2, true);
+        put(ip, static_cast<uint32_t>(20 + n), 2, true);
+        put(ip, id, 2, true);
+        put(ip, (more ? 0x2000 : 0) | static_cast<uint32_t>(off / 8), 2, true);
+        put(ip, 0x4011, 2, true);  // ttl, UDP
+        put(ip, 0, 2);
+        put(ip, 0x0a000002, 4, true);
+        put(ip, 0x0a000001, 4, true);
+        ip.insert(ip.end(), udp.begin() + off, udp.begin() + off + n);
+        frags.push_back(ip);
+    }
+    return frags;
+}
+
+std::string write_file(const std::string& name, const bytes& b) {
+    const std::string path = ::testing::TempDir() + name;
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(b.data()), b.size());
+    return path;
+}
+
+}  // namespace
+
+/// it reads big endian, nanosecond pcaps with VLAN tagged ethernet frames
+TEST(PcapReader, big_endian_nanosecond_vlan) {
+    bytes payload(3000);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = i * 7;
+
+    bytes file;
+    put(file, 0xa1b23c4d, 4, true);
+    put(file, 0x00020004, 4, true);
+    put(file, 0, 8);
+    put(file, 65535, 4, true);
+    put(file, 1, 4, true);  // ethernet
+    const auto frags = udp_fragments(payload, 1480, 42);
+    // the last fragment first, then a duplicate
+    for (size_t i : {2, 0, 1, 1}) {
+        bytes frame(12, 0);
+        put(frame, 0x8100, 2, true);
+        put(frame, 5, 2, true);
+        put(frame, 0x0800, 2, true);
+        frame.insert(frame.end(), frags[i].begin(), frags[i].end());
+        frame.resize(std::max<size_t>(frame.size(), 64));  // padding
+        put(file, 10, 4, true);
+        put(file, 500000000 + i * 1000, 4, true);
+        put(file, static_cast<uint32_t>(frame.size()), 4, true);
+        put(file, static_cast<uint32_t>(frame.size()), 4, true);
+        file.insert(file.end(), frame.begin(), frame.end());
+    }
+
+    const std::string path = write_file("pcap_test_be.pcap", file);
+    PcapReader pcap(path);
+    ASSERT_EQ(pcap.next_packet(), payload.size());
+    EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + 3000), payload);
+    const packet_info& info = pcap.current_info();
+    EXPECT_EQ(info.src_ip, "10.0.0.2");
+    EXPECT_EQ(info.dst_ip, "10.0.0.1");
+    EXPECT_EQ(info.dst_port, 7502);
+    EXPECT_EQ(info.ip_version, 4);
+    EXPECT_EQ(info.fragments_in_packet, 3);
+    EXPECT_EQ(info.encapsulation_protocol, 1);
+    EXPECT_EQ(info.timestamp.count(), 10500001);
+    // the duplicated fragment doesn't make another packet
+    EXPECT_EQ(pcap.next_packet(), 0);
+    EXPECT_EQ(pcap.current_info().file_offset, file.size());
+    std::remove(path.c_str());
+}
+
+/// it reassembles interleaved datagrams and drops incomplete ones
+TEST(PcapReader, interleaved_fragments) {
+    bytes a(4000), b(3000, 0xbb), c(2000, 0xcc);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = i % 251;
+    const auto frags_a = udp_fragments(a, 1480, 1);
+    const auto frags_b = udp_fragments(b, 1480, 2);
+    auto frags_c = udp_fragments(c, 1480, 3);
+
+    bytes file;
+    put(file, 0xa1b2c3d4, 4);
+    put(file, 0x00040002, 4);
+    put(file, 0, 8);
+    put(file, 65535, 4);
+    put(file, 101, 4);  // raw IP
+    uint32_t sec = 0;
+    auto record = [&](const bytes& ip) {
+        put(file, sec, 4);
+        put(file, 0, 4);
+        put(file, static_cast<uint32_t>(ip.size()), 4);
+        put(file, static_cast<uint32_t>(ip.size()), 4);
+        file.insert(file.end(), ip.begin(), ip.end());
+    };
+    // c loses its first fragment, b and a are interleaved
+    record(frags_c[1]);
+    record(frags_b[1]);
+    record(frags_a[0]);
+    record(frags_b[0]);
+    record(frags_a[2]);
+    record(frags_b[2]);
+    record(frags_a[1]);
+    // the first fragment of c arrives after the timeout
+    sec = 5;
+    record(frags_c[0]);
+
+    const std::string path = write_file("pcap_test_frags.pcap", file);
+    PcapReader pcap(path);
+    ASSERT_EQ(pcap.next_packet(), b.size());
+    EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + b.size()), b);
+    ASSERT_EQ(pcap.next_packet(), a.size());
+    EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + a.size()), a);
+    EXPECT_EQ(pcap.current_info().encapsulation_protocol, 101);
+    EXPECT_EQ(pcap.next_packet(), 0);
+
+    // datagrams in progress are dropped by reset
+    pcap.reset();
+    ASSERT_EQ(pcap.next_packet(), b.size());
+    ASSERT_EQ(pcap.next_packet(), a.size());
+    EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + a.size()), a);
+    std::remove(path.c_str());
+}
+
+/// it skips IPv6 extension headers and drops IPv6 fragments
+TEST(PcapReader, ipv6_extension_headers) {
+    bytes payload(100);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = i;
+
+    // IPv6 packet with the given extension headers in front of a UDP
+    // datagram, from 2001:db8::2:7502 to 2001:db8::1:7502
+    auto ipv6 = [&](int next_header, const bytes& ext) {
+        bytes ip;
+        put(ip, 0x60000000, 4, true);
+        put(ip, static_cast<uint32_t>(ext.size() + 8 + payload.size()), 2,
+            true);
+        put(ip, next_header, 1);
+        put(ip, 64, 1);  // hop limit
+        for (uint32_t last : {2, 1}) {
+            put(ip, 0x20010db8, 4, true);
+            put(ip, 0, 8);
+            put(ip, last, 4, true);
+        }
+        ip.insert(ip.end(), ext.begin(), ext.end());
+        put(ip, 7502, 2, true);
+        put(ip, 7502, 2, true);
+        put(ip, static_cast<uint32_t>(payload.size() + 8), 2, true);
+        put(ip, 0, 2);
+        ip.insert(ip.end(), payload.begin(), payload.end());
+        return ip;
+    };
+
+    // hop-by-hop options padded to 16 bytes, then routing, destination
+    // options and an atomic fragment header
+    bytes ext;
+    put(ext, 43, 1);
+    put(ext, 1, 1);
+    ext.resize(16, 0);
+    for (int next_header : {60, 44}) {
+        put(ext, next_header, 1);
+        put(ext, 0, 1);
+        put(ext, 0, 6);
+    }
+    put(ext, 17, 1);
+    put(ext, 0, 1);
+    put(ext, 0, 2);  // offset 0, no more fragments
+    put(ext, 0x12345678, 4, true);
+
+    // the first fragment of a fragmented datagram
+    bytes frag;
+    put(frag, 17, 1);
+    put(frag, 0, 1);
+    put(frag, 1, 2, true);  // offset 0, more fragments
+    put(frag, 0x12345679, 4, true);
+
+    bytes file;
+    put(file, 0xa1b2c3d4, 4);
+    put(file, 0x00040002, 4);
+    put(file, 0, 8);
+    put(file, 65535, 4);
+    put(file, 101, 4);  // raw IP
+    for (const bytes& ip : {ipv6(44, frag), ipv6(0, ext)}) {
+        put(file, 0, 4);
+        put(file, 0, 4);
+        put(file, static_cast<uint32_t>(ip.size()), 4);
+        put(file, static_cast<uint32_t>(ip.size()), 4);
+        file.insert(file.end(), ip.begin(), ip.end());
+    }
+
+    const std::string path = write_file("pcap_test_ipv6.pcap", file);
+    PcapReader pcap(path);
+    ASSERT_EQ(pcap.next_packet(), payload.size());
+    EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + 100), payload);
+    const packet_info& info = pcap.current_info();
+    EXPECT_EQ(info.src_ip, "2001:db8::2");
+    EXPECT_EQ(info.dst_ip, "2001:db8::1");
+    EXPECT_EQ(info.dst_port, 7502);
+    EXPECT_EQ(info.ip_version, 6);
+    EXPECT_EQ(info.network_protocol, IANA_UDP);
+    EXPECT_EQ(info.packet_size, 40 + ext.size() + 8 + payload.size());
+    EXPECT_EQ(pcap.next_packet(), 0);
+    std::remove(path.c_str());
+}
+
+/// it reads pcapng files, skipping blocks that aren't packets
+TEST(PcapReader, pcapng) {
+    bytes payload(2000, 0x5a);
+    const auto frags = udp_fragments(payload, 1480, 7);
+
+    auto block = [](bytes& file, uint32_t type, const bytes& body) {
+        const auto len = static_cast<uint32_t>(12 + (body.size() + 3) / 4 * 4);
+        put(file, type, 4);
+        put(file, len, 4);
+        file.insert(file.end(), body.begin(), body.end());
+        file.resize(file.size() + (4 - body.size() % 4) % 4, 0);
+        put(file, len, 4);
+    };
+
+    bytes file, body;
+    put(body, 0x1a2b3c4d, 4);
+    put(body, 0x00000001, 4);
+    put(body, 0xffffffff, 4);
+    put(body, 0xffffffff, 4);
+    block(file, 0x0a0d0d0a, body);
+
+    body.clear();
+    put(body, 113, 2);  // linux cooked capture
+    put(body, 0, 2);
+    put(body, 0, 4);
+    put(body, 9, 2);  // if_tsresol: nanoseconds
+    put(body, 1, 2);
+    put(body, 9, 4);
+    put(body, 0, 4);  // opt_endofopt
+    block(file, 0x00000001, body);
+
+    // name resolution block
+    block(file, 0x00000004, bytes(8, 0));
+
+    const uint64_t first_packet = file.size();
+    const uint64_t ts = 1700000000123456789;
+    for (const bytes& frag : frags) {
+        body.clear();
+        put(body, 0, 4);
+        put(body, static_cast<uint32_t>(ts >> 32), 4);
+        put(body, static_cast<uint32_t>(ts), 4);
+        put(body, static_cast<uint32_t>(16 + frag.size()), 4);
+        put(body, static_cast<uint32_t>(16 + frag.size()), 4);
+        bytes sll(14, 0);
+        put(sll, 0x0800, 2, true);
+        body.insert(body.end(), sll.begin(), sll.end());
+        body.insert(body.end(), frag.begin(), frag.end());
+        block(file, 0x00000006, body);
+    }
+
+    const std::string path = write_file("pcap_test.pcapng", file);
+    PcapReader pcap(path);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(pcap.next_packet(), payload.size());
+        EXPECT_EQ(bytes(pcap.current_data(), pcap.current_data() + 2000),
+                  payload);
+        EXPECT_EQ(pcap.current_info().encapsulation_protocol, 113);
+        EXPECT_EQ(pcap.current_info().timestamp.count(), ts / 1000);
+        EXPECT_EQ(pcap.next_packet(), 0);
+        // the interface is known after seeking past its description
+        pcap.seek(first_packet);
+    }
+    std::remove(path.c_str());
+}
+
+/// it throws if the file isn't a pcap
+TEST(PcapReader, bad_file) {
+    const std::string path = write_file("pcap_test_bad.pcap", bytes(64, 1));
+    EXPECT_THROW(PcapReader{path}, std::runtime_error);
+    EXPECT_THROW(PcapReader{path + ".missing"}, std::runtime_error);
+    std::remove(path.c_str());
+}
+
+/// it parses and prints IPv4 and IPv6 addresses
+TEST(PcapReader, ip_address) {
+    EXPECT_TRUE(ip_address().empty());
+    EXPECT_TRUE(ip_address("").empty());
+
+    ip_address v4("192.168.10.1");
+    EXPECT_EQ(v4.version, 4);
+    EXPECT_EQ(v4.bytes[0], 192);
+    EXPECT_EQ(v4.bytes[3], 1);
+    EXPECT_EQ(v4.to_string(), "192.168.10.1");
+    EXPECT_EQ(ip_address("0.0.0.0").to_string(), "0.0.0.0");
+
+    ip_address v6("fe80::1");
+    EXPECT_EQ(v6.version, 6);
+    EXPECT_EQ(v6.to_string(), "fe80::1");
+
+    EXPECT_NE(v4, ip_address("192.168.10.2"));
+    EXPECT_EQ(v4, ip_address(std::string("192.168.10.1")));
+    EXPECT_THROW(ip_address("192.168.10"), std::invalid_argument);
+    EXPECT_THROW(ip_address("not an address"), std::invalid_argument);
+}
+
+inline int count_packets(PcapReader& pcap) {
+    int count = 0;
+    pcap.reset();
+    while (pcap.next_packet()) count++;
+    return count;
+}
+
+/// it skips the packets not matching the filter
+TEST(PcapReader, filter) {
+    // 8 lidar packets on port 7502 and 2 imu packets on 7503, from and to
+    // 127.0.0.1
+    auto data_dir = getenvs("DATA_DIR");
+    const std::string name = "/OS-1-128_767798045_1024x10_20230712_120049";
+    PcapReader pcap(data_dir + name + ".pcap");
+    const auto info = sensor::metadata_from_json(data_dir + name + ".json");
+    ASSERT_EQ(count_packets(pcap), 10);
+
+    packet_filter filter;
+    filter.dst_ports = {7502};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 8);
+    EXPECT_EQ(pcap.current_info().dst_port, 7502);
+
+    filter.dst_ports = {7503, 9000};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 2);
+
+    filter = packet_filter{};
+    filter.src_ips = {ip_address("127.0.0.1")};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 10);
+    EXPECT_EQ(pcap.current_info().src_ip.to_string(), "127.0.0.1");
+
+    filter.dst_ips = {ip_address("127.0.0.2")};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 0);
+
+    // packets of another size than the lidar packets are kept
+    filter = packet_filter{};
+    filter.serial_numbers = {std::stoull(info.sn)};
+    EXPECT_THROW(pcap.set_filter(filter), std::invalid_argument);
+    filter.lidar_formats = {&sensor::get_format(info)};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 10);
+
+    filter.serial_numbers = {1};
+    pcap.set_filter(filter);
+    EXPECT_EQ(count_packets(pcap), 2);
+
+    pcap.set_filter(packet_filter{});
+    EXPECT_EQ(count_packets(pcap), 10);
+}
+
 TEST(IndexedPcapReader, constructor) {
     // it should be constructed with the correct number of indices
     // and previous frame counts (one for each metadata file)
@@ -173,6 +551,311 @@ TEST(IndexedPcapReader, seek_to_frame) {
     EXPECT_THROW(pcap.index_.seek_to_frame(pcap, 1, 1), std::out_of_range);
 }
 
+/// it tells sensors on the same port apart by serial number
+TEST(IndexedPcapReader, sensor_idx_for_current_packet) {
+    auto data_dir = getenvs("DATA_DIR");
+    const std::string name = "/OS-1-128_767798045_1024x10_20230712_120049";
+    auto info = sensor::metadata_from_json(data_dir + name + ".json");
+    auto other = info;
+    other.sn = "1";
+
+    IndexedPcapReader pcap(data_dir + name + ".pcap",
+                           std::vector<sensor::sensor_info>{other, info});
+    ASSERT_TRUE(pcap.next_packet());
+    ASSERT_EQ(pcap.current_info().dst_port, 7502);
+    EXPECT_EQ(pcap.sensor_idx_for_current_packet(), size_t{1});
+
+    // the first sensor on the port is used without a matching serial number
+    IndexedPcapReader pcap2(data_dir + name + ".pcap",
+                            std::vector<sensor::sensor_info>{other, other});
+    ASSERT_TRUE(pcap2.next_packet());
+    EXPECT_EQ(pcap2.sensor_idx_for_current_packet(), size_t{0});
+
+    // no sensor on the imu port
+    while (pcap2.next_packet() && pcap2.current_info().dst_port == 7502) {
+    }
+    EXPECT_EQ(pcap2.current_info().dst_port, 7503);
+    EXPECT_FALSE(pcap2.sensor_idx_for_current_packet());
+}
+
+/// it starts a new frame when the init_id changes, and can be rebuilt
+TEST(IndexedPcapReader, build_index_init_id) {
+    // 8 lidar packets of the same frame
+    auto data_dir = getenvs("DATA_DIR");
+    const std::string name = "/OS-1-128_767798045_1024x10_20230712_120049";
+    const auto info = sensor::metadata_from_json(data_dir + name + ".json");
+
+    std::ifstream in(data_dir + name + ".pcap", std::ios::binary);
+    bytes file((std::istreambuf_iterator<char>(in)),
+               std::istreambuf_iterator<char>());
+
+    // the sensor was reinitialized from the 6th lidar packet on
+    const sensor::impl::packet_writer pw(sensor::get_format(info));
+    uint64_t reinit_offset = 0;
+    {
+        PcapReader pcap(data_dir + name + ".pcap");
+        int lidar_packets = 0;
+        while (pcap.next_packet()) {
+            const packet_info& pi = pcap.current_info();
+            if (pcap.current_length() != pw.lidar_packet_size) continue;
+            if (++lidar_packets < 6) continue;
+            if (!reinit_offset) reinit_offset = pi.file_offset;
+            // record header, then the headers up to the udp payload
+            const uint64_t payload =
+                pi.file_offset + 16 + pi.packet_size - pi.payload_size;
+            pw.set_init_id(file.data() + payload, info.init_id + 1);
+        }
+        ASSERT_EQ(lidar_packets, 8);
+    }
+
+    const std::string path = write_file("pcap_test_init_id.pcap", file);
+    {
+        IndexedPcapReader pcap(path, std::vector<sensor::sensor_info>{info});
+        for (int i = 0; i < 2; ++i) {
+            pcap.build_index();
+            ASSERT_EQ(pcap.index_.frame_count(0), 2);
+            EXPECT_EQ(pcap.index_.frame_indices_[0][0], 24);
+            EXPECT_EQ(pcap.index_.frame_indices_[0][1], reinit_offset);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+/// it finds the record boundaries after arbitrary offsets
+TEST(PcapReader, next_record_offset) {
+    auto data_dir = getenvs("DATA_DIR");
+    PcapReader pcap(data_dir + "/OS-2-128-U1_v2.3.0_1024x10.pcap");
+    std::vector<uint64_t> offsets;
+    while (pcap.next_packet()) {
+        offsets.push_back(pcap.current_info().file_offset);
+    }
+    ASSERT_GT(offsets.size(), 2);
+
+    const uint64_t size = pcap.file_size();
+    EXPECT_EQ(pcap.next_record_offset(0), offsets[0]);
+    EXPECT_EQ(pcap.next_record_offset(offsets[1]), offsets[1]);
+    EXPECT_EQ(pcap.next_record_offset(offsets[1] - 1), offsets[1]);
+    EXPECT_EQ(pcap.next_record_offset(offsets[1] + 1), offsets[2]);
+    EXPECT_EQ(pcap.next_record_offset(offsets.back() + 1), size);
+    EXPECT_EQ(pcap.next_record_offset(size + 1), size);
+}
+
+/// indexing in parallel gives the same index as serially
+TEST(IndexedPcapReader, build_index_parallel) {
+    auto data_dir = getenvs("DATA_DIR");
+    const std::string name = "/OS-1-128_767798045_1024x10_20230712_120049";
+    const auto info = sensor::metadata_from_json(data_dir + name + ".json");
+    const sensor::impl::packet_writer pw(sensor::get_format(info));
+
+    // 40 frames of 6 lidar packets and an imu packet, fragmented, 20 ms
+    // apart so that fragments held back don't time out
+    struct record {
+        uint32_t timestamp_us;
+        bytes ip;
+        bool first_fragment;
+    };
+    std::vector<record> records;
+    uint16_t ip_id = 0;
+    for (uint32_t f = 0; f < 40; ++f) {
+        // frame 10 is late, and the sensor is reinitialized at frame 25
+        const uint32_t frame_id = f == 10 ? 5 : f < 25 ? f + 1 : f - 24;
+        const uint32_t init_id = f < 25 ? info.init_id : info.init_id + 1;
+        for (uint32_t p = 0; p < 7; ++p) {
+            bytes payload(p < 6 ? pw.lidar_packet_size : 48);
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = static_cast<uint8_t>(i * 31 + f);
+            }
+            if (p < 6) {
+                pw.set_frame_id(payload.data(), frame_id);
+                pw.set_init_id(payload.data(), init_id);
+                pw.set_prod_sn(payload.data(), std::stoull(info.sn));
+            }
+            bool first = true;
+            for (bytes& ip : udp_fragments(payload, 1480, ip_id++)) {
+                records.push_back({f * 20000 + p * 1000, std::move(ip), first});
+                first = false;
+            }
+        }
+    }
+
+    auto pcap_file = [](const std::vector<record>& records) {
+        bytes file;
+        put(file, 0xa1b2c3d4, 4);
+        put(file, 0x00040002, 4);
+        put(file, 0, 8);
+        put(file, 65535, 4);
+        put(file, 101, 4);  // raw IP
+        for (const record& r : records) {
+            put(file, 0, 4);
+            put(file, r.timestamp_us, 4);
+            put(file, static_cast<uint32_t>(r.ip.size()), 4);
+            put(file, static_cast<uint32_t>(r.ip.size()), 4);
+            file.insert(file.end(), r.ip.begin(), r.ip.end());
+        }
+        return file;
+    };
+
+    auto expect_same_index = [](const PcapIndex& index,
+                                const PcapIndex& serial) {
+        EXPECT_EQ(index.frame_indices_, serial.frame_indices_);
+        EXPECT_EQ(index.frame_timestamp_indices_,
+                  serial.frame_timestamp_indices_);
+        EXPECT_EQ(index.frame_id_indices_, serial.frame_id_indices_);
+    };
+
+    const bytes file = pcap_file(records);
+    ASSERT_GT(file.size(), 3 * 1024 * 1024);
+    const std::string path = write_file("pcap_test_parallel.pcap", file);
+    {
+        IndexedPcapReader pcap(path, std::vector<sensor::sensor_info>{info});
+        EXPECT_EQ(pcap.build_index(1), 1);
+        const PcapIndex serial = pcap.index_;
+        ASSERT_EQ(serial.frame_count(0), 39);
+        EXPECT_EQ(serial.frame_id_indices_[0].size(), 25);
+
+        // the middle of the file splits a datagram
+        std::set<uint64_t> first_fragments;
+        uint64_t offset = 24;
+        for (const record& r : records) {
+            if (r.first_fragment) first_fragments.insert(offset);
+            offset += 16 + r.ip.size();
+        }
+        const uint64_t middle = pcap.next_record_offset(24 + file.size() / 2);
+        EXPECT_EQ(first_fragments.count(middle), 0);
+
+        for (unsigned int n_threads : {2, 3, 5, 8, 64}) {
+            EXPECT_EQ(pcap.build_index(n_threads), n_threads);
+            expect_same_index(pcap.index_, serial);
+            EXPECT_EQ(pcap.current_offset(), 24);
+        }
+    }
+
+    // the first fragment of the first packet of frame 30 is captured well
+    // over the range overlap before the rest of it, frames can only be
+    // indexed serially
+    std::vector<record> held_back = records;
+    for (size_t i = 0; i < held_back.size(); ++i) {
+        if (held_back[i].timestamp_us == 30 * 20000) {
+            record r = held_back[i];
+            held_back.erase(held_back.begin() + i);
+            held_back.insert(held_back.begin(), std::move(r));
+            break;
+        }
+    }
+    const std::string held_back_path =
+        write_file("pcap_test_parallel_held_back.pcap", pcap_file(held_back));
+    {
+        IndexedPcapReader pcap(held_back_path,
+                               std::vector<sensor::sensor_info>{info});
+        EXPECT_EQ(pcap.build_index(1), 1);
+        const PcapIndex serial = pcap.index_;
+        ASSERT_EQ(serial.frame_count(0), 39);
+        for (unsigned int n_threads : {2, 5}) {
+            EXPECT_EQ(pcap.build_index(n_threads), 1);
+            expect_same_index(pcap.index_, serial);
+        }
+    }
+
+    // pcapng files are indexed serially
+    bytes pcapng;
+    auto block = [&pcapng](uint32_t type, const bytes& body) {
+        const auto len = static_cast<uint32_t>(12 + (body.size() + 3) / 4 * 4);
+        put(pcapng, type, 4);
+        put(pcapng, len, 4);
+        pcapng.insert(pcapng.end(), body.begin(), body.end());
+        pcapng.resize(pcapng.size() + (4 - body.size() % 4) % 4, 0);
+        put(pcapng, len, 4);
+    };
+    bytes body;
+    put(body, 0x1a2b3c4d, 4);
+    put(body, 0x00000001, 4);
+    put(body, 0xffffffff, 8);
+    block(0x0a0d0d0a, body);
+    body.clear();
+    put(body, 101, 2);  // raw IP
+    put(body, 0, 6);
+    block(0x00000001, body);
+    for (const record& r : records) {
+        body.clear();
+        put(body, 0, 4);
+        put(body, 0, 4);
+        put(body, r.timestamp_us, 4);
+        put(body, static_cast<uint32_t>(r.ip.size()), 4);
+        put(body, static_cast<uint32_t>(r.ip.size()), 4);
+        body.insert(body.end(), r.ip.begin(), r.ip.end());
+        block(0x00000006, body);
+    }
+    const std::string pcapng_path =
+        write_file("pcap_test_parallel.pcapng", pcapng);
+    {
+        IndexedPcapReader pcap(pcapng_path,
+                               std::vector<sensor::sensor_info>{info});
+        EXPECT_EQ(pcap.build_index(1), 1);
+        const PcapIndex serial = pcap.index_;
+        ASSERT_EQ(serial.frame_count(0), 39);
+        EXPECT_EQ(pcap.build_index(4), 1);
+        expect_same_index(pcap.index_, serial);
+    }
+
+    std::remove(path.c_str());
+    std::remove(held_back_path.c_str());
+    std::remove(pcapng_path.c_str());
+}
+
+/// it saves the index and only loads it back for the same pcap and sensors
+TEST(IndexedPcapReader, save_load_index) {
+    auto data_dir = getenvs("DATA_DIR");
+    const std::string name = data_dir + "/OS-2-128-U1_v2.3.0_1024x10";
+    const auto info = sensor::metadata_from_json(name + ".json");
+
+    std::ifstream in(name + ".pcap", std::ios::binary);
+    const bytes file((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    const std::string path = write_file("pcap_test_index.pcap", file);
+    const std::string index_file = path + ".idx";
+
+    IndexedPcapReader pcap(path, std::vector<sensor::sensor_info>{info});
+    EXPECT_FALSE(pcap.load_index(index_file));
+    pcap.build_index();
+    ASSERT_GT(pcap.index_.frame_count(0), 0);
+    pcap.save_index(index_file);
+
+    IndexedPcapReader pcap2(path, std::vector<sensor::sensor_info>{info});
+    EXPECT_TRUE(pcap2.load_index(index_file));
+    EXPECT_EQ(pcap2.index_.frame_indices_, pcap.index_.frame_indices_);
+    EXPECT_EQ(pcap2.index_.frame_timestamp_indices_,
+              pcap.index_.frame_timestamp_indices_);
+    EXPECT_EQ(pcap2.index_.frame_id_indices_, pcap.index_.frame_id_indices_);
+
+    // other sensors
+    auto other = info;
+    other.config.udp_port_lidar = 7000;
+    IndexedPcapReader pcap3(path, std::vector<sensor::sensor_info>{other});
+    EXPECT_FALSE(pcap3.load_index(index_file));
+    IndexedPcapReader pcap4(path,
+                            std::vector<sensor::sensor_info>{info, info});
+    EXPECT_FALSE(pcap4.load_index(index_file));
+
+    // another pcap
+    write_file("pcap_test_index.pcap", bytes(file.begin(), file.end() - 100));
+    IndexedPcapReader pcap5(path, std::vector<sensor::sensor_info>{info});
+    EXPECT_FALSE(pcap5.load_index(index_file));
+
+    // a truncated index
+    pcap5.build_index();
+    pcap5.save_index(index_file);
+    EXPECT_TRUE(pcap5.load_index(index_file));
+    std::ifstream idx_in(index_file, std::ios::binary);
+    const bytes idx((std::istreambuf_iterator<char>(idx_in)),
+                    std::istreambuf_iterator<char>());
+    idx_in.close();
+    write_file("pcap_test_index.pcap.idx", bytes(idx.begin(), idx.end() - 4));
+    EXPECT_FALSE(pcap5.load_index(index_file));
+
+    std::remove(index_file.c_str());
+    std::remove(path.c_str());
+}
+
 TEST(IndexedPcapReader, frame_id_rolled_over) {
     EXPECT_TRUE(IndexedPcapReader::frame_id_rolled_over(65535, 0));
     EXPECT_TRUE(IndexedPcapReader::frame_id_rolled_over(65290, 100));
@@ -475,6 +475,68 @@ TEST_P(ScanBatcherTest, scan_batcher_wraparound_test) {
     ouster::impl::foreach_channel_field(ls, pf, test_fields);
 }
 
+TEST_P(ScanBatcherTest, scan_batcher_field_set_change_test) {
+    auto param = GetParam();
+    UDPProfileLidar profile = std::get<0>(param);
+    size_t columns_per_frame = std::get<1>(param);
+    size_t pixels_per_column = std::get<2>(param);
+    size_t columns_per_packet = std::get<3>(param);
+
+    auto packets = random_frame(profile, columns_per_frame, pixels_per_column,
+                                columns_per_packet);
+    packet_format pf(profile, pixels_per_column, columns_per_packet);
+    auto new_scan = [&]() {
+        return LidarScan(columns_per_frame, pixels_per_column, profile,
+                         columns_per_packet);
+    };
+
+    auto ref = new_scan();
+    ScanBatcher ref_batcher(columns_per_frame, pf);
+    for (const auto& p : packets) ref_batcher(p, ref);
+
+    auto expect_parsed = [&](const LidarScan& ls) {
+        for (const auto& ft : pf) {
+            if (!ls.has_field(ft.first)) continue;
+            img_t<uint64_t> expected, actual;
+            ouster::impl::visit_field(ref, ft.first,
+                                      ouster::impl::read_and_cast(), expected);
+            ouster::impl::visit_field(ls, ft.first,
+                                      ouster::impl::read_and_cast(), actual);
+            EXPECT_TRUE((expected == actual).all()) << ft.first;
+        }
+    };
+
+    // a single batcher parsing into scans with different field sets has to
+    // pick up the fields of each scan
+    ScanBatcher batcher(columns_per_frame, pf);
+    auto ls = new_scan();
+    for (const auto& p : packets) batcher(p, ls);
+    expect_parsed(ls);
+
+    auto widened = new_scan();
+    widened.del_field(ChanField::RANGE);
+    widened.add_field({ChanField::RANGE, ChanFieldType::UINT64});
+    for (const auto& p : packets) batcher(p, widened);
+    expect_parsed(widened);
+
+    // replaced in place under the same name, possibly at the old address,
+    // but with another layout
+    auto zero = [](auto ref_field, const std::string&) { ref_field = 0; };
+    ls.del_field(ChanField::RANGE);
+    ls.add_field({ChanField::RANGE, ChanFieldType::UINT64});
+    ouster::impl::foreach_channel_field(ls, pf, zero);
+    ls.frame_id = -1;
+    for (const auto& p : packets) batcher(p, ls);
+    expect_parsed(ls);
+
+    ls.del_field(ChanField::RANGE);
+    ouster::impl::foreach_channel_field(ls, pf, zero);
+    ls.frame_id = -1;
+    for (const auto& p : packets) batcher(p, ls);
+    EXPECT_FALSE(ls.has_field(ChanField::RANGE));
+    expect_parsed(ls);
+}
+
 using HashMap = std::map<std::string, size_t>;
 using snapshot_param = std::tuple<std::string, std::string, HashMap>;
 class ScanBatcherSnapshotTest
@@ -7,10 +7,15 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <mutex>
 #include <numeric>
 #include <thread>
 #include <unordered_set>
 
+#include "ouster/impl/client_poller.h"
 #include "ouster/pcap.h"
 #include "ouster/types.h"
 #include "ouster/udp_packet_source.h"
@@ -79,6 +84,256 @@ TEST(UdpQueueTest, ring_buffer_test) {
     EXPECT_EQ(writes, reads);
 }
 
+TEST(UdpQueueTest, ring_buffer_batch_test) {
+    RingBuffer<int> rb{10, 0};
+
+    EXPECT_EQ(rb.space(), 10);
+
+    // write a batch into consecutive free slots, then commit it at once
+    for (int i = 0; i < 4; ++i) rb.back(i) = i;
+    EXPECT_EQ(rb.size(), 0);
+    EXPECT_NO_THROW(rb.push(4));
+    EXPECT_EQ(rb.size(), 4);
+    EXPECT_EQ(rb.space(), 6);
+    EXPECT_THROW(rb.push(7), std::overflow_error);
+
+    // wrap around the end of the underlying storage
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(rb.front(), i);
+        rb.pop();
+    }
+    for (int i = 0; i < 10; ++i) rb.back(i) = 100 + i;
+    EXPECT_NO_THROW(rb.push(10));
+    EXPECT_TRUE(rb.full());
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(rb.front(), 100 + i);
+        rb.pop();
+    }
+    EXPECT_TRUE(rb.empty());
+}
+
+static void send_localhost(int port,
+                           const std::vector<std::vector<uint8_t>>& datagrams) {
+    SOCKET sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_TRUE(impl::socket_valid(sockfd));
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr("127.0.0.1");
+    dest.sin_port = htons(static_cast<uint16_t>(port));
+    for (const auto& d : datagrams) {
+        sendto(sockfd, (const char*)d.data(), d.size(), 0,
+               (const sockaddr*)&dest, sizeof(dest));
+    }
+    impl::socket_close(sockfd);
+}
+
+TEST(UdpQueueTest, read_lidar_packets_batch_test) {
+    auto cli = init_client("127.0.0.1", 0, 0);
+    ASSERT_TRUE(cli);
+
+    const size_t packet_size = 1024;
+    const int n_packets = 5;
+    std::vector<std::vector<uint8_t>> datagrams;
+    for (int i = 0; i < n_packets; ++i) {
+        // a packet of unexpected size is dropped
+        if (i == 2) datagrams.emplace_back(packet_size / 2, 0xff);
+        datagrams.emplace_back(packet_size, static_cast<uint8_t>(i));
+    }
+    send_localhost(get_lidar_port(*cli), datagrams);
+
+    std::vector<LidarPacket> packets(2 * n_packets, LidarPacket(packet_size));
+    size_t total = 0;
+    while (total < static_cast<size_t>(n_packets)) {
+        auto st = poll_client(*cli, 1);
+        ASSERT_TRUE(st & client_state::LIDAR_DATA);
+        total += read_lidar_packets(*cli, packets.data() + total,
+                                    packets.size() - total);
+    }
+
+    EXPECT_EQ(total, n_packets);
+    for (int i = 0; i < n_packets; ++i) {
+        EXPECT_EQ(packets[i].buf,
+                  std::vector<uint8_t>(packet_size, static_cast<uint8_t>(i)));
+        EXPECT_NE(packets[i].host_timestamp, 0u);
+    }
+}
+
+// other platforms read a single datagram per call without recvmmsg
+#if defined(__linux__)
+TEST(UdpQueueTest, read_packets_drained_test) {
+    auto cli = init_client("127.0.0.1", 0, 0);
+    ASSERT_TRUE(cli);
+
+    const size_t packet_size = 64;
+    std::vector<LidarPacket> packets(4, LidarPacket(packet_size));
+    Packet* ptrs[4];
+    for (size_t i = 0; i < 4; ++i) ptrs[i] = &packets[i];
+
+    // slots of dropped packets are refilled; the socket is not drained until
+    // it returns fewer datagrams than requested
+    send_localhost(get_lidar_port(*cli),
+                   {std::vector<uint8_t>(packet_size, 1),
+                    std::vector<uint8_t>(packet_size / 2, 0xff),
+                    std::vector<uint8_t>(packet_size + 1, 0xff),
+                    std::vector<uint8_t>(packet_size, 2),
+                    std::vector<uint8_t>(packet_size, 3),
+                    std::vector<uint8_t>(packet_size, 4),
+                    std::vector<uint8_t>(packet_size, 5)});
+    ASSERT_TRUE(poll_client(*cli, 1) & client_state::LIDAR_DATA);
+
+    bool drained = true;
+    EXPECT_EQ(impl::read_packets(*cli, client_state::LIDAR_DATA, ptrs, 4,
+                                 drained),
+              4u);
+    EXPECT_FALSE(drained);
+    for (size_t i = 0; i < 4; ++i) {
+        auto expected = static_cast<uint8_t>(i + 1);
+        EXPECT_EQ(packets[i].buf, std::vector<uint8_t>(packet_size, expected));
+    }
+
+    EXPECT_EQ(impl::read_packets(*cli, client_state::LIDAR_DATA, ptrs, 4,
+                                 drained),
+              1u);
+    EXPECT_TRUE(drained);
+    EXPECT_EQ(packets[0].buf, std::vector<uint8_t>(packet_size, 5));
+
+    EXPECT_EQ(impl::read_packets(*cli, client_state::LIDAR_DATA, ptrs, 4,
+                                 drained),
+              0u);
+    EXPECT_TRUE(drained);
+}
+#endif
+
+TEST(UdpQueueTest, client_poller_test) {
+    const size_t packet_size = 64;
+    std::vector<std::shared_ptr<client>> clients;
+    for (int i = 0; i < 4; ++i) {
+        clients.push_back(init_client("127.0.0.1", 0, 0));
+        ASSERT_TRUE(clients.back());
+    }
+
+    auto poller = make_poller();
+    auto poll_all = [&](int timeout_sec) {
+        reset_poll(*poller);
+        for (auto& cli : clients) set_poll(*poller, *cli);
+        return poll(*poller, timeout_sec);
+    };
+    auto drain = [&](const client& cli, client_state st) {
+        std::vector<LidarPacket> lidar_packets(8, LidarPacket(packet_size));
+        std::vector<ImuPacket> imu_packets(8, ImuPacket(packet_size));
+        size_t n = st == client_state::LIDAR_DATA
+                       ? read_lidar_packets(cli, lidar_packets.data(),
+                                            lidar_packets.size())
+                       : read_imu_packets(cli, imu_packets.data(),
+                                          imu_packets.size());
+        clear_poll(*poller, cli, st);
+        return n;
+    };
+
+    // sockets may initially be reported as ready until drained
+    poll_all(0);
+    for (auto& cli : clients) {
+        auto st = get_poll(*poller, *cli);
+        if (st & client_state::LIDAR_DATA) {
+            EXPECT_EQ(drain(*cli, client_state::LIDAR_DATA), 0u);
+        }
+        if (st & client_state::IMU_DATA) {
+            EXPECT_EQ(drain(*cli, client_state::IMU_DATA), 0u);
+        }
+    }
+    EXPECT_EQ(poll_all(0), 0);
+
+    send_localhost(get_lidar_port(*clients[1]),
+                   {std::vector<uint8_t>(packet_size, 1),
+                    std::vector<uint8_t>(packet_size, 2)});
+    send_localhost(get_imu_port(*clients[3]),
+                   {std::vector<uint8_t>(packet_size, 3)});
+
+    int ready = 0;
+    for (int tries = 0; ready < 2 && tries < 10; ++tries) ready = poll_all(1);
+    EXPECT_EQ(ready, 2);
+    EXPECT_EQ(get_poll(*poller, *clients[0]), client_state(0));
+    EXPECT_EQ(get_poll(*poller, *clients[1]), client_state::LIDAR_DATA);
+    EXPECT_EQ(get_poll(*poller, *clients[2]), client_state(0));
+    EXPECT_EQ(get_poll(*poller, *clients[3]), client_state::IMU_DATA);
+
+    // stays ready until cleared
+    EXPECT_EQ(poll_all(0), 2);
+    EXPECT_EQ(drain(*clients[1], client_state::LIDAR_DATA), 2u);
+    EXPECT_EQ(drain(*clients[3], client_state::IMU_DATA), 1u);
+    EXPECT_EQ(poll_all(0), 0);
+    EXPECT_EQ(get_error(*poller), client_state::TIMEOUT);
+}
+
+TEST(UdpQueueTest, packet_lease_test) {
+    const size_t packet_size = 256;
+    const int n_packets = 3;
+    auto cli = init_client("127.0.0.1", 0, 0);
+    ASSERT_TRUE(cli);
+    int port = get_lidar_port(*cli);
+
+    BufferedUDPSource source(cli, 8, packet_size, 8, 48);
+    std::thread producer(&BufferedUDPSource::produce, &source);
+
+    std::vector<std::vector<uint8_t>> datagrams;
+    for (int i = 0; i < n_packets; ++i)
+        datagrams.emplace_back(packet_size, static_cast<uint8_t>(i));
+    send_localhost(port, datagrams);
+
+    PacketLease lease;
+    for (int i = 0; i < n_packets; ++i) {
+        auto st = source.consume(lease, 1.0);
+        ASSERT_EQ(st, client_state::LIDAR_DATA);
+        ASSERT_TRUE(lease);
+        EXPECT_EQ(lease.event().state, client_state::LIDAR_DATA);
+
+        // lease points straight into the ring buffer slot
+        EXPECT_EQ(lease.lidar_packet().buf.data(),
+                  source.packet(client_state::LIDAR_DATA).buf.data());
+        EXPECT_EQ(lease.lidar_packet().buf,
+                  std::vector<uint8_t>(packet_size, static_cast<uint8_t>(i)));
+        // the slot is held until the lease is released
+        EXPECT_GE(source.size(), 1u);
+    }
+    lease.release();
+    EXPECT_FALSE(lease);
+    EXPECT_EQ(source.size(), 0u);
+
+    source.shutdown();
+    producer.join();
+}
+
+TEST(UdpQueueTest, event_queue_timeout_test) {
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::milliseconds;
+    EventQueue eq;
+
+    // grow the spin budget by letting consumers catch pushes while spinning
+    std::thread producer([&eq] {
+        for (int i = 0; i < 64; ++i) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            eq.push({0, client_state::LIDAR_DATA});
+        }
+    });
+    for (int i = 0; i < 64; ++i) eq.pop();
+    producer.join();
+
+    auto t0 = clock::now();
+    EXPECT_EQ(eq.pop(0.0f).state, client_state::TIMEOUT);
+    EXPECT_LT(clock::now() - t0, ms(5));
+
+    t0 = clock::now();
+    EXPECT_EQ(eq.next(0.01f, {{0, client_state::LIDAR_DATA}}).state,
+              client_state::TIMEOUT);
+    auto elapsed = clock::now() - t0;
+    EXPECT_GE(elapsed, ms(10));
+    EXPECT_LT(elapsed, ms(100));
+
+    eq.push({0, client_state::IMU_DATA});
+    EXPECT_EQ(eq.pop(0.0f).state, client_state::IMU_DATA);
+}
+
 TEST(UdpQueueTest, event_queue_tests) {
     auto eq = std::make_shared<EventQueue>();
 
@@ -138,6 +393,159 @@ TEST(UdpQueueTest, event_queue_tests) {
     }
 }
 
+namespace {
+
+/*
+ * Previous producer -> subscriber path, kept as a reference for the
+ * benchmark below: CAS loop ring buffer with modulo indexing and a queue
+ * taking a lock and waking every waiter on each event.
+ */
+template <typename T>
+class LegacyRingBuffer {
+    std::atomic<size_t> r_idx_, w_idx_;
+    std::vector<T> bufs_;
+
+    size_t _capacity() const { return bufs_.size(); }
+
+   public:
+    LegacyRingBuffer(size_t size, T value = {})
+        : r_idx_(0), w_idx_(0), bufs_(size + 1, value) {}
+
+    bool empty() const { return w_idx_ == r_idx_; }
+    bool full() const { return r_idx_ == ((w_idx_ + 1) % _capacity()); }
+    T& front() { return bufs_[r_idx_]; }
+    T& back() { return bufs_[w_idx_]; }
+
+    void pop() {
+        size_t read_idx = r_idx_.load();
+        while (!r_idx_.compare_exchange_strong(read_idx,
+                                               (read_idx + 1) % _capacity())) {
+        }
+    }
+
+    void push() {
+        size_t write_idx = r_idx_.load();
+        while (!w_idx_.compare_exchange_strong(write_idx,
+                                               (write_idx + 1) % _capacity())) {
+        }
+    }
+};
+
+class LegacyEventQueue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Event> q;
+
+   public:
+    void push(Event e) {
+        {
+            std::lock_guard<std::mutex> lock{m};
+            q.push_back(e);
+        }
+        cv.notify_all();
+    }
+
+    Event pop() {
+        Event e;
+        {
+            std::unique_lock<std::mutex> lock{m};
+            cv.wait(lock, [this] { return !q.empty(); });
+            e = q.front();
+            q.pop_front();
+        }
+        cv.notify_all();
+        return e;
+    }
+};
+
+/*
+ * Run n_packets through a ring buffer + event queue pair with one producer and
+ * one consumer thread, returning elapsed time in microseconds.
+ */
+template <typename Push, typename Pop>
+int64_t run_queue_bench(int n_packets, Push&& push, Pop&& pop) {
+    Timer t;
+    t.start();
+    std::thread producer([&] {
+        for (int i = 0; i < n_packets;) i += push(i);
+    });
+    uint64_t sum = 0;
+    for (int i = 0; i < n_packets; ++i) sum += pop();
+    producer.join();
+    t.stop();
+    EXPECT_EQ(sum, uint64_t(n_packets) * (n_packets - 1) / 2);
+    return t.elapsed_microseconds();
+}
+
+}  // namespace
+
+TEST(UdpQueueTest, event_queue_benchmark) {
+    std::map<std::string, std::string> styles = term_styles();
+
+    constexpr int N_PACKETS = 200000;
+    constexpr size_t BUF_SIZE = 1024;
+    constexpr int BATCH = 16;
+
+    int64_t legacy_us = 0;
+    {
+        LegacyRingBuffer<int> rb{BUF_SIZE, 0};
+        LegacyEventQueue q;
+        legacy_us = run_queue_bench(
+            N_PACKETS,
+            [&](int i) {
+                if (rb.full()) {
+                    std::this_thread::yield();
+                    return 0;
+                }
+                rb.back() = i;
+                rb.push();
+                q.push({0, client_state::LIDAR_DATA});
+                return 1;
+            },
+            [&] {
+                q.pop();
+                int v = rb.front();
+                rb.pop();
+                return v;
+            });
+    }
+
+    int64_t batched_us = 0;
+    {
+        RingBuffer<int> rb{BUF_SIZE, 0};
+        EventQueue q;
+        batched_us = run_queue_bench(
+            N_PACKETS,
+            [&](int i) {
+                int n = std::min<int>(
+                    {static_cast<int>(rb.space()), BATCH, N_PACKETS - i});
+                if (n == 0) {
+                    std::this_thread::yield();
+                    return 0;
+                }
+                for (int k = 0; k < n; ++k) rb.back(k) = i + k;
+                rb.push(n);
+                q.push({0, client_state::LIDAR_DATA}, n);
+                return n;
+            },
+            [&] {
+                q.pop();
+                int v = rb.front();
+                rb.pop();
+                return v;
+            });
+    }
+
+    std::cout << styles["bold"] << "event queue, " << N_PACKETS
+              << " packets: " << styles["reset"] << "legacy: " << styles["cyan"]
+              << legacy_us << "μs" << styles["reset"]
+              << ", spsc + batched: " << styles["cyan"] << batched_us << "μs"
+              << styles["reset"] << ", speedup: " << styles["green"]
+              << std::setprecision(3)
+              << static_cast<double>(legacy_us) / std::max<int64_t>(batched_us, 1)
+              << "x" << styles["reset"] << std::endl;
+}
+
 using str_pair = std::pair<std::string, std::string>;
 class UdpQueuePcapTest : public ::testing::TestWithParam<str_pair> {};
 